@@ -0,0 +1,101 @@
+#include "benchmark.h"
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "digidaw/core/audio/effects/convolution.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * 16 stereo buses, every one with a Convolution of its own 10 second true stereo impulse response,
+ * processed one block after the other at the pace the audio callback would (the tail stages run on the background workers in between).
+ *
+ * Reports the time the audio thread spends per second of audio (under 100% is realtime), and its slowest block,
+ * which includes any wait on a background job that's late.
+ */
+
+static constexpr unsigned int sampleRate = 48000;
+static constexpr unsigned int blockFrames = 512;
+static constexpr unsigned int nBuses = 16;
+static constexpr unsigned int nChannels = 2;
+static constexpr unsigned int impulseSeconds = 10;
+static constexpr unsigned int runSeconds = 10;
+
+static void FillNoise(AudioBuffer& buffer, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+	for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+		for (unsigned int frame = 0; frame < buffer.GetFrameCount(); ++frame)
+			buffer.GetChannel(channel)[frame] = distribution(random);
+}
+
+// Exponentially decaying noise, like a hall.
+static std::vector<std::vector<float>> MakeImpulseResponse(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	const std::size_t nFrames = static_cast<std::size_t>(impulseSeconds) * sampleRate;
+
+	std::vector<std::vector<float>> impulseResponse(nChannels * nChannels, std::vector<float>(nFrames));
+	for (std::vector<float>& channel : impulseResponse)
+		for (std::size_t frame = 0; frame < nFrames; ++frame)
+			channel[frame] = distribution(random) * 0.01f * std::exp(-6.9f * static_cast<float>(frame) / nFrames);
+	return impulseResponse;
+}
+
+static void Run(const char* name, bool zeroLatency, unsigned int headBlockSize)
+{
+	std::mt19937 random(1);
+
+	std::vector<AudioBuffer> inputs;
+	std::vector<AudioBuffer> buffers;
+	std::vector<std::unique_ptr<Effects::Convolution>> buses;
+	for (unsigned int bus = 0; bus < nBuses; ++bus)
+	{
+		inputs.emplace_back(nChannels, blockFrames);
+		FillNoise(inputs.back(), random);
+		buffers.emplace_back(nChannels, blockFrames);
+
+		buses.push_back(std::make_unique<Effects::Convolution>(zeroLatency, headBlockSize));
+		buses.back()->Prepare(nChannels, blockFrames, sampleRate);
+		buses.back()->SetImpulseResponse(MakeImpulseResponse(random), Effects::Convolution::Routing::Matrix);
+	}
+
+	const unsigned int nBlocks = runSeconds * sampleRate / blockFrames;
+	const std::chrono::duration<double> blockDuration(static_cast<double>(blockFrames) / sampleRate);
+	const auto runStart = std::chrono::steady_clock::now();
+	double totalSeconds = 0.0;
+	double slowestBlock = 0.0;
+	for (unsigned int block = 0; block < nBlocks; ++block)
+	{
+		std::this_thread::sleep_until(runStart + block * blockDuration);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned int bus = 0; bus < nBuses; ++bus)
+		{
+			Bench::Benchmark::Restore(inputs[bus], buffers[bus]);
+			buses[bus]->Process(buffers[bus].GetView());
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		totalSeconds += seconds;
+		slowestBlock = std::max(slowestBlock, seconds);
+	}
+	Bench::Benchmark::Consume(buffers[0].GetChannel(0)[0]);
+
+	Bench::Benchmark::Report((std::string(name) + ", audio thread").c_str(), 100.0 * totalSeconds / runSeconds, "% of realtime");
+	Bench::Benchmark::Report((std::string(name) + ", slowest block").c_str(), 100.0 * slowestBlock / blockDuration.count(), "% of a block");
+}
+
+int main()
+{
+	Bench::Benchmark::Title("Convolution, 16 true stereo buses, 10 second impulse responses, 512 frame blocks at 48 kHz");
+	Run("128 frame head", false, 128);
+	Run("128 frame head, zero latency", true, 128);
+	Run("512 frame head", false, 512);
+
+	return 0;
+}
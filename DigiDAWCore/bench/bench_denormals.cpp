@@ -0,0 +1,79 @@
+#include "benchmark.h"
+
+#include <vector>
+
+#include "digidaw/core/threading/denormals.h"
+
+using namespace DigiDAW::Core;
+
+/*
+ * A one-pole IIR filter (y = x + a * y) on 64 channels of 512 frames of silence, like the tail of a filter or a reverb,
+ * with its state starting out in the normal range, and in the denormal range with and without a DenormalGuard.
+ */
+
+static constexpr unsigned int blockFrames = 512;
+static constexpr unsigned int nChannels = 64;
+static constexpr float coefficient = 0.9999f; // Slow enough that the state stays in the same range for the whole block.
+
+class OnePole
+{
+private:
+	std::vector<float> buffer;
+	std::vector<float> state;
+public:
+	OnePole()
+	{
+		this->buffer = std::vector<float>(static_cast<std::size_t>(nChannels) * blockFrames, 0.0f);
+		this->state = std::vector<float>(nChannels, 0.0f);
+	}
+
+	// Starts every channel from the same state, with silence as the input, so every call does the same work.
+	void Process(float initialState)
+	{
+		std::fill(state.begin(), state.end(), initialState);
+		std::fill(buffer.begin(), buffer.end(), 0.0f);
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+		{
+			float* samples = &buffer[static_cast<std::size_t>(channel) * blockFrames];
+			float y = state[channel];
+			for (unsigned int frame = 0; frame < blockFrames; ++frame)
+			{
+				y = samples[frame] + coefficient * y;
+				samples[frame] = y;
+			}
+			state[channel] = y;
+		}
+	}
+
+	float GetOutput() const
+	{
+		return buffer.back();
+	}
+};
+
+int main()
+{
+	const float normal = 1.0f;
+	const float denormal = std::numeric_limits<float>::min() / 4.0f;
+
+	OnePole filter;
+	const double blockSeconds = static_cast<double>(blockFrames) / 48000.0;
+
+	Bench::Benchmark::Title("One-pole IIR, 64 channels, 512 frame blocks of silence (% of a block at 48 kHz)");
+
+	const double normalSeconds = Bench::Benchmark::Time([&]() { filter.Process(normal); }, 1000);
+	Bench::Benchmark::Report("Normal state", 100.0 * normalSeconds / blockSeconds, "%");
+
+	const double denormalSeconds = Bench::Benchmark::Time([&]() { filter.Process(denormal); }, 1000);
+	Bench::Benchmark::Report("Denormal state, without a DenormalGuard", 100.0 * denormalSeconds / blockSeconds, "%");
+	Bench::Benchmark::Consume(filter.GetOutput());
+
+	{
+		Threading::DenormalGuard guard;
+		const double guardedSeconds = Bench::Benchmark::Time([&]() { filter.Process(denormal); }, 1000);
+		Bench::Benchmark::Report("Denormal state, with a DenormalGuard", 100.0 * guardedSeconds / blockSeconds, "%");
+		Bench::Benchmark::Consume(filter.GetOutput());
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include "benchmark.h"
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "digidaw/core/audio/engine.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * How long the Engine takes to start on the first API RtAudio was compiled with, without a device cache (so its devices are probed first)
+ * and with one from the run before, and how long the device probe thread takes to probe every API in the background either way.
+ * The probing depends entirely on the devices (and drivers) of the machine it runs on, so only compare runs on the same machine.
+ */
+
+static constexpr unsigned int nRuns = 5;
+
+struct Startup
+{
+	double constructSeconds;
+	double probeSeconds; // From the start of the constructor.
+};
+
+static Startup Start(RtAudio::Api api, const std::filesystem::path& cachePath)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<Engine> engine = std::make_unique<Engine>(api, cachePath);
+	const auto constructed = std::chrono::steady_clock::now();
+	engine->ReconcileDevices(true); // Also saves the cache for the next run.
+	const auto probed = std::chrono::steady_clock::now();
+
+	return { std::chrono::duration<double>(constructed - start).count(), std::chrono::duration<double>(probed - start).count() };
+}
+
+int main()
+{
+	std::vector<RtAudio::Api> compiledAPIs;
+	RtAudio::getCompiledApi(compiledAPIs);
+	const RtAudio::Api api = compiledAPIs.empty() ? Engine::virtualAPI : compiledAPIs.front();
+
+	const std::filesystem::path cachePath = std::filesystem::temp_directory_path() / "digidaw_bench_device_cache";
+
+	Bench::Benchmark::Title(("Engine startup on " + RtAudio::getApiDisplayName(api) + ", fastest of 5 (milliseconds)").c_str());
+
+	Startup cold = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+	Startup warm = cold;
+	for (unsigned int run = 0; run < nRuns; ++run)
+	{
+		std::filesystem::remove(cachePath);
+		const Startup coldRun = Start(api, cachePath);
+		cold.constructSeconds = std::min(cold.constructSeconds, coldRun.constructSeconds);
+		cold.probeSeconds = std::min(cold.probeSeconds, coldRun.probeSeconds);
+
+		const Startup warmRun = Start(api, cachePath);
+		warm.constructSeconds = std::min(warm.constructSeconds, warmRun.constructSeconds);
+		warm.probeSeconds = std::min(warm.probeSeconds, warmRun.probeSeconds);
+	}
+	std::filesystem::remove(cachePath);
+
+	Bench::Benchmark::Report("Cold (probing), until constructed", cold.constructSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Cold (probing), until every API is probed", cold.probeSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Warm (device cache), until constructed", warm.constructSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Warm (device cache), until every API is probed", warm.probeSeconds * 1e3, "ms");
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include "benchmark.h"
+
+#include <random>
+#include <vector>
+
+#include "detail/simdhelper.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * Summing 300 stereo tracks into a stereo bus at 512 frame blocks, into a float bus buffer (like every bus does by default),
+ * and into a double precision one that's rounded back to floats at the end (like a bus with double precision summing).
+ *
+ * Also reports how far each result is from the same sum in long double, in dB relative to the biggest sample of the sum.
+ */
+
+static constexpr unsigned int blockFrames = 512;
+static constexpr unsigned int nTracks = 300;
+static constexpr unsigned int nChannels = 2;
+
+// The worst difference between the result and the reference, in dB below the loudest sample of the reference.
+static double ErrorDecibels(const AudioBuffer& result, const std::vector<long double>& reference)
+{
+	long double peak = 0.0L, error = 0.0L;
+	for (unsigned int channel = 0; channel < nChannels; ++channel)
+	{
+		for (unsigned int frame = 0; frame < blockFrames; ++frame)
+		{
+			const long double expected = reference[channel * blockFrames + frame];
+			peak = std::max(peak, std::abs(expected));
+			error = std::max(error, std::abs(static_cast<long double>(result.GetChannel(channel)[frame]) - expected));
+		}
+	}
+	return 20.0 * std::log10(static_cast<double>(error / peak));
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+
+	std::vector<AudioBuffer> tracks;
+	for (unsigned int track = 0; track < nTracks; ++track)
+	{
+		tracks.emplace_back(nChannels, blockFrames);
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+			for (unsigned int frame = 0; frame < blockFrames; ++frame)
+				tracks.back().GetChannel(channel)[frame] = distribution(random);
+	}
+
+	// Every track is mapped straight through, at a gain that isn't a power of two (so every product gets rounded).
+	const unsigned int sources[] = { 0, 1 };
+	const unsigned int destinations[] = { 0, 1 };
+	const float gains[] = { 0.3f, 0.3f };
+
+	std::vector<long double> reference(static_cast<std::size_t>(nChannels) * blockFrames, 0.0L);
+	for (const AudioBuffer& track : tracks)
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+			for (unsigned int frame = 0; frame < blockFrames; ++frame)
+				reference[channel * blockFrames + frame] += static_cast<long double>(track.GetChannel(channel)[frame]) * gains[channel];
+
+	AudioBuffer bus(nChannels, blockFrames);
+	const AudioBufferView& busView = bus.GetView();
+	std::vector<double, simdpp::aligned_allocator<double, 64>> doubleBus(static_cast<std::size_t>(nChannels) * busView.GetChannelStride());
+
+	const auto sumFloat = [&]()
+		{
+			for (unsigned int channel = 0; channel < nChannels; ++channel)
+				std::fill_n(bus.GetChannel(channel), blockFrames, 0.0f);
+			for (const AudioBuffer& track : tracks)
+				Detail::SimdHelper::MixSparseMatrix(track.GetView(), busView, sources, destinations, gains, gains, 2);
+		};
+	const auto sumDouble = [&]()
+		{
+			std::fill(doubleBus.begin(), doubleBus.end(), 0.0);
+			for (const AudioBuffer& track : tracks)
+				Detail::SimdHelper::MixSparseMatrixDouble(track.GetView(), doubleBus.data(), busView.GetChannelStride(),
+					sources, destinations, gains, gains, 2);
+			Detail::SimdHelper::ConvertDoubleBuffer(doubleBus.data(), busView.GetChannelStride(), busView);
+		};
+
+	const double blockSeconds = static_cast<double>(blockFrames) / 48000.0;
+
+	Bench::Benchmark::Title("Summing 300 stereo tracks into a stereo bus, 512 frame blocks");
+
+	const double floatSeconds = Bench::Benchmark::Time(sumFloat, 1000);
+	sumFloat();
+	Bench::Benchmark::Report("Float, time per block", floatSeconds * 1e6, "us");
+	Bench::Benchmark::Report("Float, of a block at 48 kHz", 100.0 * floatSeconds / blockSeconds, "%");
+	Bench::Benchmark::Report("Float, error", ErrorDecibels(bus, reference), "dB");
+
+	const double doubleSeconds = Bench::Benchmark::Time(sumDouble, 1000);
+	sumDouble();
+	Bench::Benchmark::Report("Double, time per block", doubleSeconds * 1e6, "us");
+	Bench::Benchmark::Report("Double, of a block at 48 kHz", 100.0 * doubleSeconds / blockSeconds, "%");
+	Bench::Benchmark::Report("Double, error", ErrorDecibels(bus, reference), "dB");
+
+	Bench::Benchmark::Report("Double / float", doubleSeconds / floatSeconds, "x");
+
+	return 0;
+}
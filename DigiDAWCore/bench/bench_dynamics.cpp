@@ -0,0 +1,77 @@
+#include "benchmark.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "digidaw/core/audio/effects/dynamics.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * How much of a single core 200 stereo Dynamics instances take at 48 kHz with 64 frame blocks
+ * (every instance processes its own buffer, like one per track), for each mode and detection.
+ * The time includes putting the input back before every block, which is a small part of it.
+ */
+
+static constexpr unsigned int sampleRate = 48000;
+static constexpr unsigned int blockFrames = 64;
+static constexpr unsigned int nInstances = 200;
+static constexpr unsigned int nChannels = 2;
+
+static void FillNoise(AudioBuffer& buffer, std::mt19937& random)
+{
+	// Loud enough to be over the threshold most of the time, so the gain is always moving.
+	std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+	for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+		for (unsigned int frame = 0; frame < buffer.GetFrameCount(); ++frame)
+			buffer.GetChannel(channel)[frame] = distribution(random);
+}
+
+static void Run(const char* name, Effects::Dynamics::Mode mode, Effects::Dynamics::Detection detection)
+{
+	std::mt19937 random(1);
+
+	std::vector<AudioBuffer> inputs;
+	std::vector<AudioBuffer> buffers;
+	std::vector<std::unique_ptr<Effects::Dynamics>> instances;
+	for (unsigned int instance = 0; instance < nInstances; ++instance)
+	{
+		inputs.emplace_back(nChannels, blockFrames);
+		FillNoise(inputs.back(), random);
+		buffers.emplace_back(nChannels, blockFrames);
+
+		Effects::Dynamics::Parameters parameters;
+		parameters.mode = mode;
+		parameters.detection = detection;
+
+		instances.push_back(std::make_unique<Effects::Dynamics>());
+		instances.back()->SetParameters(parameters);
+		instances.back()->Prepare(nChannels, blockFrames, sampleRate);
+	}
+
+	const double seconds = Bench::Benchmark::Time([&]()
+		{
+			for (unsigned int instance = 0; instance < nInstances; ++instance)
+			{
+				Bench::Benchmark::Restore(inputs[instance], buffers[instance]);
+				instances[instance]->Process(buffers[instance].GetView());
+			}
+		}, 1000);
+	Bench::Benchmark::Consume(buffers[0].GetChannel(0)[0]);
+
+	const double blockSeconds = static_cast<double>(blockFrames) / sampleRate;
+	Bench::Benchmark::Report(name, 100.0 * seconds / blockSeconds, "% of a core");
+}
+
+int main()
+{
+	Bench::Benchmark::Title("Dynamics, 200 stereo instances, 64 frame blocks at 48 kHz");
+	Run("Compressor, RMS", Effects::Dynamics::Mode::Compressor, Effects::Dynamics::Detection::RMS);
+	Run("Compressor, peak", Effects::Dynamics::Mode::Compressor, Effects::Dynamics::Detection::Peak);
+	Run("Expander, RMS", Effects::Dynamics::Mode::Expander, Effects::Dynamics::Detection::RMS);
+	Run("Gate, peak", Effects::Dynamics::Mode::Gate, Effects::Dynamics::Detection::Peak);
+
+	return 0;
+}
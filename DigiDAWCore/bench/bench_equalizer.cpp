@@ -0,0 +1,117 @@
+#include "benchmark.h"
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "digidaw/core/audio/effects/equalizer.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * How many channels of an 8 band Equalizer a single core can run in real time at 48 kHz,
+ * against a scalar cascade of Transposed Direct Form II biquads that filters one channel at a time
+ * (which is also what the Equalizer itself does with fewer than 4 channels).
+ */
+
+static constexpr unsigned int sampleRate = 48000;
+static constexpr unsigned int blockFrames = 512;
+static constexpr unsigned int nBands = Effects::Equalizer::maxBands;
+
+// The scalar reference, with the coefficients of a bell (like the Equalizer's) for every band.
+class ScalarEqualizer
+{
+private:
+	struct Biquad
+	{
+		float b0, b1, b2, a1, a2;
+	};
+
+	std::array<Biquad, nBands> biquads;
+	std::vector<float> state; // z1, z2 per band per channel
+public:
+	ScalarEqualizer(unsigned int nChannels)
+	{
+		for (unsigned int band = 0; band < nBands; ++band)
+		{
+			const double w0 = 2.0 * pi<double> * (100.0 * (band + 1)) / sampleRate;
+			const double alpha = std::sin(w0) / (2.0 * 0.707);
+			const double a = std::pow(10.0, 3.0 / 40.0);
+			const double a0 = 1.0 + alpha / a;
+
+			biquads[band].b0 = static_cast<float>((1.0 + alpha * a) / a0);
+			biquads[band].b1 = static_cast<float>((-2.0 * std::cos(w0)) / a0);
+			biquads[band].b2 = static_cast<float>((1.0 - alpha * a) / a0);
+			biquads[band].a1 = biquads[band].b1;
+			biquads[band].a2 = static_cast<float>((1.0 - alpha / a) / a0);
+		}
+		state = std::vector<float>(static_cast<std::size_t>(nChannels) * nBands * 2, 0.0f);
+	}
+
+	void Process(const AudioBufferView& buffer)
+	{
+		for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+		{
+			float* samples = buffer.GetChannel(channel);
+			float* channelState = state.data() + static_cast<std::size_t>(channel) * nBands * 2;
+			for (unsigned int frame = 0; frame < buffer.GetFrameCount(); ++frame)
+			{
+				float x = samples[frame];
+				for (unsigned int band = 0; band < nBands; ++band)
+				{
+					const Biquad& biquad = biquads[band];
+					float& z1 = channelState[band * 2];
+					float& z2 = channelState[band * 2 + 1];
+
+					const float y = biquad.b0 * x + z1;
+					z1 = biquad.b1 * x - biquad.a1 * y + z2;
+					z2 = biquad.b2 * x - biquad.a2 * y;
+					x = y;
+				}
+				samples[frame] = x;
+			}
+		}
+	}
+};
+
+static void FillNoise(AudioBuffer& buffer)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+	for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+		for (unsigned int frame = 0; frame < buffer.GetFrameCount(); ++frame)
+			buffer.GetChannel(channel)[frame] = distribution(random);
+}
+
+int main()
+{
+	const double blockSeconds = static_cast<double>(blockFrames) / sampleRate;
+
+	Bench::Benchmark::Title("Equalizer, 8 bands, 512 frame blocks at 48 kHz (channels per core)");
+	for (unsigned int nChannels : { 1u, 2u, 4u, 8u, 16u, 64u })
+	{
+		AudioBuffer input(nChannels, blockFrames);
+		FillNoise(input);
+		AudioBuffer buffer(nChannels, blockFrames);
+
+		Effects::Equalizer equalizer;
+		for (unsigned int band = 0; band < nBands; ++band)
+			equalizer.SetBand(band, Effects::Equalizer::Band(Effects::Equalizer::FilterType::Bell, 100.0f * (band + 1), 3.0f, 0.707f));
+		equalizer.Prepare(nChannels, blockFrames, sampleRate);
+
+		ScalarEqualizer scalar(nChannels);
+
+		const AudioBufferView& view = buffer.GetView();
+		const double simdSeconds = Bench::Benchmark::Time([&]() { Bench::Benchmark::Restore(input, buffer); equalizer.Process(view); }, 1000);
+		const double scalarSeconds = Bench::Benchmark::Time([&]() { Bench::Benchmark::Restore(input, buffer); scalar.Process(view); }, 1000);
+		Bench::Benchmark::Consume(view.GetChannel(0)[0]);
+
+		const std::string name = std::to_string(nChannels) + " channels";
+		Bench::Benchmark::Report((name + ", Equalizer").c_str(), nChannels * blockSeconds / simdSeconds, "channels");
+		Bench::Benchmark::Report((name + ", scalar TDF-II").c_str(), nChannels * blockSeconds / scalarSeconds, "channels");
+	}
+
+	return 0;
+}
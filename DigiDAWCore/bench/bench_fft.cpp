@@ -0,0 +1,202 @@
+#include "benchmark.h"
+
+#include <bit>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "detail/fft.h"
+
+using namespace DigiDAW::Core;
+
+/*
+ * One forward real FFT for the power of two sizes from 64 to 65536, against the radix-2 FFT the mixed radix one replaced,
+ * and the mixed radix complex FFT for sizes that aren't powers of two.
+ */
+
+// The radix-2 reference: in place decimation in time after a bit reversed copy, with the butterflies vectorized over each group.
+class RadixTwoFFT
+{
+private:
+	std::size_t size;
+	std::size_t complexSize;
+
+	std::vector<float> twiddleReal; // The stage with "half" butterflies starts at "half - 1".
+	std::vector<float> twiddleImag;
+	std::vector<float> realTwiddleReal;
+	std::vector<float> realTwiddleImag;
+	std::vector<std::size_t> bitReverse;
+
+	std::vector<float> workReal;
+	std::vector<float> workImag;
+
+	static void ButterflyStage(float* real, float* imag, const float* twiddleReal, const float* twiddleImag, std::size_t half, std::size_t length)
+	{
+		for (std::size_t group = 0; group < length; group += 2 * half)
+		{
+			float* aReal = &real[group];
+			float* aImag = &imag[group];
+			float* bReal = &real[group + half];
+			float* bImag = &imag[group + half];
+
+			std::size_t i = 0;
+			for (; i + SIMDPP_FAST_FLOAT32_SIZE <= half; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v wRe = simdpp::load_u(&twiddleReal[i]);
+				simdpp::float32v wIm = simdpp::load_u(&twiddleImag[i]);
+				simdpp::float32v xRe = simdpp::load_u(&bReal[i]);
+				simdpp::float32v xIm = simdpp::load_u(&bImag[i]);
+
+				simdpp::float32v tRe = wRe * xRe - wIm * xIm;
+				simdpp::float32v tIm = wRe * xIm + wIm * xRe;
+
+				simdpp::float32v yRe = simdpp::load_u(&aReal[i]);
+				simdpp::float32v yIm = simdpp::load_u(&aImag[i]);
+				simdpp::store_u(&aReal[i], yRe + tRe);
+				simdpp::store_u(&aImag[i], yIm + tIm);
+				simdpp::store_u(&bReal[i], yRe - tRe);
+				simdpp::store_u(&bImag[i], yIm - tIm);
+			}
+			for (; i < half; ++i)
+			{
+				float tRe = twiddleReal[i] * bReal[i] - twiddleImag[i] * bImag[i];
+				float tIm = twiddleReal[i] * bImag[i] + twiddleImag[i] * bReal[i];
+				bReal[i] = aReal[i] - tRe;
+				bImag[i] = aImag[i] - tIm;
+				aReal[i] += tRe;
+				aImag[i] += tIm;
+			}
+		}
+	}
+public:
+	RadixTwoFFT(std::size_t size)
+	{
+		this->size = size;
+		this->complexSize = size / 2;
+
+		twiddleReal = std::vector<float>(complexSize);
+		twiddleImag = std::vector<float>(complexSize);
+		for (std::size_t half = 1; half < complexSize; half *= 2)
+		{
+			for (std::size_t i = 0; i < half; ++i)
+			{
+				double angle = -pi<double> * static_cast<double>(i) / static_cast<double>(half);
+				twiddleReal[half - 1 + i] = static_cast<float>(std::cos(angle));
+				twiddleImag[half - 1 + i] = static_cast<float>(std::sin(angle));
+			}
+		}
+
+		realTwiddleReal = std::vector<float>(complexSize);
+		realTwiddleImag = std::vector<float>(complexSize);
+		for (std::size_t i = 0; i < complexSize; ++i)
+		{
+			double angle = -2.0 * pi<double> * static_cast<double>(i) / static_cast<double>(size);
+			realTwiddleReal[i] = static_cast<float>(std::cos(angle));
+			realTwiddleImag[i] = static_cast<float>(std::sin(angle));
+		}
+
+		const unsigned int bits = std::countr_zero(complexSize);
+		bitReverse = std::vector<std::size_t>(complexSize);
+		for (std::size_t i = 0; i < complexSize; ++i)
+		{
+			std::size_t reversed = 0;
+			for (unsigned int bit = 0; bit < bits; ++bit)
+				reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+			bitReverse[i] = reversed;
+		}
+
+		workReal = std::vector<float>(complexSize);
+		workImag = std::vector<float>(complexSize);
+	}
+
+	void Forward(const float* src, float* dstReal, float* dstImag)
+	{
+		for (std::size_t i = 0; i < complexSize; ++i)
+		{
+			workReal[i] = src[2 * bitReverse[i]];
+			workImag[i] = src[2 * bitReverse[i] + 1];
+		}
+
+		for (std::size_t half = 1; half < complexSize; half *= 2)
+			ButterflyStage(workReal.data(), workImag.data(), &twiddleReal[half - 1], &twiddleImag[half - 1], half, complexSize);
+
+		dstReal[0] = workReal[0] + workImag[0];
+		dstImag[0] = 0.0f;
+		dstReal[complexSize] = workReal[0] - workImag[0];
+		dstImag[complexSize] = 0.0f;
+		for (std::size_t k = 1; k < complexSize; ++k)
+		{
+			const float zRe = workReal[k], zIm = workImag[k];
+			const float zcRe = workReal[complexSize - k], zcIm = -workImag[complexSize - k];
+
+			const float eRe = 0.5f * (zRe + zcRe), eIm = 0.5f * (zIm + zcIm);
+			const float oRe = 0.5f * (zIm - zcIm), oIm = -0.5f * (zRe - zcRe);
+
+			dstReal[k] = eRe + realTwiddleReal[k] * oRe - realTwiddleImag[k] * oIm;
+			dstImag[k] = eIm + realTwiddleReal[k] * oIm + realTwiddleImag[k] * oRe;
+		}
+	}
+};
+
+static std::vector<float> MakeNoise(std::size_t size)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<float> noise(size);
+	for (float& sample : noise)
+		sample = distribution(random);
+	return noise;
+}
+
+// Enough calls to take a while, as the small sizes take well under a microsecond.
+static unsigned int GetCallCount(std::size_t size)
+{
+	return static_cast<unsigned int>(std::max<std::size_t>(4194304 / size, 10));
+}
+
+int main()
+{
+	Bench::Benchmark::Title("Real forward FFT (microseconds per transform)");
+	for (std::size_t size = 64; size <= 65536; size *= 2)
+	{
+		const std::vector<float> input = MakeNoise(size);
+		std::vector<float> real(size / 2 + 1), imag(size / 2 + 1);
+		std::vector<float> referenceReal(size / 2 + 1), referenceImag(size / 2 + 1);
+
+		Detail::FFT fft(size);
+		RadixTwoFFT reference(size);
+
+		const double seconds = Bench::Benchmark::Time([&]() { fft.Forward(input.data(), real.data(), imag.data()); }, GetCallCount(size));
+		const double referenceSeconds = Bench::Benchmark::Time(
+			[&]() { reference.Forward(input.data(), referenceReal.data(), referenceImag.data()); }, GetCallCount(size));
+
+		// Both have to compute the same spectrum, or the comparison means nothing.
+		float difference = 0.0f;
+		for (std::size_t bin = 0; bin < real.size(); ++bin)
+			difference = std::max({ difference, std::abs(real[bin] - referenceReal[bin]), std::abs(imag[bin] - referenceImag[bin]) });
+		if (difference > 1e-3f * std::sqrt(static_cast<float>(size)))
+		{
+			std::printf("The spectra of size %zu differ by %f\n", size, difference);
+			return 1;
+		}
+
+		Bench::Benchmark::Report((std::to_string(size) + ", mixed radix").c_str(), seconds * 1e6, "us");
+		Bench::Benchmark::Report((std::to_string(size) + ", radix-2").c_str(), referenceSeconds * 1e6, "us");
+	}
+
+	Bench::Benchmark::Title("Complex forward FFT, other sizes (microseconds per transform)");
+	for (std::size_t size : { 480u, 1000u, 1536u, 4410u, 6000u })
+	{
+		const std::vector<float> real = MakeNoise(size), imag = MakeNoise(size);
+		std::vector<float> outputReal(size), outputImag(size);
+
+		Detail::ComplexFFT fft(size);
+		const double seconds = Bench::Benchmark::Time(
+			[&]() { fft.Forward(real.data(), imag.data(), outputReal.data(), outputImag.data()); }, GetCallCount(size));
+		Bench::Benchmark::Consume(outputReal[0]);
+
+		Bench::Benchmark::Report(std::to_string(size).c_str(), seconds * 1e6, "us");
+	}
+
+	return 0;
+}
@@ -0,0 +1,301 @@
+#include "benchmark.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "digidaw/core/audio/session.h"
+#include "digidaw/core/audio/trackhistory.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * Saving and loading a session of 100000 stereo tracks and 10000 stereo buses (each bus has 10 of the tracks as inputs,
+ * and every tenth bus has the 9 before it as inputs and outputs to the device), as a snapshot, as a journaled save of 100 changed tracks
+ * (from the TrackState, which compares every track, and from a TrackHistory snapshot, which only compares the chunks that changed, not counting the Commit),
+ * and as a naive text file (a line per track and bus, written and parsed with iostreams) for comparison, which can only ever be written whole.
+ * Loads are into an empty TrackState, and include destroying what they loaded.
+ */
+
+static constexpr unsigned int nTracks = 100000;
+static constexpr unsigned int nBuses = 10000;
+static constexpr unsigned int nTracksPerBus = nTracks / nBuses;
+static constexpr unsigned int nBusesPerGroup = 10;
+static constexpr unsigned int nChangedTracks = 100;
+
+using Mapping = std::vector<std::vector<unsigned int>>;
+
+static void BuildSession(TrackState& trackState)
+{
+	std::vector<std::shared_ptr<TrackState::Track>> tracks;
+	tracks.reserve(nTracks);
+	for (unsigned int track = 0; track < nTracks; ++track)
+		tracks.push_back(trackState.AddTrack(TrackState::Track("Track " + std::to_string(track), TrackState::ChannelNumber::Stereo,
+			static_cast<float>(track % 13) * -0.5f, static_cast<float>(track % 7) / 7.0f - 0.5f)));
+
+	std::vector<std::shared_ptr<TrackState::Bus>> group;
+	for (unsigned int bus = 0; bus < nBuses; ++bus)
+	{
+		std::vector<TrackState::TrackInput> trackInputs;
+		for (unsigned int track = bus * nTracksPerBus; track < (bus + 1) * nTracksPerBus; ++track)
+			trackInputs.emplace_back(tracks[track], TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } }));
+
+		const bool isGroup = (bus % nBusesPerGroup) == nBusesPerGroup - 1;
+		std::vector<TrackState::BusInput> busInputs;
+		if (isGroup)
+			for (std::shared_ptr<TrackState::Bus>& input : group)
+				busInputs.emplace_back(input, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } }));
+
+		group.push_back(trackState.AddBus(TrackState::Bus("Bus " + std::to_string(bus), TrackState::ChannelNumber::Stereo, 0.0f, 0.0f,
+			isGroup ? Mapping{ { 0 }, { 1 } } : Mapping{}, trackInputs, busInputs)));
+		if (isGroup) group.clear();
+	}
+}
+
+// Changes the gain of 100 tracks spread across the session, different ones every time.
+static void ChangeTracks(TrackState& trackState, unsigned int change)
+{
+	std::vector<std::shared_ptr<TrackState::Track>>& tracks = trackState.GetAllTracks();
+	for (unsigned int track = 0; track < nChangedTracks; ++track)
+		tracks[(track * (nTracks / nChangedTracks) + change) % nTracks]->gain -= 0.25f;
+}
+
+static void WriteMapping(std::ostream& stream, const Mapping& mapping)
+{
+	stream << ' ' << mapping.size();
+	for (const std::vector<unsigned int>& list : mapping)
+	{
+		stream << ' ' << list.size();
+		for (unsigned int channel : list)
+			stream << ' ' << channel;
+	}
+}
+
+static Mapping ReadMapping(std::istream& stream)
+{
+	std::size_t nLists = 0;
+	stream >> nLists;
+	Mapping mapping(nLists);
+	for (std::vector<unsigned int>& list : mapping)
+	{
+		std::size_t nChannels = 0;
+		stream >> nChannels;
+		list.resize(nChannels);
+		for (unsigned int& channel : list)
+			stream >> channel;
+	}
+	return mapping;
+}
+
+// Tracks and buses refer to each other by their position in the TrackState, every bus comes after the buses it has as inputs.
+static void SaveText(const std::filesystem::path& path, TrackState& trackState)
+{
+	std::ofstream stream(path);
+	stream << std::setprecision(9);
+
+	const std::vector<std::shared_ptr<TrackState::Track>> tracks = trackState.ThreadedCopyAllTracks();
+	const std::vector<std::shared_ptr<TrackState::Bus>> buses = trackState.ThreadedCopyAllBuses();
+	std::unordered_map<const TrackState::Track*, std::size_t> trackIndices;
+	std::unordered_map<const TrackState::Bus*, std::size_t> busIndices;
+
+	stream << tracks.size() << ' ' << buses.size() << '\n';
+	for (const std::shared_ptr<TrackState::Track>& track : tracks)
+	{
+		trackIndices[track.get()] = trackIndices.size();
+		stream << std::quoted(track->name) << ' ' << static_cast<unsigned int>(track->nChannels) << ' ' << track->gain << ' ' << track->pan << ' '
+			<< track->panDepth << ' ' << track->liveInput << ' ' << track->frozen << '\n';
+	}
+	for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+	{
+		busIndices[bus.get()] = busIndices.size();
+		stream << std::quoted(bus->name) << ' ' << static_cast<unsigned int>(bus->nChannels) << ' ' << bus->gain << ' ' << bus->pan << ' '
+			<< bus->panDepth << ' ' << bus->doublePrecisionSumming;
+
+		stream << ' ' << bus->trackInputs.size();
+		for (const TrackState::TrackInput& input : bus->trackInputs)
+		{
+			stream << ' ' << trackIndices[input.track.get()] << ' ' << input.trackToBusMap.layoutPanning;
+			WriteMapping(stream, input.trackToBusMap.mapping);
+		}
+		stream << ' ' << bus->busInputs.size();
+		for (const TrackState::BusInput& input : bus->busInputs)
+		{
+			stream << ' ' << busIndices[input.bus.get()] << ' ' << input.busToBusMap.layoutPanning;
+			WriteMapping(stream, input.busToBusMap.mapping);
+		}
+		WriteMapping(stream, bus->busChannelToDeviceOutputChannels);
+		stream << '\n';
+	}
+}
+
+static void LoadText(const std::filesystem::path& path, TrackState& trackState)
+{
+	std::ifstream stream(path);
+
+	std::size_t nSavedTracks = 0, nSavedBuses = 0;
+	stream >> nSavedTracks >> nSavedBuses;
+
+	std::vector<std::shared_ptr<TrackState::Track>> tracks;
+	tracks.reserve(nSavedTracks);
+	for (std::size_t i = 0; i < nSavedTracks; ++i)
+	{
+		std::string name;
+		unsigned int nChannels = 0;
+		TrackState::Track track;
+		stream >> std::quoted(name) >> nChannels >> track.gain >> track.pan >> track.panDepth >> track.liveInput >> track.frozen;
+		std::strncpy(track.name, name.c_str(), sizeof(track.name) - 1);
+		track.nChannels = static_cast<TrackState::ChannelNumber>(nChannels);
+		tracks.push_back(trackState.AddTrack(track));
+	}
+
+	std::vector<std::shared_ptr<TrackState::Bus>> buses;
+	buses.reserve(nSavedBuses);
+	for (std::size_t i = 0; i < nSavedBuses; ++i)
+	{
+		std::string name;
+		unsigned int nChannels = 0;
+		float gain = 0.0f, pan = 0.0f, panDepth = 0.0f;
+		bool doublePrecisionSumming = false;
+		stream >> std::quoted(name) >> nChannels >> gain >> pan >> panDepth >> doublePrecisionSumming;
+
+		std::size_t nTrackInputs = 0;
+		stream >> nTrackInputs;
+		std::vector<TrackState::TrackInput> trackInputs;
+		for (std::size_t input = 0; input < nTrackInputs; ++input)
+		{
+			std::size_t index = 0;
+			bool layoutPanning = false;
+			stream >> index >> layoutPanning;
+			trackInputs.emplace_back(tracks[index], TrackState::ChannelMapping(ReadMapping(stream), layoutPanning));
+		}
+
+		std::size_t nBusInputs = 0;
+		stream >> nBusInputs;
+		std::vector<TrackState::BusInput> busInputs;
+		for (std::size_t input = 0; input < nBusInputs; ++input)
+		{
+			std::size_t index = 0;
+			bool layoutPanning = false;
+			stream >> index >> layoutPanning;
+			busInputs.emplace_back(buses[index], TrackState::ChannelMapping(ReadMapping(stream), layoutPanning));
+		}
+
+		TrackState::Bus bus(name, static_cast<TrackState::ChannelNumber>(nChannels), gain, pan, ReadMapping(stream), trackInputs, busInputs);
+		bus.panDepth = panDepth;
+		bus.doublePrecisionSumming = doublePrecisionSumming;
+		buses.push_back(trackState.AddBus(bus));
+	}
+}
+
+// Enough of what was loaded to tell that both formats loaded the same session.
+static double Checksum(TrackState& trackState)
+{
+	double sum = 0.0;
+	for (const std::shared_ptr<TrackState::Track>& track : trackState.GetAllTracks())
+		sum += track->gain + track->pan + static_cast<double>(track->nChannels);
+	for (const std::shared_ptr<TrackState::Bus>& bus : trackState.GetAllBuses())
+		sum += static_cast<double>(bus->trackInputs.size() + 100 * bus->busInputs.size() + 10000 * bus->busChannelToDeviceOutputChannels.size());
+	return sum;
+}
+
+static double MegaBytes(const std::filesystem::path& path)
+{
+	return static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+}
+
+int main()
+{
+	const std::filesystem::path sessionPath = std::filesystem::temp_directory_path() / "digidaw_bench_session.ddsn";
+	const std::filesystem::path historyPath = std::filesystem::temp_directory_path() / "digidaw_bench_session_history.ddsn";
+	const std::filesystem::path textPath = std::filesystem::temp_directory_path() / "digidaw_bench_session.txt";
+
+	TrackState trackState;
+	BuildSession(trackState);
+	const double expected = Checksum(trackState);
+
+	Bench::Benchmark::Title("Saving a session of 100000 tracks and 10000 buses, fastest of 3 (milliseconds)");
+
+	Session session;
+	const double snapshotSeconds = Bench::Benchmark::Time([&]() { session.SaveSnapshot(sessionPath, trackState); }, 1, 3);
+	const double snapshotSize = MegaBytes(sessionPath);
+
+	// Every save changes the gain of 100 tracks, so each one appends a batch of them.
+	unsigned int nSaves = 0;
+
+	// The changes are committed to the history before the saves are timed, a snapshot for every save (and the one to warm up).
+	TrackHistory history;
+	history.Commit(trackState);
+	Session historySession;
+	historySession.SaveSnapshot(historyPath, history.GetCurrentSnapshot());
+	std::vector<std::shared_ptr<const TrackHistory::Snapshot>> snapshots;
+	for (unsigned int save = 0; save < 4; ++save)
+	{
+		ChangeTracks(trackState, nSaves++);
+		history.Commit(trackState);
+		snapshots.push_back(history.GetCurrentSnapshot());
+	}
+	const double committed = Checksum(trackState);
+
+	unsigned int nHistorySaves = 0;
+	const double historySeconds = Bench::Benchmark::Time([&]() { historySession.Save(historyPath, snapshots[nHistorySaves++]); }, 1, 3);
+
+	const double journalSeconds = Bench::Benchmark::Time([&]()
+		{
+			ChangeTracks(trackState, nSaves++);
+			session.Save(sessionPath, trackState);
+		}, 1, 3);
+	const double changed = Checksum(trackState);
+
+	const double textSaveSeconds = Bench::Benchmark::Time([&]() { SaveText(textPath, trackState); }, 1, 3);
+
+	Bench::Benchmark::Report("Snapshot", snapshotSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Journal, 100 changed tracks", journalSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Journal from history, 100 changed tracks", historySeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Text", textSaveSeconds * 1e3, "ms");
+
+	Bench::Benchmark::Title("Loading it, fastest of 3 (milliseconds)");
+
+	bool matches = true;
+	const double loadSeconds = Bench::Benchmark::Time([&]()
+		{
+			TrackState loaded;
+			Session loader;
+			matches = matches && loader.Load(sessionPath, loaded) == ReturnCode::Success && Checksum(loaded) == changed;
+		}, 1, 3);
+	const double textLoadSeconds = Bench::Benchmark::Time([&]()
+		{
+			TrackState loaded;
+			LoadText(textPath, loaded);
+			matches = matches && Checksum(loaded) == changed;
+		}, 1, 3);
+	{
+		TrackState loaded;
+		Session loader;
+		matches = matches && loader.Load(historyPath, loaded) == ReturnCode::Success && Checksum(loaded) == committed;
+	}
+	if (!matches || changed == expected || committed == expected)
+	{
+		std::printf("The loaded sessions don't match the saved one\n");
+		return 1;
+	}
+
+	Bench::Benchmark::Report("Snapshot and journal", loadSeconds * 1e3, "ms");
+	Bench::Benchmark::Report("Text", textLoadSeconds * 1e3, "ms");
+
+	Bench::Benchmark::Title("File sizes (megabytes)");
+	Bench::Benchmark::Report("Snapshot", snapshotSize, "MB");
+	Bench::Benchmark::Report("Snapshot and journal", MegaBytes(sessionPath), "MB");
+	Bench::Benchmark::Report("Text", MegaBytes(textPath), "MB");
+
+	std::filesystem::remove(sessionPath);
+	std::filesystem::remove(historyPath);
+	std::filesystem::remove(textPath);
+
+	return 0;
+}
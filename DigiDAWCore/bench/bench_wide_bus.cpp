@@ -0,0 +1,133 @@
+#include "benchmark.h"
+
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "digidaw/core/audio/engine.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * Mixing 128 stereo tracks into one stereo master bus at 512 frame blocks, rendered on the virtual device as fast as it goes
+ * (so the time is all spent in Mixer::Mix), with the summing of the bus never split between threads,
+ * split when the Mixer's own heuristic decides it's worth it (parallelSummingThresholdUS), and always split as far as it goes.
+ * Every render has to give a bit identical result, as each frame is still summed from the same inputs in the same order.
+ */
+
+static constexpr unsigned int sampleRate = 48000;
+static constexpr unsigned int blockFrames = 512;
+static constexpr unsigned int renderFrames = blockFrames * 375; // 4 seconds
+static constexpr unsigned int nTracks = 128;
+
+using Mapping = std::vector<std::vector<unsigned int>>;
+
+static std::shared_ptr<const AudioBuffer> MakeClip(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+	std::shared_ptr<AudioBuffer> clip = std::make_shared<AudioBuffer>(2, renderFrames);
+	for (unsigned int channel = 0; channel < 2; ++channel)
+		for (unsigned int frame = 0; frame < renderFrames; ++frame)
+			clip->GetChannel(channel)[frame] = distribution(random);
+	return clip;
+}
+
+// The seconds one render takes (not counting building the session), or a negative time if it didn't render.
+// Without a summingThresholdUS the Mixer's default is used.
+static double Render(const std::vector<std::shared_ptr<const AudioBuffer>>& clips, std::optional<unsigned int> summingThresholdUS, std::uint64_t& hash)
+{
+	Engine engine(Engine::virtualAPI);
+
+	VirtualDevice::Settings settings;
+	settings.nOutputChannels = 2;
+	settings.sampleRates = { sampleRate };
+	settings.simulateClock = false;
+	settings.lengthFrames = renderFrames;
+	if (engine.SetVirtualDeviceSettings(settings) != ReturnCode::Success) return -1.0;
+
+	Engine::EngineConfig config;
+	config.outputDevice = "Virtual Device";
+	config.sampleRate = sampleRate;
+	config.bufferSize = blockFrames;
+	if (engine.ApplyConfig(config) != ReturnCode::Success) return -1.0;
+
+	engine.mixer.SetDeterministicProcessing(true);
+	if (summingThresholdUS) engine.mixer.parallelSummingThresholdUS = *summingThresholdUS;
+
+	std::vector<TrackState::TrackInput> inputs;
+	for (unsigned int track = 0; track < nTracks; ++track)
+	{
+		std::shared_ptr<TrackState::Track> added = engine.trackState.AddTrack(TrackState::Track("Track " + std::to_string(track),
+			TrackState::ChannelNumber::Stereo, static_cast<float>(track % 13) * -0.5f, static_cast<float>(track % 7) / 7.0f - 0.5f));
+		engine.mixer.SetClip(added, clips[track]);
+		inputs.emplace_back(added, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } }));
+	}
+	engine.trackState.AddBus(TrackState::Bus("Master", TrackState::ChannelNumber::Stereo, -12.0f, 0.0f, Mapping{ { 0 }, { 1 } }, inputs, {}));
+
+	const auto start = std::chrono::steady_clock::now();
+	engine.StartEngine();
+	while (engine.IsStreamRunning())
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	const auto end = std::chrono::steady_clock::now();
+
+	VirtualDevice* device = engine.GetVirtualDevice();
+	if (!device || device->GetPlayedFrames() != renderFrames) return -1.0;
+	hash = device->GetOutputHash();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int main()
+{
+	std::mt19937 random(1);
+	std::vector<std::shared_ptr<const AudioBuffer>> clips;
+	for (unsigned int track = 0; track < nTracks; ++track)
+		clips.push_back(MakeClip(random));
+
+	struct Split
+	{
+		const char* name;
+		std::optional<unsigned int> summingThresholdUS;
+	};
+	const Split splits[] =
+	{
+		{ "Never split", std::numeric_limits<unsigned int>::max() },
+		{ "Split by the Mixer (default threshold)", std::nullopt },
+		{ "Always split", 0 }
+	};
+
+	Bench::Benchmark::Title("Mixing 128 stereo tracks into a stereo bus, 512 frame blocks, fastest of 3 (microseconds per block)");
+	std::printf("  (%u hardware threads)\n", std::max(std::thread::hardware_concurrency(), 1u));
+
+	std::uint64_t expectedHash = 0;
+	for (const Split& split : splits)
+	{
+		double fastest = std::numeric_limits<double>::max();
+		for (unsigned int run = 0; run < 3; ++run)
+		{
+			std::uint64_t hash = 0;
+			const double seconds = Render(clips, split.summingThresholdUS, hash);
+			if (seconds < 0.0)
+			{
+				std::printf("Couldn't render on the virtual device\n");
+				return 1;
+			}
+			if (expectedHash == 0) expectedHash = hash;
+			if (hash != expectedHash)
+			{
+				std::printf("%s changed the result\n", split.name);
+				return 1;
+			}
+			fastest = std::min(fastest, seconds);
+		}
+
+		Bench::Benchmark::Report(split.name, fastest * 1e6 / (renderFrames / blockFrames), "us");
+	}
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+
+#include "digidaw/core/common.h"
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Bench
+{
+	/*
+	 * What the benchmarks have in common: timing a piece of work, and printing the results in the same format,
+	 * so runs can be compared between changes (and between SIMD targets, see DIGIDAW_COMPILE_WITH_AVX).
+	 *
+	 * Every benchmark is its own executable, which prints a line per result, and takes no arguments.
+	 * They run on whatever thread they're started on, so run them on an otherwise idle machine.
+	 */
+	class Benchmark
+	{
+	public:
+		/*
+		 * The time one call of func takes, in seconds. func is called once to warm up,
+		 * then in batches of nCalls, and the fastest batch is taken (as anything else the machine is doing only ever adds to it).
+		 */
+		static double Time(const std::function<void()>& func, unsigned int nCalls = 100, unsigned int nBatches = 5)
+		{
+			func();
+
+			double fastest = std::numeric_limits<double>::max();
+			for (unsigned int batch = 0; batch < nBatches; ++batch)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				for (unsigned int call = 0; call < nCalls; ++call)
+					func();
+				const auto end = std::chrono::steady_clock::now();
+
+				fastest = std::min(fastest, std::chrono::duration<double>(end - start).count() / nCalls);
+			}
+			return fastest;
+		}
+
+		/*
+		 * Copies every channel of src to dst (of the same size). The effects process in place,
+		 * so this puts the same input back before every call, or the input would drift block after block
+		 * (down into denormals, or up into infinity) and the timing with it.
+		 */
+		static void Restore(const Audio::AudioBuffer& src, Audio::AudioBuffer& dst)
+		{
+			for (unsigned int channel = 0; channel < src.GetChannelCount(); ++channel)
+				std::copy_n(src.GetChannel(channel), src.GetFrameCount(), dst.GetChannel(channel));
+		}
+
+		static void Title(const char* title)
+		{
+			std::printf("\n%s\n", title);
+		}
+
+		static void Report(const char* name, double value, const char* unit)
+		{
+			std::printf("  %-48s %12.3f %s\n", name, value, unit);
+		}
+
+		// So the result of the work being timed is used, and the compiler can't leave it out.
+		static void Consume(float value)
+		{
+			static volatile float sink = 0.0f;
+			sink = sink + value;
+		}
+	};
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * A view of a planar audio buffer, where every channel is a contiguous block of nFrames samples,
+	 * and each channel starts "channelStride" samples after the previous one.
+	 *
+	 * Buffers from an AudioBuffer or an AudioArena pad every channel up to a multiple of 64 bytes,
+	 * so every channel starts on its own cache line and can be processed with aligned loads and stores.
+	 * A view doesn't own its memory, so it's cheap to copy around, and can be narrowed down to some of its channels or frames.
+	 */
+	class AudioBufferView
+	{
+	public:
+		static constexpr std::size_t alignment = 64; // In bytes
+		static constexpr std::size_t alignmentSamples = alignment / sizeof(float);
+
+		// The amount of samples a channel of nFrames takes up when it's padded to the alignment.
+		static constexpr std::size_t GetAlignedStride(std::size_t nFrames)
+		{
+			return (nFrames + alignmentSamples - 1) / alignmentSamples * alignmentSamples;
+		}
+	private:
+		float* data;
+		unsigned int nChannels;
+		unsigned int nFrames;
+		std::size_t channelStride;
+	public:
+		AudioBufferView()
+		{
+			this->data = nullptr;
+			this->nChannels = 0;
+			this->nFrames = 0;
+			this->channelStride = 0;
+		}
+
+		AudioBufferView(float* data, unsigned int nChannels, unsigned int nFrames, std::size_t channelStride)
+		{
+			this->data = data;
+			this->nChannels = nChannels;
+			this->nFrames = nFrames;
+			this->channelStride = channelStride;
+		}
+
+		// A buffer with no padding between its channels (like the buffers from the audio device).
+		AudioBufferView(float* data, unsigned int nChannels, unsigned int nFrames)
+			: AudioBufferView(data, nChannels, nFrames, nFrames)
+		{
+		}
+
+		float* GetChannel(unsigned int channel) const
+		{
+			return data + channel * channelStride;
+		}
+
+		unsigned int GetChannelCount() const
+		{
+			return nChannels;
+		}
+
+		unsigned int GetFrameCount() const
+		{
+			return nFrames;
+		}
+
+		std::size_t GetChannelStride() const
+		{
+			return channelStride;
+		}
+
+		bool IsEmpty() const
+		{
+			return data == nullptr || nChannels == 0;
+		}
+
+		// Whether every channel starts on a 64 byte boundary.
+		bool IsAligned() const
+		{
+			return reinterpret_cast<std::uintptr_t>(data) % alignment == 0 && channelStride % alignmentSamples == 0;
+		}
+
+		// The frames [firstFrame, firstFrame + nFrames) of every channel,
+		// this is only aligned if firstFrame is a multiple of alignmentSamples.
+		AudioBufferView GetFrames(unsigned int firstFrame, unsigned int nFrames) const
+		{
+			return AudioBufferView(data + firstFrame, nChannels, nFrames, channelStride);
+		}
+
+		// The channels [firstChannel, firstChannel + nChannels).
+		AudioBufferView GetChannels(unsigned int firstChannel, unsigned int nChannels) const
+		{
+			return AudioBufferView(GetChannel(firstChannel), nChannels, nFrames, channelStride);
+		}
+	};
+
+	struct AlignedSampleDeleter
+	{
+		void operator()(float* samples) const
+		{
+			::operator delete[](samples, std::align_val_t(AudioBufferView::alignment));
+		}
+	};
+
+	using AlignedSamples = std::unique_ptr<float[], AlignedSampleDeleter>;
+
+	// Allocates nSamples zeroed samples, aligned to AudioBufferView::alignment.
+	inline AlignedSamples AllocateAlignedSamples(std::size_t nSamples)
+	{
+		float* samples = static_cast<float*>(::operator new[](nSamples * sizeof(float), std::align_val_t(AudioBufferView::alignment)));
+		std::fill_n(samples, nSamples, 0.0f);
+		return AlignedSamples(samples);
+	}
+
+	// A planar audio buffer that owns its (aligned) memory.
+	class AudioBuffer
+	{
+	private:
+		AlignedSamples samples;
+		AudioBufferView view;
+	public:
+		AudioBuffer()
+		{
+		}
+
+		AudioBuffer(unsigned int nChannels, unsigned int nFrames)
+		{
+			const std::size_t channelStride = AudioBufferView::GetAlignedStride(nFrames);
+			this->samples = AllocateAlignedSamples(channelStride * nChannels);
+			this->view = AudioBufferView(samples.get(), nChannels, nFrames, channelStride);
+		}
+
+		const AudioBufferView& GetView() const
+		{
+			return view;
+		}
+
+		float* GetChannel(unsigned int channel) const
+		{
+			return view.GetChannel(channel);
+		}
+
+		unsigned int GetChannelCount() const
+		{
+			return view.GetChannelCount();
+		}
+
+		unsigned int GetFrameCount() const
+		{
+			return view.GetFrameCount();
+		}
+
+		// The memory used (in bytes), including the padding.
+		std::size_t GetSize() const
+		{
+			return view.GetChannelStride() * view.GetChannelCount() * sizeof(float);
+		}
+	};
+
+	/*
+	 * Hands out aligned buffers from a single block of memory, which is only allocated by Reset.
+	 * The Mixer rebuilds its arena whenever its processing plan changes (including when the buffer size changes),
+	 * so all the buffers used while mixing sit next to each other, and getting them never touches the heap.
+	 */
+	class AudioArena
+	{
+	private:
+		AlignedSamples samples;
+		std::size_t size; // In samples
+		std::size_t used;
+	public:
+		AudioArena()
+		{
+			this->size = 0;
+			this->used = 0;
+		}
+
+		// Frees everything that was allocated from this arena, and makes room for nSamples samples
+		// (only reallocating if there wasn't enough room already).
+		// Every allocation is rounded up to AudioBufferView::alignmentSamples.
+		void Reset(std::size_t nSamples)
+		{
+			nSamples = AudioBufferView::GetAlignedStride(nSamples);
+			if (nSamples > size || nSamples < size / 2) // Give back the memory if it's mostly unused.
+			{
+				samples = nSamples > 0 ? AllocateAlignedSamples(nSamples) : AlignedSamples();
+				size = nSamples;
+			}
+			used = 0;
+		}
+
+		// Returns nullptr if there isn't enough room left.
+		float* AllocateSamples(std::size_t nSamples)
+		{
+			nSamples = AudioBufferView::GetAlignedStride(nSamples);
+			if (used + nSamples > size) return nullptr;
+
+			float* allocation = samples.get() + used;
+			used += nSamples;
+			return allocation;
+		}
+
+		// Returns an empty view if there isn't enough room left.
+		AudioBufferView Allocate(unsigned int nChannels, unsigned int nFrames)
+		{
+			const std::size_t channelStride = AudioBufferView::GetAlignedStride(nFrames);
+			float* allocation = AllocateSamples(channelStride * nChannels);
+			return allocation ? AudioBufferView(allocation, nChannels, nFrames, channelStride) : AudioBufferView();
+		}
+
+		// The memory reserved by this arena (in bytes).
+		std::size_t GetSize() const
+		{
+			return size * sizeof(float);
+		}
+	};
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * A lock-free FIFO of planar audio, so one thread can hand audio to another without either of them ever waiting.
+	 * Only one thread can write to it, and only one thread can read from it (at a time).
+	 *
+	 * Every channel is a circular buffer of a power of two frames, and the read and write positions only ever count up
+	 * (they're wrapped around with a mask when they're used), so the amount of frames in the FIFO is always just the difference between them.
+	 */
+	class AudioFifo
+	{
+	private:
+		AlignedSamples samples;
+		unsigned int nChannels;
+		std::size_t capacity; // In frames, always a power of two.
+		std::size_t channelStride;
+
+		// On their own cache lines, as they're written by different threads.
+		alignas(AudioBufferView::alignment) std::atomic<std::size_t> readPosition;
+		alignas(AudioBufferView::alignment) std::atomic<std::size_t> writePosition;
+
+		// Copies length frames between a view and the circular buffers, in (at most) two parts, wrapping around the end.
+		template<bool write>
+		void CopyFrames(const AudioBufferView& view, std::size_t position, std::size_t length)
+		{
+			const unsigned int nCopyChannels = std::min(nChannels, view.GetChannelCount());
+			const std::size_t start = position & (capacity - 1);
+			const std::size_t firstPart = std::min(length, capacity - start);
+
+			for (unsigned int channel = 0; channel < nCopyChannels; ++channel)
+			{
+				float* fifoChannel = samples.get() + channel * channelStride;
+				float* viewChannel = view.GetChannel(channel);
+				if constexpr (write)
+				{
+					std::copy_n(viewChannel, firstPart, fifoChannel + start);
+					std::copy_n(viewChannel + firstPart, length - firstPart, fifoChannel);
+				}
+				else
+				{
+					std::copy_n(fifoChannel + start, firstPart, viewChannel);
+					std::copy_n(fifoChannel, length - firstPart, viewChannel + firstPart);
+				}
+			}
+		}
+	public:
+		AudioFifo()
+		{
+			this->nChannels = 0;
+			this->capacity = 0;
+			this->channelStride = 0;
+			this->readPosition = 0;
+			this->writePosition = 0;
+		}
+
+		// Holds at least minimumCapacity frames.
+		AudioFifo(unsigned int nChannels, std::size_t minimumCapacity)
+			: AudioFifo()
+		{
+			this->nChannels = nChannels;
+			this->capacity = std::bit_ceil(std::max<std::size_t>(minimumCapacity, 1));
+			this->channelStride = AudioBufferView::GetAlignedStride(capacity);
+			this->samples = AllocateAlignedSamples(channelStride * nChannels);
+		}
+
+		unsigned int GetChannelCount() const
+		{
+			return nChannels;
+		}
+
+		std::size_t GetCapacity() const
+		{
+			return capacity;
+		}
+
+		std::size_t GetReadableFrames() const
+		{
+			return writePosition.load(std::memory_order_acquire) - readPosition.load(std::memory_order_acquire);
+		}
+
+		std::size_t GetWritableFrames() const
+		{
+			return capacity - GetReadableFrames();
+		}
+
+		// Only called by the writing thread, writes as much of src as there's room for and returns the amount of frames written.
+		std::size_t Write(const AudioBufferView& src)
+		{
+			const std::size_t position = writePosition.load(std::memory_order_relaxed);
+			const std::size_t length = std::min<std::size_t>(src.GetFrameCount(),
+				capacity - (position - readPosition.load(std::memory_order_acquire)));
+
+			CopyFrames<true>(src, position, length);
+			writePosition.store(position + length, std::memory_order_release); // Publish the frames only after they've been written.
+			return length;
+		}
+
+		// Only called by the reading thread, reads as much of dst as is available and returns the amount of frames read.
+		std::size_t Read(const AudioBufferView& dst)
+		{
+			const std::size_t position = readPosition.load(std::memory_order_relaxed);
+			const std::size_t length = std::min<std::size_t>(dst.GetFrameCount(),
+				writePosition.load(std::memory_order_acquire) - position);
+
+			CopyFrames<false>(dst, position, length);
+			readPosition.store(position + length, std::memory_order_release); // Only give the frames back once they've been read.
+			return length;
+		}
+
+		// Only called by the reading thread, like Read but throws the frames away instead of copying them.
+		std::size_t Skip(std::size_t nFrames)
+		{
+			const std::size_t position = readPosition.load(std::memory_order_relaxed);
+			const std::size_t length = std::min(nFrames, writePosition.load(std::memory_order_acquire) - position);
+
+			readPosition.store(position + length, std::memory_order_release);
+			return length;
+		}
+	};
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "digidaw/core/audio/common.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * What the Engine uses of an audio API, so it can run on RtAudio or on the VirtualDevice the same way.
+	 * These do what the RtAudio functions of the same names do (and use its types), so RtAudio's documentation applies.
+	 */
+	class Backend
+	{
+	public:
+		virtual ~Backend()
+		{
+		}
+
+		virtual RtAudio::Api GetCurrentAPI() = 0;
+
+		virtual unsigned int GetDeviceCount() = 0;
+		virtual RtAudio::DeviceInfo GetDeviceInfo(unsigned int device) = 0;
+		virtual unsigned int GetDefaultOutputDevice() = 0;
+		virtual unsigned int GetDefaultInputDevice() = 0;
+
+		virtual RtAudioErrorType OpenStream(
+			RtAudio::StreamParameters* outputParams,
+			RtAudio::StreamParameters* inputParams,
+			RtAudioFormat format,
+			unsigned int sampleRate,
+			unsigned int* bufferFrames,
+			RtAudioCallback callback,
+			void* userData,
+			RtAudio::StreamOptions* options) = 0;
+		virtual void CloseStream() = 0;
+		virtual RtAudioErrorType StartStream() = 0;
+		virtual RtAudioErrorType StopStream() = 0;
+
+		virtual bool IsStreamOpen() = 0;
+		virtual bool IsStreamRunning() = 0;
+
+		virtual double GetStreamTime() = 0;
+		virtual long GetStreamLatency() = 0;
+	};
+
+	// One of the APIs compiled into RtAudio.
+	class RtAudioBackend : public Backend
+	{
+	private:
+		RtAudio audio;
+	public:
+		RtAudioBackend(RtAudio::Api api)
+			: audio(api)
+		{
+		}
+
+		RtAudio::Api GetCurrentAPI() override
+		{
+			return audio.getCurrentApi();
+		}
+
+		unsigned int GetDeviceCount() override
+		{
+			return audio.getDeviceCount();
+		}
+
+		RtAudio::DeviceInfo GetDeviceInfo(unsigned int device) override
+		{
+			return audio.getDeviceInfo(device);
+		}
+
+		unsigned int GetDefaultOutputDevice() override
+		{
+			return audio.getDefaultOutputDevice();
+		}
+
+		unsigned int GetDefaultInputDevice() override
+		{
+			return audio.getDefaultInputDevice();
+		}
+
+		RtAudioErrorType OpenStream(
+			RtAudio::StreamParameters* outputParams,
+			RtAudio::StreamParameters* inputParams,
+			RtAudioFormat format,
+			unsigned int sampleRate,
+			unsigned int* bufferFrames,
+			RtAudioCallback callback,
+			void* userData,
+			RtAudio::StreamOptions* options) override
+		{
+			return audio.openStream(outputParams, inputParams, format, sampleRate, bufferFrames, callback, userData, options);
+		}
+
+		void CloseStream() override
+		{
+			audio.closeStream();
+		}
+
+		RtAudioErrorType StartStream() override
+		{
+			return audio.startStream();
+		}
+
+		RtAudioErrorType StopStream() override
+		{
+			return audio.stopStream();
+		}
+
+		bool IsStreamOpen() override
+		{
+			return audio.isStreamOpen();
+		}
+
+		bool IsStreamRunning() override
+		{
+			return audio.isStreamRunning();
+		}
+
+		double GetStreamTime() override
+		{
+			return audio.getStreamTime();
+		}
+
+		long GetStreamLatency() override
+		{
+			return audio.getStreamLatency();
+		}
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+
+#include "digidaw/core/audio/common.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * The devices (and what they support) that were found for every audio API, the last time they were probed.
+	 * Probing every device can take seconds (some APIs open every device to find its sample rates), so the Engine starts from
+	 * what's in here, and probes the devices again in the background (see Engine::ReconcileDevices).
+	 *
+	 * Devices are kept by API and by name (the indices of the devices can change between runs), and written to a single file (if one has been set),
+	 * a line per device, with the name at the end of the line.
+	 */
+	class DeviceCache
+	{
+	private:
+		static constexpr const char* fileMagic = "DDDC";
+		static constexpr unsigned int fileVersion = 1;
+
+		std::filesystem::path path;
+		std::vector<RtAudio::Api> supportedAPIs; // In the order RtAudio prefers them.
+		std::unordered_map<std::string, std::vector<RtAudio::DeviceInfo>> devices; // By the name of the API, in the order of their indices.
+		std::mutex mutex;
+
+		void Load();
+	public:
+		DeviceCache()
+		{
+		}
+
+		// Loads the cache from this file, an empty path only keeps the devices in memory.
+		void SetPath(const std::filesystem::path& path);
+		ReturnCode Save();
+
+		// Returns false if the devices of this API have never been probed.
+		bool Find(RtAudio::Api api, std::vector<RtAudio::DeviceInfo>& devicesOut);
+		void Store(RtAudio::Api api, const std::vector<RtAudio::DeviceInfo>& apiDevices);
+
+		// Empty if the APIs have never been probed.
+		std::vector<RtAudio::Api> GetSupportedAPIs();
+		void SetSupportedAPIs(const std::vector<RtAudio::Api>& apis);
+
+		// Whether two probes of a device found the same device, with the same capabilities.
+		static bool IsSameDevice(const RtAudio::DeviceInfo& a, const RtAudio::DeviceInfo& b);
+	};
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "digidaw/core/audio/effects/effect.h"
+
+#include "digidaw/core/threading/threadpool.h"
+
+namespace DigiDAW::Core::Detail
+{
+	class FFT;
+}
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	/*
+	 * A convolution processor (for reverb and cabinet impulse responses), meant to be used on Buses.
+	 *
+	 * The impulse response is split into partitions that get larger the further into the impulse response they are.
+	 * Every group of same-sized partitions is a "stage", and each stage is a uniformly partitioned overlap-save convolution
+	 * (every block of input is transformed once, and multiplied with the spectrum of every partition of the stage).
+	 *
+	 *  - The head stage uses small partitions (headBlockSize frames) and is computed in the audio thread.
+	 *  - Every tail stage uses partitions 8 times bigger than the previous stage, and is computed on lower priority
+	 *    background workers. A tail stage with a block size of P only starts 2 * P frames into the impulse response,
+	 *    so the job for a block has a whole block worth of time to finish before its output is needed.
+	 *    The audio thread only waits on it if the job is late (which keeps the output correct, but can glitch).
+	 *
+	 * Without zero latency, the effect reports headBlockSize frames of latency (which the delay compensation takes care of).
+	 * With zero latency, the first headBlockSize frames of the impulse response are convolved directly in the time domain instead,
+	 * which costs headBlockSize multiply-adds per frame.
+	 *
+	 * Multichannel impulse responses can be routed in different ways:
+	 *  - Mono: A single impulse response is used for every channel.
+	 *  - PerChannel: Channel n of the impulse response is used for channel n (e.g. a 5.1 reverb).
+	 *  - Matrix: Impulse response channel (output * nChannels + input) goes from the input to the output (e.g. true stereo,
+	 *    with LL, LR, RL, RR for 2 channels). Every input is only transformed once, and every output only inverse transformed once,
+	 *    no matter how many paths there are.
+	 * If the impulse response doesn't have enough channels for the routing, channel (n % channels) is used for channel n.
+	 */
+	class Convolution : public Effect
+	{
+	public:
+		enum class Routing
+		{
+			Mono,
+			PerChannel,
+			Matrix
+		};
+
+		// Tail stages stop growing at this block size, the last stage covers the rest of the impulse response.
+		static const unsigned int maxBlockSize = 65536;
+		// The most tail stages there can be (with the smallest head block size).
+		static const unsigned int maxTailStages = 4;
+	private:
+		struct Path
+		{
+			unsigned int input;
+			unsigned int output;
+			unsigned int impulse; // The channel of the impulse response
+		};
+
+		struct Stage
+		{
+			unsigned int blockSize;
+			unsigned int nPartitions;
+			unsigned int nBins;
+			bool background;
+
+			std::shared_ptr<Detail::FFT> fft;
+
+			// Per path: the spectrum of every partition (real, then imaginary, for each partition).
+			std::vector<std::vector<float>> partitions;
+			// Per input: the spectra of the last nPartitions input blocks (a frequency domain delay line).
+			std::vector<std::vector<float>> inputSpectra;
+			unsigned int spectrumPosition;
+
+			// Per input: the block that's currently being collected, and the last two blocks (which are transformed).
+			std::vector<std::vector<float>> input;
+			std::vector<std::vector<float>> fftInput;
+
+			// Per output: the block that's currently being played, and the block the background job is computing.
+			std::vector<std::vector<float>> output;
+			std::vector<std::vector<float>> pendingOutput;
+
+			std::vector<float> accumulator; // Real, then imaginary
+			std::vector<float> fftOutput;
+
+			unsigned int position; // The position in the current block (for both input and output)
+			std::future<void> job;
+		};
+
+		// Everything that depends on the impulse response, so it can be built off of the audio thread and swapped in.
+		struct Engine
+		{
+			unsigned int nChannels;
+			unsigned int headBlockSize;
+			std::vector<Path> paths;
+
+			// Zero latency only, per path: the first headBlockSize frames of the impulse response.
+			std::vector<std::vector<float>> directKernels;
+			// Zero latency only, per input: headBlockSize - 1 frames of history, and then the current head block.
+			std::vector<std::vector<float>> history;
+			unsigned int position; // The position in the current head block
+
+			std::vector<Stage> stages; // The head stage first, then the tail stages.
+
+			// The length of the impulse response (with the latency), plus two of the biggest blocks,
+			// by when every block of input that wasn't silent has left every stage.
+			unsigned int tailFrames;
+
+			~Engine();
+		};
+
+		bool zeroLatency;
+		unsigned int headBlockSize;
+
+		unsigned int nChannels;
+		unsigned int sampleRate;
+
+		std::vector<std::vector<float>> impulseResponse;
+		Routing routing;
+		std::uint64_t impulseResponseHash; // Hashed once when it's set, as it can be millions of samples.
+
+		std::unique_ptr<Engine> engine;
+		std::unique_ptr<Engine> pendingEngine; // The next engine, or the last one (to be freed off of the audio thread)
+		std::mutex engineMutex;
+		std::atomic<bool> engineChanged;
+
+		static Threading::ThreadPool& GetBackgroundPool(unsigned int tailStage);
+
+		std::unique_ptr<Engine> BuildEngine();
+		static void ProcessStage(Engine& engine, Stage& stage);
+		void ProcessBoundary(Engine& engine);
+	public:
+		Convolution(bool zeroLatency = false, unsigned int headBlockSize = 128);
+
+		// Can be called from any thread, the new impulse response is prepared on the calling thread.
+		void SetImpulseResponse(const std::vector<std::vector<float>>& impulseResponse, Routing routing);
+
+		void Prepare(unsigned int nChannels, unsigned int maxFrames, unsigned int sampleRate) override;
+		void Process(const AudioBufferView& buffer) override;
+
+		unsigned int GetLatency() override
+		{
+			return zeroLatency ? 0 : headBlockSize;
+		}
+
+		// Without an impulse response, the input is passed through untouched.
+		unsigned int GetTailFrames() override
+		{
+			return engine ? engine->tailFrames : 0;
+		}
+
+		std::string GetName() override
+		{
+			return "Convolution";
+		}
+
+		std::shared_ptr<Effect> Clone() override;
+		std::uint64_t GetStateHash() override;
+	};
+}
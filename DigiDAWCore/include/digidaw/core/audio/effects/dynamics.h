@@ -0,0 +1,107 @@
+#pragma once
+
+#include "digidaw/core/audio/effects/effect.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	/*
+	 * A compressor / expander / gate with a soft knee.
+	 * 
+	 * All the channels are linked (the loudest channel drives the gain of every channel).
+	 * The detector and the gain computer are vectorized over frames, and the gain computer is branch-free
+	 * (the level is converted to dB with a vectorized log approximation, the curve is built from min/max operations,
+	 * and the resulting gain is converted back with a vectorized exp approximation).
+	 * Only the envelope smoothing (RMS averaging and the attack/release ballistics) is done per sample, 
+	 * as every sample depends on the previous one.
+	 */
+	class Dynamics : public Effect
+	{
+	public:
+		enum class Mode
+		{
+			Compressor,
+			Expander,
+			Gate
+		};
+
+		enum class Detection
+		{
+			Peak,
+			RMS
+		};
+
+		struct Parameters
+		{
+			Mode mode;
+			Detection detection;
+
+			float threshold; // In dB
+			float ratio; // Unused by the Gate
+			float knee; // The width of the soft knee, in dB
+			float range; // The maximum amount of gain reduction, in dB
+
+			float attackMS;
+			float releaseMS;
+			float rmsWindowMS;
+
+			float makeupGain; // In dB
+
+			Parameters()
+			{
+				this->mode = Mode::Compressor;
+				this->detection = Detection::Peak;
+				this->threshold = -18.0f;
+				this->ratio = 4.0f;
+				this->knee = 6.0f;
+				this->range = 80.0f;
+				this->attackMS = 10.0f;
+				this->releaseMS = 100.0f;
+				this->rmsWindowMS = 10.0f;
+				this->makeupGain = 0.0f;
+			}
+		};
+	private:
+		Parameters parameters;
+		std::mutex parametersMutex;
+		std::atomic<bool> parametersChanged;
+
+		// The parameters the audio thread is currently using, and the values derived from them.
+		Parameters currentParameters;
+		float compressionSlope;
+		float expansionSlope;
+		float attackCoefficient;
+		float releaseCoefficient;
+		float rmsCoefficient;
+
+		float rmsState;
+		float envelope; // The smoothed gain reduction (in dB)
+
+		std::vector<float> gainBuffer;
+
+		unsigned int sampleRate;
+
+		void UpdateCoefficients();
+	public:
+		// The current gain reduction in dB (for metering).
+		std::atomic<float> gainReduction;
+
+		Dynamics();
+
+		void SetParameters(const Parameters& parameters);
+		Parameters GetParameters();
+
+		void Prepare(unsigned int nChannels, unsigned int maxFrames, unsigned int sampleRate) override;
+		void Process(const AudioBufferView& buffer) override;
+
+		// Silence in is always silence out, but the envelope keeps moving until it's settled on the silence.
+		unsigned int GetTailFrames() override;
+
+		std::string GetName() override
+		{
+			return "Dynamics";
+		}
+
+		std::shared_ptr<Effect> Clone() override;
+		std::uint64_t GetStateHash() override;
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	/*
+	 * The base class for every effect that can be inserted into the effects chain of a Track or Bus.
+	 * 
+	 * Effects process planar buffers (see AudioBufferView) in place,
+	 * and are always called from the audio processing threads, so Process should never allocate or block.
+	 * Anything that needs to be allocated should be done in Prepare, which the Mixer calls whenever
+	 * the amount of channels, the buffer size, or the sample rate changes.
+	 */
+	class Effect
+	{
+	public:
+		static constexpr unsigned int infiniteTail = std::numeric_limits<unsigned int>::max();
+
+		virtual ~Effect()
+		{
+		}
+
+		virtual void Prepare(unsigned int nChannels, unsigned int maxFrames, unsigned int sampleRate) = 0;
+		virtual void Process(const AudioBufferView& buffer) = 0;
+
+		// The amount of latency (in frames) this effect introduces, used for delay compensation.
+		virtual unsigned int GetLatency()
+		{
+			return 0;
+		}
+
+		/*
+		 * How long (in frames) the output of this effect can keep going after its input goes silent, not counting its latency.
+		 * Once the input of a Mixable has been silent for longer than the tails (and latencies) of all of its effects,
+		 * the Mixer stops calling Process until the input isn't silent anymore, so effects that can output something without any input
+		 * (or don't know how long their tail is) return infiniteTail. This is called from the audio processing threads.
+		 */
+		virtual unsigned int GetTailFrames()
+		{
+			return infiniteTail;
+		}
+
+		virtual std::string GetName() = 0;
+
+		// A new effect with the same settings as this one (and none of its processing state), so a track can be rendered
+		// without touching the effects the audio threads are using (see Mixer::FreezeTrack). Returns nullptr if it can't be copied.
+		virtual std::shared_ptr<Effect> Clone()
+		{
+			return nullptr;
+		}
+
+		// A hash of every setting that changes the output of this effect, which is a part of the key of a render (see RenderCache).
+		// Returns 0 if the settings can't be hashed, so nothing this effect is on is ever cached.
+		virtual std::uint64_t GetStateHash()
+		{
+			return 0;
+		}
+	};
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "digidaw/core/audio/effects/effect.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	/*
+	 * A parametric equalizer made of a cascade of biquad filters (one per band).
+	 * 
+	 * Instead of filtering one channel at a time (where every sample depends on the previous one, 
+	 * so the filter can't be vectorized over time) the channels are laid out as the lanes of a SIMD vector,
+	 * so 4, 8 or 16 channels are filtered at the same time with a single set of vector instructions.
+	 * Because of this, the coefficients and filter state are stored structure-of-arrays (one value per lane),
+	 * which also means every lane could have different coefficients.
+	 * Mono, stereo and 3 channel buffers are filtered a channel at a time instead, as padding them out to 4 lanes costs more than it saves.
+	 * 
+	 * Coefficient changes are smoothed by linearly ramping the coefficients to their new values,
+	 * so the trigonometry is only computed once when a band changes, not per sample.
+	 */
+	class Equalizer : public Effect
+	{
+	public:
+		enum class FilterType
+		{
+			Bell,
+			LowShelf,
+			HighShelf,
+			LowPass,
+			HighPass,
+			Notch
+		};
+
+		struct Band
+		{
+			FilterType type;
+			float frequency; // In hz
+			float gain; // In dB (only used by Bell and Shelf filters)
+			float q;
+			bool enabled;
+
+			Band()
+			{
+				this->type = FilterType::Bell;
+				this->frequency = 1000.0f;
+				this->gain = 0.0f;
+				this->q = 0.707f;
+				this->enabled = false;
+			}
+
+			Band(FilterType type, float frequency, float gain, float q, bool enabled = true)
+			{
+				this->type = type;
+				this->frequency = frequency;
+				this->gain = gain;
+				this->q = q;
+				this->enabled = enabled;
+			}
+		};
+
+		static const unsigned int maxBands = 8;
+
+		// The amount of frames it takes to go from the old coefficients to the new ones.
+		unsigned int smoothingFrames = 256;
+	private:
+		// A single group of channels that are processed together in the lanes of a vector.
+		struct LaneGroup
+		{
+			unsigned int firstChannel;
+			unsigned int nChannels;
+
+			// Per band: b0, b1, b2, a1, a2, each with one value per lane.
+			std::vector<float> coefficients;
+			std::vector<float> coefficientDeltas;
+			std::vector<float> targetCoefficients;
+			// Per band: z1, z2, each with one value per lane (Transposed Direct Form II).
+			std::vector<float> state;
+		};
+
+		std::vector<LaneGroup> groups;
+		unsigned int laneWidth; // 4, 8 or 16 lanes, or 1 (without a vector) for fewer than 4 channels
+		unsigned int rampRemaining;
+
+		std::vector<float> laneBuffer; // The interleaved (frame-major) buffer the filters are run on (only used with more than one lane).
+
+		unsigned int sampleRate;
+		unsigned int nChannels;
+
+		std::array<Band, maxBands> bands;
+		std::array<bool, maxBands> bandActive; // Whether the band is enabled or is still ramping to flat.
+		unsigned int tailFrames; // How long the active bands take to ring out, for the bands the audio thread is using.
+
+		std::mutex bandsMutex;
+		std::atomic<bool> bandsChanged;
+
+		void CalculateCoefficients(const Band& band, float* coefficients);
+		void UpdateTargets(const std::array<Band, maxBands>& currentBands);
+	public:
+		Equalizer();
+
+		void SetBand(unsigned int index, const Band& band);
+		Band GetBand(unsigned int index);
+
+		void Prepare(unsigned int nChannels, unsigned int maxFrames, unsigned int sampleRate) override;
+		void Process(const AudioBufferView& buffer) override;
+
+		unsigned int GetTailFrames() override
+		{
+			return tailFrames;
+		}
+
+		std::string GetName() override
+		{
+			return "Equalizer";
+		}
+
+		std::shared_ptr<Effect> Clone() override;
+		std::uint64_t GetStateHash() override;
+	};
+}
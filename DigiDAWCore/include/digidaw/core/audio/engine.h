@@ -4,12 +4,21 @@
 
 #include "digidaw/core/audio/trackstate.h"
 #include "digidaw/core/audio/mixer.h"
+#include "digidaw/core/audio/devicecache.h"
+#include "digidaw/core/audio/backend.h"
+#include "digidaw/core/audio/virtualdevice.h"
 
 namespace DigiDAW::Core::Audio
 {
 	class Engine
 	{
 	public:
+		// The VirtualDevice, which is there like any other API (after the ones that were probed).
+		static constexpr RtAudio::Api virtualAPI = VirtualDevice::api;
+
+		// The index of the "None" (no device) option, for the input or output device.
+		static constexpr unsigned int noDevice = std::numeric_limits<unsigned int>::max();
+
 		struct AudioDevice
 		{
 			RtAudio::DeviceInfo info;
@@ -27,11 +36,80 @@ namespace DigiDAW::Core::Audio
 			{
 				this->info = RtAudio::DeviceInfo();
 				this->backend = RtAudio::Api::UNSPECIFIED;
-				this->index = -1;
+				this->index = noDevice;
 			}
 		};
+
+		// How the audio threads (the callback, and the Mixer's track and bus threads) are scheduled.
+		struct ThreadSettings
+		{
+			// Use realtime scheduling, falling back to a high priority if it's not allowed.
+			// Otherwise the callback keeps the scheduling the audio API gave it.
+			bool realtime;
+			int realtimePriority; // From 1 to 99 (Linux only)
+			bool roundRobin; // SCHED_RR instead of SCHED_FIFO (Linux only)
+
+			// Pin the callback to the first core and the Mixer's threads to the cores after it, 
+			// and keep the meter thread on the last core (if there are at least 3 cores).
+			bool pinThreads;
+
+			// The most threads the Mixer processes the tracks on (e.g. to check a render doesn't depend on how many there are),
+			// 0 for a thread per track.
+			unsigned int maxTrackThreads;
+
+			ThreadSettings()
+			{
+				this->realtime = false;
+				this->realtimePriority = 70;
+				this->roundRobin = false;
+				this->pinThreads = false;
+				this->maxTrackThreads = 0;
+			}
+		};
+
+		/*
+		 * Changes to the backend, devices, sample rate and buffer size that are applied together by ApplyConfig,
+		 * so the stream is only reopened (and the Mixer's buffers only reallocated) once, however many of them change.
+		 * Anything that's left unset keeps its current value, or its default if the backend changes.
+		 */
+		struct EngineConfig
+		{
+			std::optional<RtAudio::Api> api;
+
+			// By name, as the indices of the devices of another backend aren't known yet. An empty name is no device ("None").
+			std::optional<std::string> outputDevice;
+			std::optional<std::string> inputDevice;
+
+			// If it's left unset and the devices change, the fastest sample rate they support is used (like SetCurrentOutputDevice).
+			std::optional<unsigned int> sampleRate;
+			std::optional<unsigned int> bufferSize;
+		};
+
+		// How long the last time the stream was (re)opened took, in milliseconds (see Mixer Reconfiguration).
+		struct ReconfigurationReport
+		{
+			double planMS = 0.0; // Planning the new buffers, while the old stream was still playing.
+			double fadeOutMS = 0.0; // Fading out and stopping the old stream.
+			double reopenMS = 0.0; // Opening the new stream, swapping in the new buffers, and starting it again (the gap in the audio).
+			double totalMS = 0.0;
+		};
+
+		// What every audio thread was actually granted.
+		struct ThreadReport
+		{
+			Threading::ThreadPriority::Report callback;
+			std::vector<Threading::ThreadPriority::Report> trackThreads;
+			std::vector<Threading::ThreadPriority::Report> busThreads;
+			std::vector<Threading::ThreadPriority::Report> summingThreads;
+			Threading::ThreadPriority::Report meterThread;
+		};
 	private:
-		std::unique_ptr<RtAudio> audioBackend;
+		std::unique_ptr<Backend> audioBackend;
+
+		VirtualDevice::Settings virtualDeviceSettings;
+
+		std::unique_ptr<Backend> CreateBackend(RtAudio::Api api);
+		ReturnCode ChangeBackend(std::unique_ptr<Backend> backend);
 
 		std::vector<RtAudio::Api> supportedAPIs;
 
@@ -44,7 +122,7 @@ namespace DigiDAW::Core::Audio
 			However, this would require multiple instances of RtAudio to open multiple streams.
 			Which I believe is a valid use of the API, but currently I'm not concerning myself with it.
 		*/
-		unsigned int currentOutputDevice; // -1 is reserved for the "None" (no device) option.
+		unsigned int currentOutputDevice; // Or noDevice for the "None" option.
 		unsigned int currentInputDevice;
 
 		unsigned int currentSampleRate;
@@ -52,14 +130,48 @@ namespace DigiDAW::Core::Audio
 
 		void UpdateCurrentSupportedSampleRates();
 		void ResetSampleRate();
-		AudioDevice GetAudioDevice(unsigned int index);
+		std::vector<AudioDevice> ListDevices(Backend& backend);
 		void UpdateDevices();
 
-		unsigned int GetFirstAvailableInputDevice();
-		unsigned int GetFirstAvailableOutputDevice();
+		static unsigned int GetFirstAvailableInputDevice(Backend& backend, const std::vector<AudioDevice>& devices);
+		static unsigned int GetFirstAvailableOutputDevice(Backend& backend, const std::vector<AudioDevice>& devices);
+		static unsigned int FindDevice(const std::vector<AudioDevice>& devices, const std::string& name, bool output);
 
 		void InitializeDevices();
 
+		/*
+		 * Device probing:
+		 *
+		 * Probing the devices of every compiled API can take seconds, so the Engine starts with the devices in the device cache
+		 * (or only probes the devices of the API it starts with, the first time), and every API is probed on the device probe thread.
+		 * Once that's finished, ReconcileDevices brings the devices (and the cache) up to date.
+		 */
+		struct DeviceProbe
+		{
+			std::vector<RtAudio::Api> supportedAPIs;
+			std::vector<std::pair<RtAudio::Api, std::vector<RtAudio::DeviceInfo>>> devices; // For every API with devices.
+		};
+
+		DeviceCache deviceCache;
+		std::mutex deviceProbeMutex;
+		DeviceProbe deviceProbe;
+		std::atomic<bool> deviceProbeFinished = false;
+		std::atomic<bool> probingDevices = false;
+		std::jthread deviceProbeThread;
+
+		void ProbeDevices(std::stop_token stopToken);
+
+		ThreadSettings threadSettings;
+		std::mutex threadSettingsMutex;
+		std::atomic<bool> callbackScheduled = true; // Cleared whenever the callback thread needs to apply the settings.
+		Threading::ThreadPriority::Report callbackReport;
+
+		void ScheduleCallbackThread();
+
+		ReconfigurationReport reconfigurationReport;
+
+		void QuiesceStream();
+
 		static int AudioCallback(
 			void* outputBuffer, 
 			void* inputBuffer, 
@@ -71,7 +183,8 @@ namespace DigiDAW::Core::Audio
 		TrackState trackState; // TrackState initializes before the Mixer.
 		Mixer mixer;
 
-		Engine(RtAudio::Api api);
+		// The devices found the last time are kept in the file at deviceCachePath (if it isn't empty), see Device probing.
+		Engine(RtAudio::Api api, const std::filesystem::path& deviceCachePath = std::filesystem::path());
 		~Engine();
 
 		const std::vector<RtAudio::Api>& GetSupportedAPIs();
@@ -79,8 +192,39 @@ namespace DigiDAW::Core::Audio
 
 		ReturnCode ChangeBackend(RtAudio::Api api);
 
+		// The virtual device is created with these the next time it's used, or again straight away if it's the current API.
+		// Returns an error (without changing anything) if there's an input or reference file that can't be read.
+		ReturnCode SetVirtualDeviceSettings(const VirtualDevice::Settings& settings);
+		VirtualDevice::Settings GetVirtualDeviceSettings()
+		{
+			return virtualDeviceSettings;
+		}
+
+		// The virtual device, if it's the current API (otherwise nullptr).
+		VirtualDevice* GetVirtualDevice();
+
+		/*
+		 * Validates everything in config against the devices it'll use (those of the new backend, if it changes) before changing anything,
+		 * and returns an error without changing anything if some of it can't be used (an unsupported API, a missing device, or an unsupported sample rate).
+		 * Otherwise applies all of it and reopens the stream once (if anything changed), restarting it if it was running.
+		 */
+		ReturnCode ApplyConfig(const EngineConfig& config);
+
 		const std::vector<AudioDevice>& GetDevices();
 
+		/*
+		 * Applies the devices found by the device probe thread once it's finished (only once), keeping the selected devices
+		 * (by name, as their indices can change) and reopening the stream if anything about them changed.
+		 * Returns true if the devices changed. Called from the thread that uses the rest of the Engine (e.g. every frame of the UI),
+		 * or with wait to block until the probe has finished (for when something can't be decided without it).
+		 */
+		bool ReconcileDevices(bool wait = false);
+
+		bool IsProbingDevices()
+		{
+			return probingDevices;
+		}
+
 		std::string GetAPIDisplayName(RtAudio::Api api);
 		std::string GetAPIName(RtAudio::Api api);
 
@@ -96,6 +240,10 @@ namespace DigiDAW::Core::Audio
 		ReturnCode SetCurrentBufferSize(unsigned int bufferSize);
 		unsigned int GetCurrentBufferSize();
 
+		// The total latency (in frames) from a Track to the output device, 
+		// the delay compensation of the Mixer plus the latency reported by the stream.
+		unsigned int GetTotalOutputLatency();
+
 		const std::vector<unsigned int>& GetSupportedSampleRates();
 		ReturnCode GetSupportedSampleRates(std::vector<unsigned int>& sampleRates);
 		ReturnCode GetSupportedSampleRates(std::vector<unsigned int>& sampleRates, unsigned int outputDevice, unsigned int inputDevice);
@@ -106,7 +254,17 @@ namespace DigiDAW::Core::Audio
 
 		ReturnCode StopEngine();
 
+		// Applies to the callback on its next call, and to the Mixer's threads before their next task.
+		ReturnCode SetThreadSettings(const ThreadSettings& settings);
+		ThreadSettings GetThreadSettings();
+		ThreadReport GetThreadReport();
+
 		bool IsStreamOpen();
 		bool IsStreamRunning();
+
+		ReconfigurationReport GetReconfigurationReport()
+		{
+			return reconfigurationReport;
+		}
 	};
 }
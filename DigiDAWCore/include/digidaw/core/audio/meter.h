@@ -0,0 +1,102 @@
+#pragma once
+
+#include <span>
+
+#include "digidaw/core/audio/common.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * Hands the levels of a meter from the thread that computes them (the Mixer's meter thread) to the one that draws them (the UI), through a triple buffer.
+	 *
+	 * There are three slots: the writer has one, the reader has one, and the third is the one that was last handed over.
+	 * Publish fills the writer's slot and swaps it with the handed over one, and Read takes the handed over one if it's newer than its own,
+	 * so neither of them ever waits on the other (or allocates), and the reader always gets a whole set of levels from the same update.
+	 * Every slot starts on its own cache line, and is only as big as the meter's channels.
+	 *
+	 * There can only be one writer and one reader, and the levels Read returns stay valid until the next Read.
+	 */
+	class Meter
+	{
+	public:
+		struct ChannelInfo
+		{
+		public:
+			float rms;
+			float peak;
+			bool clip;
+
+			ChannelInfo()
+			{
+				this->rms = -(float)INFINITY;
+				this->peak = -(float)INFINITY;
+
+				this->clip = false;
+			}
+		};
+	private:
+		static constexpr std::size_t cacheLineSize = 64;
+		static constexpr unsigned char indexMask = 0x3;
+		static constexpr unsigned char newerFlag = 0x4; // Set on the handed over slot once it's been published, until it's been read.
+		static constexpr std::size_t channelsPerLine = cacheLineSize / sizeof(ChannelInfo);
+
+		struct alignas(cacheLineSize) Line
+		{
+			ChannelInfo channels[channelsPerLine];
+		};
+
+		// The writer and the reader both change the handed over index on every update, so the rest of what they use goes on the same line.
+		struct alignas(cacheLineSize) Control
+		{
+			std::atomic<unsigned char> handedOver;
+			unsigned char writer;
+			unsigned char reader;
+			std::uint32_t nChannels[3]; // Of each slot, as the output's channels can change between updates.
+		};
+
+		Control control;
+		std::size_t capacity;
+		std::size_t linesPerSlot;
+		std::unique_ptr<Line[]> lines;
+
+		ChannelInfo* GetSlot(unsigned char slot)
+		{
+			return lines[slot * linesPerSlot].channels;
+		}
+	public:
+		// Holds up to capacity channels, anything published past that is left out.
+		Meter(std::size_t capacity)
+		{
+			this->capacity = capacity;
+			this->linesPerSlot = std::max<std::size_t>((capacity + channelsPerLine - 1) / channelsPerLine, 1);
+			this->lines = std::make_unique<Line[]>(3 * linesPerSlot);
+
+			control.handedOver.store(0, std::memory_order_relaxed);
+			control.writer = 1;
+			control.reader = 2;
+			std::fill(std::begin(control.nChannels), std::end(control.nChannels), 0);
+		}
+
+		Meter(const Meter&) = delete;
+		Meter& operator=(const Meter&) = delete;
+
+		// Only from the writer.
+		void Publish(std::span<const ChannelInfo> channels)
+		{
+			const std::size_t nChannels = std::min(channels.size(), capacity);
+			std::copy_n(channels.begin(), nChannels, GetSlot(control.writer));
+			control.nChannels[control.writer] = static_cast<std::uint32_t>(nChannels);
+
+			control.writer = control.handedOver.exchange(control.writer | newerFlag, std::memory_order_acq_rel) & indexMask;
+		}
+
+		// Only from the reader, the newest levels that have been published (none until the first Publish).
+		std::span<const ChannelInfo> Read()
+		{
+			if (control.handedOver.load(std::memory_order_relaxed) & newerFlag)
+				control.reader = control.handedOver.exchange(control.reader, std::memory_order_acq_rel) & indexMask;
+
+			return std::span<const ChannelInfo>(GetSlot(control.reader), control.nChannels[control.reader]);
+		}
+	};
+}
@@ -3,8 +3,13 @@
 #include "digidaw/core/threading/threadpool.h"
 
 #include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/audiobuffer.h"
+#include "digidaw/core/audio/audiofifo.h"
+#include "digidaw/core/audio/rendercache.h"
+#include "digidaw/core/audio/meter.h"
 
 #include "digidaw/core/audio/trackstate.h"
+#include "digidaw/core/audio/spectrumanalyzer.h"
 
 namespace DigiDAW::Core::Audio
 {
@@ -17,10 +22,11 @@ namespace DigiDAW::Core::Audio
 	 * |
 	 * track buffer (this is where gain is applied and panning if it's a stereo track)
 	 * |
-	 * bus input buffer 
+	 * bus input gain matrix 
 	 * (this is apart of the track -> bus channel mapping system, 
 	 * which allows any channel on the track to be mapped to any number of bus channels. 
-	 * Panning gets applied here instead if this is a mono track with a stereo output)
+	 * Panning gets applied here instead if this is a mono track mapped to two bus channels,
+	 * and if the mapping asks for layout panning, channels mapped onto a surround layout get panned, up or downmixed, see Detail::Panning)
 	 * |
 	 * bus buffer 
 	 * (this is where bus processing begins, any track can output to any number of buses.
@@ -30,29 +36,15 @@ namespace DigiDAW::Core::Audio
 	{
 	public:
 		// TODO: LUFS metering (could be based off this https://github.com/klangfreund/LUFSMeter)
-		struct ChannelInfo
-		{
-		public:
-			float rms;
-			float peak;
-			bool clip;
-
-			ChannelInfo()
-			{
-				this->rms = -(float)INFINITY;
-				this->peak = -(float)INFINITY;
-
-				this->clip = false;
-			}
-		};
+		using ChannelInfo = Meter::ChannelInfo;
 
 		struct MixableInfo
 		{
-		public:
-			std::vector<ChannelInfo> channels;
 		private:
 			std::vector<std::vector<float>> lookbackBuffers; // The lookback buffers that are used to calculate the amplitudes used for metering.
 			std::mutex lookbackBufferMutex;
+			std::size_t lookbackSilentFrames = 0; // Once a whole lookback interval of silence has been added, there's no need to add more.
+			std::shared_ptr<SpectrumAnalyzer> spectrumAnalyzer; // Only for buses, and only when it's been enabled.
 			std::future<void> processAsync;
 		public:
 			MixableInfo()
@@ -69,91 +61,546 @@ namespace DigiDAW::Core::Audio
 
 		Engine& audioEngine;
 
-		struct MixBuffer
+		// A circular buffer used to delay a source (with any amount of channels) by a set amount of frames,
+		// used to compensate for the latency of parallel paths into a bus.
+		// The memory is preallocated whenever the delay changes, so that processing never has to allocate.
+		// The delayed output is written to a scratch buffer from the buffer pool.
+		struct DelayLine
 		{
-			std::vector<float> buffer;
+			std::vector<float> buffer; // Each channel has its own circular buffer of "size" samples.
+
+			unsigned int nChannels;
+			std::size_t size; // Always a power of two.
+			std::size_t writePosition;
+			unsigned int delay;
+			std::size_t silentFrames; // How many frames of silence were written last, the whole buffer is silent once it's reached size.
+
+			DelayLine()
+			{
+				this->nChannels = 0;
+				this->size = 0;
+				this->writePosition = 0;
+				this->delay = 0;
+				this->silentFrames = 0;
+			}
 
-			MixBuffer()
+			DelayLine(unsigned int nChannels)
 			{
+				this->nChannels = nChannels;
+				this->size = 0;
+				this->writePosition = 0;
+				this->delay = 0;
+				this->silentFrames = 0;
 			}
 
-			MixBuffer(unsigned int nFrames, unsigned int nChannels)
+			// Whether nothing but silence can come out of it, for as long as only silence goes in.
+			bool IsFlushed() const
 			{
-				this->buffer = std::vector<float>(nChannels * nFrames);
+				return delay == 0 || silentFrames >= size;
+			}
+
+			void SetDelay(unsigned int delay, unsigned int nFrames)
+			{
+				this->delay = delay;
+				silentFrames = 0; // What's already in the buffer is read from somewhere else now, so it's flushed again.
+				if (delay == 0) return;
+
+				// Only reallocate if the current circular buffer is too small to hold the new delay.
+				std::size_t requiredSize = std::bit_ceil(static_cast<std::size_t>(delay) + nFrames);
+				if (requiredSize > size)
+				{
+					size = requiredSize;
+					buffer = std::vector<float>(static_cast<std::size_t>(nChannels) * size);
+					writePosition = 0;
+					silentFrames = size;
+				}
 			}
 		};
-		
+
+		// A gain matrix that's recomputed whenever the pan parameters it depends on change, 
+		// and ramped from the previous matrix over the next block so the change doesn't click.
+		// The memory is preallocated, so updating it never has to allocate.
+		struct PanMatrix
+		{
+			std::vector<float> gains; // The gains at the start of the next block.
+			std::vector<float> targetGains; // The gains at the end of the next block.
+
+			// The parameters that the target gains were computed with (NaN until they've been computed).
+			float pan;
+			float panDepth;
+
+			PanMatrix()
+			{
+				this->pan = std::numeric_limits<float>::quiet_NaN();
+				this->panDepth = std::numeric_limits<float>::quiet_NaN();
+			}
+
+			PanMatrix(std::size_t size)
+				: PanMatrix()
+			{
+				this->gains = std::vector<float>(size);
+				this->targetGains = std::vector<float>(size);
+			}
+		};
+
+		/*
+		 * A channel mapping compiled into a sparse gain matrix, with an entry for every (source channel, destination channel) pair 
+		 * that's mapped. The entries are sorted by source channel and then destination channel, so each block of a source channel
+		 * is read once and fanned out to all of its destinations, and only the mapped pairs cost anything 
+		 * (so even 64 channel mappings are cheap).
+		 */
+		struct MappingMatrix
+		{
+			std::vector<unsigned int> sources;
+			std::vector<unsigned int> destinations;
+			PanMatrix gains; // The gain of every entry
+
+			// The gain of every channel in the mapping (in mapping order), and the entry it's added to (or -1 if it's out of range).
+			std::vector<float> mappingGains;
+			std::vector<int> mappingEntries;
+
+			MappingMatrix()
+			{
+			}
+
+			MappingMatrix(const TrackState::ChannelMapping& mapping, unsigned int nSourceChannels, unsigned int nDestinationChannels)
+			{
+				for (unsigned int source = 0; source < nSourceChannels && source < mapping.mapping.size(); ++source)
+				{
+					const std::size_t firstEntry = sources.size();
+
+					// Every destination of this source channel, sorted, with duplicates merged into one entry.
+					std::vector<unsigned int> sortedDestinations;
+					for (unsigned int destination : mapping.mapping[source])
+						if (destination < nDestinationChannels) sortedDestinations.push_back(destination);
+					std::sort(sortedDestinations.begin(), sortedDestinations.end());
+					sortedDestinations.erase(std::unique(sortedDestinations.begin(), sortedDestinations.end()), sortedDestinations.end());
+
+					for (unsigned int destination : sortedDestinations)
+					{
+						sources.push_back(source);
+						destinations.push_back(destination);
+					}
+
+					for (unsigned int destination : mapping.mapping[source])
+					{
+						auto it = std::lower_bound(sortedDestinations.begin(), sortedDestinations.end(), destination);
+						mappingEntries.push_back((it != sortedDestinations.end() && *it == destination) ?
+							static_cast<int>(firstEntry + (it - sortedDestinations.begin())) : -1);
+					}
+				}
+
+				this->gains = PanMatrix(sources.size());
+				this->mappingGains = std::vector<float>(mappingEntries.size());
+			}
+		};
+
+		/*
+		 * Anticipative processing:
+		 *
+		 * A track that isn't fed by the input device in real time (see TrackState::Track::liveInput) doesn't need to be processed
+		 * within the callback, as its input is already there ahead of time. So when anticipative processing is enabled,
+		 * the input and effects of those tracks are rendered ahead by the anticipative threads, in blocks of up to anticipativeBlockFrames,
+		 * into a FIFO that's kept anticipativeLookaheadMS ahead of the callback, and the callback only reads them back out
+		 * (the gain and panning are still applied in the callback, so they respond straight away).
+		 *
+		 * That leaves only the live tracks and the buses to be processed at the device buffer size, so small buffers can be used
+		 * for tracking with hundreds of tracks, as long as the effects on them keep up on average. Changes to those effects are heard
+		 * once the audio that was already rendered has played out.
+		 */
+		struct AnticipativeTrack
+		{
+			std::shared_ptr<TrackState::Track> track;
+			AudioFifo fifo;
+			AudioBuffer renderBuffer; // A single block, only used by the anticipative threads.
+
+			std::size_t startPosition; // The frame of the timeline the FIFO starts at.
+
+			// The silence of the rendered blocks, counted in frames written to the FIFO.
+			std::size_t silentFrames; // Only used by the anticipative threads (see RenderTrackInput).
+			std::size_t renderedFrames; // Only used by the anticipative threads.
+			std::atomic<std::size_t> audibleFrames; // Everything from here on is silent, set before the block is written.
+			std::size_t playedFrames; // Only used by the callback.
+
+			AnticipativeTrack(const std::shared_ptr<TrackState::Track>& track, std::size_t capacity, unsigned int blockFrames, std::size_t startPosition)
+				: fifo(static_cast<unsigned int>(track->nChannels), capacity),
+				renderBuffer(static_cast<unsigned int>(track->nChannels), blockFrames)
+			{
+				this->track = track;
+				this->startPosition = startPosition;
+				this->silentFrames = 0;
+				this->renderedFrames = 0;
+				this->audibleFrames = 0;
+				this->playedFrames = 0;
+			}
+		};
+
+		/*
+		 * Freezing:
+		 *
+		 * A frozen track plays back a render of its input and effects instead of processing them (its gain and panning are still applied live).
+		 * The render covers the timeline from the start to the end of the clip plus the tails and latencies of the effects, and it's played back
+		 * at the transport position, so it lines up with the timeline wherever it's moved to. A track with an effect that has an infinite tail
+		 * (see Effects::Effect::GetTailFrames) never ends, so it can't be frozen.
+		 * The render is made on the freeze thread with copies of the effects (see Effects::Effect::Clone), so the track keeps playing while it's rendered,
+		 * and it's stored in the render cache, keyed by a hash of every setting that went into it (see GetRenderKey).
+		 *
+		 * The freeze thread recomputes the key of every frozen track every freezeIntervalMS, and a track whose key has changed
+		 * goes straight back to being processed (only the tracks that changed are touched, everything else stays frozen).
+		 * It's frozen again once its settings have been left alone for freezeDelayMS (without rendering anything if those settings
+		 * were rendered before). With automatic freezing, the same is done for every track that isn't live, whether or not it was frozen.
+		 */
+		struct FrozenTrack
+		{
+			std::uint64_t key;
+			std::shared_ptr<const AudioBuffer> render;
+			std::size_t audibleFrames; // Everything in the render from here on is silence, as is everything after the end of it.
+
+			FrozenTrack(std::uint64_t key, const std::shared_ptr<const AudioBuffer>& render, std::size_t audibleFrames)
+			{
+				this->key = key;
+				this->render = render;
+				this->audibleFrames = audibleFrames;
+			}
+		};
+
+		/*
+		 * Silence propagation:
+		 *
+		 * Most tracks are silent most of the time, so every track and bus buffer is flagged as silent when it's known to be,
+		 * and then nothing is written to it at all (whatever is in it is never read). A track is silent once its input has been silent
+		 * for longer than the tails and latencies of its effects (see Effects::Effect::GetTailFrames), and a bus is silent
+		 * once all of its inputs are silent (and have been for longer than the tails of its effects).
+		 *
+		 * The gain, panning and summing of silent buffers are skipped, as are the effects of silent tracks and buses. Delay lines are the
+		 * exception, as they still hold the audio from before the input went silent, so a silent input is fed through its delay line
+		 * (from the silence buffer) until the delay line has been flushed. The meters are fed from the silence buffer.
+		 */
+		enum class InputState
+		{
+			Silent,
+			Flushing, // The input is silent, but its delay line still has to be flushed.
+			Audible
+		};
+
 		struct TrackInfo
 		{
-			MixBuffer mainTrackBuffer;
+			AudioBufferView mainTrackBuffer; // From the buffer pool
+			PanMatrix balance; // A gain for every channel
+			std::shared_ptr<AnticipativeTrack> anticipative; // Only set if the track is rendered ahead.
+			std::shared_ptr<FrozenTrack> frozen; // Only set if the track is playing back a render.
+
+			bool silent = false; // Whether the track buffer is known to be silent this block (and wasn't written to).
+			std::size_t silentFrames = 0; // How long the input has been silent for (see RenderTrackInput).
 
 			TrackInfo()
 			{
 			}
 
-			TrackInfo(const std::shared_ptr<TrackState::Track>& track, unsigned int nFrames)
+			TrackInfo(const std::shared_ptr<TrackState::Track>& track)
 			{
-				this->mainTrackBuffer = MixBuffer(nFrames, static_cast<unsigned int>(track->nChannels));
+				this->balance = PanMatrix(static_cast<std::size_t>(track->nChannels));
 			}
 		};
 
 		struct BusInfo
 		{
-			MixBuffer mainBusBuffer;
-			std::vector<std::vector<MixBuffer>> trackInputBuffers;
-			std::vector<std::vector<MixBuffer>> busInputBuffers;
+			AudioBufferView mainBusBuffer; // From the buffer pool
+			AudioBufferView delayBuffer; // Scratch for the delayed inputs (only if there's more than one input to align)
+			double* doubleBusBuffer = nullptr; // The inputs are summed into this instead if double precision summing is enabled.
+			PanMatrix balance; // A gain for every channel
+
+			float summingCost = 0.0f; // The (smoothed) CPU time of summing the inputs, in microseconds.
+
+			bool silent = false; // Whether the bus buffer is known to be silent this block (and wasn't written to).
+			std::size_t silentFrames = 0; // How long all the inputs have been silent for.
+
+			// Whether every input has to be summed this block (only written before summing, so every summing thread reads the same).
+			std::vector<InputState> trackInputStates;
+			std::vector<InputState> busInputStates;
+
+			// The gain matrix of every input (from the channels of the input to the channels of this bus),
+			// compiled from its channel mapping, with gains computed from its panning.
+			std::vector<MappingMatrix> trackInputMatrices;
+			std::vector<MappingMatrix> busInputMatrices;
+
+			// Latency compensation for each input, and for the output to the device.
+			std::vector<DelayLine> trackInputDelays;
+			std::vector<DelayLine> busInputDelays;
+			DelayLine outputDelay;
 
 			BusInfo()
 			{
 			}
 
-			BusInfo(const std::shared_ptr<TrackState::Bus>& bus, unsigned int nFrames)
+			BusInfo(const std::shared_ptr<TrackState::Bus>& bus)
 			{
-				this->mainBusBuffer = MixBuffer(nFrames, static_cast<unsigned int>(bus->nChannels));
+				const std::size_t nChannels = static_cast<std::size_t>(bus->nChannels);
+				this->balance = PanMatrix(nChannels);
 
-				// Each channel of the track associated with this input has a mapping to the channels of this bus
-				for (unsigned int input = 0; input < bus->trackInputs.size(); ++input)
+				for (const TrackState::TrackInput& trackInput : bus->trackInputs)
 				{
-					const TrackState::TrackInput& trackInput = bus->trackInputs[input];
-					std::vector<MixBuffer> channelBuffers;
-
-					// Loop through each channel in the track and allocate the channel buffer for that input
-					for (unsigned int channel = 0; channel < static_cast<unsigned int>(trackInput.track->nChannels); ++channel)
-						channelBuffers.push_back(MixBuffer(nFrames, trackInput.trackToBusMap.mapping[channel].size()));
-
-					trackInputBuffers.push_back(channelBuffers);
+					trackInputMatrices.push_back(MappingMatrix(trackInput.trackToBusMap, 
+						static_cast<unsigned int>(trackInput.track->nChannels), static_cast<unsigned int>(nChannels)));
+					trackInputDelays.push_back(DelayLine(static_cast<unsigned int>(trackInput.track->nChannels)));
 				}
+				this->trackInputStates = std::vector<InputState>(bus->trackInputs.size(), InputState::Audible);
 
-				// Each channel of the source bus associated with this input has a mapping to the channels of this bus
-				for (unsigned int input = 0; input < bus->busInputs.size(); ++input)
+				for (const TrackState::BusInput& busInput : bus->busInputs)
 				{
-					const TrackState::BusInput& busInput = bus->busInputs[input];
-					std::vector<MixBuffer> channelBuffers;
-
-					// Loop through each chanel in the source bus and allocate the channel buffer for that input
-					for (unsigned int channel = 0; channel < static_cast<unsigned int>(busInput.bus->nChannels); ++channel)
-						channelBuffers.push_back(MixBuffer(nFrames, busInput.busToBusMap.mapping[channel].size()));
-
-					busInputBuffers.push_back(channelBuffers);
+					busInputMatrices.push_back(MappingMatrix(busInput.busToBusMap,
+						static_cast<unsigned int>(busInput.bus->nChannels), static_cast<unsigned int>(nChannels)));
+					busInputDelays.push_back(DelayLine(static_cast<unsigned int>(busInput.bus->nChannels)));
 				}
+				this->busInputStates = std::vector<InputState>(bus->busInputs.size(), InputState::Audible);
+
+				this->outputDelay = DelayLine(static_cast<unsigned int>(nChannels));
 			}
 		};
 
 		std::unordered_map<const TrackState::Track*, TrackInfo> trackInfo;
 		std::unordered_map<const TrackState::Bus*, BusInfo> busInfo;
+		// Only added to and removed from with both audioProcessingMutex and meterMutex held, as the meter thread reads it with only meterMutex held.
+		// Everything else only finds entries in it (never operator[], which could insert one while the meter thread is reading it).
 		std::unordered_map<const TrackState::Mixable*, MixableInfo> mixableInfo;
 
+		/*
+		 * Meters:
+		 *
+		 * The meter thread smooths the levels of every Mixable (from its lookback buffers) and publishes them through its Meter, which the UI reads without waiting on anything.
+		 * The meters are added and removed by the TrackState callbacks, which is the only time the map (or mixableInfo) gains or loses entries,
+		 * under meterMutex as well, which the meter thread holds while it goes through them. GetMeter doesn't lock it, as it's called from the thread
+		 * that changes the TrackState (the UI thread), so the map can't change while it's being read.
+		 */
+		struct MeterInfo
+		{
+			std::vector<ChannelInfo> channels; // The smoothed levels, only used by the meter thread.
+			Meter meter;
+
+			MeterInfo(std::size_t nChannels)
+				: meter(nChannels)
+			{
+			}
+		};
+
+		std::unordered_map<const TrackState::Mixable*, std::unique_ptr<MeterInfo>> meters;
+		MeterInfo outputMeter{ static_cast<std::size_t>(TrackState::ChannelNumber::MAX) }; // Only the first 64 channels of the output device are metered.
+		std::mutex meterMutex;
+		std::atomic<bool> resetClipping = false;
+
+		void AddMeter(const TrackState::Mixable& mixable);
+		void UpdateMeter(MixableInfo& info, MeterInfo& meter, unsigned int nChannels, float deltaTime, bool resetClipping,
+			std::vector<float>& rmsBuffer, std::vector<float>& peakBuffer);
+
+		/*
+		 * Buffer pooling:
+		 *
+		 * The Track and Bus buffers only hold a single block while it's being mixed (the meters keep their own copy),
+		 * so instead of every Mixable owning its buffers, they're assigned to a pool of buffers whenever the tracks or buses change.
+		 * The lifetime of each buffer is worked out from the processing order (a buffer is free once everything
+		 * reading it has finished), and buffers that are free before a Bus starts are reused for its buffers
+		 * (see Detail::BufferAllocator), keeping the working set small enough to stay in cache.
+		 *
+		 * Every Track is processed in parallel, so they each still need a buffer, while Buses (and the scratch buffers
+		 * for delayed inputs) mostly reuse them. Buses that output to the device are read at the end of the callback,
+		 * so their buffers are never reused.
+		 *
+		 * All of the pooled buffers are allocated from a single arena, with every channel aligned to its own cache line.
+		 */
+		AudioArena bufferArena;
+		AudioBufferView outputDelayBuffer; // Scratch for delaying the buses that output to the device, one at a time.
+		AudioBufferView silenceBuffer; // Always silent, with as many channels as the widest track or bus (see Silence propagation).
+
+		// Every buffer of the pool, planned for a buffer size without touching anything the audio threads use,
+		// so it can be planned ahead and swapped in later (see Reconfiguration).
+		struct BufferPlan
+		{
+			struct BusBuffers
+			{
+				AudioBufferView mainBusBuffer;
+				AudioBufferView delayBuffer;
+				double* doubleBusBuffer = nullptr;
+			};
+
+			AudioArena arena;
+			unsigned int nFrames = 0;
+			std::uint64_t version = 0; // The planVersion it was planned at.
+			std::unordered_map<const TrackState::Track*, AudioBufferView> trackBuffers;
+			std::unordered_map<const TrackState::Bus*, BusBuffers> busBuffers;
+			AudioBufferView outputDelayBuffer;
+			AudioBufferView silenceBuffer;
+		};
+
+		// Everything a BufferPlan is planned from, copied out of the TrackState (and trackInfo and busInfo) with the audio threads locked out,
+		// so the planning itself can be done without them locked out. The nodes are numbered tracks first, then buses in processing order.
+		struct BufferLayout
+		{
+			struct TrackNode
+			{
+				const TrackState::Track* track;
+				unsigned int nChannels;
+			};
+
+			struct BusNode
+			{
+				const TrackState::Bus* bus;
+				unsigned int nChannels;
+				unsigned int nInputChannels; // The most channels of any of its inputs, for the delay buffer.
+				bool delaysInputs; // It has more than one input, so it may have to align them.
+				bool doublePrecisionSumming;
+				bool outputsToDevice;
+				std::vector<std::size_t> inputs; // The nodes of the inputs that are still there.
+			};
+
+			std::vector<TrackNode> tracks;
+			std::vector<BusNode> buses;
+			std::uint64_t version = 0; // The planVersion it was copied at.
+		};
+
+		std::uint64_t planVersion = 0; // Bumped whenever the buffers are planned again, as the tracks or buses that need them changed.
+
+		void PlanBuffers();
+		BufferLayout GetBufferLayout();
+		BufferPlan BuildBufferPlan(const BufferLayout& layout, unsigned int nFrames, AudioArena&& arena);
+		void ApplyBufferPlan(BufferPlan& plan);
+		unsigned int GetMaxInputChannels(const TrackState::Bus* bus);
+
+		bool doublePrecisionSumming = false;
+
+		// Debug builds check the output of the effects every denormalCheckInterval callbacks and count the denormal samples,
+		// which should always be 0 while the threads are flushing them (see Threading::DenormalGuard).
+		static constexpr unsigned int denormalCheckInterval = 32;
+		unsigned int callbackCount = 0;
+		std::atomic<std::uint64_t> denormalCount = 0;
+		void CheckDenormals(const AudioBufferView& buffer);
+
+		bool UsesDoublePrecisionSumming(const TrackState::Bus* bus)
+		{
+			return doublePrecisionSumming || bus->doublePrecisionSumming;
+		}
+
+		/*
+		 * Delay compensation:
+		 * 
+		 * Every Mixable can introduce some amount of processing latency (for example from its effects).
+		 * The output latency of a Track is simply its processing latency, while the output latency of a Bus
+		 * is the largest output latency of all of its inputs, plus its own processing latency.
+		 * Every input into a Bus that has less latency than the largest one is delayed by the difference,
+		 * so that all the inputs are time-aligned when they are summed. The same is done for every Bus
+		 * that outputs to the device, so the total output latency is the largest latency of those Buses.
+		 */
+		struct LatencyInfo
+		{
+			unsigned int processingLatency = 0;
+			unsigned int outputLatency = 0;
+		};
+
+		std::unordered_map<const TrackState::Mixable*, LatencyInfo> latencyInfo;
+		unsigned int totalOutputLatency = 0;
+
+		unsigned int GetSourceLatency(const TrackState::Mixable* mixable);
+		bool UpdateBusLatency(const std::shared_ptr<TrackState::Bus>& bus);
+		void UpdateOutputLatency();
+		void RecomputeAllLatencies();
+
+		AudioBufferView ProcessDelayLine(DelayLine& delayLine, const AudioBufferView& src, const AudioBufferView& dst);
+		AudioBufferView DelayFrames(DelayLine& delayLine, const AudioBufferView& src, const AudioBufferView& dst, 
+			unsigned int firstFrame, unsigned int nFrames);
+		void UpdateProcessingLatency(const TrackState::Mixable* mixable, unsigned int latency);
+		void PropagateLatency(const TrackState::Mixable* mixable);
+
+		// Effects are prepared for the bigger of the device buffer size and the anticipative block size.
+		unsigned int GetMaxBlockFrames();
+		void PrepareEffects(const std::shared_ptr<TrackState::Mixable>& mixable);
+
 		MixableInfo outputInfo;
 		unsigned int nOutChannels;
 
+		/*
+		 * Reconfiguration:
+		 *
+		 * Changing the buffer size or the sample rate means reopening the stream, so the Engine fades the old stream out over its last block
+		 * (it only plays silence after that, until it's stopped) and fades the new one in over its first block, so neither of them clicks.
+		 * The buffers for the new buffer size are planned while the old stream is still playing (see PrepareReconfiguration),
+		 * and swapped in once the new stream has been opened (see Reconfigure), which keeps everything that's still valid:
+		 * the meters always, and if the sample rate hasn't changed, the delay lines, the gain ramps, the silence of every track and bus,
+		 * the anticipative FIFOs and the frozen renders, and the state of the effects too, unless they have to be prepared for bigger blocks.
+		 */
+		enum class Fade
+		{
+			None,
+			In, // Ramp up over the next block.
+			Out, // Ramp down over the next block, and then go silent.
+			Silent
+		};
+
+		std::atomic<Fade> fade = Fade::None;
+		std::optional<BufferPlan> pendingPlan; // Planned by PrepareReconfiguration, for Reconfigure.
+		unsigned int configuredSampleRate = 0; // What everything was last prepared for.
+		unsigned int configuredMaxBlockFrames = 0;
+
+		void ApplyFade(const AudioBufferView& output);
+
 		bool running = true;
 		std::jthread mixerThread;
 
+		// The meter thread applies a new scheduling whenever the version changes.
+		std::mutex meterSchedulingMutex;
+		Threading::ThreadPriority::Scheduling meterScheduling;
+		Threading::ThreadPriority::Report meterReport;
+		std::atomic<unsigned int> meterSchedulingVersion = 0;
+
 		Threading::ThreadPool trackThreads;
+		std::atomic<std::size_t> maxTrackThreads = 0;
 		Threading::ThreadPool busThreads;
+		// Sum the frame ranges of wide buses along with the bus threads (see Wide buses).
+		Threading::ThreadPool summingThreads;
 
 		std::mutex audioProcessingMutex;
 
+		// The frame of the timeline the next callback starts at (the clips of the tracks are played from here), advanced by every callback.
+		// Only used with audioProcessingMutex held.
+		std::size_t transportPosition = 0;
+
+		// The channels of the input device for the current callback, for the live input tracks.
+		AudioBufferView deviceInput;
+
+		static constexpr unsigned int anticipativeBlockFrames = 512;
+		bool anticipativeProcessing = false;
+		unsigned int anticipativeLookaheadMS = 200;
+		std::size_t anticipativeLookaheadFrames = 0;
+
+		// Held by the anticipative threads while they render, so nothing they use changes under them.
+		// When both are needed, this is always locked before audioProcessingMutex, so the callback never waits on a render.
+		std::mutex anticipativeMutex;
+		std::vector<std::shared_ptr<AnticipativeTrack>> anticipativeTracks;
+		std::atomic<std::uint64_t> anticipativeUnderruns = 0;
+
+		// These run at the default priority, below the (possibly realtime) callback and worker threads.
+		Threading::ThreadPool anticipativeThreads;
+		std::jthread anticipativeThread;
+
+		void UpdateAnticipativeTracks();
+		void RenderAhead(AnticipativeTrack& anticipative);
+
+		// The settings of a track that have to stay the same for this long before it's frozen (again).
+		struct PendingFreeze
+		{
+			std::uint64_t key;
+			std::chrono::steady_clock::time_point since;
+		};
+
+		static constexpr unsigned int freezeIntervalMS = 50;
+		static constexpr std::uint64_t renderKeyVersion = 3; // Bumped whenever the way tracks are rendered changes, so older renders are never used.
+		bool automaticFreezing = false;
+		RenderCache renderCache;
+		std::jthread freezeThread;
+
+		std::uint64_t ComputeRenderKey(const TrackState::Track& track);
+		std::size_t GetRenderFrames(const TrackState::Track& track);
+		std::shared_ptr<const AudioBuffer> RenderTrack(const TrackState::Track& track, unsigned int sampleRate);
+		void UpdateFrozenTracks(std::unordered_map<const TrackState::Track*, PendingFreeze>& pending);
+
 		// Basically this is an asymmetrical Lerp, where the speed varies 
 		// depending on if the target value is higher than the current value, or lower.
 		void LerpMeter(float& value, const float& target, float deltaTime, float riseTime, float fallTime, float minimumValue)
@@ -167,19 +614,54 @@ namespace DigiDAW::Core::Audio
 		}
 
 		void AddToLookback(
-			float* src, std::vector<std::vector<float>>& dst, 
-			std::mutex& mutex, 
-			unsigned nFrames, unsigned int nChannels, unsigned int sampleRate);
-
-		void ApplyGain(
-			float gain, std::vector<float>& buffer, 
-			unsigned int nChannels, unsigned int nFrames);
-		void ApplyStereoPanning(
-			float pan, std::vector<float>& buffer, 
-			unsigned int nChannels, unsigned int nFrames);
-
+			const AudioBufferView& src, std::vector<std::vector<float>>& dst, 
+			std::mutex& mutex, unsigned int sampleRate);
+		void AddSilenceToLookback(unsigned int nChannels, unsigned int nFrames, MixableInfo& info, unsigned int sampleRate);
+
+		void ApplyEffects(const std::vector<std::shared_ptr<Effects::Effect>>& effects, const AudioBufferView& buffer);
+		static std::size_t GetTailFrames(const std::vector<std::shared_ptr<Effects::Effect>>& effects);
+		InputState GetInputState(bool silent, const DelayLine& delayLine);
+		void ApplyGain(float gain, const AudioBufferView& buffer);
+		void ApplyBalance(float pan, PanMatrix& balance, const AudioBufferView& buffer);
+		void UpdateInputGains(const TrackState::ChannelMapping& mapping, const TrackState::Mixable& source, MappingMatrix& matrix);
+		void MixInput(
+			const AudioBufferView& src, const MappingMatrix& matrix, const AudioBufferView& busBuffer, double* doubleBusBuffer,
+			unsigned int firstFrame, unsigned int blockFrames);
+
+		/*
+		 * Wide buses:
+		 *
+		 * A bus with lots of inputs (or channels) can take longer to sum than everything else, and it's a single task.
+		 * So once the measured cost of summing a bus goes over parallelSummingThresholdUS, the block is split into frame ranges
+		 * that are summed by the bus thread and the summing threads. The summing threads only ever sum, as a helper queued behind
+		 * a track that hasn't been processed yet would hold up the bus thread that waits on it. The bus thread sums ranges too, instead of just waiting,
+		 * and every helper only takes the ranges that are left when it starts, so a late helper only costs the wait for it to start.
+		 * Every frame is still summed from the same inputs in the same order (with the same gain ramps and delays),
+		 * so the result is bit identical to summing it on a single thread.
+		 */
+		static constexpr unsigned int maxSummingThreads = 8;
+		unsigned int GetSummingRanges(const BusInfo& info, unsigned int nFrames);
+		void SumInputs(const TrackState::Bus& bus, BusInfo& info, unsigned int firstFrame, unsigned int nFrames, unsigned int blockFrames);
+		void SumAllInputs(const TrackState::Bus& bus, BusInfo& info, unsigned int nFrames);
+
+		/*
+		 * Deterministic processing:
+		 *
+		 * What the Mixer sums never depends on which thread finishes first: every frame of a bus is summed from its inputs
+		 * in the order they're listed in the bus (tracks, then buses), on whichever thread sums it (see Wide buses),
+		 * and the buses are summed into the output in the order of the buses, once they've all finished.
+		 * What can depend on timing is whether a track is processed at all: an anticipative track that's fallen behind plays silence,
+		 * and tracks are frozen (and thawed) by the freeze thread once their settings have stayed the same for long enough in wall clock time.
+		 *
+		 * So with deterministic processing every track is processed live in the callback (nothing is rendered ahead or frozen),
+		 * and the output is bit identical for the same session and the same blocks, however many threads there are and however they're scheduled
+		 * (e.g. for null tests and golden renders, see VirtualDevice).
+		 */
+		bool deterministicProcessing = false;
+
+		bool RenderTrackInput(const TrackState::Track& track, const AudioBufferView& buffer, std::size_t position, std::size_t& silentFrames);
 		void ProcessTrack(
-			std::vector<float>& trackInputBuffer, const std::shared_ptr<TrackState::Track>& track,
+			const std::shared_ptr<TrackState::Track>& track,
 			unsigned int nFrames, unsigned int sampleRate);
 		void ProcessBus(
 			const std::shared_ptr<TrackState::Bus>& bus,
@@ -196,14 +678,176 @@ namespace DigiDAW::Core::Audio
 
 		float minimumDecibelLevel = -60.0f;
 
+		unsigned int parallelSummingThresholdUS = 50; // Buses that take longer than this to sum are split between threads.
+
 		Mixer(Engine& audioEngine);
 		~Mixer();
 
-		void UpdateAllTrackBuffers();
-		void UpdateAllBusBuffers();
+		// Plans the buffers for the buffer size the stream is about to be reopened with (see Reconfiguration),
+		// on the calling thread, while the old stream keeps playing.
+		void PrepareReconfiguration(unsigned int nFrames);
+
+		// Brings everything up to date with the buffer size and sample rate the stream has just been (re)opened with,
+		// while the stream is stopped, keeping whatever state is still valid (see Reconfiguration).
+		void Reconfigure();
+
+		// Fades the output out over the next block, and waits (for up to timeoutMS) for the callback to have done it,
+		// returns false if it didn't get to it in time. It stays silent until FadeIn is called.
+		bool FadeOut(unsigned int timeoutMS);
+		void FadeIn();
 
+		// Clears the clipping indicators of every meter on the meter thread's next update.
 		void ResetClippingIndicators();
 
+		// Sets the latency (in frames) that the processing of this Mixable introduces,
+		// and recomputes the delay compensation of everything downstream of it.
+		void SetProcessingLatency(const std::shared_ptr<TrackState::Mixable>& mixable, unsigned int latency);
+		unsigned int GetProcessingLatency(const std::shared_ptr<TrackState::Mixable>& mixable);
+
+		// Adds an effect to the end of the effects chain of this Mixable, the processing latency 
+		// of the Mixable is set to the total latency of its effects chain.
+		void AddEffect(const std::shared_ptr<TrackState::Mixable>& mixable, std::shared_ptr<Effects::Effect> effect);
+		void RemoveEffect(const std::shared_ptr<TrackState::Mixable>& mixable, const std::shared_ptr<Effects::Effect>& effect);
+
+		// Starts analyzing the spectrum of the output of this Bus (on the meter thread), 
+		// returns the existing analyzer if it's already enabled.
+		std::shared_ptr<SpectrumAnalyzer> EnableSpectrumAnalyzer(const std::shared_ptr<TrackState::Bus>& bus);
+		void DisableSpectrumAnalyzer(const std::shared_ptr<TrackState::Bus>& bus);
+
+		/*
+		 * Sums the inputs of every Bus (or only this Bus) in double precision, and rounds the sum back to float
+		 * before the bus processing, so summing hundreds of tracks doesn't build up rounding error in quiet passages.
+		 * This costs some throughput (the summing runs at half the SIMD width), so it's off by default.
+		 */
+		void SetDoublePrecisionSumming(bool enabled);
+		void SetDoublePrecisionSumming(const std::shared_ptr<TrackState::Bus>& bus, bool enabled);
+
+		bool GetDoublePrecisionSumming()
+		{
+			return doublePrecisionSumming;
+		}
+
+		/*
+		 * Renders the tracks that aren't fed by the input device lookaheadMS ahead of the callback on background threads
+		 * (see Anticipative processing), so only the live tracks and the buses are processed at the device buffer size.
+		 * This adds no latency, but the effects on those tracks are only heard lookaheadMS after they change, so it's off by default.
+		 */
+		void SetAnticipativeProcessing(bool enabled, unsigned int lookaheadMS = 200);
+
+		bool GetAnticipativeProcessing()
+		{
+			return anticipativeProcessing;
+		}
+
+		// Processes every track live, so the output doesn't depend on timing (see Deterministic processing).
+		// Anticipative processing and freezing pick up where they were once it's turned off again.
+		void SetDeterministicProcessing(bool enabled);
+
+		bool GetDeterministicProcessing()
+		{
+			return deterministicProcessing;
+		}
+
+		// Marks a track as fed by the input device in real time, so it's always processed in the callback.
+		void SetLiveInput(const std::shared_ptr<TrackState::Track>& track, bool liveInput);
+
+		// Sets the audio a track plays (nullptr for none), from the start of the timeline. What was already rendered ahead
+		// of the old clip is thrown away, so the new one is heard straight away. Hashing the clip reads through all of it.
+		void SetClip(const std::shared_ptr<TrackState::Track>& track, const std::shared_ptr<const AudioBuffer>& clip);
+
+		// Moves the timeline to a frame, the next callback plays the clips from there.
+		// What was already rendered ahead is thrown away and rendered again from the new position.
+		void SetTransportPosition(std::size_t position);
+		std::size_t GetTransportPosition();
+
+		// The amount of times the callback has caught up with a track that's rendered ahead (and played silence instead).
+		std::uint64_t GetAnticipativeUnderruns()
+		{
+			return anticipativeUnderruns.load(std::memory_order_relaxed);
+		}
+
+		unsigned int freezeDelayMS = 1000; // How long the settings of a track have to stay the same before it's frozen (again).
+
+		// Freezes a track once its settings have stayed the same for freezeDelayMS and it's been rendered (on the freeze thread,
+		// the track keeps playing until then), returns false if it can't be frozen (it's live, or one of its effects can't be copied or hashed,
+		// or has an infinite tail).
+		bool FreezeTrack(const std::shared_ptr<TrackState::Track>& track);
+		void UnfreezeTrack(const std::shared_ptr<TrackState::Track>& track);
+
+		// Whether the track is currently playing back a render.
+		bool IsTrackFrozen(const std::shared_ptr<TrackState::Track>& track);
+
+		// Freezes every track that isn't live once its settings have stayed the same for freezeDelayMS (see Freezing).
+		void SetAutomaticFreezing(bool enabled);
+
+		bool GetAutomaticFreezing()
+		{
+			return automaticFreezing;
+		}
+
+		// A hash of every setting that changes the render of this track, 0 if it can't be rendered or cached.
+		std::uint64_t GetRenderKey(const std::shared_ptr<TrackState::Track>& track);
+
+		RenderCache& GetRenderCache()
+		{
+			return renderCache;
+		}
+
+		// Caps the memory (in bytes) the render cache keeps the renders in, 0 for no cap (see RenderCache::SetMemoryLimit).
+		// As automatic freezing stores a new render every time a track is changed and left alone, the cache would otherwise only grow.
+		void SetRenderCacheLimit(std::size_t bytes)
+		{
+			renderCache.SetMemoryLimit(bytes);
+		}
+
+		std::size_t GetRenderCacheLimit()
+		{
+			return renderCache.GetMemoryLimit();
+		}
+
+		// The memory (in bytes) used by the buffers of the mixing path (the buffer arena and the delay lines).
+		std::size_t GetBufferMemory();
+
+		// The scheduling of the threads that process the tracks and buses, and of the meter thread.
+		void SetThreadScheduling(
+			const Threading::ThreadPriority::Scheduling& workers, const Threading::ThreadPriority::Scheduling& meter);
+
+		// Caps the track threads (0 for a thread per track) from the next callback on. The buses always have a thread each,
+		// as a bus waits on the buses that feed it.
+		void SetMaxTrackThreads(std::size_t maxThreads)
+		{
+			maxTrackThreads = maxThreads;
+		}
+
+		std::vector<Threading::ThreadPriority::Report> GetTrackThreadReports()
+		{
+			return trackThreads.GetReports();
+		}
+
+		std::vector<Threading::ThreadPriority::Report> GetBusThreadReports()
+		{
+			return busThreads.GetReports();
+		}
+
+		std::vector<Threading::ThreadPriority::Report> GetSummingThreadReports()
+		{
+			return summingThreads.GetReports();
+		}
+
+		Threading::ThreadPriority::Report GetMeterThreadReport();
+
+		// The amount of denormal samples found in the output of the effects (always 0 in release builds).
+		std::uint64_t GetDenormalCount()
+		{
+			return denormalCount.load(std::memory_order_relaxed);
+		}
+
+		// The latency (in frames) from the input of any Track to the output device, including delay compensation.
+		unsigned int GetOutputLatency()
+		{
+			return totalOutputLatency;
+		}
+
 		void Mix(
 			float* outputBuffer,
 			float* inputBuffer, 
@@ -219,14 +863,18 @@ namespace DigiDAW::Core::Audio
 		void StartTestTone();
 		void EndTestTone();
 
-		const MixableInfo& GetMixableInfo(const std::shared_ptr<TrackState::Mixable> mixable)
+		// The newest levels of a Mixable's meter (none if it isn't in the TrackState), which stay valid until its next call.
+		// Never waits or allocates, but only call it from the thread that changes the TrackState (see Meters).
+		std::span<const ChannelInfo> GetMeter(const std::shared_ptr<TrackState::Mixable>& mixable)
 		{
-			return mixableInfo[mixable.get()];
+			auto it = meters.find(mixable.get());
+			return (it != meters.end()) ? it->second->meter.Read() : std::span<const ChannelInfo>();
 		}
 
-		const MixableInfo& GetOutputInfo()
+		// The newest levels of the output device channels, from the same thread as GetMeter.
+		std::span<const ChannelInfo> GetOutputMeter()
 		{
-			return outputInfo;
+			return outputMeter.meter.Read();
 		}
 	};
 }
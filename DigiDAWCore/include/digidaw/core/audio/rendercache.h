@@ -0,0 +1,84 @@
+#pragma once
+
+#include <filesystem>
+#include <unordered_map>
+
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * Rendered audio, keyed by a hash of everything that went into rendering it (see Mixer::GetRenderKey).
+	 * So something is only rendered again once one of its settings has changed, and going back to earlier settings reuses the earlier render.
+	 *
+	 * Renders are kept in memory, and are also written to the cache directory (if one has been set),
+	 * so they're still there the next time the same settings are used, even after a restart.
+	 * Every file is named after its key, and holds a small header followed by every channel, one after the other.
+	 *
+	 * As every change to a frozen track stores a new render, the renders kept in memory are capped (see SetMemoryLimit).
+	 * Going over the cap frees the least recently used renders that nothing is playing, which are loaded from their files again
+	 * if they're needed again (or rendered again, without a cache directory).
+	 */
+	class RenderCache
+	{
+	private:
+		struct FileHeader
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t nChannels;
+			std::uint32_t nFrames;
+		};
+
+		static constexpr char fileMagic[4] = { 'D', 'D', 'R', 'C' };
+		static constexpr std::uint32_t fileVersion = 1;
+
+		struct Entry
+		{
+			std::shared_ptr<const AudioBuffer> render;
+			std::uint64_t lastUsed; // When it was last found or stored, in calls to either.
+		};
+
+		std::filesystem::path directory;
+		std::unordered_map<std::uint64_t, Entry> renders;
+		std::uint64_t useCount;
+		std::size_t memoryUsage;
+		std::size_t memoryLimit;
+		std::mutex mutex;
+
+		std::filesystem::path GetPath(std::uint64_t key);
+		std::shared_ptr<const AudioBuffer> Load(const std::filesystem::path& path);
+		void Save(const std::filesystem::path& path, const AudioBuffer& render);
+		void Insert(std::uint64_t key, const std::shared_ptr<const AudioBuffer>& render);
+		void Evict();
+	public:
+		static constexpr std::size_t defaultMemoryLimit = std::size_t(1) << 30; // 1 GiB, about 45 minutes of stereo at 48 kHz.
+
+		RenderCache()
+		{
+			this->useCount = 0;
+			this->memoryUsage = 0;
+			this->memoryLimit = defaultMemoryLimit;
+		}
+
+		// An empty path only keeps the renders in memory.
+		void SetDirectory(const std::filesystem::path& directory);
+
+		// Returns nullptr if there's no render with this key, in memory or on disk.
+		std::shared_ptr<const AudioBuffer> Find(std::uint64_t key);
+		void Store(std::uint64_t key, const std::shared_ptr<const AudioBuffer>& render);
+
+		// Frees the renders kept in memory (the files are kept), anything still playing a render keeps it until it's done with it.
+		void Clear();
+
+		// The memory (in bytes) used by the renders kept in memory.
+		std::size_t GetMemoryUsage();
+
+		/*
+		 * Caps the memory (in bytes) used by the renders kept in memory, 0 for no cap.
+		 * Renders that are still being played are never freed, so the usage can go over the cap while they are.
+		 */
+		void SetMemoryLimit(std::size_t bytes);
+		std::size_t GetMemoryLimit();
+	};
+}
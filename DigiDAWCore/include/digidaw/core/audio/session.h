@@ -0,0 +1,248 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+
+#include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/trackstate.h"
+#include "digidaw/core/audio/trackhistory.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * Saves the tracks and buses of a TrackState (with their channel mappings and their routing to the output device channels) to a binary file, and loads them back.
+	 *
+	 * A file starts with a snapshot: a header, a table of sections, then the sections, each a flat array of fixed size records at an offset from the start of the file.
+	 * Records refer to each other by their index in a section, and to tracks and buses by their id, so a file is loaded by mapping it into memory
+	 * and reading the records where they are (only checking that they're in bounds), without parsing anything.
+	 * Names are kept out of the records, one after the other in the Strings section, so they take as many bytes as they're long.
+	 *
+	 * After the snapshot is a journal. A Save to the file the session was last loaded from or saved to only appends what changed since then
+	 * (the tracks and buses that were added or changed, as whole records, and the ids of the ones that were removed), as a batch that ends with a hash of it.
+	 * Load ignores a batch that was cut short or doesn't match its hash, along with everything after it.
+	 * Once the journal is bigger than the snapshot, Save writes a new snapshot instead (under a temporary name first, so a file that's cut short never replaces the last one).
+	 *
+	 * Nothing marks what was edited in a TrackState, so a Save from one compares every track and bus with what was last saved of it:
+	 * it only writes what changed, but takes as long as the session is big. A Save from a snapshot of a TrackHistory, after one from an earlier snapshot
+	 * of the same history, only compares the tracks and buses in the chunks the two snapshots don't share, so that takes as long as what changed (plus a pointer per chunk).
+	 *
+	 * Effects aren't saved (as they can't be serialized yet), and neither are the inputs of a bus from tracks or buses that aren't in the TrackState.
+	 * Files are in the byte order of the machine that wrote them.
+	 */
+	class Session
+	{
+	private:
+		struct FileHeader
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t nSections;
+			std::uint32_t nextId;
+			std::uint64_t snapshotSize; // Where the journal starts.
+		};
+
+		enum class SectionType : std::uint32_t
+		{
+			Tracks,
+			Buses,
+			Inputs,
+			ChannelLists,
+			Channels,
+			Strings,
+
+			Count
+		};
+
+		struct SectionRecord
+		{
+			SectionType type;
+			std::uint32_t recordSize;
+			std::uint64_t offset; // From the start of the file, a multiple of sectionAlignment.
+			std::uint64_t count;
+		};
+
+		static constexpr std::uint32_t liveInputFlag = 1 << 0;
+		static constexpr std::uint32_t frozenFlag = 1 << 1;
+		static constexpr std::uint32_t doublePrecisionSummingFlag = 1 << 0;
+		static constexpr std::uint32_t layoutPanningFlag = 1 << 0;
+
+		struct TrackRecord
+		{
+			std::uint32_t id;
+			std::uint32_t nChannels;
+			float gain;
+			float pan;
+			float panDepth;
+			std::uint32_t flags;
+			std::uint32_t nameOffset; // In the Strings section, which holds the bytes of the names (without a terminator).
+			std::uint32_t nameLength;
+		};
+
+		// The inputs of a bus are in the Inputs section (its track inputs, then its bus inputs), and the channel lists
+		// of its mappings are in the ChannelLists section (a list per channel of the source, or per channel of the bus for its device outputs).
+		struct BusRecord
+		{
+			std::uint32_t id;
+			std::uint32_t nChannels;
+			float gain;
+			float pan;
+			float panDepth;
+			std::uint32_t flags;
+			std::uint32_t firstTrackInput;
+			std::uint32_t nTrackInputs;
+			std::uint32_t firstBusInput;
+			std::uint32_t nBusInputs;
+			std::uint32_t firstOutputList;
+			std::uint32_t nOutputLists;
+			std::uint32_t nameOffset;
+			std::uint32_t nameLength;
+		};
+
+		struct InputRecord
+		{
+			std::uint32_t sourceId;
+			std::uint32_t firstList;
+			std::uint32_t nLists;
+			std::uint32_t flags;
+		};
+
+		struct ChannelListRecord
+		{
+			std::uint32_t firstChannel; // In the Channels section, which holds 32 bit channel numbers.
+			std::uint32_t nChannels;
+		};
+
+		/*
+		 * Every journal record is a JournalRecord followed by size bytes:
+		 * - SetTrack: a TrackRecord, of a new track (added after the others) or one that changed, then its name.
+		 * - SetBus: a BusRecord, a BusSizes, then its inputs, channel lists, channels and name (indexed from the start of each, as if they were whole sections).
+		 * The name is padded out to a multiple of 4 bytes, which every record is.
+		 * - RemoveTrack and RemoveBus: the 32 bit id.
+		 * - Commit: the 64 bit hash (see Detail::Hash) of the records since the last commit, which are only applied once they're committed.
+		 */
+		enum class JournalType : std::uint32_t
+		{
+			SetTrack,
+			SetBus,
+			RemoveTrack,
+			RemoveBus,
+			Commit
+		};
+
+		struct JournalRecord
+		{
+			JournalType type;
+			std::uint32_t size;
+		};
+
+		struct BusSizes
+		{
+			std::uint32_t nLists;
+			std::uint32_t nChannels;
+		};
+
+		// A track of the file, with the names its name is in (the Strings section of the snapshot, or the bytes after it in the journal).
+		struct TrackView
+		{
+			const TrackRecord* track;
+			const char* strings;
+			std::size_t nStrings;
+		};
+
+		// A bus of the file, with the arrays its indices are into (the sections of the snapshot, or the ones after it in the journal).
+		struct BusView
+		{
+			const BusRecord* bus;
+			const InputRecord* inputs;
+			std::size_t nInputs;
+			const ChannelListRecord* lists;
+			std::size_t nLists;
+			const std::uint32_t* channels;
+			std::size_t nChannels;
+			const char* strings;
+			std::size_t nStrings;
+		};
+
+		// What was last saved of every track and bus (by the object, as they don't have ids of their own), to find what's changed.
+		struct SavedTrack
+		{
+			std::weak_ptr<TrackState::Track> track; // An expired one is a different object at the same address.
+			TrackRecord record;
+			std::string name;
+		};
+
+		struct SavedBus
+		{
+			std::weak_ptr<TrackState::Bus> bus;
+			std::uint32_t id;
+			std::vector<char> record; // As it would be in a SetBus.
+		};
+
+		using TrackEntry = TrackHistory::Entry<TrackState::Track>;
+		using BusEntry = TrackHistory::Entry<TrackState::Bus>;
+
+		// What a save goes through: tracks and buses with the values they're saved with (in their order, every one of them for a snapshot,
+		// and for the journal at least every one that could have changed), and the ones that are gone since the last save.
+		struct Changes
+		{
+			std::vector<const TrackEntry*> tracks;
+			std::vector<const BusEntry*> buses;
+			std::vector<const TrackState::Track*> removedTracks;
+			std::vector<const TrackState::Bus*> removedBuses;
+		};
+
+		static constexpr char fileMagic[4] = { 'D', 'D', 'S', 'N' };
+		static constexpr std::uint32_t fileVersion = 3;
+		static constexpr std::size_t sectionAlignment = 8;
+
+		std::filesystem::path path; // Of the file that's appended to, empty until the session has been loaded or saved.
+		std::uint64_t snapshotSize;
+		std::uint64_t fileSize; // Where the last whole batch ends, anything else in the file means it has to be written again.
+		std::uint32_t nextId;
+
+		std::unordered_map<const TrackState::Track*, SavedTrack> savedTracks;
+		std::unordered_map<const TrackState::Bus*, SavedBus> savedBuses;
+		std::shared_ptr<const TrackHistory::Snapshot> savedSnapshot; // Null unless the last save was of a snapshot, which is what savedTracks and savedBuses are of then.
+
+		static TrackRecord MakeTrackRecord(const TrackEntry& entry, std::uint32_t id);
+		void MakeBusRecord(const BusEntry& entry, std::uint32_t id, std::vector<char>& record);
+
+		static Changes GetEntries(TrackState& trackState, std::vector<TrackEntry>& tracks, std::vector<BusEntry>& buses);
+		static Changes GetEntries(const TrackHistory::Snapshot& snapshot);
+		void FindRemoved(Changes& changes);
+		bool CanAppend(const std::filesystem::path& path);
+		ReturnCode AppendBatch(const std::filesystem::path& path, const Changes& changes, const std::function<ReturnCode()>& saveSnapshot);
+		ReturnCode WriteSnapshot(const std::filesystem::path& path, const Changes& changes);
+
+		static bool IsValidTrack(const TrackView& view);
+		static bool IsValidBus(const BusView& view);
+		static std::shared_ptr<TrackState::Bus> AddBus(const BusView& view, TrackState& trackState,
+			const std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Track>>& tracksById,
+			const std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Bus>>& busesById);
+	public:
+		Session()
+		{
+			this->snapshotSize = 0;
+			this->fileSize = 0;
+			this->nextId = 0;
+		}
+
+		// Replaces every track and bus in the TrackState with the ones in the file, leaving it alone if the file can't be read.
+		ReturnCode Load(const std::filesystem::path& path, TrackState& trackState);
+
+		// Appends what changed to the file if it's the one the session was last loaded from or saved to (and it hasn't changed since), otherwise writes a snapshot.
+		ReturnCode Save(const std::filesystem::path& path, TrackState& trackState);
+		// The same, from a snapshot of a TrackHistory (which never changes, so it can be saved while the TrackState is edited).
+		ReturnCode Save(const std::filesystem::path& path, const std::shared_ptr<const TrackHistory::Snapshot>& snapshot);
+		// Always writes a snapshot, without a journal.
+		ReturnCode SaveSnapshot(const std::filesystem::path& path, TrackState& trackState);
+		ReturnCode SaveSnapshot(const std::filesystem::path& path, const std::shared_ptr<const TrackHistory::Snapshot>& snapshot);
+
+		// How much the saves since the last snapshot have appended (in bytes).
+		std::uint64_t GetJournalSize()
+		{
+			return fileSize - snapshotSize;
+		}
+	};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Detail
+{
+	class FFT;
+}
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * A realtime spectrum analyzer.
+	 *
+	 * The audio thread pushes a copy of its output (downmixed to mono) into a circular buffer of fftSize frames,
+	 * and the meter thread periodically takes a Hann windowed FFT of the last fftSize frames,
+	 * and reduces the spectrum into log-frequency bands (in dB, where a full scale sine is 0 dB).
+	 * Bands that are narrower than a single bin (at the low end) are interpolated from the nearest bins,
+	 * wider bands take the loudest bin in them.
+	 *
+	 * The bands fall at a set rate instead of dropping instantly, and every band has a peak that's held for a while before falling.
+	 */
+	class SpectrumAnalyzer
+	{
+	public:
+		struct Settings
+		{
+			unsigned int fftSize = 4096;
+			unsigned int nBands = 96;
+
+			float minimumFrequency = 20.0f;
+			float maximumFrequency = 20000.0f;
+			float minimumDecibel = -90.0f;
+
+			float fallRate = 60.0f; // dB per second
+			unsigned int peakHoldTimeMS = 1000;
+			float peakFallRate = 20.0f; // dB per second
+		};
+	private:
+		Settings settings;
+		unsigned int sampleRate = 0;
+
+		// Written by the audio thread.
+		std::vector<float> ringBuffer; // The sum of every channel.
+		std::size_t writePosition = 0;
+		unsigned int nChannels = 1;
+		std::mutex ringBufferMutex;
+
+		// Only used by the meter thread (while holding the mutex).
+		std::shared_ptr<Detail::FFT> fft;
+		std::vector<float> window;
+		float decibelOffset = 0.0f; // Normalizes the spectrum so a full scale sine is 0 dB.
+		std::vector<float> frame;
+		std::vector<float> spectrumReal;
+		std::vector<float> spectrumImag;
+		std::vector<float> spectrumDecibel;
+
+		// Per band, the first bin and the bin after the last one (if the band has no bins,
+		// the position of its center frequency in bins is used to interpolate instead).
+		std::vector<unsigned int> bandFirstBin;
+		std::vector<unsigned int> bandEndBin;
+		std::vector<float> bandCenterBin;
+
+		std::vector<float> bands;
+		std::vector<float> peaks;
+		std::vector<float> peakHoldTimes;
+		std::mutex mutex;
+
+		void Allocate();
+	public:
+		SpectrumAnalyzer();
+		SpectrumAnalyzer(const Settings& settings);
+
+		// Can be called from any thread, resets the analyzer.
+		void Prepare(unsigned int sampleRate);
+		void SetSettings(const Settings& settings);
+
+		Settings GetSettings()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return settings;
+		}
+
+		// Called from the audio thread.
+		void Push(const AudioBufferView& src);
+
+		// Called from the meter thread, analyzes the last fftSize frames.
+		void Update(float deltaTimeMS);
+
+		// Copies the bands and their peaks (in dB), this only allocates if the amount of bands has changed.
+		void GetBands(std::vector<float>& bandsOut, std::vector<float>& peaksOut);
+
+		// The center frequency (in Hz) of a band.
+		float GetBandFrequency(unsigned int band);
+	};
+}
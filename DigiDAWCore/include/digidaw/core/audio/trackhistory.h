@@ -0,0 +1,171 @@
+#pragma once
+
+#include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/trackstate.h"
+
+namespace DigiDAW::Core::Audio
+{
+	class Mixer;
+
+	/*
+	 * Undo and redo for a TrackState, as a history of immutable snapshots of it.
+	 *
+	 * A snapshot has the tracks and buses in their order, each as the object (which is what the Mixer, and the inputs of buses, refer to)
+	 * and the values it had. The entries are kept in chunks, and a snapshot shares every chunk (and every entry) that didn't change with the one before it,
+	 * so a step only takes the memory of what changed, plus a pointer per chunk. Snapshots are never changed or copied once they're taken,
+	 * so they can be handed to other threads (e.g. to save them) and read for as long as they're held.
+	 *
+	 * Commit takes a snapshot once an edit is finished. The values of tracks and buses are set directly, so nothing marks what was edited,
+	 * and Commit compares every track and bus with the current snapshot: it takes as long as the session is big (a comparison per track and bus),
+	 * and only allocates for what changed.
+	 *
+	 * Undo and Redo move to the snapshot before or after the current one, then change the TrackState to match it (the TrackState isn't swapped for the snapshot,
+	 * as the Mixer, and the inputs of buses, refer to the objects). Only the chunks that differ between the two snapshots are looked at,
+	 * so that takes as long as what changed, though every entry of a chunk that differs has its values set again: tracks and buses that aren't in the snapshot
+	 * are removed, ones that were removed are put back (as the same objects, where they were), and the values of the others are set.
+	 * That expects the TrackState to be the current snapshot, so every edit has to be committed before the next Undo or Redo.
+	 *
+	 * The snapshots have every value of a track or bus that can change once it's been added: the name, gain and panning (which are set directly),
+	 * and the effects chain, whether a track is live or frozen, its clip, and whether a bus sums in double precision (which are set through the Mixer, as Apply does too).
+	 * The effects are kept as the objects, so which effects are in the chain (and in what order) is undone, but not the changes to their parameters.
+	 * The inputs and device outputs of a bus aren't in them, as they can't change once the bus has been added.
+	 */
+	class TrackHistory
+	{
+	public:
+		struct Values
+		{
+			std::string name; // Only as long as the name is, rather than as big as TrackState::Mixable::name.
+			float gain;
+			float pan;
+			float panDepth;
+
+			std::vector<std::shared_ptr<Effects::Effect>> effects;
+
+			// Only of tracks.
+			bool liveInput;
+			bool frozen;
+			std::shared_ptr<const AudioBuffer> clip;
+
+			// Only of buses.
+			bool doublePrecisionSumming;
+
+			bool operator==(const Values& other) const = default;
+		};
+
+		template<typename T>
+		struct Entry
+		{
+			std::shared_ptr<T> mixable;
+			Values values;
+		};
+
+		template<typename T>
+		struct Chunk
+		{
+			std::vector<std::shared_ptr<const Entry<T>>> entries;
+		};
+
+		template<typename T>
+		using ChunkList = std::vector<std::shared_ptr<const Chunk<T>>>;
+
+		struct Snapshot
+		{
+			ChunkList<TrackState::Track> tracks;
+			ChunkList<TrackState::Bus> buses;
+
+			std::size_t nTracks;
+			std::size_t nBuses;
+
+			Snapshot()
+			{
+				this->nTracks = 0;
+				this->nBuses = 0;
+			}
+
+			template<typename Func>
+			void ForEachTrack(Func&& func) const
+			{
+				for (const std::shared_ptr<const Chunk<TrackState::Track>>& chunk : tracks)
+					for (const std::shared_ptr<const Entry<TrackState::Track>>& entry : chunk->entries)
+						func(*entry);
+			}
+
+			template<typename Func>
+			void ForEachBus(Func&& func) const
+			{
+				for (const std::shared_ptr<const Chunk<TrackState::Bus>>& chunk : buses)
+					for (const std::shared_ptr<const Entry<TrackState::Bus>>& entry : chunk->entries)
+						func(*entry);
+			}
+		};
+	private:
+		// Chunks are split once they're this big, small enough that copying one is cheap, and big enough that there aren't many pointers to them.
+		static constexpr std::size_t chunkSize = 128;
+
+		struct Step
+		{
+			std::shared_ptr<const Snapshot> snapshot;
+			std::size_t memory;
+		};
+
+		template<typename T>
+		struct Changes
+		{
+			std::vector<std::shared_ptr<T>> removed;
+			std::vector<std::pair<std::size_t, std::shared_ptr<T>>> restored; // With where they go, in the order they go there.
+			std::vector<const Entry<T>*> entries; // Every entry of the chunks that differ, whose values are set.
+		};
+
+		std::deque<Step> steps;
+		std::size_t currentStep;
+		std::size_t maxSteps;
+		std::mutex mutex;
+
+		static Values GetValues(const TrackState::Mixable& mixable);
+		static void SetValues(const std::shared_ptr<TrackState::Mixable>& mixable, const Values& values, Mixer& mixer);
+		static void SetValues(const std::shared_ptr<TrackState::Track>& track, const Values& values, Mixer& mixer);
+		static void SetValues(const std::shared_ptr<TrackState::Bus>& bus, const Values& values, Mixer& mixer);
+		static std::size_t GetEntryMemory(const Values& values);
+
+		template<typename T>
+		static bool CommitChunks(const ChunkList<T>& previous, const std::vector<std::shared_ptr<T>>& mixables, ChunkList<T>& chunks, std::size_t& memory);
+		template<typename T>
+		static Changes<T> FindChanges(const ChunkList<T>& from, const ChunkList<T>& to);
+
+		void Apply(const Snapshot& from, const Snapshot& to, TrackState& trackState, Mixer& mixer);
+	public:
+		// The values a track or bus has now.
+		static Values GetValues(const TrackState::Track& track);
+		static Values GetValues(const TrackState::Bus& bus);
+
+		TrackHistory()
+		{
+			this->currentStep = 0;
+			this->maxSteps = 1000;
+		}
+
+		// Takes a snapshot if the TrackState changed since the current one (dropping any that could be redone), returns whether it did.
+		bool Commit(TrackState& trackState);
+
+		// The Mixer is the one playing the TrackState, which sets what can only be changed through it.
+		bool Undo(TrackState& trackState, Mixer& mixer);
+		bool Redo(TrackState& trackState, Mixer& mixer);
+		bool CanUndo();
+		bool CanRedo();
+
+		// Forgets every snapshot (e.g. once a session has been loaded), the next Commit starts the history again.
+		void Clear();
+
+		// Null until the first Commit.
+		std::shared_ptr<const Snapshot> GetCurrentSnapshot();
+
+		// The oldest snapshots are dropped once there are more than this.
+		void SetMaxSteps(std::size_t maxSteps);
+
+		std::size_t GetStepCount();
+		// The memory a step took when its snapshot was taken (what it doesn't share with the one before it, which is all of it for the first).
+		std::size_t GetStepMemory(std::size_t step);
+		std::size_t GetMemory();
+	};
+}
@@ -2,11 +2,15 @@
 
 #include "digidaw/core/audio/common.h"
 
+#include "digidaw/core/audio/effects/effect.h"
+
 namespace DigiDAW::Core::Audio
 {
 	class TrackState
 	{
 	public:
+		// Any amount of channels up to MAX can be used (for large-format interfaces),
+		// the named layouts are the ones that can be panned, up and downmixed.
 		enum class ChannelNumber
 		{
 			Mono = 1,
@@ -14,19 +18,28 @@ namespace DigiDAW::Core::Audio
 			Surround_5_1 = 6,
 			Surround_7_1 = 8,
 
-			MAX = Surround_7_1
+			MAX = 64
 		};
 
 		struct Bus;
 		struct Track;
 
+		/*
+		 * Which channels of the destination every channel of the source goes to (one list per source channel).
+		 * Every channel in a list gets a copy of the source channel, except that a mono source mapped to two channels is panned between them.
+		 *
+		 * With layoutPanning, each list of 2, 6 or 8 channels is a stereo, 5.1 or 7.1 speaker layout (in the order of the list) instead,
+		 * and the source channel is panned (or downmixed) onto it, see Detail::Panning.
+		 */
 		struct ChannelMapping
 		{
 			std::vector<std::vector<unsigned int>> mapping;
+			bool layoutPanning;
 
-			ChannelMapping(const std::vector<std::vector<unsigned int>>& mapping)
+			ChannelMapping(const std::vector<std::vector<unsigned int>>& mapping, bool layoutPanning = false)
 			{
 				this->mapping = mapping;
+				this->layoutPanning = layoutPanning;
 			}
 		};
 
@@ -60,9 +73,14 @@ namespace DigiDAW::Core::Audio
 
 			float gain;
 			float pan;
+			float panDepth; // From 0 (front) to 100 (back), only used when a mono Mixable is panned onto a surround layout.
 
 			char name[256];
 
+			// The effects chain, processed in order. Only modify this through the Mixer
+			// (Mixer::AddEffect and Mixer::RemoveEffect), as it's used by the audio processing threads.
+			std::vector<std::shared_ptr<Effects::Effect>> effects;
+
 			Mixable()
 			{
 				std::memset(this->name, 0, sizeof(this->name));
@@ -70,6 +88,7 @@ namespace DigiDAW::Core::Audio
 				this->nChannels = ChannelNumber::Mono;
 				this->gain = 0.0f;
 				this->pan = 0.0f;
+				this->panDepth = 0.0f;
 			}
 
 			Mixable(const std::string& name, ChannelNumber nChannels, float gain, float pan)
@@ -81,6 +100,7 @@ namespace DigiDAW::Core::Audio
 				this->nChannels = nChannels;
 				this->gain = gain;
 				this->pan = pan;
+				this->panDepth = 0.0f;
 			}
 		};
 
@@ -100,13 +120,35 @@ namespace DigiDAW::Core::Audio
 		{
 			// TODO: Other track specific features.
 
+			// Whether the track is fed by the input device in real time, so it can't be rendered ahead of the callback.
+			// Channel c of the track is fed by channel c of the input device (channels the device doesn't have are silent).
+			// Only modify this through the Mixer (Mixer::SetLiveInput), as it decides which thread processes the track.
+			bool liveInput;
+
+			// The audio the track plays when it isn't live, from the start of the timeline (see Mixer::SetTransportPosition),
+			// and silence after the end of it (or without one). Channel c of the track plays channel c of the clip,
+			// or its last channel when the clip has fewer (so a mono clip plays on every channel).
+			// Only modify this through the Mixer (Mixer::SetClip), as it's read by the audio processing threads.
+			std::shared_ptr<const AudioBuffer> clip;
+			std::uint64_t clipHash; // A hash of the samples of the clip, so renders of it can be cached (see Mixer::ComputeRenderKey).
+
+			// Whether the track should play back a render of its input and effects instead of processing them.
+			// Only modify this through the Mixer (Mixer::FreezeTrack and Mixer::UnfreezeTrack).
+			bool frozen;
+
 			Track()
 			{
+				this->liveInput = false;
+				this->frozen = false;
+				this->clipHash = 0;
 			}
 
 			Track(const std::string& name, ChannelNumber nChannels, float gain, float pan)
 				: Mixable(name, nChannels, gain, pan)
 			{
+				this->liveInput = false;
+				this->frozen = false;
+				this->clipHash = 0;
 			}
 		};
 
@@ -119,6 +161,10 @@ namespace DigiDAW::Core::Audio
 
 			std::vector<std::vector<unsigned int>> busChannelToDeviceOutputChannels;
 
+			// Sum the inputs in double precision, only modify this through the Mixer (Mixer::SetDoublePrecisionSumming),
+			// as it needs to allocate the buffer it sums into.
+			bool doublePrecisionSumming;
+
 			bool CheckCircularBusDependency(std::shared_ptr<Bus> otherBus)
 			{
 				for (const BusInput& input : otherBus->busInputs)
@@ -142,6 +188,7 @@ namespace DigiDAW::Core::Audio
 
 			Bus()
 			{
+				this->doublePrecisionSumming = false;
 			}
 
 			Bus(const std::string& name, ChannelNumber nChannels, float gain, float pan, 
@@ -153,6 +200,7 @@ namespace DigiDAW::Core::Audio
 				this->busChannelToDeviceOutputChannels = deviceOutputs;
 				this->trackInputs = trackInputs;
 				this->busInputs = busInputs;
+				this->doublePrecisionSumming = false;
 
 				ValidateAndRemoveInvalidInputs();
 			}
@@ -176,6 +224,11 @@ namespace DigiDAW::Core::Audio
 		void RemoveTrack(std::shared_ptr<Track>& track);
 		void RemoveBus(std::shared_ptr<Bus>& bus);
 
+		// Puts a track or bus that was removed back at a position (e.g. to undo removing it), as the same object,
+		// so everything that still refers to it (like the inputs of a bus) does again.
+		std::shared_ptr<Track> RestoreTrack(const std::shared_ptr<Track>& track, std::size_t position);
+		std::shared_ptr<Bus> RestoreBus(const std::shared_ptr<Bus>& bus, std::size_t position);
+
 		std::vector<std::shared_ptr<TrackState::Track>>& GetAllTracks()
 		{
 			return currentTracks;
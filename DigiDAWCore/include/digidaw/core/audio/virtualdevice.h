@@ -0,0 +1,187 @@
+#pragma once
+
+#include <filesystem>
+
+#include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/backend.h"
+#include "digidaw/core/audio/audiobuffer.h"
+#include "digidaw/core/audio/wavfile.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * An audio API with a single device that doesn't need any hardware, so the whole Engine can run headless (e.g. to test or benchmark it).
+	 * Its input channels are read from a WAV file (silence after the end of it, or without one), and its output channels are written to a WAV file.
+	 *
+	 * The callback is called on the device's own thread, either as fast as it returns (so a run is only as long as the processing takes),
+	 * or on a simulated clock that paces it like a real device, arriving late by a random amount up to the jitter.
+	 * The callback can also be asked for a random amount of frames every time (up to the buffer size), like some APIs do.
+	 * The random amounts come from the seed, so runs with the same settings ask for the same blocks.
+	 *
+	 * To check a render against a known one (see GetOutputHash and GetReferenceDifference), everything the stream plays
+	 * is hashed, and compared against a reference WAV file if there is one.
+	 *
+	 * Streams are always 32 bit float and non-interleaved (as that's what the Engine uses).
+	 */
+	class VirtualDevice : public Backend
+	{
+	public:
+		// Not an API of RtAudio's, so it's used for the virtual device.
+		static constexpr RtAudio::Api api = RtAudio::Api::NUM_APIS;
+
+		struct Settings
+		{
+			std::filesystem::path inputPath; // If it's empty the input is silent, and it has nInputChannels.
+			std::filesystem::path outputPath; // If it's empty the output is discarded.
+			std::filesystem::path referencePath; // The output is compared against this, if it isn't empty.
+
+			unsigned int nInputChannels; // Without an input file, otherwise it has the channels of the file.
+			unsigned int nOutputChannels;
+
+			// Without an input file, otherwise the sample rate of the file is the only one (as it isn't resampled).
+			std::vector<unsigned int> sampleRates;
+
+			bool simulateClock; // Otherwise as fast as possible.
+			double jitterMS; // How late the callback can be (on the simulated clock).
+			bool variableFrames;
+
+			std::uint64_t lengthFrames; // The stream stops itself after this many frames (0 runs until it's stopped).
+			unsigned int seed;
+
+			Settings()
+			{
+				this->nInputChannels = 2;
+				this->nOutputChannels = 2;
+				this->sampleRates = { 44100, 48000, 96000 };
+				this->simulateClock = true;
+				this->jitterMS = 0.0;
+				this->variableFrames = false;
+				this->lengthFrames = 0;
+				this->seed = 0;
+			}
+		};
+	private:
+		Settings settings;
+		RtAudio::DeviceInfo info;
+
+		AudioBuffer input;
+		bool inputLoaded;
+		AudioBuffer reference;
+		bool referenceLoaded;
+
+		bool streamOpen;
+		RtAudioCallback callback;
+		void* userData;
+		unsigned int nStreamOutputChannels;
+		unsigned int nStreamInputChannels;
+		unsigned int streamSampleRate;
+		unsigned int bufferFrames;
+		std::vector<float> outputBuffer;
+		std::vector<float> inputBuffer;
+		WavWriter output;
+
+		std::uint64_t framePosition; // The frames the stream has played, which is also where it is in the input file.
+		std::uint64_t outputHash;
+		double referenceDifference;
+		std::atomic<double> streamTime;
+		std::atomic<bool> running;
+		std::mt19937 framesRandom;
+		std::mt19937 jitterRandom;
+		std::jthread deviceThread;
+
+		void CheckOutput(const AudioBufferView& outputView);
+		void Run(std::stop_token stopToken);
+		void JoinDeviceThread();
+	public:
+		VirtualDevice(const Settings& settings);
+		~VirtualDevice();
+
+		// Whether the input file could be read (false without one, then the input is silent).
+		bool IsInputLoaded()
+		{
+			return inputLoaded;
+		}
+
+		// Whether the reference file could be read (false without one).
+		bool IsReferenceLoaded()
+		{
+			return referenceLoaded;
+		}
+
+		/*
+		 * What the stream has played since it was opened, which is only read once it's stopped (or has stopped itself).
+		 * The hash is of every sample in the order they'd be in the output file, so it doesn't depend on the sizes of the blocks.
+		 * The difference is the biggest between a sample and the same sample of the reference (or silence, past the end of it).
+		 */
+		std::uint64_t GetPlayedFrames()
+		{
+			return framePosition;
+		}
+
+		std::uint64_t GetOutputHash()
+		{
+			return outputHash;
+		}
+
+		double GetReferenceDifference()
+		{
+			return referenceDifference;
+		}
+
+		RtAudio::Api GetCurrentAPI() override
+		{
+			return api;
+		}
+
+		unsigned int GetDeviceCount() override
+		{
+			return 1;
+		}
+
+		RtAudio::DeviceInfo GetDeviceInfo(unsigned int device) override;
+
+		unsigned int GetDefaultOutputDevice() override
+		{
+			return 0;
+		}
+
+		unsigned int GetDefaultInputDevice() override
+		{
+			return 0;
+		}
+
+		RtAudioErrorType OpenStream(
+			RtAudio::StreamParameters* outputParams,
+			RtAudio::StreamParameters* inputParams,
+			RtAudioFormat format,
+			unsigned int sampleRate,
+			unsigned int* bufferFrames,
+			RtAudioCallback callback,
+			void* userData,
+			RtAudio::StreamOptions* options) override;
+		void CloseStream() override;
+		RtAudioErrorType StartStream() override;
+		RtAudioErrorType StopStream() override;
+
+		bool IsStreamOpen() override
+		{
+			return streamOpen;
+		}
+
+		bool IsStreamRunning() override
+		{
+			return running;
+		}
+
+		double GetStreamTime() override
+		{
+			return streamTime;
+		}
+
+		// There's no hardware after the callback.
+		long GetStreamLatency() override
+		{
+			return 0;
+		}
+	};
+}
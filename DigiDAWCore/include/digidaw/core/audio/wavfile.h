@@ -0,0 +1,63 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+
+#include "digidaw/core/audio/common.h"
+#include "digidaw/core/audio/audiobuffer.h"
+
+namespace DigiDAW::Core::Audio
+{
+	/*
+	 * Reads 16, 24 and 32 bit PCM and 32 and 64 bit float WAV files (including WAVE_FORMAT_EXTENSIBLE ones),
+	 * the whole file at once, into planar float audio.
+	 */
+	class WavReader
+	{
+	public:
+		// Returns an error (leaving audio and sampleRate alone) if the file can't be read or isn't in one of those formats.
+		static ReturnCode Read(const std::filesystem::path& path, AudioBuffer& audio, unsigned int& sampleRate);
+	};
+
+	/*
+	 * Writes 32 bit float WAV files from planar audio, a block at a time.
+	 * The sizes in the header are only written by Flush and Close, so a file that's cut short before either still has the audio up to the last one.
+	 */
+	class WavWriter
+	{
+	private:
+		std::ofstream file;
+		unsigned int nChannels;
+		std::uint64_t nFrames;
+		std::vector<float> interleaved;
+	public:
+		WavWriter()
+		{
+			this->nChannels = 0;
+			this->nFrames = 0;
+		}
+
+		~WavWriter()
+		{
+			Close();
+		}
+
+		// Replaces the file if it already exists, maxFrames is the most frames Write will be given at once (so it never allocates).
+		ReturnCode Open(const std::filesystem::path& path, unsigned int nChannels, unsigned int sampleRate, unsigned int maxFrames);
+		void Close();
+
+		bool IsOpen()
+		{
+			return file.is_open();
+		}
+
+		// Writes the first nFrames of every channel, which has to have nChannels channels.
+		void Write(const AudioBufferView& audio, unsigned int nFrames);
+		void Flush();
+
+		std::uint64_t GetFrameCount()
+		{
+			return nFrames;
+		}
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -11,6 +12,12 @@
 #include <deque>
 #include <type_traits>
 #include <random>
+#include <bit>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <optional>
 
 template <typename T>
 constexpr T pi = T(3.14159265358979323846);
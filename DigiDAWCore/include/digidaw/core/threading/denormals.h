@@ -0,0 +1,29 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Threading
+{
+	/*
+	 * Makes the calling thread flush denormal floats to zero (FTZ), and treat denormal inputs as zero (DAZ),
+	 * until the guard goes out of scope, when the previous floating point state is restored.
+	 *
+	 * Anything with feedback (IIR filters, reverb tails, compressor envelopes) decays towards zero through the denormal range,
+	 * where every operation can be around 100 times slower, which is enough to make the callback miss its deadline.
+	 * Nothing audible is lost by flushing them, as they're more than 700dB below full scale.
+	 */
+	class DenormalGuard
+	{
+	private:
+		std::uint64_t previousState;
+	public:
+		DenormalGuard();
+		~DenormalGuard();
+
+		DenormalGuard(const DenormalGuard&) = delete;
+		DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+		// Whether the calling thread currently flushes denormals to zero.
+		static bool IsFlushingDenormals();
+	};
+}
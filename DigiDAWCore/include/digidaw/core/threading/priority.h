@@ -0,0 +1,90 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Threading
+{
+	class ThreadPriority
+	{
+	public:
+		enum class Priority
+		{
+			Low, // For background work that can be late without glitching (e.g. the tail of a convolution).
+			Normal,
+			High,
+			Realtime // For the audio threads, SCHED_FIFO/SCHED_RR on Linux, a time constraint policy on macOS, and time critical on Windows.
+		};
+
+		/*
+		 * How a thread should be scheduled.
+		 * Realtime scheduling usually needs permission (e.g. RLIMIT_RTPRIO or CAP_SYS_NICE on Linux),
+		 * so ScheduleCurrentThread falls back to the next lower priority until one is allowed.
+		 */
+		struct Scheduling
+		{
+			Priority priority;
+			int realtimePriority; // From 1 to 99, only used by SCHED_FIFO/SCHED_RR on Linux.
+			bool roundRobin; // Use SCHED_RR instead of SCHED_FIFO, so realtime threads with the same priority take turns.
+
+			// Thread n of a pool is pinned to core (firstCore + n % nCores), or isn't pinned if firstCore is -1 (which unpins it if it was).
+			int firstCore;
+			unsigned int nCores;
+
+			Scheduling()
+			{
+				this->priority = Priority::Normal;
+				this->realtimePriority = 70;
+				this->roundRobin = false;
+				this->firstCore = -1;
+				this->nCores = 1;
+			}
+
+			Scheduling(Priority priority)
+				: Scheduling()
+			{
+				this->priority = priority;
+			}
+		};
+
+		// What a thread was actually granted by the OS.
+		struct Report
+		{
+			Priority requested;
+			Priority granted;
+			int realtimePriority; // The granted SCHED_FIFO/SCHED_RR priority (Linux only), 0 if the thread isn't realtime.
+			int core; // The core the thread is pinned to, -1 if it isn't pinned.
+
+			Report()
+			{
+				this->requested = Priority::Normal;
+				this->granted = Priority::Normal;
+				this->realtimePriority = 0;
+				this->core = -1;
+			}
+		};
+
+		// Sets the scheduling priority of the calling thread, returns false if the OS didn't allow it.
+		static bool SetCurrentThreadPriority(Priority priority);
+
+		/*
+		 * Sets realtime scheduling for the calling thread, returns the realtime priority that was granted (0 if it wasn't allowed).
+		 * On Linux this lowers the priority down to RLIMIT_RTPRIO if the requested one isn't allowed.
+		 */
+		static int SetCurrentThreadRealtime(int realtimePriority, bool roundRobin);
+
+		// Pins the calling thread to a single core (or lets it run on any core if the core is -1),
+		// returns false if the OS doesn't support it (macOS) or didn't allow it.
+		static bool SetCurrentThreadAffinity(int core);
+
+		/*
+		 * Gives the calling thread back the affinity it had before SetCurrentThreadAffinity pinned it,
+		 * and does nothing if it isn't pinned (so the affinity the audio API, host or user gave the thread is kept).
+		 */
+		static bool UnpinCurrentThread();
+
+		static unsigned int GetCoreCount();
+
+		// Applies the scheduling of the thread "index" (of a pool) to the calling thread, falling back if it's not allowed.
+		static Report ScheduleCurrentThread(const Scheduling& scheduling, std::size_t index);
+	};
+}
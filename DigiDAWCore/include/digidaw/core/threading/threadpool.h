@@ -2,6 +2,9 @@
 
 #include "digidaw/core/common.h"
 
+#include "digidaw/core/threading/priority.h"
+#include "digidaw/core/threading/denormals.h"
+
 namespace DigiDAW::Core::Threading
 {
 	class ThreadPool
@@ -11,6 +14,7 @@ namespace DigiDAW::Core::Threading
 		{
 			std::future<void> future;
 			bool isRunning;
+			ThreadPriority::Report report;
 
 			ThreadInfo()
 			{
@@ -31,13 +35,40 @@ namespace DigiDAW::Core::Threading
 
 		std::vector<ThreadInfo> threads;
 
+		ThreadPriority::Scheduling scheduling;
+		std::atomic<unsigned int> schedulingVersion = 0; // Bumped by SetScheduling, so every thread knows to reapply it.
+
+		void ApplyScheduling(std::size_t id, bool isNewThread)
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			const ThreadPriority::Scheduling threadScheduling = scheduling;
+			lock.unlock();
+
+			// A new thread already has the default scheduling.
+			if (isNewThread && threadScheduling.priority == ThreadPriority::Priority::Normal && threadScheduling.firstCore < 0) return;
+
+			const ThreadPriority::Report report = ThreadPriority::ScheduleCurrentThread(threadScheduling, id);
+
+			lock.lock();
+			threads[id].report = report;
+		}
+
 		void ThreadTask(std::size_t id)
 		{
-			while (threads[id].isRunning)
+			unsigned int appliedVersion = schedulingVersion.load();
+			ApplyScheduling(id, true);
+
+			// The pools run audio processing, so they never process denormals (for as long as the thread is running).
+			DenormalGuard denormalGuard;
+
+			while (true)
 			{
 				std::packaged_task<void()> task;
 				{
+					// threads is only read with the lock held, as Resize might still be adding this thread to it.
 					std::unique_lock<std::mutex> lock(queueMutex);
+					if (!threads[id].isRunning) return;
+
 					// Wait until a task is added if the work queue is empty.
 					if (work.empty())
 						threadSemaphore.wait(
@@ -51,6 +82,13 @@ namespace DigiDAW::Core::Threading
 				}
 				// If the task is invalid, it means an abort message has been sent.
 				if (!task.valid()) return;
+
+				// Only checked before running a task, as a waiting thread doesn't need to be rescheduled yet.
+				if (appliedVersion != schedulingVersion.load())
+				{
+					appliedVersion = schedulingVersion.load();
+					ApplyScheduling(id, false);
+				}
 				task(); // Otherwise run the task.
 			}
 		}
@@ -76,6 +114,7 @@ namespace DigiDAW::Core::Threading
 
 			if (N > threads.size())
 			{
+				std::unique_lock<std::mutex> lock(queueMutex);
 				threads.reserve(N);
 				for (std::size_t i = threads.size(); i < N; ++i)
 					threads.push_back(ThreadInfo(
@@ -85,20 +124,56 @@ namespace DigiDAW::Core::Threading
 			}
 			else if (N < threads.size())
 			{
-				for (std::size_t i = threads.size(); i >= N; --i)
 				{
-					threads[i].isRunning = false;
-					threads[i].future.wait();
+					std::unique_lock<std::mutex> lock(queueMutex);
+					for (std::size_t i = N; i < threads.size(); ++i)
+						threads[i].isRunning = false;
 				}
+				threadSemaphore.notify_all(); // Wake the stopped threads if they're waiting for work.
+
+				for (std::size_t i = N; i < threads.size(); ++i)
+					threads[i].future.wait();
 				threads.resize(N);
 			}
 		}
 
-		ThreadPool(std::size_t N = 1)
+		ThreadPool(std::size_t N = 1, ThreadPriority::Priority priority = ThreadPriority::Priority::Normal)
+			: ThreadPool(N, ThreadPriority::Scheduling(priority))
+		{
+		}
+
+		ThreadPool(std::size_t N, const ThreadPriority::Scheduling& scheduling)
 		{
+			this->scheduling = scheduling;
 			Resize(N);
 		}
 
+		// Every thread applies the new scheduling before it runs its next task.
+		void SetScheduling(const ThreadPriority::Scheduling& scheduling)
+		{
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				this->scheduling = scheduling;
+			}
+			++schedulingVersion;
+		}
+
+		std::size_t GetThreadCount()
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			return threads.size();
+		}
+
+		// What every thread was granted the last time it applied its scheduling.
+		std::vector<ThreadPriority::Report> GetReports()
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			std::vector<ThreadPriority::Report> reports;
+			for (const ThreadInfo& thread : threads)
+				reports.push_back(thread.report);
+			return reports;
+		}
+
 		void CancelPending()
 		{
 			std::unique_lock<std::mutex> lock(queueMutex);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Detail
+{
+	/*
+	 * Assigns the buffers used while mixing to a small pool of reusable buffers, like a register allocator.
+	 *
+	 * Every request is a buffer that's written by a node (a Track or a Bus) and read by some other nodes.
+	 * The nodes run in parallel, so a buffer is only free once its node and every node that reads it have finished,
+	 * and that's only known to have happened before another node starts if they're all ancestors of that node
+	 * (nodes it waits on, directly or through other nodes).
+	 *
+	 * The requests are assigned in processing order, each one reuses the smallest free buffer that's big enough
+	 * (or grows the biggest free buffer if none are), and only gets a new buffer if nothing is free.
+	 */
+	class BufferAllocator
+	{
+	public:
+		struct Request
+		{
+			std::size_t node;
+			std::size_t size;
+			std::vector<std::size_t> readers; // The nodes that read the buffer after the node that writes it, none if only the node uses it.
+			bool persistent; // Needed until the end of the callback, so it's never reused.
+
+			Request(std::size_t node, std::size_t size, const std::vector<std::size_t>& readers = {}, bool persistent = false)
+			{
+				this->node = node;
+				this->size = size;
+				this->readers = readers;
+				this->persistent = persistent;
+			}
+		};
+	private:
+		static bool IsFreeBefore(const Request& previous, const std::vector<bool>& ancestors)
+		{
+			if (previous.persistent || !ancestors[previous.node]) return false;
+			return std::all_of(previous.readers.begin(), previous.readers.end(),
+				[&](std::size_t reader) { return ancestors[reader]; });
+		}
+	public:
+		/*
+		 * ancestors[a][b] is true if node b always finishes before node a starts.
+		 * Returns the buffer assigned to every request, and the size every buffer needs to be.
+		 */
+		static std::vector<std::size_t> Allocate(
+			const std::vector<Request>& requests, const std::vector<std::vector<bool>>& ancestors,
+			std::vector<std::size_t>& bufferSizes)
+		{
+			constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+			std::vector<std::size_t> assigned(requests.size());
+			std::vector<std::size_t> lastRequest; // The last request that was assigned to each buffer.
+			bufferSizes.clear();
+
+			for (std::size_t request = 0; request < requests.size(); ++request)
+			{
+				const std::size_t size = requests[request].size;
+				const std::vector<bool>& nodeAncestors = ancestors[requests[request].node];
+
+				std::size_t best = none;
+				for (std::size_t buffer = 0; buffer < bufferSizes.size(); ++buffer)
+				{
+					if (!IsFreeBefore(requests[lastRequest[buffer]], nodeAncestors)) continue;
+
+					if (best == none)
+						best = buffer;
+					else if (bufferSizes[buffer] >= size)
+					{
+						if (bufferSizes[best] < size || bufferSizes[buffer] < bufferSizes[best]) best = buffer;
+					}
+					else if (bufferSizes[best] < size && bufferSizes[buffer] > bufferSizes[best])
+						best = buffer;
+				}
+
+				if (best == none)
+				{
+					best = bufferSizes.size();
+					bufferSizes.push_back(0);
+					lastRequest.push_back(request);
+				}
+
+				bufferSizes[best] = std::max(bufferSizes[best], size);
+				lastRequest[best] = request;
+				assigned[request] = best;
+			}
+
+			return assigned;
+		}
+	};
+}
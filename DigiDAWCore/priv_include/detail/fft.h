@@ -0,0 +1,347 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+#include "detail/simdhelper.h"
+
+namespace DigiDAW::Core::Detail
+{
+	/*
+	 * A mixed radix complex FFT of any size, working on split complex buffers (real and imaginary parts in separate arrays),
+	 * so spectra can be multiplied together with SIMD without any shuffling.
+	 *
+	 * The size is factored into radix 4, 2, 3 and 5 stages (and a generic scalar stage for any other prime factor),
+	 * which are done as a Stockham autosort FFT, so there's no bit reversal pass and every stage reads and writes contiguously.
+	 * (the vectorized stages are in SimdHelper::FFTStockhamStage)
+	 *
+	 * The inverse isn't scaled, so Inverse(Forward(x)) is x * size.
+	 *
+	 * An FFT object holds scratch buffers, so it should only be used by one thread at a time.
+	 */
+	class ComplexFFT
+	{
+	private:
+		struct Stage
+		{
+			unsigned int radix;
+			std::size_t m; // The amount of butterflies per group
+			std::size_t s; // The stride (the product of the radices of the previous stages)
+
+			// Twiddle factor r of butterfly q is at q * (radix - 1) + r - 1 
+			// (or at (r - 1) * m + q for the first stage, which is vectorized over q instead)
+			std::vector<float> twiddleReal;
+			std::vector<float> twiddleImag;
+
+			// Only for generic stages, the radix-th roots of unity, and scratch space for the butterfly.
+			std::vector<float> rootReal;
+			std::vector<float> rootImag;
+			std::vector<float> scratch;
+		};
+
+		std::size_t size;
+		std::vector<Stage> stages;
+
+		// Aligned, as the first stage always writes into the first buffer with packed stores.
+		std::vector<float, simdpp::aligned_allocator<float, 64>> bufferReal[2];
+		std::vector<float, simdpp::aligned_allocator<float, 64>> bufferImag[2];
+
+		static bool IsPackedFirstStage(const Stage& stage)
+		{
+			return stage.s == 1 && stage.radix <= 4;
+		}
+
+		static void GenericStage(Stage& stage, const float* srcReal, const float* srcImag, float* dstReal, float* dstImag)
+		{
+			const unsigned int p = stage.radix;
+			const std::size_t m = stage.m, s = stage.s;
+			float* aReal = stage.scratch.data();
+			float* aImag = aReal + p;
+
+			for (std::size_t q = 0; q < m; ++q)
+			{
+				for (std::size_t k = 0; k < s; ++k)
+				{
+					for (unsigned int j = 0; j < p; ++j)
+					{
+						aReal[j] = srcReal[k + s * (q + m * j)];
+						aImag[j] = srcImag[k + s * (q + m * j)];
+					}
+
+					for (unsigned int r = 0; r < p; ++r)
+					{
+						float yRe = 0.0f, yIm = 0.0f;
+						for (unsigned int j = 0; j < p; ++j)
+						{
+							const unsigned int root = (j * r) % p;
+							yRe += aReal[j] * stage.rootReal[root] - aImag[j] * stage.rootImag[root];
+							yIm += aReal[j] * stage.rootImag[root] + aImag[j] * stage.rootReal[root];
+						}
+
+						if (r > 0)
+						{
+							const float wRe = stage.twiddleReal[q * (p - 1) + r - 1];
+							const float wIm = stage.twiddleImag[q * (p - 1) + r - 1];
+							const float tRe = yRe * wRe - yIm * wIm;
+							yIm = yRe * wIm + yIm * wRe;
+							yRe = tRe;
+						}
+
+						dstReal[k + s * (p * q + r)] = yRe;
+						dstImag[k + s * (p * q + r)] = yIm;
+					}
+				}
+			}
+		}
+
+		void RunStage(Stage& stage, const float* srcReal, const float* srcImag, float* dstReal, float* dstImag)
+		{
+			const float* twiddleReal = stage.twiddleReal.data();
+			const float* twiddleImag = stage.twiddleImag.data();
+			if (IsPackedFirstStage(stage))
+			{
+				switch (stage.radix)
+				{
+				case 2: SimdHelper::FFTStockhamFirstStage<2>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m); break;
+				case 3: SimdHelper::FFTStockhamFirstStage<3>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m); break;
+				case 4: SimdHelper::FFTStockhamFirstStage<4>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m); break;
+				}
+				return;
+			}
+
+			switch (stage.radix)
+			{
+			case 2: SimdHelper::FFTStockhamStage<2>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m, stage.s); break;
+			case 3: SimdHelper::FFTStockhamStage<3>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m, stage.s); break;
+			case 4: SimdHelper::FFTStockhamStage<4>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m, stage.s); break;
+			case 5: SimdHelper::FFTStockhamStage<5>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, stage.m, stage.s); break;
+			default: GenericStage(stage, srcReal, srcImag, dstReal, dstImag); break;
+			}
+		}
+	public:
+		ComplexFFT(std::size_t size)
+		{
+			this->size = std::max(size, static_cast<std::size_t>(1));
+
+			// Factor the size, using radix 4 as much as possible.
+			std::vector<unsigned int> radices;
+			std::size_t remaining = this->size;
+			while (remaining % 4 == 0) { radices.push_back(4); remaining /= 4; }
+			for (unsigned int radix : { 2u, 3u, 5u })
+				while (remaining % radix == 0) { radices.push_back(radix); remaining /= radix; }
+			for (unsigned int radix = 7; remaining > 1; radix += 2)
+				while (remaining % radix == 0) { radices.push_back(radix); remaining /= radix; }
+
+			std::size_t n = this->size;
+			std::size_t s = 1;
+			for (unsigned int radix : radices)
+			{
+				Stage stage;
+				stage.radix = radix;
+				stage.m = n / radix;
+				stage.s = s;
+
+				stage.twiddleReal = std::vector<float>(stage.m * (radix - 1));
+				stage.twiddleImag = std::vector<float>(stage.m * (radix - 1));
+				for (std::size_t q = 0; q < stage.m; ++q)
+				{
+					for (unsigned int r = 1; r < radix; ++r)
+					{
+						double angle = -2.0 * pi<double> * static_cast<double>(q * r) / static_cast<double>(n);
+						std::size_t index = IsPackedFirstStage(stage) ? (r - 1) * stage.m + q : q * (radix - 1) + r - 1;
+						stage.twiddleReal[index] = static_cast<float>(std::cos(angle));
+						stage.twiddleImag[index] = static_cast<float>(std::sin(angle));
+					}
+				}
+
+				if (radix > 5)
+				{
+					stage.rootReal = std::vector<float>(radix);
+					stage.rootImag = std::vector<float>(radix);
+					for (unsigned int j = 0; j < radix; ++j)
+					{
+						double angle = -2.0 * pi<double> * static_cast<double>(j) / static_cast<double>(radix);
+						stage.rootReal[j] = static_cast<float>(std::cos(angle));
+						stage.rootImag[j] = static_cast<float>(std::sin(angle));
+					}
+					stage.scratch = std::vector<float>(2 * static_cast<std::size_t>(radix));
+				}
+
+				stages.push_back(std::move(stage));
+
+				n /= radix;
+				s *= radix;
+			}
+
+			for (unsigned int buffer = 0; buffer < 2; ++buffer)
+			{
+				bufferReal[buffer].resize(this->size);
+				bufferImag[buffer].resize(this->size);
+			}
+		}
+
+		std::size_t GetSize() const
+		{
+			return size;
+		}
+
+		// All buffers are GetSize() values, the source and destination can be the same buffers.
+		void Forward(const float* srcReal, const float* srcImag, float* dstReal, float* dstImag)
+		{
+			if (stages.empty())
+			{
+				dstReal[0] = srcReal[0];
+				dstImag[0] = srcImag[0];
+				return;
+			}
+
+			// Every stage goes from one buffer to the other, the first stage reads from the source (and writes to the first buffer)
+			// and the last one writes to the destination.
+			const float* inReal = srcReal;
+			const float* inImag = srcImag;
+			for (std::size_t stage = 0; stage < stages.size(); ++stage)
+			{
+				const bool last = stage + 1 == stages.size() && stages.size() > 1;
+				float* outReal = last ? dstReal : bufferReal[stage % 2].data();
+				float* outImag = last ? dstImag : bufferImag[stage % 2].data();
+
+				RunStage(stages[stage], inReal, inImag, outReal, outImag);
+
+				inReal = outReal;
+				inImag = outImag;
+			}
+
+			// With a single stage the output had to go to a buffer, in case the source and destination are the same.
+			if (stages.size() == 1)
+			{
+				std::copy_n(bufferReal[0].data(), size, dstReal);
+				std::copy_n(bufferImag[0].data(), size, dstImag);
+			}
+		}
+
+		void Inverse(const float* srcReal, const float* srcImag, float* dstReal, float* dstImag)
+		{
+			// The inverse is the forward transform with the real and imaginary parts swapped.
+			Forward(srcImag, srcReal, dstImag, dstReal);
+		}
+	};
+
+	/*
+	 * A real FFT (of any even size), working on split complex spectra.
+	 *
+	 * A real FFT of "size" samples is done as a complex FFT of size / 2 (the even samples as the real part and
+	 * the odd samples as the imaginary part), followed by a pass that separates the two halves again.
+	 * The spectrum has size / 2 + 1 bins (DC up to and including Nyquist).
+	 *
+	 * The inverse isn't scaled, so Inverse(Forward(x)) is x * size.
+	 *
+	 * An FFT object holds scratch buffers, so it should only be used by one thread at a time.
+	 */
+	class FFT
+	{
+	private:
+		std::size_t size;
+		std::size_t complexSize;
+
+		ComplexFFT complexFFT;
+
+		// The twiddle factors used to separate the two halves of the real FFT.
+		std::vector<float> realTwiddleReal;
+		std::vector<float> realTwiddleImag;
+
+		std::vector<float> packedReal;
+		std::vector<float> packedImag;
+		std::vector<float> workReal;
+		std::vector<float> workImag;
+	public:
+		FFT(std::size_t size)
+			: complexFFT(std::max((size + 1) / 2, static_cast<std::size_t>(1)))
+		{
+			this->complexSize = complexFFT.GetSize();
+			this->size = complexSize * 2;
+
+			realTwiddleReal = std::vector<float>(complexSize);
+			realTwiddleImag = std::vector<float>(complexSize);
+			for (std::size_t i = 0; i < complexSize; ++i)
+			{
+				double angle = -2.0 * pi<double> * static_cast<double>(i) / static_cast<double>(this->size);
+				realTwiddleReal[i] = static_cast<float>(std::cos(angle));
+				realTwiddleImag[i] = static_cast<float>(std::sin(angle));
+			}
+
+			packedReal = std::vector<float>(complexSize);
+			packedImag = std::vector<float>(complexSize);
+			workReal = std::vector<float>(complexSize);
+			workImag = std::vector<float>(complexSize);
+		}
+
+		std::size_t GetSize() const
+		{
+			return size;
+		}
+
+		std::size_t GetSpectrumSize() const
+		{
+			return complexSize + 1;
+		}
+
+		// "src" is GetSize() samples, "dstReal" and "dstImag" are GetSpectrumSize() bins.
+		void Forward(const float* src, float* dstReal, float* dstImag)
+		{
+			// Pack the even and odd samples into a complex signal.
+			for (std::size_t i = 0; i < complexSize; ++i)
+			{
+				packedReal[i] = src[2 * i];
+				packedImag[i] = src[2 * i + 1];
+			}
+
+			complexFFT.Forward(packedReal.data(), packedImag.data(), workReal.data(), workImag.data());
+
+			// Separate the spectra of the even (e) and odd (o) samples, and combine them into the real spectrum.
+			dstReal[0] = workReal[0] + workImag[0];
+			dstImag[0] = 0.0f;
+			dstReal[complexSize] = workReal[0] - workImag[0];
+			dstImag[complexSize] = 0.0f;
+			for (std::size_t k = 1; k < complexSize; ++k)
+			{
+				const float zRe = workReal[k], zIm = workImag[k];
+				const float zcRe = workReal[complexSize - k], zcIm = -workImag[complexSize - k]; // conj(Z[N - k])
+
+				const float eRe = 0.5f * (zRe + zcRe), eIm = 0.5f * (zIm + zcIm);
+				// o = (z - zc) / 2i
+				const float oRe = 0.5f * (zIm - zcIm), oIm = -0.5f * (zRe - zcRe);
+
+				dstReal[k] = eRe + realTwiddleReal[k] * oRe - realTwiddleImag[k] * oIm;
+				dstImag[k] = eIm + realTwiddleReal[k] * oIm + realTwiddleImag[k] * oRe;
+			}
+		}
+
+		// "srcReal" and "srcImag" are GetSpectrumSize() bins, "dst" is GetSize() samples.
+		void Inverse(const float* srcReal, const float* srcImag, float* dst)
+		{
+			// Rebuild the complex spectrum (times 2) of the packed signal.
+			for (std::size_t k = 0; k < complexSize; ++k)
+			{
+				const float xRe = srcReal[k], xIm = srcImag[k];
+				const float xcRe = srcReal[complexSize - k], xcIm = -srcImag[complexSize - k]; // conj(X[N - k])
+
+				const float eRe = xRe + xcRe, eIm = xIm + xcIm;
+				// o = (x - xc) * conj(w)
+				const float dRe = xRe - xcRe, dIm = xIm - xcIm;
+				const float oRe = dRe * realTwiddleReal[k] + dIm * realTwiddleImag[k];
+				const float oIm = dIm * realTwiddleReal[k] - dRe * realTwiddleImag[k];
+
+				// z = e + i * o
+				packedReal[k] = eRe - oIm;
+				packedImag[k] = eIm + oRe;
+			}
+
+			complexFFT.Inverse(packedReal.data(), packedImag.data(), workReal.data(), workImag.data());
+
+			for (std::size_t i = 0; i < complexSize; ++i)
+			{
+				dst[2 * i] = workReal[i];
+				dst[2 * i + 1] = workImag[i];
+			}
+		}
+	};
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Detail
+{
+	/*
+	 * A 64 bit FNV-1a hash, used to key renders by the settings that went into them (see Audio::RenderCache).
+	 * It's stable between runs and platforms (of the same endianness), so the keys can be used for files on disk.
+	 * Values are hashed by their bytes, so only pass it types without padding (floats are hashed by their bits).
+	 */
+	class Hash
+	{
+	public:
+		static constexpr std::uint64_t offsetBasis = 0xcbf29ce484222325ull;
+		static constexpr std::uint64_t prime = 0x100000001b3ull;
+
+		static std::uint64_t Bytes(const void* data, std::size_t size, std::uint64_t hash = offsetBasis)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= prime;
+			}
+			return hash;
+		}
+
+		template<typename T>
+		static std::uint64_t Combine(std::uint64_t hash, const T& value)
+		{
+			static_assert((std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>) || std::is_floating_point_v<T>,
+				"Only values without padding can be hashed by their bytes");
+			return Bytes(&value, sizeof(value), hash);
+		}
+
+		static std::uint64_t Combine(std::uint64_t hash, const std::string& value)
+		{
+			return Bytes(value.data(), value.size(), Combine(hash, value.size()));
+		}
+	};
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "digidaw/core/common.h"
+
+namespace DigiDAW::Core::Detail
+{
+	/*
+	 * Computes the gains used for panning and for mapping channels between speaker layouts.
+	 * Mappings only use the layouts when they ask for it (see TrackState::ChannelMapping), otherwise their channels are just copied.
+	 *
+	 * Every layout (mono, stereo, 5.1 and 7.1, in the WAVE channel order) has a speaker azimuth for each channel,
+	 * and anything that's panned onto a surround layout uses 2D VBAP (vector base amplitude panning):
+	 * a source between two neighbouring speakers is only played by those two, with gains that keep the power constant.
+	 *
+	 *  - A mono source is positioned with its pan (left to right) and depth (front to back).
+	 *    Panning onto a stereo layout uses the sine law, the same as before there was surround panning.
+	 *    Towards the middle of the room, the source is spread over every speaker (still at constant power).
+	 *  - Every channel of a multichannel source is a virtual speaker at its own azimuth, so a stereo source keeps its image
+	 *    on a 7.1 layout, and a 5.1 source gets downmixed onto a stereo layout (anything outside of the stereo speakers
+	 *    goes to the nearest speaker, and the surround channels get -3dB, like an ITU downmix).
+	 *  - The LFE channel only ever goes to the LFE channel.
+	 */
+	class Panning
+	{
+	private:
+		static constexpr float lfe = std::numeric_limits<float>::infinity(); // The azimuth of an LFE channel
+		static constexpr float maximumAzimuthGap = 180.0f; // Two neighbouring speakers further apart than this can't pan between them.
+
+		// In degrees, 0 is the front, and positive is to the right.
+		static const float* GetLayoutAzimuths(unsigned int nChannels)
+		{
+			static const float mono[] = { 0.0f };
+			static const float stereo[] = { -30.0f, 30.0f };
+			static const float surround51[] = { -30.0f, 30.0f, 0.0f, lfe, -110.0f, 110.0f };
+			static const float surround71[] = { -30.0f, 30.0f, 0.0f, lfe, -150.0f, 150.0f, -90.0f, 90.0f };
+
+			switch (nChannels)
+			{
+			case 1: return mono;
+			case 2: return stereo;
+			case 6: return surround51;
+			case 8: return surround71;
+			default: return nullptr;
+			}
+		}
+
+		static float WrapAzimuth(float azimuth)
+		{
+			azimuth = std::fmod(azimuth + 180.0f, 360.0f);
+			if (azimuth < 0.0f) azimuth += 360.0f;
+			return azimuth - 180.0f;
+		}
+
+		// The 2D VBAP gains of a source at an azimuth onto the speaker pair at azimuth a and b,
+		// returns false if the source isn't between them.
+		static bool PairGains(float azimuth, float a, float b, float& gainA, float& gainB)
+		{
+			const float toRadians = pi<float> / 180.0f;
+			const float px = std::sin(azimuth * toRadians), py = std::cos(azimuth * toRadians);
+			const float ax = std::sin(a * toRadians), ay = std::cos(a * toRadians);
+			const float bx = std::sin(b * toRadians), by = std::cos(b * toRadians);
+
+			// Solve p = gainA * a + gainB * b
+			const float determinant = ax * by - ay * bx;
+			if (std::abs(determinant) < 1e-6f) return false;
+			gainA = (px * by - py * bx) / determinant;
+			gainB = (ax * py - ay * px) / determinant;
+			if (gainA < -1e-5f || gainB < -1e-5f) return false;
+
+			gainA = std::max(gainA, 0.0f);
+			gainB = std::max(gainB, 0.0f);
+			const float power = std::sqrt(gainA * gainA + gainB * gainB);
+			gainA /= power;
+			gainB /= power;
+			return true;
+		}
+
+		// Pans a source at an azimuth onto a layout, sources outside of the layout go to the nearest speaker.
+		static void VBAP(float azimuth, const float* layout, unsigned int nChannels, float* gains)
+		{
+			std::fill(gains, gains + nChannels, 0.0f);
+
+			// Try every pair of speakers that are next to each other (with no other speaker between them).
+			for (unsigned int a = 0; a < nChannels; ++a)
+			{
+				if (layout[a] == lfe) continue;
+
+				int next = -1;
+				float nextGap = 360.0f;
+				for (unsigned int b = 0; b < nChannels; ++b)
+				{
+					if (b == a || layout[b] == lfe) continue;
+					float gap = layout[b] - layout[a];
+					if (gap <= 0.0f) gap += 360.0f;
+					if (gap < nextGap)
+					{
+						nextGap = gap;
+						next = static_cast<int>(b);
+					}
+				}
+				if (next < 0 || nextGap >= maximumAzimuthGap) continue;
+
+				float offset = azimuth - layout[a];
+				if (offset < 0.0f) offset += 360.0f;
+				if (offset > nextGap) continue;
+
+				float gainA, gainB;
+				if (PairGains(azimuth, layout[a], layout[next], gainA, gainB))
+				{
+					gains[a] = gainA;
+					gains[next] = gainB;
+					return;
+				}
+			}
+
+			// Not between any pair, so use the nearest speaker.
+			unsigned int nearest = 0;
+			float nearestDistance = 360.0f;
+			for (unsigned int channel = 0; channel < nChannels; ++channel)
+			{
+				if (layout[channel] == lfe) continue;
+				float distance = std::abs(WrapAzimuth(azimuth - layout[channel]));
+				if (distance < nearestDistance)
+				{
+					nearestDistance = distance;
+					nearest = channel;
+				}
+			}
+			gains[nearest] = 1.0f;
+		}
+	public:
+		static bool IsSupportedLayout(unsigned int nChannels)
+		{
+			return GetLayoutAzimuths(nChannels) != nullptr;
+		}
+
+		// The sine law, pan goes from -100 (left) to 100 (right).
+		static void StereoGains(float pan, float& left, float& right)
+		{
+			const float panning = (std::clamp(pan, -100.0f, 100.0f) / 200.0f) + 0.5f;
+			const float pidiv2 = pi<float> / 2.0f;
+			right = std::sin(panning * pidiv2);
+			left = std::sin((1.0f - panning) * pidiv2);
+		}
+
+		/*
+		 * The gains of channel "channel" of a source with nSource channels, onto a layout of nDestination channels.
+		 * The pan goes from -100 (left) to 100 (right), and the depth from 0 (front) to 100 (back), these only affect mono sources.
+		 * If either layout isn't one of the known layouts, every gain is 1 (the channel is just copied).
+		 */
+		static void ChannelGains(
+			unsigned int nSource, unsigned int channel, unsigned int nDestination,
+			float pan, float depth, float* gains)
+		{
+			const float* sourceLayout = GetLayoutAzimuths(nSource);
+			const float* destinationLayout = GetLayoutAzimuths(nDestination);
+			if (!sourceLayout || !destinationLayout || nDestination == 1)
+			{
+				std::fill(gains, gains + nDestination, 1.0f);
+				return;
+			}
+
+			if (sourceLayout[channel] == lfe)
+			{
+				for (unsigned int destination = 0; destination < nDestination; ++destination)
+					gains[destination] = (destinationLayout[destination] == lfe) ? 1.0f : 0.0f;
+				return;
+			}
+
+			if (nSource == 1 && nDestination == 2)
+			{
+				StereoGains(pan, gains[0], gains[1]);
+				return;
+			}
+
+			if (nSource == 1)
+			{
+				// The position on a square room, where the front corners are the front left and right speakers.
+				const float x = std::clamp(pan / 100.0f, -1.0f, 1.0f);
+				const float y = 1.0f - 2.0f * std::clamp(depth / 100.0f, 0.0f, 1.0f); // 1 is the front
+				const float azimuth = std::atan2(x * std::tan(pi<float> / 6.0f), y) * 180.0f / pi<float>;
+				const float distance = std::max(std::abs(x), std::abs(y)); // 1 on the edges, 0 in the middle of the room.
+
+				VBAP(azimuth, destinationLayout, nDestination, gains);
+
+				// Spread the source over every speaker towards the middle of the room, keeping the power constant.
+				unsigned int nSpeakers = 0;
+				for (unsigned int destination = 0; destination < nDestination; ++destination)
+					if (destinationLayout[destination] != lfe) ++nSpeakers;
+				for (unsigned int destination = 0; destination < nDestination; ++destination)
+					if (destinationLayout[destination] != lfe)
+						gains[destination] = std::sqrt(distance * gains[destination] * gains[destination] +
+							(1.0f - distance) / static_cast<float>(nSpeakers));
+				return;
+			}
+
+			const float azimuth = sourceLayout[channel];
+			VBAP(azimuth, destinationLayout, nDestination, gains);
+
+			// The stereo layout has nothing to the side or behind, so those channels are folded into the front at -3dB.
+			if (nDestination == 2 && std::abs(azimuth) >= 90.0f)
+				for (unsigned int destination = 0; destination < nDestination; ++destination)
+					gains[destination] *= 1.0f / std::sqrt(2.0f);
+		}
+
+		/*
+		 * The gain of every entry of a channel mapping (in order, every destination of source channel 0, then channel 1, etc.).
+		 *
+		 * Without layoutPanning every destination gets a copy of its source channel, except that a mono source mapped to
+		 * two channels is panned between them with the sine law (any other source is panned by its own balance instead).
+		 * With layoutPanning, a source channel that's mapped to a list of destination channels treats them as a layout
+		 * (in the order of the list), so a mono channel mapped to 6 channels is panned over them as a 5.1 layout.
+		 */
+		static void MappingGains(
+			const std::vector<std::vector<unsigned int>>& mapping, unsigned int nSource, bool layoutPanning,
+			float pan, float depth, float* gains)
+		{
+			for (unsigned int channel = 0; channel < nSource && channel < mapping.size(); ++channel)
+			{
+				const unsigned int nMapped = static_cast<unsigned int>(mapping[channel].size());
+				if (layoutPanning && IsSupportedLayout(nMapped))
+					ChannelGains(nSource, channel, nMapped, pan, depth, gains);
+				else if (nSource == 1 && nMapped == 2)
+					StereoGains(pan, gains[0], gains[1]);
+				else
+					std::fill(gains, gains + nMapped, 1.0f);
+				gains += nMapped;
+			}
+		}
+
+		/*
+		 * The gain of every channel of a Mixable for its own pan (a balance control), from -100 (left) to 100 (right).
+		 * Stereo uses the sine law, and surround layouts do the same to each side, with the center channels left at -3dB.
+		 */
+		static void BalanceGains(unsigned int nChannels, float pan, float* gains)
+		{
+			const float* layout = GetLayoutAzimuths(nChannels);
+			if (!layout || nChannels == 1)
+			{
+				std::fill(gains, gains + nChannels, 1.0f);
+				return;
+			}
+
+			float left, right;
+			StereoGains(pan, left, right);
+			for (unsigned int channel = 0; channel < nChannels; ++channel)
+			{
+				if (layout[channel] == lfe || layout[channel] == 0.0f)
+					gains[channel] = 1.0f / std::sqrt(2.0f);
+				else
+					gains[channel] = (layout[channel] < 0.0f) ? left : right;
+			}
+		}
+	};
+}
@@ -2,6 +2,8 @@
 
 #include "digidaw/core/common.h"
 
+#include "digidaw/core/audio/audiobuffer.h"
+
 #include <simdpp/simd.h>
 
 namespace DigiDAW::Core::Detail
@@ -51,6 +53,329 @@ namespace DigiDAW::Core::Detail
 			const float rcpLn10 = 1.0f / ln10; // 1 / ln(10)
 			return LnVector(src) * rcpLn10; // ln(src) / ln(10)
 		}
+
+		// Based off https://github.com/jhjourdan/SIMD-math-prims/blob/master/simd_math_prims.h
+		template<unsigned N, class V>
+		static simdpp::float32<N> ExpVector(const simdpp::float32<N, V>& src)
+		{
+			// val = clamp(12102203.1615614 * src + 1065353216.0, 0, 2139095040.0)
+			simdpp::float32<N> val = src * 12102203.1615614f + 1065353216.0f;
+			val = simdpp::min(val, simdpp::splat<simdpp::float32<N>>(2139095040.0f));
+			val = simdpp::max(val, simdpp::splat<simdpp::float32<N>>(0.0f));
+			simdpp::int32<N> iVal = simdpp::to_int32(val);
+
+			// The exponent part and the mantissa part (in the range [1, 2)) of the result.
+			simdpp::float32<N> exponent = simdpp::bit_cast<simdpp::float32<N>>(simdpp::int32<N>(iVal & 0x7F800000));
+			simdpp::float32<N> b = simdpp::bit_cast<simdpp::float32<N>>(simdpp::int32<N>((iVal & 0x7FFFFF) | 0x3F800000));
+
+			/* (From original scalar reference code)
+			 *  Generated in Sollya with:
+			 *	> f=remez(1-x*exp(-(x-1)*log(2)),
+			 *			[|(x-1)*(x-2), (x-1)*(x-2)*x, (x-1)*(x-2)*x*x|],
+			 *			[1.000001,1.999999], exp(-(x-1)*log(2)));
+			 *	> plot(exp((x-1)*log(2))/(f+x)-1, [1,2]);
+			 *	> f+x;
+			 */
+			return exponent * (0.509871020343597804469416f + b *
+				(0.312146713032169896138863f + b *
+				(0.166617139319965966118107f + b *
+				(-2.19061993049215080032874e-3f + b *
+				1.3555747234758484073940937e-2f))));
+		}
+
+		// Loads/stores either a single float, or a vector of floats, so the same code can be used for scalar and vector lanes.
+		template<class T>
+		static T LoadLanes(const float* src)
+		{
+			if constexpr (std::is_same_v<T, float>) return *src;
+			else return simdpp::load_u(src);
+		}
+
+		template<class T>
+		static void StoreLanes(float* dst, const T& value)
+		{
+			if constexpr (std::is_same_v<T, float>) *dst = value;
+			else simdpp::store_u(dst, value);
+		}
+
+		// Loads/stores a vector with aligned instructions if the buffer is known to be aligned, 
+		// so the AudioBufferView functions only need to be written once.
+		template<bool Aligned>
+		static simdpp::float32v LoadVector(const float* src)
+		{
+			simdpp::float32v xmmA;
+			if constexpr (Aligned) xmmA = simdpp::load(src);
+			else xmmA = simdpp::load_u(src);
+			return xmmA;
+		}
+
+		template<bool Aligned>
+		static void StoreVector(float* dst, const simdpp::float32v& value)
+		{
+			if constexpr (Aligned) simdpp::store(dst, value);
+			else simdpp::store_u(dst, value);
+		}
+
+		template<bool Aligned>
+		static void SetChannel(float* dst, float value, size_t length)
+		{
+			const simdpp::float32v xmmA = simdpp::splat(value);
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+				StoreVector<Aligned>(&dst[i], xmmA);
+			for (; i < length; ++i) // Set the remaining length using scalar code.
+				dst[i] = value;
+		}
+
+		template<bool Aligned>
+		static void CopyChannel(const float* src, float* dst, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+				StoreVector<Aligned>(&dst[i], LoadVector<Aligned>(&src[i]));
+			for (; i < length; ++i) // Copy the remaining length using scalar code.
+				dst[i] = src[i];
+		}
+
+		template<bool Aligned>
+		static void AccumulateChannel(const float* src, float* dst, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = LoadVector<Aligned>(&src[i]);
+				simdpp::float32v xmmB = LoadVector<Aligned>(&dst[i]);
+				StoreVector<Aligned>(&dst[i], xmmA + xmmB);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				dst[i] += src[i];
+		}
+
+		template<bool Aligned>
+		static void MulScalarChannel(float scalar, float* buffer, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = LoadVector<Aligned>(&buffer[i]);
+				StoreVector<Aligned>(&buffer[i], xmmA * scalar);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				buffer[i] *= scalar;
+		}
+
+		template<bool Aligned>
+		static void MulScalarChannelRamp(float gain, float targetGain, float* buffer, size_t length)
+		{
+			alignas(64) static const float frameOffsets[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+			const simdpp::float32v offsets = simdpp::load(frameOffsets);
+			const float delta = (targetGain - gain) / static_cast<float>(length);
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmGain = (offsets + static_cast<float>(i)) * delta + gain;
+				simdpp::float32v xmmA = LoadVector<Aligned>(&buffer[i]);
+				StoreVector<Aligned>(&buffer[i], xmmA * xmmGain);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				buffer[i] *= gain + delta * static_cast<float>(i);
+		}
+
+		// The double precision kernels use 8 doubles at a time (converted from a single AVX2 vector of floats, into two vectors of doubles),
+		// which keeps two independent adds in flight.
+		static constexpr unsigned int doubleWidth = 8;
+		using float64d = simdpp::float64<doubleWidth>;
+		using float32d = simdpp::float32<doubleWidth>;
+
+		template<bool Aligned>
+		static void GetLinkedSquaredLevelChannels(const Audio::AudioBufferView& src, float* dst)
+		{
+			const size_t nFrames = src.GetFrameCount();
+			const unsigned int nChannels = src.GetChannelCount();
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= nFrames; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v level = simdpp::splat(0.0f);
+				for (unsigned int channel = 0; channel < nChannels; ++channel)
+				{
+					simdpp::float32v xmmA = LoadVector<Aligned>(&src.GetChannel(channel)[i]);
+					level = simdpp::max(level, xmmA * xmmA);
+				}
+				simdpp::store_u(&dst[i], level);
+			}
+			for (; i < nFrames; ++i) // Calculate the remaining frames using scalar code.
+			{
+				float level = 0.0f;
+				for (unsigned int channel = 0; channel < nChannels; ++channel)
+					level = std::max(level, src.GetChannel(channel)[i] * src.GetChannel(channel)[i]);
+				dst[i] = level;
+			}
+		}
+
+		template<bool Aligned>
+		static size_t CountDenormalsChannel(const float* buffer, size_t length)
+		{
+			// A float is denormal if its exponent is 0 and its mantissa isn't, so (without the sign bit) it's in [1, 0x7FFFFF].
+			// This is checked on the bits, as comparing the floats would treat the denormals as 0 if DAZ is set.
+			const simdpp::uint32v signMask = simdpp::splat(0x7FFFFFFFu);
+			const simdpp::uint32v largestDenormal = simdpp::splat(0x7FFFFFu);
+			const simdpp::uint32v one = simdpp::splat(1u);
+			simdpp::uint32v counts = simdpp::splat(0u);
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::uint32v bits = simdpp::bit_cast<simdpp::uint32v>(LoadVector<Aligned>(&buffer[i])) & signMask;
+				counts = counts + simdpp::bit_and(simdpp::cmp_le(simdpp::uint32v(bits - one), largestDenormal), one);
+			}
+			size_t count = simdpp::reduce_add(counts);
+			for (; i < length; ++i) // Check the remaining length using scalar code.
+			{
+				const std::uint32_t bits = std::bit_cast<std::uint32_t>(buffer[i]) & 0x7FFFFFFFu;
+				if (bits - 1u <= 0x7FFFFFu) ++count;
+			}
+			return count;
+		}
+
+		template<bool Aligned>
+		static void MixSparseMatrixChannels(
+			const Audio::AudioBufferView& src, const Audio::AudioBufferView& dst,
+			const unsigned int* sources, const unsigned int* destinations, const float* gains, const float* targetGains,
+			size_t nEntries, size_t firstFrame, size_t rampFrames)
+		{
+			alignas(64) static const float frameOffsets[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+			static_assert(SIMDPP_FAST_FLOAT32_SIZE <= 16, "frameOffsets needs to be as big as a vector");
+			const simdpp::float32v offsets = simdpp::load(frameOffsets);
+			const size_t nFrames = std::min(src.GetFrameCount(), dst.GetFrameCount());
+			const float rcpFrames = 1.0f / static_cast<float>(rampFrames);
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= nFrames; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				const simdpp::float32v frame = offsets + static_cast<float>(firstFrame + i);
+
+				size_t e = 0;
+				while (e < nEntries)
+				{
+					const unsigned int source = sources[e];
+					const simdpp::float32v xmmA = LoadVector<Aligned>(&src.GetChannel(source)[i]);
+					for (; e < nEntries && sources[e] == source; ++e)
+					{
+						const float delta = (targetGains[e] - gains[e]) * rcpFrames;
+						simdpp::float32v xmmGain = frame * delta + gains[e];
+
+						float* dstChannel = &dst.GetChannel(destinations[e])[i];
+						simdpp::float32v xmmB = LoadVector<Aligned>(dstChannel);
+						StoreVector<Aligned>(dstChannel, xmmB + xmmA * xmmGain);
+					}
+				}
+			}
+			for (; i < nFrames; ++i) // Calculate the remaining length using scalar code.
+			{
+				for (size_t e = 0; e < nEntries; ++e)
+				{
+					const float delta = (targetGains[e] - gains[e]) * rcpFrames;
+					dst.GetChannel(destinations[e])[i] += src.GetChannel(sources[e])[i] * (gains[e] + delta * static_cast<float>(firstFrame + i));
+				}
+			}
+		}
+
+		// In place forward DFTs (e^(-2 * pi * i * j * r / P)) of size 2, 3, 4 and 5, on split complex values.
+		template<unsigned int P, class T>
+		static void SmallDFT(T* re, T* im)
+		{
+			if constexpr (P == 2)
+			{
+				T t0Re = re[0] + re[1], t0Im = im[0] + im[1];
+				T t1Re = re[0] - re[1], t1Im = im[0] - im[1];
+				re[0] = t0Re; im[0] = t0Im;
+				re[1] = t1Re; im[1] = t1Im;
+			}
+			else if constexpr (P == 3)
+			{
+				const float sin60 = 0.866025403784438646763723f;
+
+				T t1Re = re[1] + re[2], t1Im = im[1] + im[2];
+				T t2Re = re[1] - re[2], t2Im = im[1] - im[2];
+				T mRe = re[0] - t1Re * 0.5f, mIm = im[0] - t1Im * 0.5f;
+				// -i * sin(60) * t2
+				T nRe = t2Im * sin60, nIm = t2Re * -sin60;
+
+				re[0] = re[0] + t1Re; im[0] = im[0] + t1Im;
+				re[1] = mRe + nRe; im[1] = mIm + nIm;
+				re[2] = mRe - nRe; im[2] = mIm - nIm;
+			}
+			else if constexpr (P == 4)
+			{
+				T t0Re = re[0] + re[2], t0Im = im[0] + im[2];
+				T t1Re = re[0] - re[2], t1Im = im[0] - im[2];
+				T t2Re = re[1] + re[3], t2Im = im[1] + im[3];
+				// -i * (x1 - x3)
+				T t3Re = im[1] - im[3], t3Im = re[3] - re[1];
+
+				re[0] = t0Re + t2Re; im[0] = t0Im + t2Im;
+				re[2] = t0Re - t2Re; im[2] = t0Im - t2Im;
+				re[1] = t1Re + t3Re; im[1] = t1Im + t3Im;
+				re[3] = t1Re - t3Re; im[3] = t1Im - t3Im;
+			}
+			else if constexpr (P == 5)
+			{
+				const float cos72 = 0.309016994374947424102293f, cos144 = -0.809016994374947424102293f;
+				const float sin72 = 0.951056516295153572116439f, sin144 = 0.587785252292473129168706f;
+
+				T t1Re = re[1] + re[4], t1Im = im[1] + im[4];
+				T t2Re = re[2] + re[3], t2Im = im[2] + im[3];
+				T t3Re = re[1] - re[4], t3Im = im[1] - im[4];
+				T t4Re = re[2] - re[3], t4Im = im[2] - im[3];
+
+				T b1Re = re[0] + t1Re * cos72 + t2Re * cos144, b1Im = im[0] + t1Im * cos72 + t2Im * cos144;
+				T b2Re = re[0] + t1Re * cos144 + t2Re * cos72, b2Im = im[0] + t1Im * cos144 + t2Im * cos72;
+				// -i * (sin72 * t3 + sin144 * t4), and -i * (sin144 * t3 - sin72 * t4)
+				T d1Re = t3Im * sin72 + t4Im * sin144, d1Im = t3Re * -sin72 - t4Re * sin144;
+				T d2Re = t3Im * sin144 - t4Im * sin72, d2Im = t4Re * sin72 - t3Re * sin144;
+
+				re[0] = re[0] + t1Re + t2Re; im[0] = im[0] + t1Im + t2Im;
+				re[1] = b1Re + d1Re; im[1] = b1Im + d1Im;
+				re[4] = b1Re - d1Re; im[4] = b1Im - d1Im;
+				re[2] = b2Re + d2Re; im[2] = b2Im + d2Im;
+				re[3] = b2Re - d2Re; im[3] = b2Im - d2Im;
+			}
+		}
+
+		// The butterflies of one "q" of a Stockham stage, "W" lanes at a time, starting at k, returns where it stopped.
+		template<unsigned int P, class T, size_t W>
+		static size_t FFTStockhamLanes(
+			const float* srcReal, const float* srcImag, float* dstReal, float* dstImag,
+			const float* twiddleReal, const float* twiddleImag, size_t q, size_t m, size_t s, size_t k)
+		{
+			for (; k + W <= s; k += W)
+			{
+				T re[P], im[P];
+				for (unsigned int j = 0; j < P; ++j)
+				{
+					re[j] = LoadLanes<T>(&srcReal[k + s * (q + m * j)]);
+					im[j] = LoadLanes<T>(&srcImag[k + s * (q + m * j)]);
+				}
+
+				SmallDFT<P, T>(re, im);
+
+				StoreLanes<T>(&dstReal[k + s * (P * q)], re[0]);
+				StoreLanes<T>(&dstImag[k + s * (P * q)], im[0]);
+				for (unsigned int r = 1; r < P; ++r)
+				{
+					const float wRe = twiddleReal[q * (P - 1) + r - 1];
+					const float wIm = twiddleImag[q * (P - 1) + r - 1];
+					T yRe = re[r] * wRe - im[r] * wIm;
+					T yIm = re[r] * wIm + im[r] * wRe;
+					StoreLanes<T>(&dstReal[k + s * (P * q + r)], yRe);
+					StoreLanes<T>(&dstImag[k + s * (P * q + r)], yIm);
+				}
+			}
+			return k;
+		}
 	public:
 		static void GetBufferRMSAndPeakMultiChannel(const std::vector<std::vector<float>>& src, size_t length, std::vector<float>& rmsOut, std::vector<float>& peakOut)
 		{
@@ -68,7 +393,7 @@ namespace DigiDAW::Core::Detail
 				size_t i;
 				for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
 				{
-					simdpp::float32v xmmA = simdpp::load(&src[channel][i]);
+					simdpp::float32v xmmA = simdpp::load_u(&src[channel][i]); // The lookback buffers are std::vectors, so they aren't aligned.
 					xmmA = xmmA * xmmA; // Mean square
 					xmmA = 10.0f * Log10Vector(xmmA);
 					xmmA = simdpp::blend(xmmA, min, xmmA > min);
@@ -117,6 +442,19 @@ namespace DigiDAW::Core::Detail
 				dst[i + dstOffset] = src[i + srcOffset];
 		}
 
+		// The same as CopyBuffer, except the offsets don't need to keep the buffers aligned to the vector size.
+		static void CopyBufferUnaligned(float* src, float* dst, size_t srcOffset, size_t dstOffset, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = simdpp::load_u(&src[i + srcOffset]);
+				simdpp::store_u(&dst[i + dstOffset], xmmA);
+			}
+			for (; i < length; ++i) // Copy the remaining length using scalar code.
+				dst[i + dstOffset] = src[i + srcOffset];
+		}
+
 		static void AccumulateBuffer(float* src, float* dst, size_t srcOffset, size_t dstOffset, size_t length)
 		{
 			size_t i;
@@ -130,6 +468,572 @@ namespace DigiDAW::Core::Detail
 				dst[i + dstOffset] += src[i + srcOffset];
 		}
 
+		// The same as AccumulateBuffer, except the offsets don't need to keep the buffers aligned to the vector size.
+		static void AccumulateBufferUnaligned(float* src, float* dst, size_t srcOffset, size_t dstOffset, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = simdpp::load_u(&src[i + srcOffset]);
+				simdpp::float32v xmmB = simdpp::load_u(&dst[i + dstOffset]);
+				simdpp::store_u(&dst[i + dstOffset], xmmA + xmmB);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				dst[i + dstOffset] += src[i + srcOffset];
+		}
+
+		// The AudioBufferView versions of the functions above, these use aligned loads and stores whenever the views are aligned.
+
+		static void SetBuffer(const Audio::AudioBufferView& dst, float value)
+		{
+			for (unsigned int channel = 0; channel < dst.GetChannelCount(); ++channel)
+			{
+				if (dst.IsAligned()) SetChannel<true>(dst.GetChannel(channel), value, dst.GetFrameCount());
+				else SetChannel<false>(dst.GetChannel(channel), value, dst.GetFrameCount());
+			}
+		}
+
+		// Copies every channel that both buffers have.
+		static void CopyBuffer(const Audio::AudioBufferView& src, const Audio::AudioBufferView& dst)
+		{
+			const bool aligned = src.IsAligned() && dst.IsAligned();
+			const size_t length = std::min(src.GetFrameCount(), dst.GetFrameCount());
+			for (unsigned int channel = 0; channel < std::min(src.GetChannelCount(), dst.GetChannelCount()); ++channel)
+			{
+				if (aligned) CopyChannel<true>(src.GetChannel(channel), dst.GetChannel(channel), length);
+				else CopyChannel<false>(src.GetChannel(channel), dst.GetChannel(channel), length);
+			}
+		}
+
+		// dst[dstChannel] += src[srcChannel]
+		static void AccumulateBuffer(
+			const Audio::AudioBufferView& src, unsigned int srcChannel, 
+			const Audio::AudioBufferView& dst, unsigned int dstChannel)
+		{
+			const size_t length = std::min(src.GetFrameCount(), dst.GetFrameCount());
+			if (src.IsAligned() && dst.IsAligned()) AccumulateChannel<true>(src.GetChannel(srcChannel), dst.GetChannel(dstChannel), length);
+			else AccumulateChannel<false>(src.GetChannel(srcChannel), dst.GetChannel(dstChannel), length);
+		}
+
+		static void MulScalarBuffer(float scalar, const Audio::AudioBufferView& buffer)
+		{
+			for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+			{
+				if (buffer.IsAligned()) MulScalarChannel<true>(scalar, buffer.GetChannel(channel), buffer.GetFrameCount());
+				else MulScalarChannel<false>(scalar, buffer.GetChannel(channel), buffer.GetFrameCount());
+			}
+		}
+
+		/*
+		 * Delays the frames [firstFrame, firstFrame + length) of a block that starts at writePosition in the circular buffer "delayLine"
+		 * (which has a power of two size, that's at least the delay plus the block size).
+		 * Frames delayed from earlier blocks are read from the circular buffer, and frames delayed from this block are read straight
+		 * from src, so different frame ranges of the same block can be delayed at the same time.
+		 * The write position has to be moved forward by the block size once every frame range has been delayed.
+		 */
+		static void DelayBuffer(float* src, float* dst, float* delayLine, size_t delayLineSize, size_t writePosition, size_t delay, 
+			size_t firstFrame, size_t length)
+		{
+			const size_t mask = delayLineSize - 1;
+
+			// Write the new samples (in at most two contiguous blocks, as the write can wrap around the end)
+			size_t start = (writePosition + firstFrame) & mask;
+			size_t firstBlock = std::min(length, delayLineSize - start);
+			CopyBufferUnaligned(src, delayLine, firstFrame, start, firstBlock);
+			CopyBufferUnaligned(src, delayLine, firstFrame + firstBlock, 0, length - firstBlock);
+
+			// Read the samples delayed from earlier blocks (same as above)
+			const size_t fromDelayLine = std::min(length, delay > firstFrame ? delay - firstFrame : 0);
+			start = (writePosition + firstFrame - delay) & mask;
+			firstBlock = std::min(fromDelayLine, delayLineSize - start);
+			CopyBufferUnaligned(delayLine, dst, start, firstFrame, firstBlock);
+			CopyBufferUnaligned(delayLine, dst, 0, firstFrame + firstBlock, fromDelayLine - firstBlock);
+
+			// And the rest from this block
+			CopyBufferUnaligned(src, dst, firstFrame + fromDelayLine - delay, firstFrame + fromDelayLine, length - fromDelayLine);
+		}
+
+		// Copies "nChannels" channels (starting at "firstChannel") of a planar buffer into a buffer 
+		// where each frame is "laneWidth" floats long, so that each channel becomes a lane of a vector.
+		// (lanes without a channel are set to zero)
+		static void InterleaveLanes(const Audio::AudioBufferView& src, float* dst, unsigned int firstChannel, unsigned int nChannels, unsigned int laneWidth)
+		{
+			const size_t nFrames = src.GetFrameCount();
+			if (nChannels < laneWidth) std::fill_n(dst, nFrames * laneWidth, 0.0f);
+			for (unsigned int lane = 0; lane < nChannels; ++lane)
+			{
+				const float* channel = src.GetChannel(firstChannel + lane);
+				for (size_t frame = 0; frame < nFrames; ++frame)
+					dst[frame * laneWidth + lane] = channel[frame];
+			}
+		}
+
+		// The inverse of InterleaveLanes.
+		static void DeinterleaveLanes(float* src, const Audio::AudioBufferView& dst, unsigned int firstChannel, unsigned int nChannels, unsigned int laneWidth)
+		{
+			const size_t nFrames = dst.GetFrameCount();
+			for (unsigned int lane = 0; lane < nChannels; ++lane)
+			{
+				float* channel = dst.GetChannel(firstChannel + lane);
+				for (size_t frame = 0; frame < nFrames; ++frame)
+					channel[frame] = src[frame * laneWidth + lane];
+			}
+		}
+
+		// Runs a single biquad filter (Transposed Direct Form II) over a lane interleaved buffer (see InterleaveLanes), 
+		// filtering all "N" lanes at the same time.
+		// "coefficients" holds b0, b1, b2, a1, a2 (N floats each), and "state" holds z1, z2 (N floats each).
+		// For the first "rampFrames" frames "coefficientDeltas" (same layout as the coefficients) is added to the coefficients every frame.
+		template<unsigned N>
+		static void ProcessBiquadLanes(float* buffer, size_t nFrames, float* coefficients, float* coefficientDeltas, size_t rampFrames, float* state)
+		{
+			simdpp::float32<N> b0 = simdpp::load_u(&coefficients[0 * N]);
+			simdpp::float32<N> b1 = simdpp::load_u(&coefficients[1 * N]);
+			simdpp::float32<N> b2 = simdpp::load_u(&coefficients[2 * N]);
+			simdpp::float32<N> a1 = simdpp::load_u(&coefficients[3 * N]);
+			simdpp::float32<N> a2 = simdpp::load_u(&coefficients[4 * N]);
+
+			simdpp::float32<N> z1 = simdpp::load_u(&state[0 * N]);
+			simdpp::float32<N> z2 = simdpp::load_u(&state[1 * N]);
+
+			size_t frame = 0;
+			if (rampFrames > 0)
+			{
+				simdpp::float32<N> db0 = simdpp::load_u(&coefficientDeltas[0 * N]);
+				simdpp::float32<N> db1 = simdpp::load_u(&coefficientDeltas[1 * N]);
+				simdpp::float32<N> db2 = simdpp::load_u(&coefficientDeltas[2 * N]);
+				simdpp::float32<N> da1 = simdpp::load_u(&coefficientDeltas[3 * N]);
+				simdpp::float32<N> da2 = simdpp::load_u(&coefficientDeltas[4 * N]);
+
+				for (; frame < std::min(rampFrames, nFrames); ++frame)
+				{
+					b0 = b0 + db0; b1 = b1 + db1; b2 = b2 + db2;
+					a1 = a1 + da1; a2 = a2 + da2;
+
+					simdpp::float32<N> x = simdpp::load_u(&buffer[frame * N]);
+					simdpp::float32<N> y = b0 * x + z1; // y = b0 * x + z1
+					z1 = b1 * x - a1 * y + z2; // z1 = b1 * x - a1 * y + z2
+					z2 = b2 * x - a2 * y; // z2 = b2 * x - a2 * y
+					simdpp::store_u(&buffer[frame * N], y);
+				}
+			}
+			for (; frame < nFrames; ++frame)
+			{
+				simdpp::float32<N> x = simdpp::load_u(&buffer[frame * N]);
+				simdpp::float32<N> y = b0 * x + z1;
+				z1 = b1 * x - a1 * y + z2;
+				z2 = b2 * x - a2 * y;
+				simdpp::store_u(&buffer[frame * N], y);
+			}
+
+			simdpp::store_u(&coefficients[0 * N], b0);
+			simdpp::store_u(&coefficients[1 * N], b1);
+			simdpp::store_u(&coefficients[2 * N], b2);
+			simdpp::store_u(&coefficients[3 * N], a1);
+			simdpp::store_u(&coefficients[4 * N], a2);
+
+			simdpp::store_u(&state[0 * N], z1);
+			simdpp::store_u(&state[1 * N], z2);
+		}
+
+		static void ProcessBiquadLanes(unsigned int laneWidth, float* buffer, size_t nFrames, float* coefficients, float* coefficientDeltas, size_t rampFrames, float* state)
+		{
+			switch (laneWidth)
+			{
+			case 4: ProcessBiquadLanes<4>(buffer, nFrames, coefficients, coefficientDeltas, rampFrames, state); break;
+			case 8: ProcessBiquadLanes<8>(buffer, nFrames, coefficients, coefficientDeltas, rampFrames, state); break;
+			case 16: ProcessBiquadLanes<16>(buffer, nFrames, coefficients, coefficientDeltas, rampFrames, state); break;
+			default: break;
+			}
+		}
+
+		// Gets the largest squared sample of every channel of a buffer, for every frame.
+		static void GetLinkedSquaredLevel(const Audio::AudioBufferView& src, float* dst)
+		{
+			if (src.IsAligned()) GetLinkedSquaredLevelChannels<true>(src, dst);
+			else GetLinkedSquaredLevelChannels<false>(src, dst);
+		}
+
+		// The amount of denormal samples in every channel of a buffer.
+		static size_t CountDenormals(const Audio::AudioBufferView& buffer)
+		{
+			size_t count = 0;
+			for (unsigned int channel = 0; channel < buffer.GetChannelCount(); ++channel)
+			{
+				if (buffer.IsAligned()) count += CountDenormalsChannel<true>(buffer.GetChannel(channel), buffer.GetFrameCount());
+				else count += CountDenormalsChannel<false>(buffer.GetChannel(channel), buffer.GetFrameCount());
+			}
+			return count;
+		}
+
+		/*
+		 * Converts squared levels to the gain reduction (in dB) of a soft knee compressor/expander, in place.
+		 * 
+		 * With d = level (dB) - threshold, and a soft knee of width W, the compressor curve is
+		 * f(d) = clamp(d + W / 2, 0, W)^2 / (2 * W) + max(d - W / 2, 0)
+		 * which is 0 below the knee, quadratic inside of it, and linear above it, so it can be computed without branching.
+		 * The gain reduction is then compressionSlope * f(d) - expansionSlope * f(-d), limited to the range.
+		 */
+		static void ComputeGainReduction(float* buffer, size_t length, 
+			float threshold, float knee, float compressionSlope, float expansionSlope, float range)
+		{
+			const float halfKnee = std::max(knee, 1.0e-3f) * 0.5f;
+			const float rcpTwoKnee = 1.0f / (4.0f * halfKnee);
+			const float minimumLevel = 1.0e-30f; // Avoid log(0)
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v level = simdpp::load_u(&buffer[i]);
+				level = simdpp::max(level, simdpp::splat<simdpp::float32v>(minimumLevel));
+				simdpp::float32v d = 10.0f * Log10Vector(level) - threshold; // The level is squared, so 10 * log10 instead of 20 * log10
+
+				simdpp::float32v kneeAbove = simdpp::min(simdpp::max(d + halfKnee, simdpp::splat<simdpp::float32v>(0.0f)), 
+					simdpp::splat<simdpp::float32v>(2.0f * halfKnee));
+				simdpp::float32v above = kneeAbove * kneeAbove * rcpTwoKnee + simdpp::max(d - halfKnee, simdpp::splat<simdpp::float32v>(0.0f));
+
+				simdpp::float32v kneeBelow = simdpp::min(simdpp::max(halfKnee - d, simdpp::splat<simdpp::float32v>(0.0f)),
+					simdpp::splat<simdpp::float32v>(2.0f * halfKnee));
+				simdpp::float32v below = kneeBelow * kneeBelow * rcpTwoKnee + simdpp::max((-halfKnee) - d, simdpp::splat<simdpp::float32v>(0.0f));
+
+				simdpp::float32v gainReduction = above * compressionSlope - below * expansionSlope;
+				simdpp::store_u(&buffer[i], simdpp::max(gainReduction, simdpp::splat<simdpp::float32v>(-range)));
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+			{
+				float d = 10.0f * std::log10(std::max(buffer[i], minimumLevel)) - threshold;
+				float kneeAbove = std::clamp(d + halfKnee, 0.0f, 2.0f * halfKnee);
+				float above = kneeAbove * kneeAbove * rcpTwoKnee + std::max(d - halfKnee, 0.0f);
+				float kneeBelow = std::clamp(halfKnee - d, 0.0f, 2.0f * halfKnee);
+				float below = kneeBelow * kneeBelow * rcpTwoKnee + std::max(-d - halfKnee, 0.0f);
+				buffer[i] = std::max(above * compressionSlope - below * expansionSlope, -range);
+			}
+		}
+
+		// Converts a buffer of decibels to amplitudes (10^((dB + offset) / 20)), in place.
+		static void DecibelToAmplitudeBuffer(float* buffer, size_t length, float offset)
+		{
+			const float dbToLn = 2.30258509299f / 20.0f; // ln(10) / 20
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = simdpp::load_u(&buffer[i]);
+				simdpp::store_u(&buffer[i], ExpVector((xmmA + offset) * dbToLn));
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				buffer[i] = std::exp((buffer[i] + offset) * dbToLn);
+		}
+
+		// dst[i + dstOffset] *= src[i + srcOffset]
+		static void MulBuffer(float* src, float* dst, size_t srcOffset, size_t dstOffset, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmA = simdpp::load_u(&src[i + srcOffset]);
+				simdpp::float32v xmmB = simdpp::load_u(&dst[i + dstOffset]);
+				simdpp::store_u(&dst[i + dstOffset], xmmA * xmmB);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				dst[i + dstOffset] *= src[i + srcOffset];
+		}
+
+		/*
+		 * One radix P (2, 3, 4 or 5) stage of a Stockham autosort FFT, on split complex buffers (real and imaginary parts in separate arrays).
+		 * 
+		 * For every q in [0, m) and k in [0, s), the P values src[k + s * (q + m * j)] go through a DFT of size P,
+		 * and output r is multiplied by the twiddle factor (twiddle[q * (P - 1) + r - 1]) and written to dst[k + s * (P * q + r)].
+		 * The k loop is contiguous, so it's vectorized (stages with less than 4 values of k use scalar code).
+		 */
+		template<unsigned int P>
+		static void FFTStockhamStage(
+			const float* srcReal, const float* srcImag, float* dstReal, float* dstImag,
+			const float* twiddleReal, const float* twiddleImag, size_t m, size_t s)
+		{
+			for (size_t q = 0; q < m; ++q)
+			{
+				size_t k = 0;
+				if (s >= SIMDPP_FAST_FLOAT32_SIZE)
+					k = FFTStockhamLanes<P, simdpp::float32v, SIMDPP_FAST_FLOAT32_SIZE>(
+						srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, q, m, s, k);
+				if (s - k >= 4)
+					k = FFTStockhamLanes<P, simdpp::float32<4>, 4>(
+						srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, q, m, s, k);
+				FFTStockhamLanes<P, float, 1>(srcReal, srcImag, dstReal, dstImag, twiddleReal, twiddleImag, q, m, s, k);
+			}
+		}
+
+		/*
+		 * The first stage (a stride of 1) of a Stockham FFT, for radix 2, 3 or 4.
+		 * 
+		 * With a stride of 1 the k loop of FFTStockhamStage is a single value, so this is vectorized over q instead,
+		 * which means the twiddle factors have to be transposed (twiddle[(r - 1) * m + q]), and the outputs of every butterfly are interleaved
+		 * with a packed store (so "dstReal" and "dstImag" must be aligned to the vector size).
+		 */
+		template<unsigned int P>
+		static void FFTStockhamFirstStage(
+			const float* srcReal, const float* srcImag, float* dstReal, float* dstImag,
+			const float* twiddleReal, const float* twiddleImag, size_t m)
+		{
+			static_assert(P >= 2 && P <= 4, "Only radix 2, 3 and 4 can be stored packed");
+
+			size_t q;
+			for (q = 0; q + SIMDPP_FAST_FLOAT32_SIZE <= m; q += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v re[P], im[P];
+				for (unsigned int j = 0; j < P; ++j)
+				{
+					re[j] = simdpp::load_u(&srcReal[q + m * j]);
+					im[j] = simdpp::load_u(&srcImag[q + m * j]);
+				}
+
+				SmallDFT<P, simdpp::float32v>(re, im);
+
+				for (unsigned int r = 1; r < P; ++r)
+				{
+					simdpp::float32v wRe = simdpp::load_u(&twiddleReal[(r - 1) * m + q]);
+					simdpp::float32v wIm = simdpp::load_u(&twiddleImag[(r - 1) * m + q]);
+					simdpp::float32v yRe = re[r] * wRe - im[r] * wIm;
+					simdpp::float32v yIm = re[r] * wIm + im[r] * wRe;
+					re[r] = yRe;
+					im[r] = yIm;
+				}
+
+				if constexpr (P == 2)
+				{
+					simdpp::store_packed2(&dstReal[P * q], re[0], re[1]);
+					simdpp::store_packed2(&dstImag[P * q], im[0], im[1]);
+				}
+				else if constexpr (P == 3)
+				{
+					simdpp::store_packed3(&dstReal[P * q], re[0], re[1], re[2]);
+					simdpp::store_packed3(&dstImag[P * q], im[0], im[1], im[2]);
+				}
+				else
+				{
+					simdpp::store_packed4(&dstReal[P * q], re[0], re[1], re[2], re[3]);
+					simdpp::store_packed4(&dstImag[P * q], im[0], im[1], im[2], im[3]);
+				}
+			}
+			for (; q < m; ++q) // Calculate the remaining butterflies using scalar code.
+			{
+				float re[P], im[P];
+				for (unsigned int j = 0; j < P; ++j)
+				{
+					re[j] = srcReal[q + m * j];
+					im[j] = srcImag[q + m * j];
+				}
+
+				SmallDFT<P, float>(re, im);
+
+				dstReal[P * q] = re[0];
+				dstImag[P * q] = im[0];
+				for (unsigned int r = 1; r < P; ++r)
+				{
+					const float wRe = twiddleReal[(r - 1) * m + q];
+					const float wIm = twiddleImag[(r - 1) * m + q];
+					dstReal[P * q + r] = re[r] * wRe - im[r] * wIm;
+					dstImag[P * q + r] = re[r] * wIm + im[r] * wRe;
+				}
+			}
+		}
+
+		// acc += a * b, for split complex buffers.
+		static void ComplexMultiplyAccumulate(
+			const float* aReal, const float* aImag, const float* bReal, const float* bImag, 
+			float* accReal, float* accImag, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmARe = simdpp::load_u(&aReal[i]);
+				simdpp::float32v xmmAIm = simdpp::load_u(&aImag[i]);
+				simdpp::float32v xmmBRe = simdpp::load_u(&bReal[i]);
+				simdpp::float32v xmmBIm = simdpp::load_u(&bImag[i]);
+				simdpp::float32v xmmAccRe = simdpp::load_u(&accReal[i]);
+				simdpp::float32v xmmAccIm = simdpp::load_u(&accImag[i]);
+				simdpp::store_u(&accReal[i], xmmAccRe + xmmARe * xmmBRe - xmmAIm * xmmBIm);
+				simdpp::store_u(&accImag[i], xmmAccIm + xmmARe * xmmBIm + xmmAIm * xmmBRe);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+			{
+				accReal[i] += aReal[i] * bReal[i] - aImag[i] * bImag[i];
+				accImag[i] += aReal[i] * bImag[i] + aImag[i] * bReal[i];
+			}
+		}
+
+		// dst[i] = max(10 * log10(real[i]^2 + imag[i]^2) + offset, minimum), the power of a split complex spectrum in decibels.
+		static void PowerSpectrumDecibel(const float* real, const float* imag, float* dst, size_t length, float offset, float minimum)
+		{
+			simdpp::float32v min = simdpp::splat(minimum);
+
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v xmmRe = simdpp::load_u(&real[i]);
+				simdpp::float32v xmmIm = simdpp::load_u(&imag[i]);
+				simdpp::float32v xmmA = xmmRe * xmmRe + xmmIm * xmmIm;
+				xmmA = 10.0f * Log10Vector(xmmA) + offset;
+				simdpp::store_u(&dst[i], simdpp::blend(xmmA, min, xmmA > min));
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+				dst[i] = std::max(10.0f * std::log10(real[i] * real[i] + imag[i] * imag[i]) + offset, minimum);
+		}
+
+		/*
+		 * Direct (time domain) convolution, dst[i] += sum(kernel[k] * src[i - k]) for k in [0, kernelLength).
+		 * "src" has to have kernelLength - 1 samples of history before it.
+		 * 
+		 * This is vectorized over the output samples, so every tap is a single multiply-add of a vector of outputs.
+		 */
+		static void AddConvolution(const float* src, const float* kernel, size_t kernelLength, float* dst, size_t length)
+		{
+			size_t i;
+			for (i = 0; i + SIMDPP_FAST_FLOAT32_SIZE <= length; i += SIMDPP_FAST_FLOAT32_SIZE)
+			{
+				simdpp::float32v acc = simdpp::load_u(&dst[i]);
+				for (size_t k = 0; k < kernelLength; ++k)
+				{
+					simdpp::float32v xmmA = simdpp::load_u(src + i - k);
+					acc = acc + xmmA * kernel[k];
+				}
+				simdpp::store_u(&dst[i], acc);
+			}
+			for (; i < length; ++i) // Calculate the remaining length using scalar code.
+			{
+				float acc = dst[i];
+				for (size_t k = 0; k < kernelLength; ++k)
+					acc += kernel[k] * *(src + i - k);
+				dst[i] = acc;
+			}
+		}
+
+		/*
+		 * Mixes the channels of "src" into the channels of "dst" through a sparse gain matrix, 
+		 * dst[destinations[e]] += gain[e] * src[sources[e]] for every entry e.
+		 * 
+		 * The entries have to be sorted by their source channel, so every block of a source channel is only loaded once 
+		 * and then fanned out to all of its destinations.
+		 * The gains ramp linearly from "gains" (at the first frame) to "targetGains" (at the frame after the last one), 
+		 * so changing the gains doesn't click.
+		 */
+		static void MixSparseMatrix(
+			const Audio::AudioBufferView& src, const Audio::AudioBufferView& dst,
+			const unsigned int* sources, const unsigned int* destinations, const float* gains, const float* targetGains, 
+			size_t nEntries)
+		{
+			MixSparseMatrix(src, dst, sources, destinations, gains, targetGains, nEntries, 0, std::min(src.GetFrameCount(), dst.GetFrameCount()));
+		}
+
+		// The same as above, for the frames [firstFrame, firstFrame + src.GetFrameCount()) of a block of "rampFrames" frames, 
+		// which gives exactly the same results as mixing the whole block at once (so a block can be split up between threads).
+		static void MixSparseMatrix(
+			const Audio::AudioBufferView& src, const Audio::AudioBufferView& dst,
+			const unsigned int* sources, const unsigned int* destinations, const float* gains, const float* targetGains, 
+			size_t nEntries, size_t firstFrame, size_t rampFrames)
+		{
+			if (src.IsAligned() && dst.IsAligned())
+				MixSparseMatrixChannels<true>(src, dst, sources, destinations, gains, targetGains, nEntries, firstFrame, rampFrames);
+			else
+				MixSparseMatrixChannels<false>(src, dst, sources, destinations, gains, targetGains, nEntries, firstFrame, rampFrames);
+		}
+
+		/*
+		 * The same as MixSparseMatrix, except it sums into a double precision buffer (where each channel is "dstStride" doubles apart,
+		 * and aligned to 64 bytes), so summing lots of sources doesn't build up rounding error.
+		 * The source samples are converted to double, and the gain ramps are computed in double precision too.
+		 */
+		static void MixSparseMatrixDouble(
+			const Audio::AudioBufferView& src, double* dst, size_t dstStride,
+			const unsigned int* sources, const unsigned int* destinations, const float* gains, const float* targetGains,
+			size_t nEntries)
+		{
+			MixSparseMatrixDouble(src, dst, dstStride, sources, destinations, gains, targetGains, nEntries, 0, src.GetFrameCount());
+		}
+
+		// The same as above, for a part of a block (see MixSparseMatrix).
+		static void MixSparseMatrixDouble(
+			const Audio::AudioBufferView& src, double* dst, size_t dstStride,
+			const unsigned int* sources, const unsigned int* destinations, const float* gains, const float* targetGains,
+			size_t nEntries, size_t firstFrame, size_t rampFrames)
+		{
+			alignas(64) static const double frameOffsets[doubleWidth] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+			const float64d offsets = simdpp::load(frameOffsets);
+			const size_t nFrames = src.GetFrameCount();
+			const double rcpFrames = 1.0 / static_cast<double>(rampFrames);
+
+			size_t i;
+			for (i = 0; i + doubleWidth <= nFrames; i += doubleWidth)
+			{
+				const float64d frame = offsets + static_cast<double>(firstFrame + i);
+
+				size_t e = 0;
+				while (e < nEntries)
+				{
+					const unsigned int source = sources[e];
+					const float32d xmmSource = simdpp::load_u(&src.GetChannel(source)[i]);
+					const float64d xmmA = simdpp::to_float64(xmmSource);
+					for (; e < nEntries && sources[e] == source; ++e)
+					{
+						const double gain = static_cast<double>(gains[e]);
+						const double delta = (static_cast<double>(targetGains[e]) - gain) * rcpFrames;
+						float64d xmmGain = frame * delta + gain;
+
+						double* dstChannel = &dst[destinations[e] * dstStride + i];
+						float64d xmmB = simdpp::load(dstChannel);
+						simdpp::store(dstChannel, xmmB + xmmA * xmmGain);
+					}
+				}
+			}
+			for (; i < nFrames; ++i) // Calculate the remaining length using scalar code.
+			{
+				for (size_t e = 0; e < nEntries; ++e)
+				{
+					const double gain = static_cast<double>(gains[e]);
+					const double delta = (static_cast<double>(targetGains[e]) - gain) * rcpFrames;
+					dst[destinations[e] * dstStride + i] += 
+						static_cast<double>(src.GetChannel(sources[e])[i]) * (gain + delta * static_cast<double>(firstFrame + i));
+				}
+			}
+		}
+
+		// Rounds a double precision buffer (see MixSparseMatrixDouble) back to floats, for every channel of "dst".
+		static void ConvertDoubleBuffer(const double* src, size_t srcStride, const Audio::AudioBufferView& dst)
+		{
+			const size_t nFrames = dst.GetFrameCount();
+			for (unsigned int channel = 0; channel < dst.GetChannelCount(); ++channel)
+			{
+				const double* srcChannel = &src[channel * srcStride];
+				float* dstChannel = dst.GetChannel(channel);
+
+				size_t i;
+				for (i = 0; i + doubleWidth <= nFrames; i += doubleWidth)
+				{
+					float64d xmmA = simdpp::load(&srcChannel[i]);
+					float32d xmmB = simdpp::to_float32(xmmA);
+					simdpp::store_u(&dstChannel[i], xmmB);
+				}
+				for (; i < nFrames; ++i) // Convert the remaining length using scalar code.
+					dstChannel[i] = static_cast<float>(srcChannel[i]);
+			}
+		}
+
+		// channel *= gain, where the gain ramps linearly from "gain" to "targetGain" over the frames of the buffer.
+		static void MulScalarBufferRamp(float gain, float targetGain, const Audio::AudioBufferView& buffer, unsigned int channel)
+		{
+			if (gain == targetGain)
+			{
+				if (buffer.IsAligned()) MulScalarChannel<true>(gain, buffer.GetChannel(channel), buffer.GetFrameCount());
+				else MulScalarChannel<false>(gain, buffer.GetChannel(channel), buffer.GetFrameCount());
+			}
+			else
+			{
+				if (buffer.IsAligned()) MulScalarChannelRamp<true>(gain, targetGain, buffer.GetChannel(channel), buffer.GetFrameCount());
+				else MulScalarChannelRamp<false>(gain, targetGain, buffer.GetChannel(channel), buffer.GetFrameCount());
+			}
+		}
+
 		static void MulScalarBuffer(float scalar, float* buffer, size_t length, size_t offset)
 		{
 			size_t i;
@@ -0,0 +1,158 @@
+#include "digidaw/core/audio/devicecache.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace DigiDAW::Core::Audio
+{
+	void DeviceCache::Load()
+	{
+		supportedAPIs.clear();
+		devices.clear();
+
+		std::ifstream file(path);
+		if (!file) return;
+
+		std::string magic;
+		unsigned int version = 0;
+		if (!(file >> magic >> version) || magic != fileMagic || version != fileVersion) return;
+
+		// Anything that doesn't parse is skipped, and anything after an API that's no longer compiled in is dropped.
+		std::vector<RtAudio::Api> compiledAPIs;
+		RtAudio::getCompiledApi(compiledAPIs);
+
+		std::vector<RtAudio::Api> loadedAPIs;
+		std::unordered_map<std::string, std::vector<RtAudio::DeviceInfo>> loadedDevices;
+		std::vector<RtAudio::DeviceInfo>* apiDevices = nullptr;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string type;
+			if (!(stream >> type)) continue;
+
+			if (type == "api")
+			{
+				std::string apiName;
+				bool supported = false;
+				if (!(stream >> apiName >> supported)) return;
+
+				RtAudio::Api api = RtAudio::getCompiledApiByName(apiName);
+				if (std::find(compiledAPIs.begin(), compiledAPIs.end(), api) == compiledAPIs.end())
+				{
+					apiDevices = nullptr;
+					continue;
+				}
+
+				if (supported) loadedAPIs.push_back(api);
+				apiDevices = &loadedDevices[apiName];
+			}
+			else if (type == "device" && apiDevices)
+			{
+				RtAudio::DeviceInfo info;
+				std::size_t nSampleRates = 0;
+				if (!(stream >> info.probed >> info.outputChannels >> info.inputChannels >> info.duplexChannels
+					>> info.isDefaultOutput >> info.isDefaultInput >> info.preferredSampleRate >> info.nativeFormats >> nSampleRates))
+					return;
+
+				info.sampleRates = std::vector<unsigned int>(std::min<std::size_t>(nSampleRates, 64));
+				for (unsigned int& sampleRate : info.sampleRates)
+					if (!(stream >> sampleRate)) return;
+
+				// The name is the rest of the line (after the space that separates it).
+				stream.get();
+				std::getline(stream, info.name);
+				apiDevices->push_back(info);
+			}
+		}
+
+		supportedAPIs = std::move(loadedAPIs);
+		devices = std::move(loadedDevices);
+	}
+
+	void DeviceCache::SetPath(const std::filesystem::path& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->path = path;
+		if (!path.empty()) Load();
+	}
+
+	ReturnCode DeviceCache::Save()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (path.empty()) return ReturnCode::Success;
+
+		// Written under a temporary name first, so a file that's cut short never replaces the last one.
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::trunc);
+			if (!file) return ReturnCode::Error;
+
+			file << fileMagic << ' ' << fileVersion << '\n';
+			for (const auto& pair : devices)
+			{
+				const RtAudio::Api api = RtAudio::getCompiledApiByName(pair.first);
+				const bool supported = std::find(supportedAPIs.begin(), supportedAPIs.end(), api) != supportedAPIs.end();
+				file << "api " << pair.first << ' ' << supported << '\n';
+
+				for (const RtAudio::DeviceInfo& info : pair.second)
+				{
+					file << "device " << info.probed << ' ' << info.outputChannels << ' ' << info.inputChannels << ' ' << info.duplexChannels << ' '
+						<< info.isDefaultOutput << ' ' << info.isDefaultInput << ' ' << info.preferredSampleRate << ' ' << info.nativeFormats << ' '
+						<< info.sampleRates.size();
+					for (unsigned int sampleRate : info.sampleRates)
+						file << ' ' << sampleRate;
+
+					// Names can't hold a line break, as that would start a new entry.
+					std::string name = info.name;
+					std::replace(name.begin(), name.end(), '\n', ' ');
+					file << ' ' << name << '\n';
+				}
+			}
+			if (!file) return ReturnCode::Error;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		return error ? ReturnCode::Error : ReturnCode::Success;
+	}
+
+	bool DeviceCache::Find(RtAudio::Api api, std::vector<RtAudio::DeviceInfo>& devicesOut)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = devices.find(RtAudio::getApiName(api));
+		if (it == devices.end()) return false;
+
+		devicesOut = it->second;
+		return true;
+	}
+
+	void DeviceCache::Store(RtAudio::Api api, const std::vector<RtAudio::DeviceInfo>& apiDevices)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		devices[RtAudio::getApiName(api)] = apiDevices;
+	}
+
+	std::vector<RtAudio::Api> DeviceCache::GetSupportedAPIs()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return supportedAPIs;
+	}
+
+	void DeviceCache::SetSupportedAPIs(const std::vector<RtAudio::Api>& apis)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		supportedAPIs = apis;
+	}
+
+	bool DeviceCache::IsSameDevice(const RtAudio::DeviceInfo& a, const RtAudio::DeviceInfo& b)
+	{
+		return a.name == b.name && a.probed == b.probed &&
+			a.outputChannels == b.outputChannels && a.inputChannels == b.inputChannels && a.duplexChannels == b.duplexChannels &&
+			a.isDefaultOutput == b.isDefaultOutput && a.isDefaultInput == b.isDefaultInput &&
+			a.preferredSampleRate == b.preferredSampleRate && a.nativeFormats == b.nativeFormats && a.sampleRates == b.sampleRates;
+	}
+}
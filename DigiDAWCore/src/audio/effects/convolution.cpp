@@ -0,0 +1,367 @@
+#include "digidaw/core/audio/effects/convolution.h"
+
+#include "detail/simdhelper.h"
+#include "detail/fft.h"
+#include "detail/hash.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	Convolution::Engine::~Engine()
+	{
+		// Background jobs reference the stages, so they have to finish before anything is freed.
+		for (Stage& stage : stages)
+			if (stage.job.valid()) stage.job.wait();
+	}
+
+	Convolution::Convolution(bool zeroLatency, unsigned int headBlockSize)
+	{
+		this->zeroLatency = zeroLatency;
+		this->headBlockSize = std::max(std::bit_ceil(headBlockSize), 16u);
+		this->nChannels = 0;
+		this->sampleRate = 0;
+		this->routing = Routing::Mono;
+		this->impulseResponseHash = Detail::Hash::offsetBasis;
+		this->engineChanged = false;
+	}
+
+	Threading::ThreadPool& Convolution::GetBackgroundPool(unsigned int tailStage)
+	{
+		// Shared by every Convolution, leaving one hardware thread for the audio callback.
+		// Every tail stage has its own workers, otherwise the jobs of the short stages (with short deadlines)
+		// would get queued behind the jobs of the long stages, which can take much longer than a short block.
+		static const std::size_t nThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		static Threading::ThreadPool pools[maxTailStages] = {
+			{ nThreads, Threading::ThreadPriority::Priority::Low },
+			{ nThreads, Threading::ThreadPriority::Priority::Low },
+			{ nThreads, Threading::ThreadPriority::Priority::Low },
+			{ nThreads, Threading::ThreadPriority::Priority::Low }
+		};
+		return pools[std::min(tailStage, maxTailStages - 1)];
+	}
+
+	void Convolution::SetImpulseResponse(const std::vector<std::vector<float>>& impulseResponse, Routing routing)
+	{
+		std::uint64_t hash = Detail::Hash::Combine(Detail::Hash::offsetBasis, impulseResponse.size());
+		for (const std::vector<float>& channel : impulseResponse)
+			hash = Detail::Hash::Bytes(channel.data(), channel.size() * sizeof(float), Detail::Hash::Combine(hash, channel.size()));
+
+		std::unique_ptr<Engine> newEngine;
+		{
+			std::lock_guard<std::mutex> lock(engineMutex);
+			this->impulseResponse = impulseResponse;
+			this->routing = routing;
+			this->impulseResponseHash = hash;
+		}
+		newEngine = BuildEngine();
+
+		std::lock_guard<std::mutex> lock(engineMutex);
+		pendingEngine = std::move(newEngine); // Also frees the previous engine, if the audio thread gave it back.
+		engineChanged = true;
+	}
+
+	std::shared_ptr<Effect> Convolution::Clone()
+	{
+		std::shared_ptr<Convolution> convolution = std::make_shared<Convolution>(zeroLatency, headBlockSize);
+
+		std::lock_guard<std::mutex> lock(engineMutex);
+		convolution->impulseResponse = impulseResponse;
+		convolution->routing = routing;
+		convolution->impulseResponseHash = impulseResponseHash;
+		return convolution; // The engine is built when the copy is prepared.
+	}
+
+	std::uint64_t Convolution::GetStateHash()
+	{
+		std::uint64_t hash = Detail::Hash::Combine(Detail::Hash::offsetBasis, GetName());
+		hash = Detail::Hash::Combine(hash, zeroLatency);
+		hash = Detail::Hash::Combine(hash, headBlockSize);
+
+		std::lock_guard<std::mutex> lock(engineMutex);
+		hash = Detail::Hash::Combine(hash, routing);
+		return Detail::Hash::Combine(hash, impulseResponseHash);
+	}
+
+	std::unique_ptr<Convolution::Engine> Convolution::BuildEngine()
+	{
+		std::vector<std::vector<float>> impulseResponse;
+		Routing routing;
+		unsigned int nChannels;
+		{
+			std::lock_guard<std::mutex> lock(engineMutex);
+			impulseResponse = this->impulseResponse;
+			routing = this->routing;
+			nChannels = this->nChannels;
+		}
+
+		if (impulseResponse.empty() || nChannels == 0) return nullptr;
+
+		std::unique_ptr<Engine> newEngine = std::make_unique<Engine>();
+		newEngine->nChannels = nChannels;
+		newEngine->headBlockSize = headBlockSize;
+		newEngine->position = 0;
+
+		const unsigned int nImpulses = static_cast<unsigned int>(impulseResponse.size());
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+		{
+			if (routing == Routing::Matrix && nImpulses >= nChannels * nChannels)
+			{
+				for (unsigned int input = 0; input < nChannels; ++input)
+					newEngine->paths.push_back({ input, channel, channel * nChannels + input });
+			}
+			else
+			{
+				unsigned int impulse = (routing == Routing::Mono) ? 0 : channel % nImpulses;
+				newEngine->paths.push_back({ channel, channel, impulse });
+			}
+		}
+
+		// Without zero latency the impulse response is delayed by the head block size (the reported latency),
+		// after that both modes are the same, except the first head block (which is all zeros without zero latency).
+		const std::size_t offset = zeroLatency ? 0 : headBlockSize;
+		std::size_t length = 0;
+		for (const std::vector<float>& impulse : impulseResponse)
+			length = std::max(length, impulse.size() + offset);
+
+		auto getImpulse = [&](unsigned int impulse, std::size_t frame)
+			{
+				if (frame < offset || frame - offset >= impulseResponse[impulse].size()) return 0.0f;
+				return impulseResponse[impulse][frame - offset];
+			};
+
+		if (zeroLatency)
+		{
+			for (const Path& path : newEngine->paths)
+			{
+				std::vector<float> kernel(headBlockSize);
+				for (unsigned int frame = 0; frame < headBlockSize; ++frame)
+					kernel[frame] = getImpulse(path.impulse, frame);
+				newEngine->directKernels.push_back(kernel);
+			}
+			newEngine->history = std::vector<std::vector<float>>(nChannels, std::vector<float>(2 * headBlockSize - 1));
+		}
+
+		// The head stage starts right after the first head block, every tail stage starts at twice its block size.
+		std::size_t start = headBlockSize;
+		unsigned int blockSize = headBlockSize;
+		while (start < length)
+		{
+			const unsigned int nextBlockSize = blockSize * 8;
+			const std::size_t end = (blockSize >= maxBlockSize) ? length : std::min(length, 2 * static_cast<std::size_t>(nextBlockSize));
+
+			Stage stage;
+			stage.blockSize = blockSize;
+			stage.nPartitions = static_cast<unsigned int>((end - start + blockSize - 1) / blockSize);
+			stage.nBins = blockSize + 1;
+			stage.background = blockSize != headBlockSize;
+			stage.fft = std::make_shared<Detail::FFT>(2 * static_cast<std::size_t>(blockSize));
+			stage.spectrumPosition = 0;
+			stage.position = 0;
+
+			const std::size_t spectrumSize = 2 * static_cast<std::size_t>(stage.nBins);
+			const float scale = 1.0f / (2.0f * blockSize); // The inverse FFT isn't scaled, so it's done here instead.
+
+			std::vector<float> partition(2 * static_cast<std::size_t>(blockSize));
+			for (const Path& path : newEngine->paths)
+			{
+				std::vector<float> spectra(stage.nPartitions * spectrumSize);
+				for (unsigned int index = 0; index < stage.nPartitions; ++index)
+				{
+					// Zero padded to twice the block size for the overlap-save.
+					std::fill(partition.begin(), partition.end(), 0.0f);
+					for (unsigned int frame = 0; frame < blockSize; ++frame)
+						partition[frame] = getImpulse(path.impulse, start + static_cast<std::size_t>(index) * blockSize + frame) * scale;
+
+					float* spectrum = &spectra[index * spectrumSize];
+					stage.fft->Forward(partition.data(), spectrum, spectrum + stage.nBins);
+				}
+				stage.partitions.push_back(std::move(spectra));
+			}
+
+			stage.inputSpectra = std::vector<std::vector<float>>(nChannels, std::vector<float>(stage.nPartitions * spectrumSize));
+			stage.input = std::vector<std::vector<float>>(nChannels, std::vector<float>(blockSize));
+			stage.fftInput = std::vector<std::vector<float>>(nChannels, std::vector<float>(2 * static_cast<std::size_t>(blockSize)));
+			stage.output = std::vector<std::vector<float>>(nChannels, std::vector<float>(blockSize));
+			stage.pendingOutput = std::vector<std::vector<float>>(nChannels, std::vector<float>(blockSize));
+			stage.accumulator = std::vector<float>(spectrumSize);
+			stage.fftOutput = std::vector<float>(2 * static_cast<std::size_t>(blockSize));
+
+			newEngine->stages.push_back(std::move(stage));
+
+			start = end;
+			blockSize = nextBlockSize;
+		}
+
+		const std::size_t tailFrames = length + 2 * static_cast<std::size_t>(newEngine->stages.empty() ? headBlockSize : newEngine->stages.back().blockSize);
+		newEngine->tailFrames = static_cast<unsigned int>(std::min<std::size_t>(tailFrames, infiniteTail - 1));
+
+		return newEngine;
+	}
+
+	// Transforms the last two input blocks of a stage, and computes its next block of output.
+	void Convolution::ProcessStage(Engine& engine, Stage& stage)
+	{
+		const std::size_t spectrumSize = 2 * static_cast<std::size_t>(stage.nBins);
+
+		for (unsigned int input = 0; input < engine.nChannels; ++input)
+		{
+			float* spectrum = &stage.inputSpectra[input][stage.spectrumPosition * spectrumSize];
+			stage.fft->Forward(stage.fftInput[input].data(), spectrum, spectrum + stage.nBins);
+		}
+
+		std::vector<std::vector<float>>& output = stage.background ? stage.pendingOutput : stage.output;
+		for (unsigned int channel = 0; channel < engine.nChannels; ++channel)
+		{
+			float* accumulatorReal = stage.accumulator.data();
+			float* accumulatorImag = accumulatorReal + stage.nBins;
+			std::fill(stage.accumulator.begin(), stage.accumulator.end(), 0.0f);
+
+			for (std::size_t path = 0; path < engine.paths.size(); ++path)
+			{
+				if (engine.paths[path].output != channel) continue;
+
+				const std::vector<float>& inputSpectra = stage.inputSpectra[engine.paths[path].input];
+				const std::vector<float>& partitions = stage.partitions[path];
+
+				// Partition n is multiplied with the input from n blocks ago.
+				for (unsigned int partition = 0; partition < stage.nPartitions; ++partition)
+				{
+					unsigned int slot = (stage.spectrumPosition + stage.nPartitions - partition) % stage.nPartitions;
+					const float* inputSpectrum = &inputSpectra[slot * spectrumSize];
+					const float* partitionSpectrum = &partitions[partition * spectrumSize];
+					Detail::SimdHelper::ComplexMultiplyAccumulate(
+						inputSpectrum, inputSpectrum + stage.nBins,
+						partitionSpectrum, partitionSpectrum + stage.nBins,
+						accumulatorReal, accumulatorImag, stage.nBins);
+				}
+			}
+
+			// Only the second half is valid (overlap-save).
+			stage.fft->Inverse(accumulatorReal, accumulatorImag, stage.fftOutput.data());
+			Detail::SimdHelper::CopyBufferUnaligned(stage.fftOutput.data(), output[channel].data(), stage.blockSize, 0, stage.blockSize);
+		}
+
+		stage.spectrumPosition = (stage.spectrumPosition + 1) % stage.nPartitions;
+	}
+
+	// Called at the end of every head block.
+	void Convolution::ProcessBoundary(Engine& engine)
+	{
+		if (zeroLatency)
+		{
+			// Keep the last headBlockSize - 1 frames as history for the next block.
+			for (std::vector<float>& history : engine.history)
+				std::copy(history.begin() + headBlockSize, history.end(), history.begin());
+		}
+
+		for (std::size_t index = 0; index < engine.stages.size(); ++index)
+		{
+			Stage& stage = engine.stages[index];
+			if (stage.position < stage.blockSize) continue;
+			stage.position = 0;
+
+			if (stage.background && stage.job.valid())
+			{
+				// The job for the block that starts now, this only actually waits if the background workers are behind.
+				stage.job.wait();
+				std::swap(stage.output, stage.pendingOutput);
+			}
+
+			for (unsigned int input = 0; input < engine.nChannels; ++input)
+			{
+				std::vector<float>& fftInput = stage.fftInput[input];
+				std::copy(fftInput.begin() + stage.blockSize, fftInput.end(), fftInput.begin());
+				std::copy(stage.input[input].begin(), stage.input[input].end(), fftInput.begin() + stage.blockSize);
+			}
+
+			if (stage.background)
+				stage.job = GetBackgroundPool(static_cast<unsigned int>(index - 1)).Queue([&engine, &stage] { ProcessStage(engine, stage); });
+			else
+				ProcessStage(engine, stage);
+		}
+	}
+
+	// The blocks are always split up at the head block size, so the state doesn't depend on the maximum amount of frames.
+	void Convolution::Prepare(unsigned int nChannels, unsigned int /* maxFrames */, unsigned int sampleRate)
+	{
+		{
+			std::lock_guard<std::mutex> lock(engineMutex);
+			this->nChannels = nChannels;
+			this->sampleRate = sampleRate;
+		}
+
+		std::unique_ptr<Engine> newEngine = BuildEngine();
+
+		// Handed over like a new impulse response, as the audio threads can still be processing with the current engine
+		// (until then they pass the input through, if the amount of channels changed).
+		std::lock_guard<std::mutex> lock(engineMutex);
+		pendingEngine = std::move(newEngine);
+		engineChanged = true;
+	}
+
+	void Convolution::Process(const AudioBufferView& buffer)
+	{
+		const unsigned int nChannels = buffer.GetChannelCount();
+		const unsigned int nFrames = buffer.GetFrameCount();
+
+		if (engineChanged)
+		{
+			std::unique_lock<std::mutex> lock(engineMutex, std::try_to_lock);
+			if (lock.owns_lock())
+			{
+				// The old engine is left in pendingEngine, so it's freed by whoever sets the next impulse response.
+				std::swap(engine, pendingEngine);
+				engineChanged = false;
+			}
+		}
+
+		if (!engine || nChannels != engine->nChannels) return;
+
+		Engine& current = *engine;
+		unsigned int frame = 0;
+		while (frame < nFrames)
+		{
+			// Process up until the end of the current head block.
+			const unsigned int length = std::min(nFrames - frame, headBlockSize - current.position);
+
+			// Collect all of the input first, as the buffer is processed in place and outputs can depend on any input.
+			for (unsigned int input = 0; input < nChannels; ++input)
+			{
+				if (zeroLatency)
+					Detail::SimdHelper::CopyBufferUnaligned(buffer.GetChannel(input), current.history[input].data(), 
+						frame, headBlockSize - 1 + current.position, length);
+				for (Stage& stage : current.stages)
+					Detail::SimdHelper::CopyBufferUnaligned(buffer.GetChannel(input), stage.input[input].data(), frame, stage.position, length);
+			}
+
+			for (unsigned int channel = 0; channel < nChannels; ++channel)
+			{
+				std::fill_n(&buffer.GetChannel(channel)[frame], length, 0.0f);
+				for (Stage& stage : current.stages)
+					Detail::SimdHelper::AccumulateBufferUnaligned(stage.output[channel].data(), buffer.GetChannel(channel), 
+						stage.position, frame, length);
+			}
+
+			if (zeroLatency)
+			{
+				for (std::size_t path = 0; path < current.paths.size(); ++path)
+				{
+					Detail::SimdHelper::AddConvolution(
+						&current.history[current.paths[path].input][headBlockSize - 1 + current.position],
+						current.directKernels[path].data(), headBlockSize,
+						&buffer.GetChannel(current.paths[path].output)[frame], length);
+				}
+			}
+
+			for (Stage& stage : current.stages)
+				stage.position += length;
+			current.position += length;
+			frame += length;
+
+			if (current.position == headBlockSize)
+			{
+				current.position = 0;
+				ProcessBoundary(current);
+			}
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#include "digidaw/core/audio/effects/dynamics.h"
+
+#include "detail/simdhelper.h"
+#include "detail/hash.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	Dynamics::Dynamics()
+	{
+		this->compressionSlope = 0.0f;
+		this->expansionSlope = 0.0f;
+		this->attackCoefficient = 0.0f;
+		this->releaseCoefficient = 0.0f;
+		this->rmsCoefficient = 0.0f;
+		this->rmsState = 0.0f;
+		this->envelope = 0.0f;
+		this->sampleRate = 0;
+		this->parametersChanged = false;
+		this->gainReduction = 0.0f;
+	}
+
+	void Dynamics::SetParameters(const Parameters& parameters)
+	{
+		std::lock_guard<std::mutex> lock(parametersMutex);
+		this->parameters = parameters;
+		parametersChanged = true;
+	}
+
+	Dynamics::Parameters Dynamics::GetParameters()
+	{
+		std::lock_guard<std::mutex> lock(parametersMutex);
+		return parameters;
+	}
+
+	std::shared_ptr<Effect> Dynamics::Clone()
+	{
+		std::shared_ptr<Dynamics> dynamics = std::make_shared<Dynamics>();
+		dynamics->SetParameters(GetParameters());
+		return dynamics;
+	}
+
+	std::uint64_t Dynamics::GetStateHash()
+	{
+		const Parameters current = GetParameters();
+
+		std::uint64_t hash = Detail::Hash::Combine(Detail::Hash::offsetBasis, GetName());
+		hash = Detail::Hash::Combine(hash, current.mode);
+		hash = Detail::Hash::Combine(hash, current.detection);
+		for (float value : { current.threshold, current.ratio, current.knee, current.range,
+			current.attackMS, current.releaseMS, current.rmsWindowMS, current.makeupGain })
+			hash = Detail::Hash::Combine(hash, value);
+		return hash;
+	}
+
+	void Dynamics::UpdateCoefficients()
+	{
+		{
+			std::unique_lock<std::mutex> lock(parametersMutex, std::try_to_lock);
+			if (!lock.owns_lock())
+			{
+				parametersChanged = true; // Try again next time.
+				return;
+			}
+			currentParameters = parameters;
+		}
+
+		// The gate is just an expander with a very steep ratio (the range limits how far down it goes).
+		const float ratio = (currentParameters.mode == Mode::Gate) ? 1000.0f : std::max(currentParameters.ratio, 1.0f);
+		compressionSlope = (currentParameters.mode == Mode::Compressor) ? (1.0f / ratio) - 1.0f : 0.0f;
+		expansionSlope = (currentParameters.mode == Mode::Compressor) ? 0.0f : ratio - 1.0f;
+
+		// One-pole smoothing coefficients (the time it takes to reach ~63% of the target).
+		auto timeToCoefficient = [&](float timeMS)
+			{
+				float samples = std::max(timeMS, 0.01f) * 0.001f * static_cast<float>(std::max(sampleRate, 1u));
+				return std::exp(-1.0f / samples);
+			};
+		attackCoefficient = timeToCoefficient(currentParameters.attackMS);
+		releaseCoefficient = timeToCoefficient(currentParameters.releaseMS);
+		rmsCoefficient = timeToCoefficient(currentParameters.rmsWindowMS);
+	}
+
+	unsigned int Dynamics::GetTailFrames()
+	{
+		// Both one-pole smoothers are within 120dB (about 13.8 time constants) of where they settle.
+		const float settleMS = 13.8f * (std::max(currentParameters.attackMS, currentParameters.releaseMS) + currentParameters.rmsWindowMS);
+		return static_cast<unsigned int>(std::ceil(std::max(settleMS, 0.0f) * 0.001f * static_cast<float>(sampleRate)));
+	}
+
+	// The channels are linked, so the state is the same whatever the number of channels.
+	void Dynamics::Prepare(unsigned int /* nChannels */, unsigned int maxFrames, unsigned int sampleRate)
+	{
+		this->sampleRate = sampleRate;
+		gainBuffer = std::vector<float>(maxFrames);
+
+		rmsState = 0.0f;
+		envelope = 0.0f;
+
+		parametersChanged = false;
+		UpdateCoefficients();
+	}
+
+	void Dynamics::Process(const AudioBufferView& buffer)
+	{
+		const unsigned int nChannels = buffer.GetChannelCount();
+		const unsigned int nFrames = buffer.GetFrameCount();
+		if (nFrames > gainBuffer.size()) return;
+
+		if (parametersChanged.exchange(false))
+			UpdateCoefficients();
+
+		float* gain = gainBuffer.data();
+
+		// Detection
+		Detail::SimdHelper::GetLinkedSquaredLevel(buffer, gain);
+		if (currentParameters.detection == Detection::RMS)
+		{
+			for (unsigned int frame = 0; frame < nFrames; ++frame)
+			{
+				rmsState = gain[frame] + rmsCoefficient * (rmsState - gain[frame]);
+				gain[frame] = rmsState;
+			}
+		}
+
+		// Gain computer (level -> gain reduction in dB)
+		Detail::SimdHelper::ComputeGainReduction(gain, nFrames, 
+			currentParameters.threshold, currentParameters.knee, 
+			compressionSlope, expansionSlope, currentParameters.range);
+
+		// Ballistics, the attack is used whenever the gain is moving away from unity (the gain reduction is increasing).
+		for (unsigned int frame = 0; frame < nFrames; ++frame)
+		{
+			const float coefficient = (gain[frame] < envelope) ? attackCoefficient : releaseCoefficient;
+			envelope = gain[frame] + coefficient * (envelope - gain[frame]);
+			gain[frame] = envelope;
+		}
+		gainReduction = envelope;
+
+		// Apply the gain (plus makeup gain) to every channel.
+		Detail::SimdHelper::DecibelToAmplitudeBuffer(gain, nFrames, currentParameters.makeupGain);
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+			Detail::SimdHelper::MulBuffer(gain, buffer.GetChannel(channel), 0, 0, nFrames);
+	}
+}
@@ -0,0 +1,377 @@
+#include "digidaw/core/audio/effects/equalizer.h"
+
+#include "detail/simdhelper.h"
+#include "detail/hash.h"
+
+namespace DigiDAW::Core::Audio::Effects
+{
+	static const unsigned int coefficientsPerBand = 5; // b0, b1, b2, a1, a2
+	static const unsigned int statePerBand = 2; // z1, z2
+
+	/*
+	 * Filters a single channel through the active bands, a frame at a time through all of them, for buffers with too few channels to fill a vector
+	 * (where padding them out to 4 lanes, and interleaving them into those lanes, costs more than the vector saves).
+	 * The arithmetic is the same as Detail::SimdHelper::ProcessBiquadLanes (in the same order), so a channel comes out the same either way.
+	 */
+	static void ProcessBiquadCascade(float* samples, unsigned int nFrames, const unsigned int* activeBands, unsigned int nActiveBands,
+		float* coefficients, const float* coefficientDeltas, unsigned int rampFrames, float* state)
+	{
+		struct Biquad
+		{
+			float b0, b1, b2, a1, a2;
+			float z1, z2;
+
+			float Filter(float x)
+			{
+				const float y = b0 * x + z1;
+				z1 = b1 * x - a1 * y + z2;
+				z2 = b2 * x - a2 * y;
+				return y;
+			}
+		};
+
+		std::array<Biquad, Equalizer::maxBands> biquads;
+		for (unsigned int i = 0; i < nActiveBands; ++i)
+		{
+			const float* bandCoefficients = &coefficients[activeBands[i] * coefficientsPerBand];
+			const float* bandState = &state[activeBands[i] * statePerBand];
+			biquads[i] = Biquad{ bandCoefficients[0], bandCoefficients[1], bandCoefficients[2], bandCoefficients[3], bandCoefficients[4],
+				bandState[0], bandState[1] };
+		}
+
+		unsigned int frame = 0;
+		for (; frame < std::min(rampFrames, nFrames); ++frame)
+		{
+			float x = samples[frame];
+			for (unsigned int i = 0; i < nActiveBands; ++i)
+			{
+				const float* deltas = &coefficientDeltas[activeBands[i] * coefficientsPerBand];
+				Biquad& biquad = biquads[i];
+				biquad.b0 = biquad.b0 + deltas[0]; biquad.b1 = biquad.b1 + deltas[1]; biquad.b2 = biquad.b2 + deltas[2];
+				biquad.a1 = biquad.a1 + deltas[3]; biquad.a2 = biquad.a2 + deltas[4];
+				x = biquad.Filter(x);
+			}
+			samples[frame] = x;
+		}
+		for (; frame < nFrames; ++frame)
+		{
+			float x = samples[frame];
+			for (unsigned int i = 0; i < nActiveBands; ++i)
+				x = biquads[i].Filter(x);
+			samples[frame] = x;
+		}
+
+		for (unsigned int i = 0; i < nActiveBands; ++i)
+		{
+			float* bandCoefficients = &coefficients[activeBands[i] * coefficientsPerBand];
+			float* bandState = &state[activeBands[i] * statePerBand];
+			const Biquad& biquad = biquads[i];
+			bandCoefficients[0] = biquad.b0; bandCoefficients[1] = biquad.b1; bandCoefficients[2] = biquad.b2;
+			bandCoefficients[3] = biquad.a1; bandCoefficients[4] = biquad.a2;
+			bandState[0] = biquad.z1;
+			bandState[1] = biquad.z2;
+		}
+	}
+
+	Equalizer::Equalizer()
+	{
+		this->laneWidth = 4;
+		this->rampRemaining = 0;
+		this->sampleRate = 0;
+		this->nChannels = 0;
+		this->bandActive.fill(false);
+		this->tailFrames = 0;
+		this->bandsChanged = false;
+	}
+
+	void Equalizer::SetBand(unsigned int index, const Band& band)
+	{
+		if (index >= maxBands) return;
+
+		std::lock_guard<std::mutex> lock(bandsMutex);
+		bands[index] = band;
+		bandsChanged = true;
+	}
+
+	Equalizer::Band Equalizer::GetBand(unsigned int index)
+	{
+		std::lock_guard<std::mutex> lock(bandsMutex);
+		return bands[std::min(index, maxBands - 1)];
+	}
+
+	std::shared_ptr<Effect> Equalizer::Clone()
+	{
+		std::shared_ptr<Equalizer> equalizer = std::make_shared<Equalizer>();
+		equalizer->smoothingFrames = smoothingFrames;
+		for (unsigned int band = 0; band < maxBands; ++band)
+			equalizer->SetBand(band, GetBand(band));
+		return equalizer;
+	}
+
+	std::uint64_t Equalizer::GetStateHash()
+	{
+		std::uint64_t hash = Detail::Hash::Combine(Detail::Hash::offsetBasis, GetName());
+		hash = Detail::Hash::Combine(hash, smoothingFrames);
+		for (unsigned int index = 0; index < maxBands; ++index)
+		{
+			const Band band = GetBand(index);
+			hash = Detail::Hash::Combine(hash, band.enabled);
+			if (!band.enabled) continue; // A disabled band is flat, whatever its settings are.
+
+			hash = Detail::Hash::Combine(hash, band.type);
+			hash = Detail::Hash::Combine(hash, band.frequency);
+			hash = Detail::Hash::Combine(hash, band.gain);
+			hash = Detail::Hash::Combine(hash, band.q);
+		}
+		return hash;
+	}
+
+	// Based off the Audio EQ Cookbook by Robert Bristow-Johnson
+	void Equalizer::CalculateCoefficients(const Band& band, float* coefficients)
+	{
+		if (!band.enabled || sampleRate == 0)
+		{
+			// A flat filter (y = x)
+			coefficients[0] = 1.0f;
+			coefficients[1] = coefficients[2] = coefficients[3] = coefficients[4] = 0.0f;
+			return;
+		}
+
+		const double frequency = std::clamp(static_cast<double>(band.frequency), 1.0, sampleRate * 0.49);
+		const double w0 = 2.0 * pi<double> * frequency / sampleRate;
+		const double cosW0 = std::cos(w0);
+		const double alpha = std::sin(w0) / (2.0 * std::max(static_cast<double>(band.q), 0.01));
+		const double a = std::pow(10.0, band.gain / 40.0);
+		const double sqrtA2Alpha = 2.0 * std::sqrt(a) * alpha;
+
+		double b0, b1, b2, a0, a1, a2;
+		switch (band.type)
+		{
+		case FilterType::Bell:
+			b0 = 1.0 + alpha * a;
+			b1 = -2.0 * cosW0;
+			b2 = 1.0 - alpha * a;
+			a0 = 1.0 + alpha / a;
+			a1 = -2.0 * cosW0;
+			a2 = 1.0 - alpha / a;
+			break;
+		case FilterType::LowShelf:
+			b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + sqrtA2Alpha);
+			b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+			b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - sqrtA2Alpha);
+			a0 = (a + 1.0) + (a - 1.0) * cosW0 + sqrtA2Alpha;
+			a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+			a2 = (a + 1.0) + (a - 1.0) * cosW0 - sqrtA2Alpha;
+			break;
+		case FilterType::HighShelf:
+			b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + sqrtA2Alpha);
+			b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+			b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - sqrtA2Alpha);
+			a0 = (a + 1.0) - (a - 1.0) * cosW0 + sqrtA2Alpha;
+			a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+			a2 = (a + 1.0) - (a - 1.0) * cosW0 - sqrtA2Alpha;
+			break;
+		case FilterType::LowPass:
+			b0 = (1.0 - cosW0) / 2.0;
+			b1 = 1.0 - cosW0;
+			b2 = (1.0 - cosW0) / 2.0;
+			a0 = 1.0 + alpha;
+			a1 = -2.0 * cosW0;
+			a2 = 1.0 - alpha;
+			break;
+		case FilterType::HighPass:
+			b0 = (1.0 + cosW0) / 2.0;
+			b1 = -(1.0 + cosW0);
+			b2 = (1.0 + cosW0) / 2.0;
+			a0 = 1.0 + alpha;
+			a1 = -2.0 * cosW0;
+			a2 = 1.0 - alpha;
+			break;
+		case FilterType::Notch:
+		default:
+			b0 = 1.0;
+			b1 = -2.0 * cosW0;
+			b2 = 1.0;
+			a0 = 1.0 + alpha;
+			a1 = -2.0 * cosW0;
+			a2 = 1.0 - alpha;
+			break;
+		}
+
+		// Normalize so a0 is 1.
+		coefficients[0] = static_cast<float>(b0 / a0);
+		coefficients[1] = static_cast<float>(b1 / a0);
+		coefficients[2] = static_cast<float>(b2 / a0);
+		coefficients[3] = static_cast<float>(a1 / a0);
+		coefficients[4] = static_cast<float>(a2 / a0);
+	}
+
+	// Calculates the new target coefficients for every band (this is the only place the trigonometry is done),
+	// and starts ramping the current coefficients towards them.
+	void Equalizer::UpdateTargets(const std::array<Band, maxBands>& currentBands)
+	{
+		const unsigned int rampFrames = std::max(smoothingFrames, 1u);
+		double tail = rampFrames;
+		for (unsigned int band = 0; band < maxBands; ++band)
+		{
+			float bandCoefficients[coefficientsPerBand];
+			CalculateCoefficients(currentBands[band], bandCoefficients);
+
+			// Keep disabled bands running until they've ramped to flat.
+			bandActive[band] = bandActive[band] || currentBands[band].enabled;
+
+			// A resonance has a time constant of 2Q / w0, and takes about 13.8 of them to decay by 120dB.
+			// Disabled bands are still counted, as they could be ringing from before they were disabled.
+			if (bandActive[band] && sampleRate != 0)
+			{
+				const double q = std::max(static_cast<double>(currentBands[band].q), 0.5);
+				const double frequency = std::max(static_cast<double>(currentBands[band].frequency), 1.0);
+				tail += 13.8 * q * static_cast<double>(sampleRate) / (pi<double> * frequency);
+			}
+
+			for (LaneGroup& group : groups)
+			{
+				for (unsigned int coefficient = 0; coefficient < coefficientsPerBand; ++coefficient)
+				{
+					std::size_t offset = (band * coefficientsPerBand + coefficient) * laneWidth;
+					for (unsigned int lane = 0; lane < laneWidth; ++lane)
+					{
+						group.targetCoefficients[offset + lane] = bandCoefficients[coefficient];
+						group.coefficientDeltas[offset + lane] = 
+							(bandCoefficients[coefficient] - group.coefficients[offset + lane]) / rampFrames;
+					}
+				}
+			}
+		}
+
+		rampRemaining = rampFrames;
+		tailFrames = static_cast<unsigned int>(std::min(std::ceil(tail), static_cast<double>(infiniteTail - 1)));
+	}
+
+	void Equalizer::Prepare(unsigned int nChannels, unsigned int maxFrames, unsigned int sampleRate)
+	{
+		this->nChannels = nChannels;
+		this->sampleRate = sampleRate;
+
+		// Use the smallest vector that fits all the channels (anything over 16 channels is split into groups of 16),
+		// or no vector at all for fewer than 4 channels (a group per channel, see ProcessBiquadCascade).
+		if (nChannels < 4) laneWidth = 1;
+		else if (nChannels == 4) laneWidth = 4;
+		else if (nChannels <= 8) laneWidth = 8;
+		else laneWidth = 16;
+
+		groups.clear();
+		for (unsigned int firstChannel = 0; firstChannel < nChannels; firstChannel += laneWidth)
+		{
+			LaneGroup group;
+			group.firstChannel = firstChannel;
+			group.nChannels = std::min(laneWidth, nChannels - firstChannel);
+			group.coefficients = std::vector<float>(maxBands * coefficientsPerBand * laneWidth);
+			group.coefficientDeltas = std::vector<float>(maxBands * coefficientsPerBand * laneWidth);
+			group.targetCoefficients = std::vector<float>(maxBands * coefficientsPerBand * laneWidth);
+			group.state = std::vector<float>(maxBands * statePerBand * laneWidth);
+			groups.push_back(group);
+		}
+
+		laneBuffer = std::vector<float>(static_cast<std::size_t>(maxFrames) * laneWidth);
+
+		// Start directly at the current settings instead of ramping to them.
+		bandActive.fill(false);
+		{
+			std::unique_lock<std::mutex> lock(bandsMutex);
+			const std::array<Band, maxBands> currentBands = bands;
+			lock.unlock();
+			UpdateTargets(currentBands);
+		}
+		for (LaneGroup& group : groups)
+		{
+			group.coefficients = group.targetCoefficients;
+			std::fill(group.coefficientDeltas.begin(), group.coefficientDeltas.end(), 0.0f);
+		}
+		rampRemaining = 0;
+		bandsChanged = false;
+
+		std::lock_guard<std::mutex> lock(bandsMutex);
+		for (unsigned int band = 0; band < maxBands; ++band)
+			bandActive[band] = bands[band].enabled;
+	}
+
+	void Equalizer::Process(const AudioBufferView& buffer)
+	{
+		const unsigned int nChannels = buffer.GetChannelCount();
+		const unsigned int nFrames = buffer.GetFrameCount();
+		if (nChannels != this->nChannels || static_cast<std::size_t>(nFrames) * laneWidth > laneBuffer.size()) return;
+
+		// The bands are only picked up if the UI isn't setting one right now, rather than waiting on it.
+		if (bandsChanged.exchange(false))
+		{
+			std::unique_lock<std::mutex> lock(bandsMutex, std::try_to_lock);
+			if (lock.owns_lock())
+			{
+				const std::array<Band, maxBands> currentBands = bands;
+				lock.unlock();
+				UpdateTargets(currentBands);
+			}
+			else bandsChanged = true; // Try again next time.
+		}
+
+		const unsigned int rampFrames = std::min(rampRemaining, nFrames);
+		if (laneWidth == 1)
+		{
+			std::array<unsigned int, maxBands> activeBands;
+			unsigned int nActiveBands = 0;
+			for (unsigned int band = 0; band < maxBands; ++band)
+				if (bandActive[band]) activeBands[nActiveBands++] = band;
+
+			for (LaneGroup& group : groups)
+				ProcessBiquadCascade(buffer.GetChannel(group.firstChannel), nFrames, activeBands.data(), nActiveBands,
+					group.coefficients.data(), group.coefficientDeltas.data(), rampFrames, group.state.data());
+		}
+		else
+		{
+			for (LaneGroup& group : groups)
+			{
+				Detail::SimdHelper::InterleaveLanes(buffer, laneBuffer.data(), group.firstChannel, group.nChannels, laneWidth);
+
+				for (unsigned int band = 0; band < maxBands; ++band)
+				{
+					if (!bandActive[band]) continue;
+
+					Detail::SimdHelper::ProcessBiquadLanes(laneWidth, laneBuffer.data(), nFrames,
+						&group.coefficients[band * coefficientsPerBand * laneWidth],
+						&group.coefficientDeltas[band * coefficientsPerBand * laneWidth],
+						rampFrames,
+						&group.state[band * statePerBand * laneWidth]);
+				}
+
+				Detail::SimdHelper::DeinterleaveLanes(laneBuffer.data(), buffer, group.firstChannel, group.nChannels, laneWidth);
+			}
+		}
+
+		rampRemaining -= rampFrames;
+		if (rampRemaining == 0 && rampFrames > 0)
+		{
+			// Snap to the exact targets (so the ramping doesn't accumulate any rounding error), 
+			// and stop processing bands that have finished ramping to flat.
+			for (LaneGroup& group : groups)
+			{
+				group.coefficients = group.targetCoefficients;
+				std::fill(group.coefficientDeltas.begin(), group.coefficientDeltas.end(), 0.0f);
+			}
+
+			std::unique_lock<std::mutex> lock(bandsMutex, std::try_to_lock);
+			if (lock.owns_lock())
+			{
+				for (unsigned int band = 0; band < maxBands; ++band)
+				{
+					if (!bands[band].enabled && bandActive[band])
+					{
+						bandActive[band] = false;
+						for (LaneGroup& group : groups)
+							std::fill_n(&group.state[band * statePerBand * laneWidth], statePerBand * laneWidth, 0.0f);
+					}
+				}
+			}
+		}
+	}
+}
@@ -2,59 +2,87 @@
 
 namespace DigiDAW::Core::Audio
 {
-	Engine::Engine(RtAudio::Api api)
+	Engine::Engine(RtAudio::Api api, const std::filesystem::path& deviceCachePath)
 		: mixer(*this)
 	{
-		audioBackend = std::make_unique<RtAudio>(api);
+		deviceCache.SetPath(deviceCachePath);
 
-		std::vector<RtAudio::Api> compiledAPIs;
-		RtAudio::getCompiledApi(compiledAPIs);
+		// Without an API, RtAudio looks for the first API with devices, which is the first one that was found last time.
+		supportedAPIs = deviceCache.GetSupportedAPIs();
+		if (api == RtAudio::Api::UNSPECIFIED && !supportedAPIs.empty()) api = supportedAPIs[0];
 
-		for (RtAudio::Api api : compiledAPIs)
-		{
-			RtAudio tempAudio(api);
-			if (tempAudio.getDeviceCount() > 0) supportedAPIs.push_back(api);
-		}
+		audioBackend = CreateBackend(api);
+
+		// Until every API has been probed, only the current one is known to work.
+		if (supportedAPIs.empty() && audioBackend->GetCurrentAPI() != virtualAPI) supportedAPIs.push_back(audioBackend->GetCurrentAPI());
+		supportedAPIs.push_back(virtualAPI);
 
 		InitializeDevices();
+
+		probingDevices = true;
+		deviceProbeThread = std::jthread([&](std::stop_token stopToken) { ProbeDevices(stopToken); });
+	}
+
+	std::unique_ptr<Backend> Engine::CreateBackend(RtAudio::Api api)
+	{
+		if (api == virtualAPI) return std::make_unique<VirtualDevice>(virtualDeviceSettings);
+		return std::make_unique<RtAudioBackend>(api);
 	}
 
 	Engine::~Engine()
 	{
-		if (audioBackend->isStreamOpen()) audioBackend->closeStream();
+		if (audioBackend->IsStreamOpen()) audioBackend->CloseStream();
 	}
 
 	void Engine::InitializeDevices()
 	{
 		UpdateDevices();
 
-		currentOutputDevice = GetFirstAvailableOutputDevice();
-		if (currentInputDevice != -1) currentInputDevice = GetFirstAvailableInputDevice();
+		currentOutputDevice = GetFirstAvailableOutputDevice(*audioBackend, currentDevices);
+		if (currentInputDevice != noDevice) currentInputDevice = GetFirstAvailableInputDevice(*audioBackend, currentDevices);
 
 		currentBufferSize = 512;
 
+		// The stream is opened by whoever needs it next (StartEngine, ApplyConfig...), so it's only opened once.
 		UpdateCurrentSupportedSampleRates();
-		ResetSampleRate(); // Also opens stream
+		ResetSampleRate();
 	}
 
-	unsigned int Engine::GetFirstAvailableInputDevice()
+	// The default devices are found from the devices themselves where possible, as asking the API can probe every device again.
+	unsigned int Engine::GetFirstAvailableInputDevice(Backend& backend, const std::vector<AudioDevice>& devices)
 	{
-		const unsigned int def = audioBackend->getDefaultInputDevice();
-		if (currentDevices[def].info.probed) return def;
-		for (Engine::AudioDevice device : currentDevices)
+		for (const Engine::AudioDevice& device : devices)
+			if (device.info.probed && device.info.isDefaultInput) return device.index;
+
+		const unsigned int def = backend.GetDefaultInputDevice();
+		if (def < devices.size() && devices[def].info.probed) return def;
+		for (Engine::AudioDevice device : devices)
 			if (device.info.probed && device.info.inputChannels > 0) return device.index;
 
-		return -1;
+		return noDevice;
 	}
 
-	unsigned int Engine::GetFirstAvailableOutputDevice()
+	unsigned int Engine::GetFirstAvailableOutputDevice(Backend& backend, const std::vector<AudioDevice>& devices)
 	{
-		const unsigned int def = audioBackend->getDefaultOutputDevice();
-		if (currentDevices[def].info.probed) return def;
-		for (Engine::AudioDevice device : currentDevices)
+		for (const Engine::AudioDevice& device : devices)
+			if (device.info.probed && device.info.isDefaultOutput) return device.index;
+
+		const unsigned int def = backend.GetDefaultOutputDevice();
+		if (def < devices.size() && devices[def].info.probed) return def;
+		for (Engine::AudioDevice device : devices)
 			if (device.info.probed && device.info.outputChannels > 0) return device.index;
 
-		return -1;
+		return noDevice;
+	}
+
+	// Finds a device that can still be used for input or output by its name, returns noDevice if there isn't one.
+	unsigned int Engine::FindDevice(const std::vector<AudioDevice>& devices, const std::string& name, bool output)
+	{
+		for (const Engine::AudioDevice& device : devices)
+			if (device.info.name == name && device.info.probed && (output ? device.info.outputChannels : device.info.inputChannels) > 0)
+				return device.index;
+
+		return noDevice;
 	}
 
 	const std::vector<RtAudio::Api>& Engine::GetSupportedAPIs()
@@ -64,19 +92,147 @@ namespace DigiDAW::Core::Audio
 
 	RtAudio::Api Engine::GetCurrentAPI()
 	{
-		return audioBackend->getCurrentApi();
+		return audioBackend->GetCurrentAPI();
+	}
+
+	// Uses the cached devices if the backend's API has been probed before, the device probe thread keeps them up to date.
+	// The virtual device is never cached (it's never probed, and listing it costs nothing).
+	std::vector<Engine::AudioDevice> Engine::ListDevices(Backend& backend)
+	{
+		const RtAudio::Api api = backend.GetCurrentAPI();
+
+		std::vector<AudioDevice> devices;
+		std::vector<RtAudio::DeviceInfo> cachedDevices;
+		if (api != virtualAPI && deviceCache.Find(api, cachedDevices))
+		{
+			for (unsigned int i = 0; i < cachedDevices.size(); ++i)
+				devices.push_back(Engine::AudioDevice(cachedDevices[i], api, i));
+			return devices;
+		}
+
+		for (unsigned int i = 0; i < backend.GetDeviceCount(); ++i)
+		{
+			devices.push_back(Engine::AudioDevice(backend.GetDeviceInfo(i), api, i));
+			cachedDevices.push_back(devices.back().info);
+		}
+		if (api != virtualAPI) deviceCache.Store(api, cachedDevices);
+		return devices;
 	}
 
 	void Engine::UpdateDevices()
 	{
-		currentDevices.clear();
-		for (unsigned int i = 0; i < audioBackend->getDeviceCount(); ++i)
-			currentDevices.push_back(GetAudioDevice(i));
+		currentDevices = ListDevices(*audioBackend);
 	}
 
-	Engine::AudioDevice Engine::GetAudioDevice(unsigned int index)
+	// Runs on the device probe thread, with its own instance of every API so the stream is never touched.
+	void Engine::ProbeDevices(std::stop_token stopToken)
 	{
-		return Engine::AudioDevice(audioBackend->getDeviceInfo(index), audioBackend->getCurrentApi(), index);
+		std::vector<RtAudio::Api> compiledAPIs;
+		RtAudio::getCompiledApi(compiledAPIs);
+
+		DeviceProbe probe;
+		for (RtAudio::Api api : compiledAPIs)
+		{
+			if (stopToken.stop_requested()) break;
+
+			RtAudio probeAudio(api);
+			const unsigned int nDevices = probeAudio.getDeviceCount();
+			if (nDevices == 0) continue;
+
+			probe.supportedAPIs.push_back(api);
+			std::vector<RtAudio::DeviceInfo> devices;
+			for (unsigned int i = 0; i < nDevices && !stopToken.stop_requested(); ++i)
+				devices.push_back(probeAudio.getDeviceInfo(i));
+			probe.devices.push_back({ api, std::move(devices) });
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(deviceProbeMutex);
+			deviceProbe = std::move(probe);
+		}
+		deviceProbeFinished = !stopToken.stop_requested();
+		probingDevices = false;
+	}
+
+	bool Engine::ReconcileDevices(bool wait)
+	{
+		if (wait && deviceProbeThread.joinable()) deviceProbeThread.join();
+		if (!deviceProbeFinished.exchange(false)) return false;
+
+		DeviceProbe probe;
+		{
+			std::lock_guard<std::mutex> lock(deviceProbeMutex);
+			probe = std::move(deviceProbe);
+		}
+
+		const RtAudio::Api currentAPI = audioBackend->GetCurrentAPI();
+		std::vector<AudioDevice> devices;
+		for (auto& [api, apiDevices] : probe.devices)
+		{
+			if (api == currentAPI)
+			{
+				// A device the stream has open can fail to probe from another instance, so what's already known about it is kept.
+				for (RtAudio::DeviceInfo& info : apiDevices)
+				{
+					auto current = std::find_if(currentDevices.begin(), currentDevices.end(),
+						[&](const AudioDevice& device) { return device.info.name == info.name; });
+					if (!info.probed && current != currentDevices.end() && current->info.probed)
+						info = current->info;
+				}
+
+				for (unsigned int i = 0; i < apiDevices.size(); ++i)
+					devices.push_back(Engine::AudioDevice(apiDevices[i], api, i));
+			}
+			deviceCache.Store(api, apiDevices);
+		}
+		deviceCache.SetSupportedAPIs(probe.supportedAPIs);
+		deviceCache.Save();
+
+		supportedAPIs = probe.supportedAPIs;
+		if (currentAPI != virtualAPI && std::find(supportedAPIs.begin(), supportedAPIs.end(), currentAPI) == supportedAPIs.end())
+			supportedAPIs.push_back(currentAPI); // It's still in use, even if it's lost its devices.
+		supportedAPIs.push_back(virtualAPI);
+
+		// The virtual device isn't probed, so it never changes.
+		if (currentAPI == virtualAPI) return false;
+
+		const bool devicesChanged = devices.size() != currentDevices.size() ||
+			!std::equal(devices.begin(), devices.end(), currentDevices.begin(),
+				[](const AudioDevice& a, const AudioDevice& b) { return DeviceCache::IsSameDevice(a.info, b.info); });
+		if (!devicesChanged) return false;
+
+		// The selected devices are kept by name, as they can have moved, otherwise the defaults are used.
+		const std::string outputName = (currentOutputDevice != noDevice) ? currentDevices[currentOutputDevice].info.name : std::string();
+		const std::string inputName = (currentInputDevice != noDevice) ? currentDevices[currentInputDevice].info.name : std::string();
+
+		// The callback reads the devices, so the stream is closed before they're replaced.
+		const bool previousStreamOpen = IsStreamOpen();
+		const bool previousStreamRunning = IsStreamRunning();
+		QuiesceStream();
+		if (previousStreamOpen) audioBackend->CloseStream();
+
+		currentDevices = std::move(devices);
+		if (currentOutputDevice != noDevice)
+		{
+			currentOutputDevice = FindDevice(currentDevices, outputName, true);
+			if (currentOutputDevice == noDevice) currentOutputDevice = GetFirstAvailableOutputDevice(*audioBackend, currentDevices);
+		}
+		if (currentInputDevice != noDevice)
+		{
+			currentInputDevice = FindDevice(currentDevices, inputName, false);
+			if (currentInputDevice == noDevice) currentInputDevice = GetFirstAvailableInputDevice(*audioBackend, currentDevices);
+		}
+
+		// Keep the sample rate if it's still supported (as ResetSampleRate picks the fastest one).
+		UpdateCurrentSupportedSampleRates();
+		if (std::find(currentSupportedSampleRates.begin(), currentSupportedSampleRates.end(), currentSampleRate) == currentSupportedSampleRates.end())
+			ResetSampleRate();
+
+		if (previousStreamOpen)
+			OpenStream();
+		if (previousStreamRunning)
+			StartEngine();
+		return true;
 	}
 
 	const std::vector<Engine::AudioDevice>& Engine::GetDevices()
@@ -86,11 +242,13 @@ namespace DigiDAW::Core::Audio
 
 	std::string Engine::GetAPIDisplayName(RtAudio::Api api)
 	{
+		if (api == virtualAPI) return "Virtual Device (WAV Files)";
 		return RtAudio::getApiDisplayName(api);
 	}
 
 	std::string Engine::GetAPIName(RtAudio::Api api)
 	{
+		if (api == virtualAPI) return "virtual";
 		return RtAudio::getApiName(api);
 	}
 
@@ -99,83 +257,22 @@ namespace DigiDAW::Core::Audio
 		GetSupportedSampleRates(currentSupportedSampleRates, currentOutputDevice, currentInputDevice);
 	}
 
+	// Picks the fastest of the current supported sample rates (so they're updated first), 0 if there aren't any.
 	void Engine::ResetSampleRate()
 	{
-		if (currentOutputDevice == -1 && currentInputDevice != -1)
-		{
-			if (!currentDevices[currentInputDevice].info.probed)
-			{
-				currentSampleRate = 0;
-				return;
-			}
-			std::vector<unsigned int>& sampleRates = currentDevices[currentInputDevice].info.sampleRates;
-			SetCurrentSampleRate(*std::max_element(sampleRates.begin(), sampleRates.end()));
-			return;
-		}
-		else if (currentInputDevice == -1 && currentOutputDevice != -1)
-		{
-			if (!currentDevices[currentOutputDevice].info.probed)
-			{
-				currentSampleRate = 0;
-				return;
-			}
-			std::vector<unsigned int>& sampleRates = currentDevices[currentOutputDevice].info.sampleRates;
-			SetCurrentSampleRate(*std::max_element(sampleRates.begin(), sampleRates.end()));
-			return;
-		}
-		else if (currentInputDevice == -1 && currentOutputDevice == -1)
-		{
-			currentSampleRate = 0;
-			return;
-		}
-
-		unsigned int bestSampleRate = 0;
-
-		RtAudio::DeviceInfo outputInfo = currentDevices[currentOutputDevice].info;
-		RtAudio::DeviceInfo inputInfo = currentDevices[currentInputDevice].info;
-
-		if (!outputInfo.probed && inputInfo.probed)
-		{
-			std::vector<unsigned int>& sampleRates = currentDevices[currentInputDevice].info.sampleRates;
-			SetCurrentSampleRate(*std::max_element(sampleRates.begin(), sampleRates.end()));
-			return;
-		}
-		else if (!inputInfo.probed && outputInfo.probed)
-		{
-			std::vector<unsigned int>& sampleRates = currentDevices[currentOutputDevice].info.sampleRates;
-			SetCurrentSampleRate(*std::max_element(sampleRates.begin(), sampleRates.end()));
-			return;
-		}
-		else if (!inputInfo.probed && !outputInfo.probed)
-		{
-			currentSampleRate = 0;
-			return;
-		}
-
-		for (unsigned int rate1 : outputInfo.sampleRates)
-		{
-			for (unsigned int rate2 : inputInfo.sampleRates)
-			{
-				if (rate1 == rate2)
-				{
-					if (rate1 > bestSampleRate) bestSampleRate = rate1;
-					break;
-				}
-			}
-		}
-
-		SetCurrentSampleRate(bestSampleRate);
+		currentSampleRate = !currentSupportedSampleRates.empty() ?
+			*std::max_element(currentSupportedSampleRates.begin(), currentSupportedSampleRates.end()) : 0;
 	}
 
 	ReturnCode Engine::SetCurrentOutputDevice(unsigned int device)
 	{
-		if (device != -1 && (!currentDevices[device].info.probed || currentDevices[device].info.outputChannels == 0))
+		if (device != noDevice && (!currentDevices[device].info.probed || currentDevices[device].info.outputChannels == 0))
 			return ReturnCode::Error;
 
 		currentOutputDevice = device;
 
-		ResetSampleRate();
 		UpdateCurrentSupportedSampleRates();
+		ResetSampleRate();
 
 		OpenStream();
 		return ReturnCode::Success;
@@ -183,13 +280,13 @@ namespace DigiDAW::Core::Audio
 
 	ReturnCode Engine::SetCurrentInputDevice(unsigned int device)
 	{
-		if (device != -1 && (!currentDevices[device].info.probed || currentDevices[device].info.inputChannels == 0))
+		if (device != noDevice && (!currentDevices[device].info.probed || currentDevices[device].info.inputChannels == 0))
 			return ReturnCode::Error;
 
 		currentInputDevice = device;
 
-		ResetSampleRate();
 		UpdateCurrentSupportedSampleRates();
+		ResetSampleRate();
 
 		OpenStream();
 		return ReturnCode::Success;
@@ -231,6 +328,12 @@ namespace DigiDAW::Core::Audio
 		return currentBufferSize;
 	}
 
+	unsigned int Engine::GetTotalOutputLatency()
+	{
+		unsigned int streamLatency = IsStreamOpen() ? static_cast<unsigned int>(audioBackend->GetStreamLatency()) : 0;
+		return mixer.GetOutputLatency() + streamLatency;
+	}
+
 	const std::vector<unsigned int>& Engine::GetSupportedSampleRates()
 	{
 		return currentSupportedSampleRates;
@@ -244,18 +347,18 @@ namespace DigiDAW::Core::Audio
 
 	ReturnCode Engine::GetSupportedSampleRates(std::vector<unsigned int>& sampleRates, unsigned int outputDevice, unsigned int inputDevice)
 	{
-		// Sanitize the devices and make sure they aren't -1 (aka None), if they are return the other one.
-		if (outputDevice == -1 && inputDevice != -1)
+		// Sanitize the devices and make sure they aren't noDevice (aka None), if they are return the other one.
+		if (outputDevice == noDevice && inputDevice != noDevice)
 		{
 			sampleRates = currentDevices[inputDevice].info.sampleRates;
 			return ReturnCode::Success;
 		}
-		else if (inputDevice == -1 && outputDevice != -1)
+		else if (inputDevice == noDevice && outputDevice != noDevice)
 		{
 			sampleRates = currentDevices[outputDevice].info.sampleRates;
 			return ReturnCode::Success;
 		}
-		else if (inputDevice == -1 && outputDevice == -1) // If we don't have any devices selected, return error.
+		else if (inputDevice == noDevice && outputDevice == noDevice) // If we don't have any devices selected, return error.
 		{
 			sampleRates.clear();
 			return ReturnCode::Error;
@@ -303,14 +406,20 @@ namespace DigiDAW::Core::Audio
 	}
 
 	ReturnCode Engine::ChangeBackend(RtAudio::Api api)
+	{
+		return ChangeBackend(CreateBackend(api));
+	}
+
+	ReturnCode Engine::ChangeBackend(std::unique_ptr<Backend> backend)
 	{
 		bool previousStreamOpen = IsStreamOpen();
 		bool previousStreamRunning = IsStreamRunning();
 
-		audioBackend->closeStream();
+		QuiesceStream();
+		audioBackend->CloseStream();
 		delete audioBackend.release();
 
-		audioBackend = std::make_unique<RtAudio>(api);
+		audioBackend = std::move(backend);
 
 		InitializeDevices();
 
@@ -322,6 +431,100 @@ namespace DigiDAW::Core::Audio
 		return ReturnCode::Success;
 	}
 
+	ReturnCode Engine::SetVirtualDeviceSettings(const VirtualDevice::Settings& settings)
+	{
+		std::unique_ptr<VirtualDevice> device = std::make_unique<VirtualDevice>(settings);
+		if ((!settings.inputPath.empty() && !device->IsInputLoaded()) || (!settings.referencePath.empty() && !device->IsReferenceLoaded()))
+			return ReturnCode::Error;
+
+		virtualDeviceSettings = settings;
+		if (GetCurrentAPI() == virtualAPI)
+			return ChangeBackend(std::move(device));
+		return ReturnCode::Success;
+	}
+
+	VirtualDevice* Engine::GetVirtualDevice()
+	{
+		return (GetCurrentAPI() == virtualAPI) ? static_cast<VirtualDevice*>(audioBackend.get()) : nullptr;
+	}
+
+	ReturnCode Engine::ApplyConfig(const EngineConfig& config)
+	{
+		const RtAudio::Api api = config.api.value_or(GetCurrentAPI());
+		const bool backendChanged = api != GetCurrentAPI();
+		if (backendChanged && std::find(supportedAPIs.begin(), supportedAPIs.end(), api) == supportedAPIs.end())
+			return ReturnCode::Error;
+		if (config.bufferSize && *config.bufferSize == 0)
+			return ReturnCode::Error;
+
+		// A new backend isn't swapped in until everything's been validated against its devices.
+		std::unique_ptr<Backend> backend = backendChanged ? CreateBackend(api) : nullptr;
+		std::vector<AudioDevice> devices = backendChanged ? ListDevices(*backend) : currentDevices;
+
+		unsigned int outputDevice = currentOutputDevice;
+		unsigned int inputDevice = currentInputDevice;
+		if (backendChanged)
+		{
+			outputDevice = GetFirstAvailableOutputDevice(*backend, devices);
+			if (inputDevice != noDevice) inputDevice = GetFirstAvailableInputDevice(*backend, devices);
+		}
+		if (config.outputDevice)
+		{
+			outputDevice = config.outputDevice->empty() ? noDevice : FindDevice(devices, *config.outputDevice, true);
+			if (outputDevice == noDevice && !config.outputDevice->empty()) return ReturnCode::Error;
+		}
+		if (config.inputDevice)
+		{
+			inputDevice = config.inputDevice->empty() ? noDevice : FindDevice(devices, *config.inputDevice, false);
+			if (inputDevice == noDevice && !config.inputDevice->empty()) return ReturnCode::Error;
+		}
+
+		const bool devicesChanged = backendChanged || outputDevice != currentOutputDevice || inputDevice != currentInputDevice;
+
+		std::vector<unsigned int> sampleRates;
+		if (outputDevice != noDevice && inputDevice != noDevice)
+			GetSupportedSampleRates(sampleRates, devices[outputDevice], devices[inputDevice]);
+		else if (outputDevice != noDevice || inputDevice != noDevice)
+			sampleRates = devices[(outputDevice != noDevice) ? outputDevice : inputDevice].info.sampleRates;
+
+		unsigned int sampleRate = currentSampleRate;
+		if (config.sampleRate)
+		{
+			sampleRate = *config.sampleRate;
+			if (std::find(sampleRates.begin(), sampleRates.end(), sampleRate) == sampleRates.end()) return ReturnCode::Error;
+		}
+		else if (devicesChanged)
+			sampleRate = !sampleRates.empty() ? *std::max_element(sampleRates.begin(), sampleRates.end()) : 0;
+
+		const unsigned int bufferSize = config.bufferSize.value_or(backendChanged ? 512 : currentBufferSize);
+
+		if (!devicesChanged && sampleRate == currentSampleRate && bufferSize == currentBufferSize && IsStreamOpen())
+			return ReturnCode::Success;
+
+		// Everything's valid, so it's all applied at once (the callback reads the devices, so the stream is closed first).
+		mixer.PrepareReconfiguration(bufferSize);
+		const bool previousStreamRunning = IsStreamRunning();
+		QuiesceStream();
+		if (IsStreamOpen()) audioBackend->CloseStream();
+
+		if (backendChanged)
+			audioBackend = std::move(backend);
+		currentDevices = std::move(devices);
+		currentOutputDevice = outputDevice;
+		currentInputDevice = inputDevice;
+		currentSupportedSampleRates = std::move(sampleRates);
+		currentSampleRate = sampleRate;
+		currentBufferSize = bufferSize;
+
+		if (currentOutputDevice == noDevice)
+			return ReturnCode::Success; // There's nothing to open a stream on.
+
+		const ReturnCode result = OpenStream();
+		if (result == ReturnCode::Success && previousStreamRunning)
+			return StartEngine();
+		return result;
+	}
+
 	int Engine::AudioCallback(
 		void* outputBuffer,
 		void* inputBuffer,
@@ -332,13 +535,15 @@ namespace DigiDAW::Core::Audio
 	{
 		Engine* engine = (Engine*)userData;
 
-		if (!outputBuffer || engine->currentOutputDevice == -1) return 2; // Abort stream
+		if (!outputBuffer || engine->currentOutputDevice == noDevice) return 2; // Abort stream
+
+		if (!engine->callbackScheduled.exchange(true)) engine->ScheduleCallbackThread();
 
 		float* outBuf = (float*)outputBuffer;
 		float* inBuf = (float*)inputBuffer;
 
 		unsigned int nOutChannels = engine->currentDevices[engine->currentOutputDevice].info.outputChannels;
-		unsigned int nInChannels = (engine->currentInputDevice != -1) ? engine->currentDevices[engine->currentInputDevice].info.inputChannels : 0;
+		unsigned int nInChannels = (engine->currentInputDevice != noDevice) ? engine->currentDevices[engine->currentInputDevice].info.inputChannels : 0;
 
 		std::memset(outBuf, 0, sizeof(float) * (nOutChannels * nFrames));
 		engine->mixer.Mix(outBuf, inBuf, streamTime, nFrames, nOutChannels, nInChannels, engine->currentSampleRate);
@@ -348,11 +553,18 @@ namespace DigiDAW::Core::Audio
 
 	ReturnCode Engine::OpenStream()
 	{
-		if (currentOutputDevice == -1)
+		if (currentOutputDevice == noDevice)
 			return ReturnCode::Error;
 
+		// The new buffers are planned while the old stream is still playing, which is then faded out (see Mixer Reconfiguration).
+		const auto startTime = std::chrono::steady_clock::now();
+		mixer.PrepareReconfiguration(currentBufferSize);
+		const auto plannedTime = std::chrono::steady_clock::now();
+
 		bool previousStreamRunning = IsStreamRunning();
-		if (IsStreamOpen()) audioBackend->closeStream();
+		QuiesceStream();
+		if (IsStreamOpen()) audioBackend->CloseStream();
+		const auto quiescedTime = std::chrono::steady_clock::now();
 
 		RtAudio::StreamParameters outputParams;
 		outputParams.deviceId = currentOutputDevice;
@@ -360,7 +572,7 @@ namespace DigiDAW::Core::Audio
 		outputParams.nChannels = currentDevices[currentOutputDevice].info.outputChannels;
 
 		RtAudio::StreamParameters inputParams;
-		if (currentInputDevice != -1)
+		if (currentInputDevice != noDevice)
 		{
 			inputParams.deviceId = currentInputDevice;
 			inputParams.firstChannel = 0;
@@ -375,9 +587,9 @@ namespace DigiDAW::Core::Audio
 
 		unsigned int bufferSize = currentBufferSize;
 		RtAudioErrorType streamError =
-			audioBackend->openStream(
+			audioBackend->OpenStream(
 				&outputParams,
-				(currentInputDevice != -1 ? &inputParams : NULL),
+				(currentInputDevice != noDevice ? &inputParams : NULL),
 				RTAUDIO_FLOAT32,
 				currentSampleRate,
 				&bufferSize,
@@ -385,27 +597,45 @@ namespace DigiDAW::Core::Audio
 
 		if (streamError != RTAUDIO_NO_ERROR)
 		{
-			if (IsStreamOpen()) audioBackend->closeStream();
+			if (IsStreamOpen()) audioBackend->CloseStream();
 			return ReturnCode::Error;
 		}
 
 		currentBufferSize = bufferSize;
-		mixer.UpdateAllTrackBuffers();
-		mixer.UpdateAllBusBuffers();
 
+		// The stream has a new callback thread.
+		{
+			std::lock_guard<std::mutex> lock(threadSettingsMutex);
+			callbackScheduled = !threadSettings.realtime && !threadSettings.pinThreads;
+		}
+
+		mixer.Reconfigure();
+
+		ReturnCode result = ReturnCode::Success;
 		if (previousStreamRunning)
-			return StartEngine();
-		return ReturnCode::Success;
+			result = StartEngine();
+
+		const auto endTime = std::chrono::steady_clock::now();
+		reconfigurationReport.planMS = std::chrono::duration<double, std::milli>(plannedTime - startTime).count();
+		reconfigurationReport.fadeOutMS = std::chrono::duration<double, std::milli>(quiescedTime - plannedTime).count();
+		reconfigurationReport.reopenMS = std::chrono::duration<double, std::milli>(endTime - quiescedTime).count();
+		reconfigurationReport.totalMS = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		return result;
 	}
 
 	ReturnCode Engine::StartEngine()
 	{
 		if (!IsStreamRunning())
 		{
-			OpenStream();
+			mixer.FadeIn();
 
-			audioBackend->startStream();
-			mixer.UpdateCurrentTime(audioBackend->getStreamTime());
+			// A stream that's already open is only reopened if it can't be started again (e.g. it lost its device).
+			if (!IsStreamOpen() || audioBackend->StartStream() != RTAUDIO_NO_ERROR)
+			{
+				OpenStream();
+				audioBackend->StartStream();
+			}
+			mixer.UpdateCurrentTime(audioBackend->GetStreamTime());
 		}
 
 		return ReturnCode::Success;
@@ -413,17 +643,107 @@ namespace DigiDAW::Core::Audio
 
 	ReturnCode Engine::StopEngine()
 	{
-		if (IsStreamRunning()) audioBackend->stopStream();
+		QuiesceStream();
+		return ReturnCode::Success;
+	}
+
+	// Fades the stream out and stops it (letting it play out what it's already been given), if it's running.
+	void Engine::QuiesceStream()
+	{
+		if (!IsStreamRunning()) return;
+
+		// A few blocks, in case the callback is running late.
+		const unsigned int blockMS = (currentSampleRate != 0) ? currentBufferSize * 1000 / currentSampleRate : 0;
+		mixer.FadeOut(4 * blockMS + 10);
+		audioBackend->StopStream();
+	}
+
+	void Engine::ScheduleCallbackThread()
+	{
+		std::lock_guard<std::mutex> lock(threadSettingsMutex);
+
+		if (threadSettings.realtime)
+		{
+			Threading::ThreadPriority::Scheduling scheduling(Threading::ThreadPriority::Priority::Realtime);
+			scheduling.realtimePriority = threadSettings.realtimePriority;
+			scheduling.roundRobin = threadSettings.roundRobin;
+			scheduling.firstCore = threadSettings.pinThreads ? 0 : -1;
+			callbackReport = Threading::ThreadPriority::ScheduleCurrentThread(scheduling, 0);
+		}
+		else
+		{
+			// Leave the priority to the audio API (some already run the callback with realtime scheduling).
+			callbackReport = Threading::ThreadPriority::Report();
+			if (threadSettings.pinThreads && Threading::ThreadPriority::SetCurrentThreadAffinity(0))
+				callbackReport.core = 0;
+			else if (!threadSettings.pinThreads)
+				Threading::ThreadPriority::UnpinCurrentThread();
+		}
+	}
+
+	ReturnCode Engine::SetThreadSettings(const ThreadSettings& settings)
+	{
+		using Threading::ThreadPriority;
+
+		if (settings.realtimePriority < 1 || settings.realtimePriority > 99)
+			return ReturnCode::Error;
+
+		const unsigned int nCores = ThreadPriority::GetCoreCount();
+		const bool isolateMeter = settings.pinThreads && nCores >= 3;
+
+		ThreadPriority::Scheduling workers(settings.realtime ? ThreadPriority::Priority::Realtime : ThreadPriority::Priority::Normal);
+		workers.realtimePriority = settings.realtimePriority;
+		workers.roundRobin = settings.roundRobin;
+		if (settings.pinThreads)
+		{
+			// Every core except the callback's (and the meter thread's), unless there's only one core.
+			workers.firstCore = nCores > 1 ? 1 : 0;
+			workers.nCores = std::max(nCores - static_cast<unsigned int>(workers.firstCore) - (isolateMeter ? 1u : 0u), 1u);
+		}
+
+		// The meter thread never needs to be realtime, so it's kept out of the way of the audio threads.
+		ThreadPriority::Scheduling meter(settings.realtime ? ThreadPriority::Priority::Low : ThreadPriority::Priority::Normal);
+		if (isolateMeter)
+			meter.firstCore = static_cast<int>(nCores - 1);
+
+		{
+			std::lock_guard<std::mutex> lock(threadSettingsMutex);
+			threadSettings = settings;
+		}
+		callbackScheduled = false;
+		mixer.SetThreadScheduling(workers, meter);
+		mixer.SetMaxTrackThreads(settings.maxTrackThreads);
+
 		return ReturnCode::Success;
 	}
 
+	Engine::ThreadSettings Engine::GetThreadSettings()
+	{
+		std::lock_guard<std::mutex> lock(threadSettingsMutex);
+		return threadSettings;
+	}
+
+	Engine::ThreadReport Engine::GetThreadReport()
+	{
+		ThreadReport report;
+		{
+			std::lock_guard<std::mutex> lock(threadSettingsMutex);
+			report.callback = callbackReport;
+		}
+		report.trackThreads = mixer.GetTrackThreadReports();
+		report.busThreads = mixer.GetBusThreadReports();
+		report.summingThreads = mixer.GetSummingThreadReports();
+		report.meterThread = mixer.GetMeterThreadReport();
+		return report;
+	}
+
 	bool Engine::IsStreamOpen()
 	{
-		return audioBackend->isStreamOpen();
+		return audioBackend->IsStreamOpen();
 	}
 
 	bool Engine::IsStreamRunning()
 	{
-		return audioBackend->isStreamRunning();
+		return audioBackend->IsStreamRunning();
 	}
 }
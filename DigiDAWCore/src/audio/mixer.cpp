@@ -2,6 +2,9 @@
 #include "digidaw/core/audio/engine.h"
 
 #include "detail/simdhelper.h"
+#include "detail/panning.h"
+#include "detail/bufferallocator.h"
+#include "detail/hash.h"
 
 namespace DigiDAW::Core::Audio
 {
@@ -12,32 +15,65 @@ namespace DigiDAW::Core::Audio
 		this->testToneStartTime = 0.0;
 		this->currentTime = 0.0;
 
+		// One summing thread less than the ranges (the bus thread sums one), and at most one per core besides the bus thread.
+		summingThreads.Resize(std::min<std::size_t>(maxSummingThreads - 1, std::max(Threading::ThreadPriority::GetCoreCount(), 2u) - 1));
+
 		audioEngine.trackState.addTrackCallbacks.push_back(
 			[&](std::shared_ptr<TrackState::Track> track) 
 			{
+				std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
 				std::lock_guard<std::mutex> lock(audioProcessingMutex); // Make sure we aren't currently using the data.
-				trackInfo[track.get()] = TrackInfo(track, audioEngine.GetCurrentBufferSize());
+				trackInfo[track.get()] = TrackInfo(track);
+				AddMeter(*track);
+				PrepareEffects(track);
+				PlanBuffers();
+				UpdateAnticipativeTracks();
 			});
 		audioEngine.trackState.removeTrackCallbacks.push_back(
 			[&](std::shared_ptr<TrackState::Track> track)
 			{
+				std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
 				std::lock_guard<std::mutex> lock(audioProcessingMutex);
 				trackInfo.erase(track.get());
-				mixableInfo.erase(track.get());
+				{
+					std::lock_guard<std::mutex> meterLock(meterMutex);
+					mixableInfo.erase(track.get());
+					meters.erase(track.get());
+				}
+				latencyInfo.erase(track.get());
+				PlanBuffers();
+				UpdateAnticipativeTracks();
+
+				// The buses it was an input of may have been aligned to it.
+				PropagateLatency(track.get());
 			});
 
 		audioEngine.trackState.addBusCallbacks.push_back(
 			[&](std::shared_ptr<TrackState::Bus> bus)
 			{
 				std::lock_guard<std::mutex> lock(audioProcessingMutex);
-				busInfo[bus.get()] = BusInfo(bus, audioEngine.GetCurrentBufferSize());
+				busInfo[bus.get()] = BusInfo(bus);
+				AddMeter(*bus);
+				PrepareEffects(bus);
+				PlanBuffers();
+
+				// Nothing can depend on a new bus yet, so only its own delay compensation needs to be computed.
+				UpdateBusLatency(bus);
+				UpdateOutputLatency();
 			});
 		audioEngine.trackState.removeBusCallbacks.push_back(
 			[&](std::shared_ptr<TrackState::Bus> bus)
 			{
 				std::lock_guard<std::mutex> lock(audioProcessingMutex);
 				busInfo.erase(bus.get());
-				mixableInfo.erase(bus.get());
+				{
+					std::lock_guard<std::mutex> meterLock(meterMutex);
+					mixableInfo.erase(bus.get());
+					meters.erase(bus.get());
+				}
+				latencyInfo.erase(bus.get());
+				PlanBuffers();
+				PropagateLatency(bus.get());
 			});
 
 		mixerThread = std::jthread(
@@ -49,8 +85,18 @@ namespace DigiDAW::Core::Audio
 				auto currentTime = std::chrono::high_resolution_clock::now();
 				auto lastTime = currentTime;
 
+				unsigned int appliedSchedulingVersion = 0;
+
 				while (running)
 				{
+					if (appliedSchedulingVersion != meterSchedulingVersion.load())
+					{
+						appliedSchedulingVersion = meterSchedulingVersion.load();
+
+						std::lock_guard<std::mutex> lock(meterSchedulingMutex);
+						meterReport = Threading::ThreadPriority::ScheduleCurrentThread(meterScheduling, 0);
+					}
+
 					// Copy tracks and buses to new vectors just incase any changes are made on a separate thread during processing.
 					const std::vector<std::shared_ptr<TrackState::Track>> tracks = audioEngine.trackState.ThreadedCopyAllTracks();
 					const std::vector<std::shared_ptr<TrackState::Bus>> buses = audioEngine.trackState.ThreadedCopyAllBuses();
@@ -59,103 +105,90 @@ namespace DigiDAW::Core::Audio
 					unsigned long long deltaTime = std::chrono::duration_cast<std::chrono::milliseconds>(
 						std::chrono::duration<double>(currentTime - lastTime)).count();
 
-					if (!tracks.empty() || !buses.empty())
+					const bool reset = resetClipping.exchange(false);
 					{
+						std::lock_guard<std::mutex> meterLock(meterMutex);
+
+						// Anything that's been removed since the copy is skipped.
 						for (const std::shared_ptr<TrackState::Bus>& bus : buses)
 						{
-							if (!mixableInfo[bus.get()].lookbackBuffers.empty())
-							{
-								std::lock_guard<std::mutex> lock(mixableInfo[bus.get()].lookbackBufferMutex);
-
-								Detail::SimdHelper::GetBufferRMSAndPeakMultiChannel(
-									mixableInfo[bus.get()].lookbackBuffers,
-									mixableInfo[bus.get()].lookbackBuffers[0].size(),
-									rmsBuffer,
-									peakBuffer);
-								mixableInfo[bus.get()].channels.resize(static_cast<std::size_t>(bus->nChannels));
-
-								for (unsigned int channel = 0; channel < static_cast<unsigned int>(bus->nChannels); ++channel)
-								{
-									LerpMeter(mixableInfo[bus.get()].channels[channel].rms, rmsBuffer[channel],
-										(float)deltaTime,
-										(float)meterRMSRiseTimeMS, (float)meterRMSFallTimeMS,
-										minimumDecibelLevel);
-									LerpMeter(mixableInfo[bus.get()].channels[channel].peak, peakBuffer[channel],
-										(float)deltaTime,
-										(float)meterPeakRiseTimeMS, (float)meterPeakFallTimeMS,
-										minimumDecibelLevel);
-
-									bool& clip = mixableInfo[bus.get()].channels[channel].clip;
-									if (!clip)
-										clip = mixableInfo[bus.get()].channels[channel].peak >= 0.0f;
-								}
-							}
-						}
+							auto infoIt = mixableInfo.find(bus.get());
+							auto meterIt = meters.find(bus.get());
+							if (infoIt == mixableInfo.end() || meterIt == meters.end()) continue;
 
-						for (const std::shared_ptr<TrackState::Track>& track : tracks)
-						{
-							if (!mixableInfo[track.get()].lookbackBuffers.empty())
+							// The spectrum is analyzed outside of the lock, so the audio thread only waits on the copy.
+							std::shared_ptr<SpectrumAnalyzer> spectrumAnalyzer;
 							{
-								std::lock_guard<std::mutex> lock(mixableInfo[track.get()].lookbackBufferMutex);
-
-								Detail::SimdHelper::GetBufferRMSAndPeakMultiChannel(
-									mixableInfo[track.get()].lookbackBuffers,
-									mixableInfo[track.get()].lookbackBuffers[0].size(),
-									rmsBuffer,
-									peakBuffer);
-								mixableInfo[track.get()].channels.resize(static_cast<std::size_t>(track->nChannels));
-
-								for (unsigned int channel = 0; channel < static_cast<unsigned int>(track->nChannels); ++channel)
-								{
-									LerpMeter(mixableInfo[track.get()].channels[channel].rms, rmsBuffer[channel],
-										(float)deltaTime,
-										(float)meterRMSRiseTimeMS, (float)meterRMSFallTimeMS,
-										minimumDecibelLevel);
-									LerpMeter(mixableInfo[track.get()].channels[channel].peak, peakBuffer[channel],
-										(float)deltaTime,
-										(float)meterPeakRiseTimeMS, (float)meterPeakFallTimeMS,
-										minimumDecibelLevel);
-
-									bool& clip = mixableInfo[track.get()].channels[channel].clip;
-									if (!clip)
-										clip = mixableInfo[track.get()].channels[channel].peak >= 0.0f;
-								}
+								std::lock_guard<std::mutex> lock(infoIt->second.lookbackBufferMutex);
+								spectrumAnalyzer = infoIt->second.spectrumAnalyzer;
 							}
+							if (spectrumAnalyzer)
+								spectrumAnalyzer->Update(static_cast<float>(deltaTime));
+
+							UpdateMeter(infoIt->second, *meterIt->second, static_cast<unsigned int>(bus->nChannels),
+								static_cast<float>(deltaTime), reset, rmsBuffer, peakBuffer);
 						}
 
-						if (!outputInfo.lookbackBuffers.empty())
+						for (const std::shared_ptr<TrackState::Track>& track : tracks)
 						{
-							std::lock_guard<std::mutex> lock(outputInfo.lookbackBufferMutex);
-
-							Detail::SimdHelper::GetBufferRMSAndPeakMultiChannel(
-								outputInfo.lookbackBuffers,
-								outputInfo.lookbackBuffers[0].size(),
-								rmsBuffer,
-								peakBuffer);
-							outputInfo.channels.resize(nOutChannels);
+							auto infoIt = mixableInfo.find(track.get());
+							auto meterIt = meters.find(track.get());
+							if (infoIt == mixableInfo.end() || meterIt == meters.end()) continue;
 
-							for (unsigned int channel = 0; channel < outputInfo.channels.size(); ++channel)
-							{
-								LerpMeter(outputInfo.channels[channel].rms, rmsBuffer[channel], 
-									(float)deltaTime,
-									(float)meterRMSRiseTimeMS, (float)meterRMSFallTimeMS, 
-									minimumDecibelLevel);
-								LerpMeter(outputInfo.channels[channel].peak, peakBuffer[channel],
-									(float)deltaTime,
-									(float)meterPeakRiseTimeMS, (float)meterPeakFallTimeMS,
-									minimumDecibelLevel);
-
-								bool& clip = outputInfo.channels[channel].clip;
-								if (!clip)
-									clip = outputInfo.channels[channel].peak >= 0.0f;
-							}
+							UpdateMeter(infoIt->second, *meterIt->second, static_cast<unsigned int>(track->nChannels),
+								static_cast<float>(deltaTime), reset, rmsBuffer, peakBuffer);
 						}
 					}
 
+					UpdateMeter(outputInfo, outputMeter, nOutChannels, static_cast<float>(deltaTime), reset, rmsBuffer, peakBuffer);
+
 					lastTime = currentTime;
 					std::this_thread::sleep_for(std::chrono::milliseconds(meterUpdateIntervalMS)); // Doesn't need to be accurate
 				}
 			});
+
+		anticipativeThread = std::jthread(
+			[&]()
+			{
+				std::vector<std::future<void>> renders;
+
+				while (running)
+				{
+					{
+						std::lock_guard<std::mutex> lock(anticipativeMutex);
+
+						// Every track that has room for another block renders one, in parallel.
+						anticipativeThreads.Resize(std::min<std::size_t>(anticipativeTracks.size(), Threading::ThreadPriority::GetCoreCount()));
+						renders.clear();
+						for (const std::shared_ptr<AnticipativeTrack>& anticipative : anticipativeTracks)
+							if (anticipative->fifo.GetReadableFrames() + anticipative->renderBuffer.GetFrameCount() <= anticipativeLookaheadFrames)
+								renders.push_back(anticipativeThreads.Queue([&, anticipative]() { RenderAhead(*anticipative); }));
+						for (std::future<void>& render : renders)
+							render.wait();
+					}
+
+					// The lock is given up between every block, so changes to the tracks and effects don't wait on the whole lookahead.
+					// Once every FIFO is full, there's nothing to do until the callback has read out some more.
+					if (renders.empty())
+						std::this_thread::sleep_for(std::chrono::milliseconds(2));
+					else
+						std::this_thread::yield();
+				}
+			});
+
+		freezeThread = std::jthread(
+			[&]()
+			{
+				// Renders run the effects, so they shouldn't process denormals either.
+				Threading::DenormalGuard denormalGuard;
+
+				std::unordered_map<const TrackState::Track*, PendingFreeze> pending;
+				while (running)
+				{
+					UpdateFrozenTracks(pending);
+					std::this_thread::sleep_for(std::chrono::milliseconds(freezeIntervalMS));
+				}
+			});
 	}
 
 	Mixer::~Mixer()
@@ -163,218 +196,1379 @@ namespace DigiDAW::Core::Audio
 		running = false;
 	}
 
-	void Mixer::UpdateAllTrackBuffers()
+	void Mixer::SetThreadScheduling(
+		const Threading::ThreadPriority::Scheduling& workers, const Threading::ThreadPriority::Scheduling& meter)
+	{
+		trackThreads.SetScheduling(workers);
+		busThreads.SetScheduling(workers);
+		summingThreads.SetScheduling(workers);
+
+		{
+			std::lock_guard<std::mutex> lock(meterSchedulingMutex);
+			meterScheduling = meter;
+		}
+		++meterSchedulingVersion;
+	}
+
+	Threading::ThreadPriority::Report Mixer::GetMeterThreadReport()
+	{
+		std::lock_guard<std::mutex> lock(meterSchedulingMutex);
+		return meterReport;
+	}
+
+	void Mixer::PrepareReconfiguration(unsigned int nFrames)
+	{
+		// The stream is still playing, so only copying what's planned from locks it out, not the planning.
+		BufferLayout layout;
+		{
+			std::lock_guard<std::mutex> lock(audioProcessingMutex);
+			if (pendingPlan && pendingPlan->nFrames == nFrames && pendingPlan->version == planVersion) return;
+			layout = GetBufferLayout();
+		}
+
+		// Planned into a new arena, as the current one is still being used by the stream.
+		pendingPlan = BuildBufferPlan(layout, nFrames, AudioArena());
+	}
+
+	void Mixer::Reconfigure()
 	{
 		const std::vector<std::shared_ptr<TrackState::Track>>& tracks = audioEngine.trackState.GetAllTracks();
+		const std::vector<std::shared_ptr<TrackState::Bus>>& buses = audioEngine.trackState.GetAllBuses();
+		const unsigned int nFrames = audioEngine.GetCurrentBufferSize();
+		const unsigned int sampleRate = audioEngine.GetCurrentSampleRate();
 
-		trackInfo.clear();
+		// The anticipative threads keep running while the stream is closed.
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
 
+		// The stream might not have been opened with the buffer size that was asked for, or the tracks might have changed since.
+		if (!pendingPlan || pendingPlan->nFrames != nFrames || pendingPlan->version != planVersion)
+			pendingPlan = BuildBufferPlan(GetBufferLayout(), nFrames, AudioArena());
+		BufferPlan plan = std::move(*pendingPlan);
+		pendingPlan.reset();
+
+		if (sampleRate != configuredSampleRate)
+		{
+			// Everything that's been rendered or delayed was at the old sample rate, so it all starts over.
+			trackInfo.clear();
+			for (const std::shared_ptr<TrackState::Track>& track : tracks)
+			{
+				trackInfo[track.get()] = TrackInfo(track);
+				PrepareEffects(track);
+			}
+
+			busInfo.clear();
+			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+			{
+				busInfo[bus.get()] = BusInfo(bus);
+				PrepareEffects(bus);
+			}
+
+			ApplyBufferPlan(plan);
+			RecomputeAllLatencies(); // All the delay lines were reallocated, so set all their delays again.
+
+			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+			{
+				auto it = mixableInfo.find(bus.get());
+				if (it != mixableInfo.end() && it->second.spectrumAnalyzer)
+					it->second.spectrumAnalyzer->Prepare(sampleRate);
+			}
+		}
+		else
+		{
+			// Only the effects of bigger blocks need preparing again (which resets them), otherwise their tails carry on.
+			if (GetMaxBlockFrames() != configuredMaxBlockFrames)
+			{
+				for (const std::shared_ptr<TrackState::Track>& track : tracks)
+					PrepareEffects(track);
+				for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+					PrepareEffects(bus);
+			}
+
+			ApplyBufferPlan(plan);
+
+			// The delay lines keep what they hold, they only need to make room for a bigger block.
+			for (auto& pair : busInfo)
+			{
+				BusInfo& info = pair.second;
+				for (DelayLine& delayLine : info.trackInputDelays) delayLine.SetDelay(delayLine.delay, nFrames);
+				for (DelayLine& delayLine : info.busInputDelays) delayLine.SetDelay(delayLine.delay, nFrames);
+				info.outputDelay.SetDelay(info.outputDelay.delay, nFrames);
+			}
+		}
+
+		configuredSampleRate = sampleRate;
+		configuredMaxBlockFrames = GetMaxBlockFrames();
+		UpdateAnticipativeTracks(); // Keeps the FIFOs unless the blocks or the lookahead got bigger.
+	}
+
+	bool Mixer::FadeOut(unsigned int timeoutMS)
+	{
+		fade = Fade::Out;
+
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMS);
+		while (fade.load() != Fade::Silent)
+		{
+			if (std::chrono::steady_clock::now() >= timeout) return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	void Mixer::FadeIn()
+	{
+		fade = Fade::In;
+	}
+
+	// Called by the callback at the end of every block.
+	inline void Mixer::ApplyFade(const AudioBufferView& output)
+	{
+		Fade current = fade.load(std::memory_order_acquire);
+		switch (current)
+		{
+		case Fade::None:
+			return;
+		case Fade::In:
+			for (unsigned int channel = 0; channel < output.GetChannelCount(); ++channel)
+				Detail::SimdHelper::MulScalarBufferRamp(0.0f, 1.0f, output, channel);
+			fade.compare_exchange_strong(current, Fade::None); // Unless it's been asked to fade out in the meantime.
+			return;
+		case Fade::Out:
+			for (unsigned int channel = 0; channel < output.GetChannelCount(); ++channel)
+				Detail::SimdHelper::MulScalarBufferRamp(1.0f, 0.0f, output, channel);
+			fade.compare_exchange_strong(current, Fade::Silent);
+			return;
+		case Fade::Silent:
+			Detail::SimdHelper::SetBuffer(output, 0.0f);
+			return;
+		}
+	}
+
+	// Plans the buffers again for the current buffer size, reusing the arena (with the audio threads locked out).
+	void Mixer::PlanBuffers()
+	{
+		++planVersion;
+		BufferPlan plan = BuildBufferPlan(GetBufferLayout(), audioEngine.GetCurrentBufferSize(), std::move(bufferArena));
+		ApplyBufferPlan(plan);
+	}
+
+	// Called with the audio threads locked out, as the TrackState, trackInfo and busInfo all change under audioProcessingMutex.
+	Mixer::BufferLayout Mixer::GetBufferLayout()
+	{
+		const std::vector<std::shared_ptr<TrackState::Track>>& tracks = audioEngine.trackState.GetAllTracks();
+		const std::vector<std::shared_ptr<TrackState::Bus>>& buses = audioEngine.trackState.GetAllBuses();
+
+		BufferLayout layout;
+		layout.version = planVersion;
+
+		// Number every node in processing order, tracks first, and then every bus after all of its inputs.
+		std::unordered_map<const TrackState::Mixable*, std::size_t> nodes;
 		for (const std::shared_ptr<TrackState::Track>& track : tracks)
-			trackInfo[track.get()] = TrackInfo(track, audioEngine.GetCurrentBufferSize());
+		{
+			if (!trackInfo.contains(track.get())) continue;
+			nodes[track.get()] = nodes.size();
+			layout.tracks.push_back({ track.get(), static_cast<unsigned int>(track->nChannels) });
+		}
+
+		std::unordered_map<const TrackState::Bus*, bool> visited;
+		std::function<void(const TrackState::Bus*)> visitBus = [&](const TrackState::Bus* bus)
+		{
+			if (!busInfo.contains(bus) || visited[bus]) return;
+			visited[bus] = true;
+			for (const TrackState::BusInput& input : bus->busInputs)
+				visitBus(input.bus.get());
+
+			BufferLayout::BusNode node;
+			node.bus = bus;
+			node.nChannels = static_cast<unsigned int>(bus->nChannels);
+			node.nInputChannels = GetMaxInputChannels(bus);
+			node.delaysInputs = bus->trackInputs.size() + bus->busInputs.size() > 1;
+			node.doublePrecisionSumming = UsesDoublePrecisionSumming(bus);
+			node.outputsToDevice = !bus->busChannelToDeviceOutputChannels.empty();
+			auto addInput = [&](const TrackState::Mixable* input)
+			{
+				auto it = nodes.find(input);
+				if (it != nodes.end()) node.inputs.push_back(it->second); // Otherwise the input has been removed.
+			};
+			for (const TrackState::TrackInput& input : bus->trackInputs) addInput(input.track.get());
+			for (const TrackState::BusInput& input : bus->busInputs) addInput(input.bus.get());
+
+			nodes[bus] = nodes.size();
+			layout.buses.push_back(std::move(node));
+		};
+		for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+			visitBus(bus.get());
+
+		return layout;
 	}
 
-	void Mixer::UpdateAllBusBuffers()
+	Mixer::BufferPlan Mixer::BuildBufferPlan(const BufferLayout& layout, unsigned int nFrames, AudioArena&& arena)
+	{
+		const std::size_t channelStride = AudioBufferView::GetAlignedStride(nFrames);
+		const std::size_t nTracks = layout.tracks.size();
+
+		// Every bus waits on its inputs, and so on everything they waited on.
+		const std::size_t nNodes = nTracks + layout.buses.size();
+		std::vector<std::vector<bool>> ancestors(nNodes, std::vector<bool>(nNodes));
+		std::vector<std::vector<std::size_t>> readers(nNodes);
+		for (std::size_t bus = 0; bus < layout.buses.size(); ++bus)
+		{
+			const std::size_t node = nTracks + bus;
+			for (std::size_t input : layout.buses[bus].inputs)
+			{
+				ancestors[node][input] = true;
+				for (std::size_t ancestor = 0; ancestor < nNodes; ++ancestor)
+					if (ancestors[input][ancestor]) ancestors[node][ancestor] = true;
+				readers[input].push_back(node);
+			}
+		}
+
+		// Request a buffer for every node, and the scratch buffers for the buses that need to align their inputs.
+		std::vector<Detail::BufferAllocator::Request> requests;
+		unsigned int nSilenceChannels = 0;
+		for (std::size_t track = 0; track < nTracks; ++track)
+		{
+			const BufferLayout::TrackNode& trackNode = layout.tracks[track];
+			requests.push_back({ track, static_cast<std::size_t>(trackNode.nChannels) * channelStride, readers[track] });
+			nSilenceChannels = std::max(nSilenceChannels, trackNode.nChannels);
+		}
+
+		unsigned int nOutputDelayChannels = 0;
+		for (std::size_t bus = 0; bus < layout.buses.size(); ++bus)
+		{
+			const BufferLayout::BusNode& busNode = layout.buses[bus];
+			const std::size_t node = nTracks + bus;
+			requests.push_back({ node, static_cast<std::size_t>(busNode.nChannels) * channelStride, readers[node], busNode.outputsToDevice });
+			if (busNode.outputsToDevice) nOutputDelayChannels = std::max(nOutputDelayChannels, busNode.nChannels);
+			nSilenceChannels = std::max(nSilenceChannels, busNode.nChannels);
+
+			// A single input is never delayed, as it's always the one with the most latency.
+			if (busNode.delaysInputs)
+				requests.push_back({ node, busNode.nInputChannels * channelStride });
+
+			// A double takes up the space of two floats.
+			if (busNode.doublePrecisionSumming)
+				requests.push_back({ node, 2 * static_cast<std::size_t>(busNode.nChannels) * channelStride });
+		}
+
+		std::vector<std::size_t> bufferSizes;
+		const std::vector<std::size_t> assigned = Detail::BufferAllocator::Allocate(requests, ancestors, bufferSizes);
+
+		BufferPlan plan;
+		plan.arena = std::move(arena);
+		plan.nFrames = nFrames;
+		plan.version = layout.version;
+
+		// Every buffer (and so every channel) is a multiple of the alignment, so they all stay aligned.
+		std::size_t arenaSize = static_cast<std::size_t>(nOutputDelayChannels + nSilenceChannels) * channelStride;
+		for (std::size_t size : bufferSizes) arenaSize += size;
+		plan.arena.Reset(arenaSize);
+
+		std::vector<float*> buffers;
+		for (std::size_t size : bufferSizes) buffers.push_back(plan.arena.AllocateSamples(size));
+		plan.outputDelayBuffer = plan.arena.Allocate(nOutputDelayChannels, nFrames);
+
+		// The arena isn't cleared when it's reused, and this is the only buffer that's read without being written first.
+		plan.silenceBuffer = plan.arena.Allocate(nSilenceChannels, nFrames);
+		Detail::SimdHelper::SetBuffer(plan.silenceBuffer, 0.0f);
+
+		// The requests were made in the same order as this.
+		std::size_t request = 0;
+		for (const BufferLayout::TrackNode& trackNode : layout.tracks)
+			plan.trackBuffers[trackNode.track] = AudioBufferView(buffers[assigned[request++]], trackNode.nChannels, nFrames, channelStride);
+		for (const BufferLayout::BusNode& busNode : layout.buses)
+		{
+			BufferPlan::BusBuffers& busBuffers = plan.busBuffers[busNode.bus];
+			busBuffers.mainBusBuffer = AudioBufferView(buffers[assigned[request++]], busNode.nChannels, nFrames, channelStride);
+			busBuffers.delayBuffer = busNode.delaysInputs ? 
+				AudioBufferView(buffers[assigned[request++]], busNode.nInputChannels, nFrames, channelStride) : AudioBufferView();
+			busBuffers.doubleBusBuffer = busNode.doublePrecisionSumming ? 
+				reinterpret_cast<double*>(buffers[assigned[request++]]) : nullptr;
+		}
+		return plan;
+	}
+
+	// Swaps in a plan, called with the audio threads locked out.
+	void Mixer::ApplyBufferPlan(BufferPlan& plan)
+	{
+		bufferArena = std::move(plan.arena);
+		outputDelayBuffer = plan.outputDelayBuffer;
+		silenceBuffer = plan.silenceBuffer;
+
+		for (auto& pair : trackInfo)
+		{
+			auto it = plan.trackBuffers.find(pair.first);
+			pair.second.mainTrackBuffer = (it != plan.trackBuffers.end()) ? it->second : AudioBufferView();
+		}
+		for (auto& pair : busInfo)
+		{
+			auto it = plan.busBuffers.find(pair.first);
+			const BufferPlan::BusBuffers busBuffers = (it != plan.busBuffers.end()) ? it->second : BufferPlan::BusBuffers();
+			pair.second.mainBusBuffer = busBuffers.mainBusBuffer;
+			pair.second.delayBuffer = busBuffers.delayBuffer;
+			pair.second.doubleBusBuffer = busBuffers.doubleBusBuffer;
+		}
+	}
+
+	void Mixer::SetDoublePrecisionSumming(bool enabled)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		doublePrecisionSumming = enabled;
+		PlanBuffers();
+	}
+
+	void Mixer::SetDoublePrecisionSumming(const std::shared_ptr<TrackState::Bus>& bus, bool enabled)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		bus->doublePrecisionSumming = enabled;
+		PlanBuffers();
+	}
+
+	unsigned int Mixer::GetMaxInputChannels(const TrackState::Bus* bus)
+	{
+		unsigned int nChannels = 0;
+		for (const TrackState::TrackInput& input : bus->trackInputs)
+			nChannels = std::max(nChannels, static_cast<unsigned int>(input.track->nChannels));
+		for (const TrackState::BusInput& input : bus->busInputs)
+			nChannels = std::max(nChannels, static_cast<unsigned int>(input.bus->nChannels));
+		return nChannels;
+	}
+
+	std::size_t Mixer::GetBufferMemory()
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+
+		std::size_t nSamples = bufferArena.GetSize() / sizeof(float);
+		for (const auto& pair : busInfo)
+		{
+			for (const DelayLine& delayLine : pair.second.trackInputDelays) nSamples += delayLine.buffer.size();
+			for (const DelayLine& delayLine : pair.second.busInputDelays) nSamples += delayLine.buffer.size();
+			nSamples += pair.second.outputDelay.buffer.size();
+		}
+		return nSamples * sizeof(float);
+	}
+
+	unsigned int Mixer::GetSourceLatency(const TrackState::Mixable* mixable)
+	{
+		auto it = latencyInfo.find(mixable);
+		return (it != latencyInfo.end()) ? it->second.outputLatency : 0;
+	}
+
+	// Recomputes the delay compensation for the inputs of this bus from the (already up to date) latency of its sources,
+	// returns whether or not the output latency of this bus has changed.
+	bool Mixer::UpdateBusLatency(const std::shared_ptr<TrackState::Bus>& bus)
+	{
+		if (!busInfo.contains(bus.get())) return false;
+		BusInfo& info = busInfo[bus.get()];
+		const unsigned int nFrames = audioEngine.GetCurrentBufferSize();
+
+		// Find the path with the most latency, which every other input needs to be aligned to.
+		unsigned int alignedLatency = 0;
+		for (const TrackState::TrackInput& input : bus->trackInputs)
+			alignedLatency = std::max(alignedLatency, GetSourceLatency(input.track.get()));
+		for (const TrackState::BusInput& input : bus->busInputs)
+			alignedLatency = std::max(alignedLatency, GetSourceLatency(input.bus.get()));
+
+		// Only the delay lines whose delay actually changed are touched.
+		for (unsigned int input = 0; input < bus->trackInputs.size() && input < info.trackInputDelays.size(); ++input)
+		{
+			unsigned int delay = alignedLatency - GetSourceLatency(bus->trackInputs[input].track.get());
+			if (info.trackInputDelays[input].delay != delay) info.trackInputDelays[input].SetDelay(delay, nFrames);
+		}
+		for (unsigned int input = 0; input < bus->busInputs.size() && input < info.busInputDelays.size(); ++input)
+		{
+			unsigned int delay = alignedLatency - GetSourceLatency(bus->busInputs[input].bus.get());
+			if (info.busInputDelays[input].delay != delay) info.busInputDelays[input].SetDelay(delay, nFrames);
+		}
+
+		LatencyInfo& latency = latencyInfo[bus.get()];
+		unsigned int previousOutputLatency = latency.outputLatency;
+		latency.outputLatency = alignedLatency + latency.processingLatency;
+		return latency.outputLatency != previousOutputLatency;
+	}
+
+	// Aligns all the buses that output to the device with each other.
+	void Mixer::UpdateOutputLatency()
 	{
 		const std::vector<std::shared_ptr<TrackState::Bus>>& buses = audioEngine.trackState.GetAllBuses();
+		const unsigned int nFrames = audioEngine.GetCurrentBufferSize();
 
-		busInfo.clear();
+		totalOutputLatency = 0;
+		for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+			if (!bus->busChannelToDeviceOutputChannels.empty())
+				totalOutputLatency = std::max(totalOutputLatency, GetSourceLatency(bus.get()));
 
 		for (const std::shared_ptr<TrackState::Bus>& bus : buses)
-			busInfo[bus.get()] = BusInfo(bus, audioEngine.GetCurrentBufferSize());
+		{
+			if (bus->busChannelToDeviceOutputChannels.empty() || !busInfo.contains(bus.get())) continue;
+
+			DelayLine& outputDelay = busInfo[bus.get()].outputDelay;
+			unsigned int delay = totalOutputLatency - GetSourceLatency(bus.get());
+			if (outputDelay.delay != delay) outputDelay.SetDelay(delay, nFrames);
+		}
+	}
+
+	void Mixer::RecomputeAllLatencies()
+	{
+		const std::vector<std::shared_ptr<TrackState::Bus>>& buses = audioEngine.trackState.GetAllBuses();
+
+		// Force every delay line to be set again, as they may have been reallocated for a new buffer size.
+		for (auto& pair : busInfo)
+		{
+			BusInfo& info = pair.second;
+			for (DelayLine& delayLine : info.trackInputDelays) delayLine = DelayLine(delayLine.nChannels);
+			for (DelayLine& delayLine : info.busInputDelays) delayLine = DelayLine(delayLine.nChannels);
+			info.outputDelay = DelayLine(info.outputDelay.nChannels);
+		}
+
+		// Buses can depend on other buses, so keep updating until nothing changes
+		// (the amount of passes is bounded by the longest chain of buses).
+		bool changed = true;
+		for (std::size_t pass = 0; changed && pass <= buses.size(); ++pass)
+		{
+			changed = false;
+			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+				changed |= UpdateBusLatency(bus);
+		}
+
+		UpdateOutputLatency();
+	}
+
+	void Mixer::SetProcessingLatency(const std::shared_ptr<TrackState::Mixable>& mixable, unsigned int latency)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		UpdateProcessingLatency(mixable.get(), latency);
+	}
+
+	void Mixer::UpdateProcessingLatency(const TrackState::Mixable* mixable, unsigned int latency)
+	{
+		LatencyInfo& info = latencyInfo[mixable];
+		if (info.processingLatency == latency) return;
+
+		// Update the output latency of this mixable (buses also add the latency of their aligned inputs).
+		info.outputLatency = info.outputLatency - info.processingLatency + latency;
+		info.processingLatency = latency;
+
+		PropagateLatency(mixable);
+	}
+
+	// Recomputes the delay compensation downstream of a mixable whose output latency changed (or that was removed),
+	// only touching the buses that depend on something that changed.
+	void Mixer::PropagateLatency(const TrackState::Mixable* mixable)
+	{
+		const std::vector<std::shared_ptr<TrackState::Bus>>& buses = audioEngine.trackState.GetAllBuses();
+		std::vector<const TrackState::Mixable*> changed = { mixable };
+		while (!changed.empty())
+		{
+			const TrackState::Mixable* source = changed.back();
+			changed.pop_back();
+
+			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
+			{
+				bool isInput = 
+					std::any_of(bus->trackInputs.begin(), bus->trackInputs.end(),
+						[source](const TrackState::TrackInput& input) { return input.track.get() == source; }) ||
+					std::any_of(bus->busInputs.begin(), bus->busInputs.end(),
+						[source](const TrackState::BusInput& input) { return input.bus.get() == source; });
+
+				if (isInput && UpdateBusLatency(bus))
+					changed.push_back(bus.get());
+			}
+		}
+
+		UpdateOutputLatency();
+	}
+
+	unsigned int Mixer::GetProcessingLatency(const std::shared_ptr<TrackState::Mixable>& mixable)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+
+		auto it = latencyInfo.find(mixable.get());
+		return (it != latencyInfo.end()) ? it->second.processingLatency : 0;
+	}
+
+	unsigned int Mixer::GetMaxBlockFrames()
+	{
+		return std::max(audioEngine.GetCurrentBufferSize(), anticipativeBlockFrames);
+	}
+
+	void Mixer::PrepareEffects(const std::shared_ptr<TrackState::Mixable>& mixable)
+	{
+		for (const std::shared_ptr<Effects::Effect>& effect : mixable->effects)
+			effect->Prepare(static_cast<unsigned int>(mixable->nChannels), 
+				GetMaxBlockFrames(), audioEngine.GetCurrentSampleRate());
 	}
 
-	inline void Mixer::ApplyGain(float gain, std::vector<float>& buffer, unsigned int nChannels, unsigned int nFrames)
+	void Mixer::AddEffect(const std::shared_ptr<TrackState::Mixable>& mixable, std::shared_ptr<Effects::Effect> effect)
+	{
+		// Prepare outside of the lock, as it can take a while and doesn't touch anything the audio threads use.
+		effect->Prepare(static_cast<unsigned int>(mixable->nChannels), 
+			GetMaxBlockFrames(), audioEngine.GetCurrentSampleRate());
+
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		mixable->effects.push_back(effect);
+
+		unsigned int chainLatency = 0;
+		for (const std::shared_ptr<Effects::Effect>& chainEffect : mixable->effects)
+			chainLatency += chainEffect->GetLatency();
+		UpdateProcessingLatency(mixable.get(), chainLatency);
+	}
+
+	void Mixer::RemoveEffect(const std::shared_ptr<TrackState::Mixable>& mixable, const std::shared_ptr<Effects::Effect>& effect)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		std::erase(mixable->effects, effect);
+
+		unsigned int chainLatency = 0;
+		for (const std::shared_ptr<Effects::Effect>& chainEffect : mixable->effects)
+			chainLatency += chainEffect->GetLatency();
+		UpdateProcessingLatency(mixable.get(), chainLatency);
+	}
+
+	void Mixer::SetAnticipativeProcessing(bool enabled, unsigned int lookaheadMS)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		anticipativeProcessing = enabled;
+		anticipativeLookaheadMS = lookaheadMS;
+		UpdateAnticipativeTracks();
+	}
+
+	void Mixer::SetDeterministicProcessing(bool enabled)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		deterministicProcessing = enabled;
+
+		// Frozen tracks go back to being processed straight away, rather than whenever the freeze thread gets to them.
+		if (enabled)
+			for (auto& pair : trackInfo)
+				pair.second.frozen.reset();
+		UpdateAnticipativeTracks();
+	}
+
+	void Mixer::SetLiveInput(const std::shared_ptr<TrackState::Track>& track, bool liveInput)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		track->liveInput = liveInput;
+		UpdateAnticipativeTracks();
+	}
+
+	void Mixer::SetClip(const std::shared_ptr<TrackState::Track>& track, const std::shared_ptr<const AudioBuffer>& clip)
+	{
+		std::uint64_t clipHash = 0;
+		if (clip)
+		{
+			clipHash = Detail::Hash::Combine(Detail::Hash::offsetBasis, clip->GetChannelCount());
+			clipHash = Detail::Hash::Combine(clipHash, clip->GetFrameCount());
+			for (unsigned int channel = 0; channel < clip->GetChannelCount(); ++channel)
+				clipHash = Detail::Hash::Bytes(clip->GetChannel(channel), clip->GetFrameCount() * sizeof(float), clipHash);
+		}
+
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		track->clip = clip;
+		track->clipHash = clipHash;
+
+		auto it = trackInfo.find(track.get());
+		if (it != trackInfo.end()) it->second.anticipative.reset();
+		UpdateAnticipativeTracks();
+	}
+
+	void Mixer::SetTransportPosition(std::size_t position)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		transportPosition = position;
+
+		for (auto& pair : trackInfo)
+			pair.second.anticipative.reset();
+		UpdateAnticipativeTracks();
+	}
+
+	std::size_t Mixer::GetTransportPosition()
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		return transportPosition;
+	}
+
+	// Decides which tracks are rendered ahead, called with both anticipativeMutex and audioProcessingMutex held.
+	void Mixer::UpdateAnticipativeTracks()
+	{
+		const unsigned int blockFrames = GetMaxBlockFrames();
+		anticipativeLookaheadFrames = std::max<std::size_t>(
+			static_cast<std::size_t>(anticipativeLookaheadMS) * audioEngine.GetCurrentSampleRate() / 1000, blockFrames);
+
+		anticipativeTracks.clear();
+		for (const std::shared_ptr<TrackState::Track>& track : audioEngine.trackState.GetAllTracks())
+		{
+			auto it = trackInfo.find(track.get());
+			if (it == trackInfo.end()) continue;
+
+			// Frozen tracks are only played back, so there's nothing to render ahead.
+			std::shared_ptr<AnticipativeTrack>& anticipative = it->second.anticipative;
+			if (!anticipativeProcessing || deterministicProcessing || track->liveInput || it->second.frozen)
+			{
+				anticipative.reset();
+				continue;
+			}
+
+			// A track that's still rendered ahead keeps what's already been rendered, unless the FIFO is now too small.
+			// Otherwise the first block is rendered straight away, so the callback doesn't run dry before the anticipative threads get to it.
+			if (!anticipative || anticipative->renderBuffer.GetFrameCount() != blockFrames ||
+				anticipative->fifo.GetCapacity() < anticipativeLookaheadFrames + blockFrames)
+			{
+				anticipative = std::make_shared<AnticipativeTrack>(track, anticipativeLookaheadFrames + blockFrames, blockFrames, transportPosition);
+				RenderAhead(*anticipative);
+			}
+			anticipativeTracks.push_back(anticipative);
+		}
+	}
+
+	bool Mixer::FreezeTrack(const std::shared_ptr<TrackState::Track>& track)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		if (track->liveInput || ComputeRenderKey(*track) == 0) return false;
+
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		track->frozen = true;
+		return true;
+	}
+
+	void Mixer::UnfreezeTrack(const std::shared_ptr<TrackState::Track>& track)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		track->frozen = false;
+
+		// With automatic freezing, it's only processed until the freeze thread freezes it again.
+		auto it = trackInfo.find(track.get());
+		if (it != trackInfo.end() && it->second.frozen)
+		{
+			it->second.frozen.reset();
+			UpdateAnticipativeTracks();
+		}
+	}
+
+	bool Mixer::IsTrackFrozen(const std::shared_ptr<TrackState::Track>& track)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		auto it = trackInfo.find(track.get());
+		return it != trackInfo.end() && it->second.frozen;
+	}
+
+	void Mixer::SetAutomaticFreezing(bool enabled)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		automaticFreezing = enabled;
+	}
+
+	std::uint64_t Mixer::GetRenderKey(const std::shared_ptr<TrackState::Track>& track)
+	{
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		return ComputeRenderKey(*track);
+	}
+
+	// Called with anticipativeMutex held, so the effects chain can't change.
+	std::uint64_t Mixer::ComputeRenderKey(const TrackState::Track& track)
+	{
+		// The gain and panning are applied live, so they aren't a part of the render.
+		std::uint64_t key = Detail::Hash::Combine(Detail::Hash::offsetBasis, renderKeyVersion);
+		key = Detail::Hash::Combine(key, track.nChannels);
+		key = Detail::Hash::Combine(key, track.clipHash);
+		key = Detail::Hash::Combine(key, audioEngine.GetCurrentSampleRate());
+
+		// A render that would never end (or is too long for a buffer) can't be made.
+		if (GetRenderFrames(track) > std::numeric_limits<unsigned int>::max() - anticipativeBlockFrames) return 0;
+
+		for (const std::shared_ptr<Effects::Effect>& effect : track.effects)
+		{
+			const std::uint64_t effectHash = effect->GetStateHash();
+			if (effectHash == 0) return 0;
+			key = Detail::Hash::Combine(key, effectHash);
+		}
+		return (key != 0) ? key : 1; // 0 means it can't be cached.
+	}
+
+	// The frames of the timeline a render of the track covers (see Freezing), the maximum if its effects never go silent.
+	std::size_t Mixer::GetRenderFrames(const TrackState::Track& track)
+	{
+		const std::size_t tailFrames = GetTailFrames(track.effects);
+		const std::size_t clipFrames = track.clip ? track.clip->GetFrameCount() : 0;
+		return (tailFrames <= std::numeric_limits<std::size_t>::max() - clipFrames) ? clipFrames + tailFrames : std::numeric_limits<std::size_t>::max();
+	}
+
+	// Renders the input and effects of a track from the start, track is a copy of it with copies of its effects.
+	std::shared_ptr<const AudioBuffer> Mixer::RenderTrack(const TrackState::Track& track, unsigned int sampleRate)
+	{
+		const unsigned int nChannels = static_cast<unsigned int>(track.nChannels);
+		const unsigned int nFrames = static_cast<unsigned int>(GetRenderFrames(track));
+
+		for (const std::shared_ptr<Effects::Effect>& effect : track.effects)
+			effect->Prepare(nChannels, anticipativeBlockFrames, sampleRate);
+
+		// Every block starts on a multiple of the block size, so they all stay aligned.
+		// The render starts out silent, so once the track is silent there's nothing left to do.
+		std::shared_ptr<AudioBuffer> render = std::make_shared<AudioBuffer>(nChannels, nFrames);
+		std::size_t silentFrames = 0;
+		for (unsigned int frame = 0; frame < nFrames; frame += anticipativeBlockFrames)
+			if (RenderTrackInput(track, render->GetView().GetFrames(frame, std::min(anticipativeBlockFrames, nFrames - frame)), frame, silentFrames))
+				break;
+		return render;
+	}
+
+	// One pass of the freeze thread (see Freezing), pending holds the settings every track is waiting to be frozen with.
+	void Mixer::UpdateFrozenTracks(std::unordered_map<const TrackState::Track*, PendingFreeze>& pending)
+	{
+		struct Render
+		{
+			std::shared_ptr<TrackState::Track> track;
+			std::uint64_t key;
+			TrackState::Track source; // A copy of the track with copies of its effects, so it can be rendered outside of the locks.
+			std::shared_ptr<const AudioBuffer> render;
+			std::size_t audibleFrames = 0;
+		};
+
+		const auto now = std::chrono::steady_clock::now();
+		const unsigned int sampleRate = audioEngine.GetCurrentSampleRate();
+		std::unordered_map<const TrackState::Track*, PendingFreeze> stillPending;
+		std::vector<Render> renders;
+
+		{
+			std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+			{
+				std::lock_guard<std::mutex> lock(audioProcessingMutex);
+
+				bool thawed = false;
+				for (const std::shared_ptr<TrackState::Track>& track : audioEngine.trackState.GetAllTracks())
+				{
+					auto it = trackInfo.find(track.get());
+					if (it == trackInfo.end()) continue;
+
+					const bool wanted = !deterministicProcessing && !track->liveInput && (track->frozen || automaticFreezing);
+					const std::uint64_t key = wanted ? ComputeRenderKey(*track) : 0;
+					std::shared_ptr<FrozenTrack>& frozen = it->second.frozen;
+					if (frozen && frozen->key == key) continue;
+
+					// The render is out of date (or isn't wanted anymore), so the track goes back to being processed.
+					if (frozen)
+					{
+						frozen.reset();
+						thawed = true;
+					}
+					if (key == 0) continue;
+
+					// The settings have to stay the same for a while, so a track isn't rendered again for every little change.
+					auto previous = pending.find(track.get());
+					const PendingFreeze pendingFreeze = (previous != pending.end() && previous->second.key == key) ? 
+						previous->second : PendingFreeze{ key, now };
+					stillPending[track.get()] = pendingFreeze;
+
+					if (now - pendingFreeze.since >= std::chrono::milliseconds(freezeDelayMS))
+						renders.push_back({ track, key, {}, nullptr, 0 });
+				}
+
+				if (thawed) UpdateAnticipativeTracks();
+			}
+
+			// Copying the effects can take a while (e.g. an impulse response), so the callback isn't held up for it.
+			for (Render& render : renders)
+			{
+				render.render = renderCache.Find(render.key);
+				if (render.render) continue;
+
+				render.source = *render.track;
+				render.source.effects.clear();
+				for (const std::shared_ptr<Effects::Effect>& effect : render.track->effects)
+					render.source.effects.push_back(effect->Clone());
+			}
+		}
+		pending = std::move(stillPending);
+
+		// Everything that hasn't been rendered before is rendered outside of the locks.
+		std::erase_if(renders, [](const Render& render)
+			{
+				return !render.render && std::any_of(render.source.effects.begin(), render.source.effects.end(),
+					[](const std::shared_ptr<Effects::Effect>& effect) { return !effect; });
+			});
+		for (Render& render : renders)
+		{
+			if (!render.render)
+			{
+				render.render = RenderTrack(render.source, sampleRate);
+				renderCache.Store(render.key, render.render);
+			}
+
+			// Find where the render goes silent for good, so playing it back can skip the rest (see Silence propagation).
+			for (unsigned int channel = 0; channel < render.render->GetChannelCount(); ++channel)
+			{
+				const float* samples = render.render->GetChannel(channel);
+				const float* last = std::find_if(std::make_reverse_iterator(samples + render.render->GetFrameCount()),
+					std::make_reverse_iterator(samples + render.audibleFrames), [](float sample) { return sample != 0.0f; }).base();
+				render.audibleFrames = std::max(render.audibleFrames, static_cast<std::size_t>(last - samples));
+			}
+		}
+
+		if (renders.empty()) return;
+
+		std::lock_guard<std::mutex> anticipativeLock(anticipativeMutex);
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		for (const Render& render : renders)
+		{
+			// The track might have been removed, or changed again, while it was being rendered.
+			auto it = trackInfo.find(render.track.get());
+			const bool wanted = !deterministicProcessing && !render.track->liveInput && (render.track->frozen || automaticFreezing);
+			if (it == trackInfo.end() || !wanted || ComputeRenderKey(*render.track) != render.key) continue;
+
+			it->second.frozen = std::make_shared<FrozenTrack>(render.key, render.render, render.audibleFrames);
+			pending.erase(render.track.get());
+		}
+		UpdateAnticipativeTracks();
+	}
+
+	// Renders the next block of a track into its FIFO, on one of the anticipative threads.
+	void Mixer::RenderAhead(AnticipativeTrack& anticipative)
+	{
+		const AudioBufferView& buffer = anticipative.renderBuffer.GetView();
+		if (RenderTrackInput(*anticipative.track, buffer, anticipative.startPosition + anticipative.renderedFrames, anticipative.silentFrames))
+			Detail::SimdHelper::SetBuffer(buffer, 0.0f); // The FIFO still needs the frames.
+		else
+			anticipative.audibleFrames.store(anticipative.renderedFrames + buffer.GetFrameCount(), std::memory_order_release);
+		anticipative.renderedFrames += anticipative.fifo.Write(buffer);
+	}
+
+	std::shared_ptr<SpectrumAnalyzer> Mixer::EnableSpectrumAnalyzer(const std::shared_ptr<TrackState::Bus>& bus)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		auto it = mixableInfo.find(bus.get());
+		if (it == mixableInfo.end()) return nullptr; // The bus isn't in the TrackState.
+
+		MixableInfo& info = it->second;
+		if (!info.spectrumAnalyzer)
+		{
+			std::shared_ptr<SpectrumAnalyzer> spectrumAnalyzer = std::make_shared<SpectrumAnalyzer>();
+			spectrumAnalyzer->Prepare(audioEngine.GetCurrentSampleRate());
+
+			std::lock_guard<std::mutex> lookbackLock(info.lookbackBufferMutex);
+			info.spectrumAnalyzer = spectrumAnalyzer;
+		}
+		return info.spectrumAnalyzer;
+	}
+
+	void Mixer::DisableSpectrumAnalyzer(const std::shared_ptr<TrackState::Bus>& bus)
+	{
+		std::lock_guard<std::mutex> lock(audioProcessingMutex);
+		auto it = mixableInfo.find(bus.get());
+		if (it == mixableInfo.end()) return; // The bus has already been removed.
+
+		std::lock_guard<std::mutex> lookbackLock(it->second.lookbackBufferMutex);
+		it->second.spectrumAnalyzer.reset();
+	}
+
+	inline AudioBufferView Mixer::ProcessDelayLine(DelayLine& delayLine, const AudioBufferView& src, const AudioBufferView& dst)
+	{
+		const AudioBufferView delayed = DelayFrames(delayLine, src, dst, 0, src.GetFrameCount());
+		delayLine.writePosition += src.GetFrameCount();
+		return delayed;
+	}
+
+	// Delays the frames [firstFrame, firstFrame + nFrames) of a block, without moving the delay line on to the next block.
+	inline AudioBufferView Mixer::DelayFrames(DelayLine& delayLine, const AudioBufferView& src, const AudioBufferView& dst,
+		unsigned int firstFrame, unsigned int nFrames)
+	{
+		if (delayLine.delay == 0 || dst.IsEmpty()) return src.GetFrames(firstFrame, nFrames);
+
+		for (unsigned int channel = 0; channel < delayLine.nChannels; ++channel)
+			Detail::SimdHelper::DelayBuffer(
+				src.GetChannel(channel),
+				dst.GetChannel(channel),
+				&delayLine.buffer[channel * delayLine.size], delayLine.size,
+				delayLine.writePosition, delayLine.delay, firstFrame, nFrames);
+
+		return dst.GetChannels(0, src.GetChannelCount()).GetFrames(firstFrame, nFrames);
+	}
+
+	inline void Mixer::ApplyEffects(const std::vector<std::shared_ptr<Effects::Effect>>& effects, const AudioBufferView& buffer)
+	{
+		for (const std::shared_ptr<Effects::Effect>& effect : effects)
+			effect->Process(buffer);
+	}
+
+	// How long the output of an effects chain can keep going after its input goes silent (the tails and latencies of every effect).
+	std::size_t Mixer::GetTailFrames(const std::vector<std::shared_ptr<Effects::Effect>>& effects)
+	{
+		std::size_t tailFrames = 0;
+		for (const std::shared_ptr<Effects::Effect>& effect : effects)
+		{
+			const unsigned int effectTail = effect->GetTailFrames();
+			if (effectTail == Effects::Effect::infiniteTail) return std::numeric_limits<std::size_t>::max();
+			tailFrames += static_cast<std::size_t>(effectTail) + effect->GetLatency();
+		}
+		return tailFrames;
+	}
+
+	// Whether an input has to be summed, a silent input is only summed while its delay line is flushed (see Silence propagation).
+	inline Mixer::InputState Mixer::GetInputState(bool silent, const DelayLine& delayLine)
+	{
+		if (!silent) return InputState::Audible;
+		return delayLine.IsFlushed() ? InputState::Silent : InputState::Flushing;
+	}
+
+	inline void Mixer::ApplyGain(float gain, const AudioBufferView& buffer)
 	{
 		// Perhaps use a lookup table for realtime mixing? (can calculate in realtime for extra accuracy when exporting)
 		float amplitudeFactor = std::powf(10.0f, gain / 20.0f);
-		Detail::SimdHelper::MulScalarBuffer(amplitudeFactor, buffer.data(), nChannels * nFrames, 0); // buffer = amplitudeFactor * buffer
+		Detail::SimdHelper::MulScalarBuffer(amplitudeFactor, buffer); // buffer = amplitudeFactor * buffer
+	}
+
+	inline void Mixer::ApplyBalance(float pan, PanMatrix& balance, const AudioBufferView& buffer)
+	{
+		const unsigned int nChannels = buffer.GetChannelCount();
+		if (nChannels < 2) return; // Mono is panned when it's mixed into a bus instead.
+
+		if (pan != balance.pan)
+		{
+			Detail::Panning::BalanceGains(nChannels, pan, balance.targetGains.data());
+			if (std::isnan(balance.pan)) // Nothing to ramp from the first time.
+				std::copy(balance.targetGains.begin(), balance.targetGains.end(), balance.gains.begin());
+			balance.pan = pan;
+		}
+
+		// channel = gain * channel
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+			Detail::SimdHelper::MulScalarBufferRamp(balance.gains[channel], balance.targetGains[channel], buffer, channel);
+
+		std::copy(balance.targetGains.begin(), balance.targetGains.end(), balance.gains.begin());
 	}
 
-	inline void Mixer::ApplyStereoPanning(float pan, std::vector<float>& buffer, unsigned int nChannels, unsigned int nFrames)
+	inline void Mixer::UpdateInputGains(const TrackState::ChannelMapping& mapping, const TrackState::Mixable& source, MappingMatrix& matrix)
 	{
-		if (nChannels != 2) return;
+		PanMatrix& gains = matrix.gains;
+
+		// Only recompute the gains when the panning changes.
+		if (source.pan != gains.pan || source.panDepth != gains.panDepth)
+		{
+			Detail::Panning::MappingGains(mapping.mapping, static_cast<unsigned int>(source.nChannels), mapping.layoutPanning,
+				source.pan, source.panDepth, matrix.mappingGains.data());
+
+			std::fill(gains.targetGains.begin(), gains.targetGains.end(), 0.0f);
+			for (std::size_t i = 0; i < matrix.mappingEntries.size(); ++i)
+				if (matrix.mappingEntries[i] >= 0)
+					gains.targetGains[matrix.mappingEntries[i]] += matrix.mappingGains[i];
+
+			if (std::isnan(gains.pan)) // Nothing to ramp from the first time.
+				std::copy(gains.targetGains.begin(), gains.targetGains.end(), gains.gains.begin());
+			gains.pan = source.pan;
+			gains.panDepth = source.panDepth;
+		}
+	}
 
-		// Sine-law panning
-		float panning = (pan / 200.0f) + 0.5f;
-		const float pidiv2 = pi<float> / 2.0f;
-		float rightAmplitude = std::sinf(panning * pidiv2);
-		float leftAmplitude = std::sinf((1.0f - panning) * pidiv2);
+	// Mixes the frames [firstFrame, firstFrame + src.GetFrameCount()) of the input into the same frames of the bus,
+	// ramping from the previous gains to the target gains over the whole block.
+	inline void Mixer::MixInput(
+		const AudioBufferView& src, const MappingMatrix& matrix, const AudioBufferView& busBuffer, double* doubleBusBuffer,
+		unsigned int firstFrame, unsigned int blockFrames)
+	{
+		const PanMatrix& gains = matrix.gains;
 
-		// leftChannel = leftAmplitude * leftChannel
-		// rightChannel = rightAmplitude * rightChannel
-		Detail::SimdHelper::MulScalarBufferStereo(leftAmplitude, rightAmplitude, buffer.data(), nFrames, 0, nFrames);
+		// busBuffer[destination] += gain * src[source], for every entry
+		if (doubleBusBuffer)
+			Detail::SimdHelper::MixSparseMatrixDouble(src, doubleBusBuffer, busBuffer.GetChannelStride(),
+				matrix.sources.data(), matrix.destinations.data(), gains.gains.data(), gains.targetGains.data(),
+				matrix.sources.size(), firstFrame, blockFrames);
+		else
+			Detail::SimdHelper::MixSparseMatrix(src, busBuffer, 
+				matrix.sources.data(), matrix.destinations.data(), gains.gains.data(), gains.targetGains.data(),
+				matrix.sources.size(), firstFrame, blockFrames);
+	}
+
+	inline void Mixer::SumInputs(const TrackState::Bus& bus, BusInfo& info, unsigned int firstFrame, unsigned int nFrames, unsigned int blockFrames)
+	{
+		const AudioBufferView busBuffer = info.mainBusBuffer.GetFrames(firstFrame, nFrames);
+		double* doubleBusBuffer = info.doubleBusBuffer ? info.doubleBusBuffer + firstFrame : nullptr;
+
+		// This can run on multiple threads at once, so the maps are only read with find.
+
+		// Process all the track inputs
+		for (unsigned int input = 0; input < bus.trackInputs.size(); ++input)
+		{
+			if (info.trackInputStates[input] == InputState::Silent) continue;
+			const TrackState::TrackInput& trackInput = bus.trackInputs[input];
+			const auto track = trackInfo.find(trackInput.track.get());
+			if (track == trackInfo.end()) continue; // The track has been removed.
+
+			// Delay the track if it has less latency than the other inputs of this bus.
+			const AudioBufferView source = (info.trackInputStates[input] == InputState::Flushing) ?
+				silenceBuffer.GetChannels(0, static_cast<unsigned int>(trackInput.track->nChannels)) : track->second.mainTrackBuffer;
+			const AudioBufferView trackBuffer = DelayFrames(info.trackInputDelays[input], 
+				source.GetFrames(0, blockFrames), info.delayBuffer, firstFrame, nFrames);
+
+			// Map (and pan) every channel of the track to its channels on this bus.
+			MixInput(trackBuffer, info.trackInputMatrices[input], busBuffer, doubleBusBuffer, firstFrame, blockFrames);
+		}
+
+		// Process all Bus inputs
+		for (unsigned int input = 0; input < bus.busInputs.size(); ++input)
+		{
+			if (info.busInputStates[input] == InputState::Silent) continue;
+			const TrackState::BusInput& busInput = bus.busInputs[input];
+			const auto sourceBus = busInfo.find(busInput.bus.get());
+			if (sourceBus == busInfo.end()) continue; // The bus has been removed.
+
+			// Delay the source bus if it has less latency than the other inputs of this bus.
+			const AudioBufferView source = (info.busInputStates[input] == InputState::Flushing) ?
+				silenceBuffer.GetChannels(0, static_cast<unsigned int>(busInput.bus->nChannels)) : sourceBus->second.mainBusBuffer;
+			const AudioBufferView sourceBusBuffer = DelayFrames(info.busInputDelays[input], 
+				source.GetFrames(0, blockFrames), info.delayBuffer, firstFrame, nFrames);
+
+			// Map (and pan, or downmix) every channel of the source bus to its channels on this bus.
+			MixInput(sourceBusBuffer, info.busInputMatrices[input], busBuffer, doubleBusBuffer, firstFrame, blockFrames);
+		}
+
+		// Round the double precision sum back to float for the rest of the processing.
+		if (doubleBusBuffer)
+			Detail::SimdHelper::ConvertDoubleBuffer(doubleBusBuffer, busBuffer.GetChannelStride(), busBuffer);
+	}
+
+	unsigned int Mixer::GetSummingRanges(const BusInfo& info, unsigned int nFrames)
+	{
+		if (info.summingCost < static_cast<float>(parallelSummingThresholdUS)) return 1;
+
+		// Every range is at least a cache line, and there's only one range per thread that can help.
+		const std::size_t maxRanges = std::min<std::size_t>({
+			maxSummingThreads,
+			summingThreads.GetThreadCount() + 1,
+			std::max<std::size_t>(nFrames / AudioBufferView::alignmentSamples, 1) });
+
+		// Enough ranges to bring each one under the threshold.
+		const std::size_t nRanges = static_cast<std::size_t>(info.summingCost / static_cast<float>(parallelSummingThresholdUS)) + 1;
+		return static_cast<unsigned int>(std::min(nRanges, maxRanges));
+	}
+
+	inline void Mixer::SumAllInputs(const TrackState::Bus& bus, BusInfo& info, unsigned int nFrames)
+	{
+		const unsigned int nRanges = GetSummingRanges(info, nFrames);
+		// Rounded up to whole cache lines, so every range stays aligned.
+		const unsigned int rangeFrames = static_cast<unsigned int>(AudioBufferView::GetAlignedStride((nFrames + nRanges - 1) / nRanges));
+
+		std::atomic<unsigned int> nextRange = 0;
+		std::atomic<long long> summingTime = 0; // In nanoseconds, across every thread.
+		auto sumRanges = [&]()
+			{
+				const auto start = std::chrono::steady_clock::now();
+				for (unsigned int range = nextRange++; range < nRanges; range = nextRange++)
+				{
+					const unsigned int firstFrame = range * rangeFrames;
+					if (firstFrame >= nFrames) break;
+					SumInputs(bus, info, firstFrame, std::min(rangeFrames, nFrames - firstFrame), nFrames);
+				}
+				summingTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			};
+
+		// The helpers only take whatever ranges are left when they start, so this thread never waits on a helper that hasn't started
+		// for anything but the helper to see there's nothing left.
+		std::array<std::future<void>, maxSummingThreads - 1> helpers;
+		for (unsigned int helper = 0; helper + 1 < nRanges; ++helper)
+			helpers[helper] = summingThreads.Queue(sumRanges);
+		sumRanges();
+		for (unsigned int helper = 0; helper + 1 < nRanges; ++helper)
+			helpers[helper].wait();
+
+		const float cost = static_cast<float>(summingTime.load()) / 1000.0f;
+		info.summingCost = (info.summingCost == 0.0f) ? cost : std::lerp(info.summingCost, cost, 0.1f);
+	}
+
+	inline void Mixer::CheckDenormals(const AudioBufferView& buffer)
+	{
+#ifndef NDEBUG
+		if (callbackCount % denormalCheckInterval != 0) return;
+
+		const std::size_t count = Detail::SimdHelper::CountDenormals(buffer);
+		if (count > 0) denormalCount.fetch_add(count, std::memory_order_relaxed);
+#endif
+	}
+
+	/*
+	 * The input of a track with the effects applied, from the frame of the timeline at position: the input device for a live track,
+	 * otherwise its clip (a copy of the track with copies of its effects when it's being frozen).
+	 * silentFrames counts how long the input has been silent for, and once that's longer than the tail of the effects
+	 * nothing is written to the buffer and this returns true, as the buffer is known to be silent (see Silence propagation).
+	 */
+	inline bool Mixer::RenderTrackInput(const TrackState::Track& track, const AudioBufferView& trackBuffer, std::size_t position, std::size_t& silentFrames)
+	{
+		const unsigned int nFrames = trackBuffer.GetFrameCount();
+
+		// Only whole blocks of silence count: the input device when it has none of the channels of the track,
+		// and the clip when the block is past the end of it (or there isn't one).
+		const unsigned int nSourceChannels = track.liveInput ? deviceInput.GetChannelCount() : (track.clip ? track.clip->GetChannelCount() : 0);
+		const std::size_t sourceFrames = track.liveInput ? nFrames : (track.clip ? track.clip->GetFrameCount() : 0);
+		const unsigned int nAudible = static_cast<unsigned int>(std::min<std::size_t>(nFrames, sourceFrames - std::min(position, sourceFrames)));
+		const bool inputSilent = nSourceChannels == 0 || nAudible == 0;
+		if (inputSilent && silentFrames >= GetTailFrames(track.effects))
+			return true;
+
+		// The input is written straight into the track buffer.
+		for (unsigned int channel = 0; channel < trackBuffer.GetChannelCount(); ++channel)
+		{
+			float* trackInput = trackBuffer.GetChannel(channel);
+			unsigned int nCopied = 0;
+			if (track.liveInput && channel < nSourceChannels)
+			{
+				Detail::SimdHelper::CopyBufferUnaligned(deviceInput.GetChannel(channel), trackInput, 0, 0, nFrames);
+				nCopied = nFrames;
+			}
+			else if (!track.liveInput && !inputSilent)
+			{
+				Detail::SimdHelper::CopyBufferUnaligned(track.clip->GetChannel(std::min(channel, nSourceChannels - 1)), trackInput, position, 0, nAudible);
+				nCopied = nAudible;
+			}
+			std::fill(trackInput + nCopied, trackInput + nFrames, 0.0f);
+		}
+
+		// Apply effects
+		ApplyEffects(track.effects, trackBuffer);
+
+		silentFrames = inputSilent ? silentFrames + nFrames : 0;
+		return false;
 	}
 
 	inline void Mixer::ProcessTrack(
-		std::vector<float>& trackInputBuffer, const std::shared_ptr<TrackState::Track>& track,
+		const std::shared_ptr<TrackState::Track>& track,
 		unsigned int nFrames, unsigned int sampleRate)
 	{
-		if (!trackInfo.contains(track.get())) return;
-		std::vector<float>& trackBuffer = trackInfo[track.get()].mainTrackBuffer.buffer;
-		if (trackBuffer.empty()) return;
-
-		// Copy input buffer to track output buffer
-		Detail::SimdHelper::CopyBuffer(trackInputBuffer.data(), trackBuffer.data(), 0, 0, 
-			static_cast<std::size_t>(track->nChannels) * nFrames);
+		const auto mixableIt = mixableInfo.find(track.get());
+		if (!trackInfo.contains(track.get()) || mixableIt == mixableInfo.end()) return;
+		TrackInfo& info = trackInfo[track.get()];
+		MixableInfo& mixable = mixableIt->second;
+		info.silent = true; // Until something is written to the track buffer.
+		if (info.mainTrackBuffer.IsEmpty() || nFrames > info.mainTrackBuffer.GetFrameCount()) return;
+		const AudioBufferView trackBuffer = info.mainTrackBuffer.GetFrames(0, nFrames);
+
+		if (info.frozen)
+		{
+			// Play back the render from the transport position, anything after the end of it is silence.
+			const AudioBuffer& render = *info.frozen->render;
+			const std::size_t position = transportPosition;
+			info.silent = position >= info.frozen->audibleFrames;
+			if (!info.silent)
+			{
+				const std::size_t renderFrames = render.GetFrameCount();
+				const unsigned int nRendered = static_cast<unsigned int>(std::min<std::size_t>(nFrames, renderFrames - std::min(position, renderFrames)));
+				for (unsigned int channel = 0; channel < trackBuffer.GetChannelCount(); ++channel)
+					Detail::SimdHelper::CopyBufferUnaligned(render.GetChannel(channel), trackBuffer.GetChannel(channel), position, 0, nRendered);
+				if (nRendered < nFrames)
+					Detail::SimdHelper::SetBuffer(trackBuffer.GetFrames(nRendered, nFrames - nRendered), 0.0f);
+			}
+		}
+		else if (info.anticipative)
+		{
+			// Already rendered ahead, if the anticipative threads have fallen behind the rest is played as silence.
+			// The FIFO is read before the silence is checked, so every frame that's read was flagged before it was written.
+			AnticipativeTrack& anticipative = *info.anticipative;
+			const std::size_t nReadable = std::min<std::size_t>(anticipative.fifo.GetReadableFrames(), nFrames);
+			info.silent = anticipative.playedFrames >= anticipative.audibleFrames.load(std::memory_order_acquire);
+			const std::size_t nRead = info.silent ? 
+				anticipative.fifo.Skip(nReadable) : anticipative.fifo.Read(trackBuffer.GetFrames(0, static_cast<unsigned int>(nReadable)));
+			anticipative.playedFrames += nRead;
+			if (nRead < nFrames)
+			{
+				if (!info.silent)
+					Detail::SimdHelper::SetBuffer(trackBuffer.GetFrames(static_cast<unsigned int>(nRead), nFrames - static_cast<unsigned int>(nRead)), 0.0f);
+				anticipativeUnderruns.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		else
+			info.silent = RenderTrackInput(*track, trackBuffer, transportPosition, info.silentFrames);
 
-		// TODO: Apply effects
+		if (info.silent)
+		{
+			// Nothing to apply the gain or panning to, the buses skip this track too.
+			AddSilenceToLookback(trackBuffer.GetChannelCount(), nFrames, mixable, sampleRate);
+			return;
+		}
+		CheckDenormals(trackBuffer);
 
 		// Apply gain
-		ApplyGain(track->gain, trackBuffer, static_cast<unsigned int>(track->nChannels), nFrames);
+		ApplyGain(track->gain, trackBuffer);
 
-		// TODO: Support Surround Panning
 		// Apply panning
-		if (track->nChannels == TrackState::ChannelNumber::Stereo)
-			ApplyStereoPanning(track->pan, trackBuffer, static_cast<unsigned int>(track->nChannels), nFrames);
+		ApplyBalance(track->pan, info.balance, trackBuffer);
 
 		// Add final output to the lookback buffer
-		AddToLookback(trackBuffer.data(), 
-			mixableInfo[track.get()].lookbackBuffers,
-			mixableInfo[track.get()].lookbackBufferMutex,
-			nFrames, static_cast<unsigned int>(track->nChannels), sampleRate);
+		mixable.lookbackSilentFrames = 0;
+		AddToLookback(trackBuffer, 
+			mixable.lookbackBuffers,
+			mixable.lookbackBufferMutex,
+			sampleRate);
 	}
 
 	inline void Mixer::ProcessBus(
 		const std::shared_ptr<TrackState::Bus>& bus,
 		unsigned int nFrames, unsigned int nOutChannels, unsigned int sampleRate)
 	{
-		if (bus->busChannelToDeviceOutputChannels.empty()) return;
-
-		// Note: These two loops do essentially the same thing
-		// just on different structs. We could use polymorphism, but then you'd probably have 
-		// to do a reinterpret_cast and get a little funky with it. And I think it's fairly easy 
-		// to understand with this code, just a little repetitive.
+		const auto mixableIt = mixableInfo.find(bus.get());
+		if (!busInfo.contains(bus.get()) || mixableIt == mixableInfo.end()) return;
+		BusInfo& info = busInfo[bus.get()];
+		MixableInfo& mixable = mixableIt->second;
+		info.silent = true; // Until something is written to the bus buffer.
+		if (info.mainBusBuffer.IsEmpty() || nFrames > info.mainBusBuffer.GetFrameCount()) return;
+		const AudioBufferView busBuffer = info.mainBusBuffer.GetFrames(0, nFrames);
+
+		// Wait for every input to finish processing before touching the bus buffer, 
+		// as it can be a pooled buffer that's only free once they (and everything they waited on) have finished.
+		// An input that was added after the callback copied the tracks and buses has never been queued, so there's nothing to wait on.
+		for (const TrackState::TrackInput& trackInput : bus->trackInputs)
+		{
+			auto input = mixableInfo.find(trackInput.track.get());
+			if (input != mixableInfo.end() && input->second.processAsync.valid()) input->second.processAsync.wait();
+		}
+		for (const TrackState::BusInput& busInput : bus->busInputs)
+		{
+			auto input = mixableInfo.find(busInput.bus.get());
+			if (input != mixableInfo.end() && input->second.processAsync.valid()) input->second.processAsync.wait();
+		}
 
-		// Process all the track inputs
+		// Find out which inputs have anything to sum (see Silence propagation).
+		bool inputsSilent = true;
 		for (unsigned int input = 0; input < bus->trackInputs.size(); ++input)
 		{
-			const TrackState::TrackInput& trackInput = bus->trackInputs[input];
-			mixableInfo[trackInput.track.get()].processAsync.wait(); // Wait for the specified track to finish processing.
-
-			// Loop through each channel in the track to get its corresponding outputs to the bus
-			for (unsigned int channel = 0; channel < static_cast<unsigned int>(trackInput.track->nChannels); ++channel)
-			{
-				if (trackInput.trackToBusMap.mapping[channel].empty()) continue;
-
-				// Copy the track buffer to this buffer
-				// for expanding the amount of channels that the track has to the amount of channels of the bus
-				// so that we can apply panning to Mono tracks.
-				std::vector<float>& channelInputBuffer = busInfo[bus.get()].trackInputBuffers[input][channel].buffer;
-				for (unsigned int inChannel = 0; inChannel < static_cast<unsigned int>(
-					trackInput.trackToBusMap.mapping[channel].size()); ++inChannel)
-					Detail::SimdHelper::CopyBuffer(
-						trackInfo[trackInput.track.get()].mainTrackBuffer.buffer.data(),
-						channelInputBuffer.data(),
-						channel * nFrames, inChannel * nFrames, nFrames);
-
-				// TODO: Support Surround Panning
-				// Apply panning (for panning Mono tracks to Stereo buses)
-				if (trackInput.trackToBusMap.mapping[channel].size() == static_cast<std::size_t>(TrackState::ChannelNumber::Stereo)
-					&& trackInput.track->nChannels == TrackState::ChannelNumber::Mono)
-					ApplyStereoPanning(trackInput.track->pan, channelInputBuffer,
-						trackInput.trackToBusMap.mapping[channel].size(),
-						nFrames);
-
-				// Go through each output for this track channel (one track channel -> multiple bus channel mapping)
-				unsigned int trackChannel = 0;
-				for (unsigned int busChannel : trackInput.trackToBusMap.mapping[channel])
-				{
-					// Finally, pass the track output to the bus buffer as the input
-					std::vector<float>& busOutputBuffer = busInfo[bus.get()].mainBusBuffer.buffer;
-
-					// busOutputBuffer[busChannel] += channelOutputBuffer[trackChannel]
-					Detail::SimdHelper::AccumulateBuffer(
-						channelInputBuffer.data(),
-						busOutputBuffer.data(),
-						trackChannel * nFrames, busChannel * nFrames,
-						nFrames);
-
-					++trackChannel;
-				}
-			}
+			const auto track = trackInfo.find(bus->trackInputs[input].track.get());
+			info.trackInputStates[input] = GetInputState(track == trackInfo.end() || track->second.silent, info.trackInputDelays[input]);
+			inputsSilent &= info.trackInputStates[input] == InputState::Silent;
 		}
-
-		// Process all Bus inputs
 		for (unsigned int input = 0; input < bus->busInputs.size(); ++input)
 		{
-			const TrackState::BusInput& busInput = bus->busInputs[input];
-			mixableInfo[busInput.bus.get()].processAsync.wait(); // Wait for the specified bus to finish processing.
-
-			// Loop through each channel in the source bus to get its corresponding outputs to this bus
-			for (unsigned int channel = 0; channel < static_cast<unsigned int>(busInput.bus->nChannels); ++channel)
-			{
-				if (busInput.busToBusMap.mapping[channel].empty()) continue;
-
-				// Copy the bus buffer to this buffer
-				// for expanding the amount of channels that the bus has to the amount of channels of the bus
-				// so that we can apply panning to Mono buses.
-				std::vector<float>& channelInputBuffer = busInfo[bus.get()].busInputBuffers[input][channel].buffer;
-				for (unsigned int inChannel = 0; inChannel < static_cast<unsigned int>(
-					busInput.busToBusMap.mapping[channel].size()); ++inChannel)
-					Detail::SimdHelper::CopyBuffer(
-						busInfo[busInput.bus.get()].mainBusBuffer.buffer.data(),
-						channelInputBuffer.data(),
-						channel * nFrames, inChannel * nFrames, nFrames);
-
-				// TODO: Support Surround Panning
-				// Apply panning (for panning Mono tracks to Stereo buses)
-				if (busInput.busToBusMap.mapping[channel].size() == static_cast<std::size_t>(TrackState::ChannelNumber::Stereo)
-					&& busInput.bus->nChannels == TrackState::ChannelNumber::Mono)
-					ApplyStereoPanning(busInput.bus->pan, channelInputBuffer,
-						busInput.busToBusMap.mapping[channel].size(),
-						nFrames);
-
-				// Go through each output for this track channel (one track channel -> multiple bus channel mapping)
-				unsigned int srcChannel = 0;
-				for (unsigned int dstChannel : busInput.busToBusMap.mapping[channel])
-				{
-					// Finally, pass the bus output to the destination bus buffer as the input
-					std::vector<float>& busOutputBuffer = busInfo[bus.get()].mainBusBuffer.buffer;
+			const auto sourceBus = busInfo.find(bus->busInputs[input].bus.get());
+			info.busInputStates[input] = GetInputState(sourceBus == busInfo.end() || sourceBus->second.silent, info.busInputDelays[input]);
+			inputsSilent &= info.busInputStates[input] == InputState::Silent;
+		}
 
-					// busOutputBuffer[busChannel] += channelOutputBuffer[trackChannel]
-					Detail::SimdHelper::AccumulateBuffer(
-						channelInputBuffer.data(),
-						busOutputBuffer.data(),
-						srcChannel * nFrames, dstChannel * nFrames,
-						nFrames);
+		// Every input has been silent for longer than the tail of the effects, so there's nothing to process.
+		// The delay lines of the inputs have all been flushed, so they don't need to move on either.
+		info.silent = inputsSilent && info.silentFrames >= GetTailFrames(bus->effects);
+		if (info.silent)
+		{
+			AddSilenceToLookback(busBuffer.GetChannelCount(), nFrames, mixable, sampleRate);
 
-					++srcChannel;
-				}
-			}
+			if (mixable.spectrumAnalyzer)
+				mixable.spectrumAnalyzer->Push(silenceBuffer.GetChannels(0, busBuffer.GetChannelCount()).GetFrames(0, nFrames));
+			return;
 		}
+		info.silentFrames = inputsSilent ? info.silentFrames + nFrames : 0;
 
-		if (!busInfo.contains(bus.get())) return;
-		std::vector<float>& busBuffer = busInfo[bus.get()].mainBusBuffer.buffer;
-		if (busBuffer.empty()) return;
+		// Zero out the bus buffer
+		Detail::SimdHelper::SetBuffer(busBuffer, 0.0f);
 
-		// TODO: Apply effects
+		if (!inputsSilent)
+		{
+			if (info.doubleBusBuffer)
+				std::fill_n(info.doubleBusBuffer, static_cast<std::size_t>(bus->nChannels) * busBuffer.GetChannelStride(), 0.0);
+
+			// Pan changes are picked up before summing (which might be split between threads), and ramped over this block.
+			for (unsigned int input = 0; input < bus->trackInputs.size(); ++input)
+				UpdateInputGains(bus->trackInputs[input].trackToBusMap, *bus->trackInputs[input].track, info.trackInputMatrices[input]);
+			for (unsigned int input = 0; input < bus->busInputs.size(); ++input)
+				UpdateInputGains(bus->busInputs[input].busToBusMap, *bus->busInputs[input].bus, info.busInputMatrices[input]);
+
+			SumAllInputs(*bus, info, nFrames);
+
+			// The next block ramps from where this one ended, and the delay lines move on to the next block.
+			for (MappingMatrix& matrix : info.trackInputMatrices)
+				std::copy(matrix.gains.targetGains.begin(), matrix.gains.targetGains.end(), matrix.gains.gains.begin());
+			for (MappingMatrix& matrix : info.busInputMatrices)
+				std::copy(matrix.gains.targetGains.begin(), matrix.gains.targetGains.end(), matrix.gains.gains.begin());
+			for (unsigned int input = 0; input < info.trackInputDelays.size(); ++input)
+			{
+				DelayLine& delayLine = info.trackInputDelays[input];
+				delayLine.writePosition += nFrames;
+				delayLine.silentFrames = (info.trackInputStates[input] == InputState::Audible) ? 0 : delayLine.silentFrames + nFrames;
+			}
+			for (unsigned int input = 0; input < info.busInputDelays.size(); ++input)
+			{
+				DelayLine& delayLine = info.busInputDelays[input];
+				delayLine.writePosition += nFrames;
+				delayLine.silentFrames = (info.busInputStates[input] == InputState::Audible) ? 0 : delayLine.silentFrames + nFrames;
+			}
+		}
+
+		// Apply effects
+		ApplyEffects(bus->effects, busBuffer);
+		CheckDenormals(busBuffer);
 
-		// TODO: Support Surround Panning
 		// Apply panning
-		if (bus->nChannels == TrackState::ChannelNumber::Stereo)
-			ApplyStereoPanning(bus->pan, busBuffer, static_cast<unsigned int>(bus->nChannels), nFrames);
+		ApplyBalance(bus->pan, info.balance, busBuffer);
 
 		// Apply gain
-		ApplyGain(bus->gain, busBuffer, static_cast<unsigned int>(bus->nChannels), nFrames);
+		ApplyGain(bus->gain, busBuffer);
 
 		// Add final output to the lookback buffer
-		AddToLookback(busBuffer.data(), 
-			mixableInfo[bus.get()].lookbackBuffers,
-			mixableInfo[bus.get()].lookbackBufferMutex,
-			nFrames, static_cast<unsigned int>(bus->nChannels), sampleRate);
+		mixable.lookbackSilentFrames = 0;
+		AddToLookback(busBuffer, 
+			mixable.lookbackBuffers,
+			mixable.lookbackBufferMutex,
+			sampleRate);
+
+		if (mixable.spectrumAnalyzer)
+			mixable.spectrumAnalyzer->Push(busBuffer);
 	}
 
 	void Mixer::ResetClippingIndicators()
 	{
-		for (auto& pair : mixableInfo)
-		{
-			MixableInfo& info = pair.second;
-			for (ChannelInfo& channel : info.channels)
+		// The levels are only ever changed by the meter thread.
+		resetClipping = true;
+	}
+
+	// Called from the TrackState callbacks, with audioProcessingMutex held.
+	void Mixer::AddMeter(const TrackState::Mixable& mixable)
+	{
+		std::lock_guard<std::mutex> meterLock(meterMutex);
+		mixableInfo.try_emplace(&mixable);
+		meters[&mixable] = std::make_unique<MeterInfo>(static_cast<std::size_t>(mixable.nChannels));
+	}
+
+	void Mixer::UpdateMeter(MixableInfo& info, MeterInfo& meter, unsigned int nChannels, float deltaTime, bool resetClipping,
+		std::vector<float>& rmsBuffer, std::vector<float>& peakBuffer)
+	{
+		if (resetClipping)
+			for (ChannelInfo& channel : meter.channels)
 				channel.clip = false;
+
+		{
+			std::lock_guard<std::mutex> lock(info.lookbackBufferMutex);
+			if (info.lookbackBuffers.empty())
+			{
+				if (resetClipping) meter.meter.Publish(meter.channels);
+				return;
+			}
+
+			Detail::SimdHelper::GetBufferRMSAndPeakMultiChannel(
+				info.lookbackBuffers,
+				info.lookbackBuffers[0].size(),
+				rmsBuffer,
+				peakBuffer);
 		}
 
-		for (ChannelInfo& channel : outputInfo.channels)
-			channel.clip = false;
+		meter.channels.resize(std::min<std::size_t>({ nChannels, rmsBuffer.size(), static_cast<std::size_t>(TrackState::ChannelNumber::MAX) }));
+		for (std::size_t channel = 0; channel < meter.channels.size(); ++channel)
+		{
+			LerpMeter(meter.channels[channel].rms, rmsBuffer[channel],
+				deltaTime,
+				(float)meterRMSRiseTimeMS, (float)meterRMSFallTimeMS,
+				minimumDecibelLevel);
+			LerpMeter(meter.channels[channel].peak, peakBuffer[channel],
+				deltaTime,
+				(float)meterPeakRiseTimeMS, (float)meterPeakFallTimeMS,
+				minimumDecibelLevel);
+
+			bool& clip = meter.channels[channel].clip;
+			if (!clip)
+				clip = meter.channels[channel].peak >= 0.0f;
+		}
+
+		meter.meter.Publish(meter.channels);
 	}
 
 	void Mixer::Mix(
@@ -384,10 +1578,15 @@ namespace DigiDAW::Core::Audio
 		unsigned int nFrames,
 		unsigned int nOutChannels, unsigned int nInChannels, unsigned int sampleRate)
 	{
+		// The callback thread is owned by the audio API, so the floating point state it had is put back afterwards.
+		Threading::DenormalGuard denormalGuard;
+
 		this->nOutChannels = nOutChannels;
 
 		currentTime = time;
 
+		const AudioBufferView output(outputBuffer, nOutChannels, nFrames);
+
 		// Copy tracks and buses to new vectors just incase any changes are made on a separate thread during processing.
 		const std::vector<std::shared_ptr<TrackState::Track>> tracks = audioEngine.trackState.ThreadedCopyAllTracks();
 		const std::vector<std::shared_ptr<TrackState::Bus>> buses = audioEngine.trackState.ThreadedCopyAllBuses();
@@ -395,14 +1594,13 @@ namespace DigiDAW::Core::Audio
 		if (!doTestTone)
 		{
 			std::lock_guard<std::mutex> lock(audioProcessingMutex);
+			++callbackCount;
 
-			// Zero out bus buffers
-			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
-				Detail::SimdHelper::SetBuffer(busInfo[bus.get()].mainBusBuffer.buffer.data(), 0.0f,
-					static_cast<std::size_t>(bus->nChannels) * nFrames, 0);
+			deviceInput = (inputBuffer && nInChannels > 0) ? AudioBufferView(inputBuffer, nInChannels, nFrames) : AudioBufferView();
 
-			// Process Tracks (one thread per track)
-			trackThreads.Resize(tracks.size());
+			// Process Tracks (one thread per track, unless they're capped)
+			const std::size_t maxThreads = maxTrackThreads;
+			trackThreads.Resize((maxThreads != 0) ? std::min(tracks.size(), maxThreads) : tracks.size());
 			for (const std::shared_ptr<TrackState::Track>& track : tracks)
 			{
 				// Track Sends will probably complicate this more, 
@@ -414,28 +1612,12 @@ namespace DigiDAW::Core::Audio
 				// Of course this'd be slower than doing it completely parallel, 
 				// but it's necessary since the track being sent to would depend 
 				// on the other track to finish processing.
-				mixableInfo[track.get()].processAsync = trackThreads.Queue(
+				auto mixable = mixableInfo.find(track.get());
+				if (mixable == mixableInfo.end()) continue;
+				mixable->second.processAsync = trackThreads.Queue(
 					[&]()
 					{
-						//thread_local static std::random_device rd; // For debugging
-						//thread_local static std::mt19937 rng(rd()); // For debugging
-						//thread_local std::uniform_real_distribution<float> urd(0.0f, 1.0f); // For debugging
-
-						// Currently we'll use silence for track inputs
-						std::vector<float> trackInput(static_cast<std::size_t>(track->nChannels) * nFrames);
-						for (unsigned int channel = 0; channel < static_cast<unsigned int>(track->nChannels); ++channel)
-						{
-							for (unsigned int frame = 0; frame < nFrames; ++frame)
-							{
-								//trackInput[(channel * nFrames) + frame] = urd(rng); // For debugging
-								
-								//double sampleTime = (time + (static_cast<double>(frame) / static_cast<double>(sampleRate))); // For debugging
-								//trackInput[(channel * nFrames) + frame] = (std::cosf(2.0f * pi<float> * 440.0f * sampleTime) * 0.5f) + 0.5f; // For debugging
-
-								trackInput[(channel * nFrames) + frame] = 0.0f;
-							}
-						}
-						ProcessTrack(trackInput, track, nFrames, sampleRate);
+						ProcessTrack(track, nFrames, sampleRate);
 					});
 			}
 
@@ -443,7 +1625,9 @@ namespace DigiDAW::Core::Audio
 			busThreads.Resize(buses.size());
 			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
 			{
-				mixableInfo[bus.get()].processAsync = busThreads.Queue(
+				auto mixable = mixableInfo.find(bus.get());
+				if (mixable == mixableInfo.end()) continue;
+				mixable->second.processAsync = busThreads.Queue(
 					[&]()
 					{
 						ProcessBus(bus, nFrames, nOutChannels, sampleRate);
@@ -453,7 +1637,25 @@ namespace DigiDAW::Core::Audio
 			// Send buses to output
 			for (const std::shared_ptr<TrackState::Bus>& bus : buses)
 			{
-				mixableInfo[bus.get()].processAsync.wait();
+				auto mixable = mixableInfo.find(bus.get());
+				if (mixable == mixableInfo.end()) continue;
+				mixable->second.processAsync.wait();
+
+				// Buses without device outputs were only processed for the buses they're an input of.
+				auto infoIt = busInfo.find(bus.get());
+				if (infoIt == busInfo.end() || bus->busChannelToDeviceOutputChannels.empty()) continue;
+				BusInfo& info = infoIt->second;
+				if (info.mainBusBuffer.IsEmpty() || nFrames > info.mainBusBuffer.GetFrameCount()) continue;
+
+				// A silent bus is only sent out while its output delay is being flushed.
+				DelayLine& outputDelay = info.outputDelay;
+				if (info.silent && outputDelay.IsFlushed()) continue;
+				outputDelay.silentFrames = info.silent ? outputDelay.silentFrames + nFrames : 0;
+
+				// Align this bus with the other buses that output to the device.
+				const AudioBufferView busBuffer = ProcessDelayLine(outputDelay, 
+					(info.silent ? silenceBuffer.GetChannels(0, static_cast<unsigned int>(bus->nChannels)) : info.mainBusBuffer).GetFrames(0, nFrames),
+					outputDelayBuffer);
 
 				// Send out to output device / buffer
 				for (unsigned int channel = 0; channel < static_cast<unsigned int>(bus->nChannels); ++channel)
@@ -465,14 +1667,19 @@ namespace DigiDAW::Core::Audio
 						// TODO: Mono Bus Panning
 
 						// outputBuffer[outChannel] += busBuffers[bus].buffer[channel]
-						Detail::SimdHelper::AccumulateBuffer(
-							busInfo[bus.get()].mainBusBuffer.buffer.data(),
-							outputBuffer, 
-							channel * nFrames, outChannel * nFrames, 
-							nFrames);
+						Detail::SimdHelper::AccumulateBuffer(busBuffer, channel, output, outChannel);
 					}
 				}
 			}
+
+			// The tracks that were already playing this block finish before the timeline moves on (the rest are cancelled, see below).
+			trackThreads.CancelPending();
+			for (const std::shared_ptr<TrackState::Track>& track : tracks)
+			{
+				auto it = mixableInfo.find(track.get());
+				if (it != mixableInfo.end()) it->second.processAsync.wait();
+			}
+			transportPosition += nFrames;
 		}
 		else
 		{
@@ -493,21 +1700,26 @@ namespace DigiDAW::Core::Audio
 
 		// Cancel all pending tasks and make sure all the currently executing tasks finish.
 		// (would be better if there was a way to cancel currently executing tasks)
+		// Anything added since the tracks and buses were copied hasn't been queued yet.
 		trackThreads.CancelPending();
 		for (auto& pair : mixableInfo)
-			pair.second.processAsync.wait();
+			if (pair.second.processAsync.valid()) pair.second.processAsync.wait();
 
-		AddToLookback(outputBuffer, 
+		ApplyFade(output);
+
+		AddToLookback(output, 
 			outputInfo.lookbackBuffers,
 			outputInfo.lookbackBufferMutex, 
-			nFrames, nOutChannels, sampleRate);
+			sampleRate);
 	}
 
 	inline void Mixer::AddToLookback(
-		float* src, std::vector<std::vector<float>>& dst, 
-		std::mutex& mutex, 
-		unsigned nFrames, unsigned int nChannels, unsigned int sampleRate)
+		const AudioBufferView& src, std::vector<std::vector<float>>& dst, 
+		std::mutex& mutex, unsigned int sampleRate)
 	{
+		const unsigned int nFrames = src.GetFrameCount();
+		const unsigned int nChannels = src.GetChannelCount();
+
 		std::lock_guard<std::mutex> lock(mutex);
 
 		std::size_t amountOfSamples = static_cast<std::size_t>(
@@ -552,10 +1764,21 @@ namespace DigiDAW::Core::Audio
 			}
 			else buffer.resize(buffer.size() + nFrames);
 
-			Detail::SimdHelper::CopyBuffer(src, buffer.data(), channel * nFrames, offset, nFrames);
+			Detail::SimdHelper::CopyBufferUnaligned(src.GetChannel(channel), buffer.data(), 0, offset, nFrames);
 		}
 	}
 
+	// Adds silence to the lookback buffer, until the whole lookback interval is silent.
+	inline void Mixer::AddSilenceToLookback(unsigned int nChannels, unsigned int nFrames, MixableInfo& info, unsigned int sampleRate)
+	{
+		const std::size_t amountOfSamples = static_cast<std::size_t>(
+			(static_cast<float>(lookbackBufferIntervalMS) / 1000.0f) * static_cast<float>(sampleRate));
+		if (info.lookbackSilentFrames >= amountOfSamples) return;
+
+		AddToLookback(silenceBuffer.GetChannels(0, nChannels).GetFrames(0, nFrames), info.lookbackBuffers, info.lookbackBufferMutex, sampleRate);
+		info.lookbackSilentFrames += nFrames;
+	}
+
 	void Mixer::StartTestTone()
 	{
 		testToneStartTime = currentTime;
@@ -0,0 +1,143 @@
+#include "digidaw/core/audio/rendercache.h"
+#include "digidaw/core/audio/trackstate.h"
+
+#include <fstream>
+
+namespace DigiDAW::Core::Audio
+{
+	std::filesystem::path RenderCache::GetPath(std::uint64_t key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.ddrender", static_cast<unsigned long long>(key));
+		return directory / name;
+	}
+
+	std::shared_ptr<const AudioBuffer> RenderCache::Load(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return nullptr;
+
+		FileHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			!std::equal(std::begin(fileMagic), std::end(fileMagic), header.magic) || header.version != fileVersion ||
+			header.nChannels == 0 || header.nChannels > static_cast<std::uint32_t>(TrackState::ChannelNumber::MAX))
+			return nullptr;
+
+		std::shared_ptr<AudioBuffer> render = std::make_shared<AudioBuffer>(header.nChannels, header.nFrames);
+		for (unsigned int channel = 0; channel < header.nChannels; ++channel)
+			if (!file.read(reinterpret_cast<char*>(render->GetChannel(channel)), static_cast<std::streamsize>(header.nFrames) * sizeof(float)))
+				return nullptr; // Cut short (e.g. it was still being written when the app closed).
+		return render;
+	}
+
+	void RenderCache::Save(const std::filesystem::path& path, const AudioBuffer& render)
+	{
+		// Written under a temporary name first, so a file that's cut short is never mistaken for a whole render.
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file) return;
+
+			FileHeader header;
+			std::copy(std::begin(fileMagic), std::end(fileMagic), header.magic);
+			header.version = fileVersion;
+			header.nChannels = render.GetChannelCount();
+			header.nFrames = render.GetFrameCount();
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (unsigned int channel = 0; channel < render.GetChannelCount(); ++channel)
+				file.write(reinterpret_cast<const char*>(render.GetChannel(channel)), static_cast<std::streamsize>(render.GetFrameCount()) * sizeof(float));
+			if (!file) return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+	}
+
+	void RenderCache::SetDirectory(const std::filesystem::path& directory)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->directory = directory;
+		if (!directory.empty())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(directory, error);
+		}
+	}
+
+	void RenderCache::Insert(std::uint64_t key, const std::shared_ptr<const AudioBuffer>& render)
+	{
+		Entry& entry = renders[key];
+		if (entry.render) memoryUsage -= entry.render->GetSize();
+		entry.render = render;
+		entry.lastUsed = ++useCount;
+		memoryUsage += render->GetSize();
+		Evict();
+	}
+
+	// Frees the least recently used renders that only the cache holds on to, until the renders kept in memory fit under the cap.
+	void RenderCache::Evict()
+	{
+		while (memoryLimit != 0 && memoryUsage > memoryLimit)
+		{
+			auto oldest = renders.end();
+			for (auto it = renders.begin(); it != renders.end(); ++it)
+				if (it->second.render.use_count() == 1 && (oldest == renders.end() || it->second.lastUsed < oldest->second.lastUsed))
+					oldest = it;
+			if (oldest == renders.end()) return; // Everything left is being played.
+
+			memoryUsage -= oldest->second.render->GetSize();
+			renders.erase(oldest);
+		}
+	}
+
+	std::shared_ptr<const AudioBuffer> RenderCache::Find(std::uint64_t key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = renders.find(key);
+		if (it != renders.end())
+		{
+			it->second.lastUsed = ++useCount;
+			return it->second.render;
+		}
+		if (directory.empty()) return nullptr;
+
+		std::shared_ptr<const AudioBuffer> render = Load(GetPath(key));
+		if (render) Insert(key, render);
+		return render;
+	}
+
+	void RenderCache::Store(std::uint64_t key, const std::shared_ptr<const AudioBuffer>& render)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Insert(key, render);
+		if (!directory.empty()) Save(GetPath(key), *render);
+	}
+
+	void RenderCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		renders.clear();
+		memoryUsage = 0;
+	}
+
+	std::size_t RenderCache::GetMemoryUsage()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return memoryUsage;
+	}
+
+	void RenderCache::SetMemoryLimit(std::size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		memoryLimit = bytes;
+		Evict();
+	}
+
+	std::size_t RenderCache::GetMemoryLimit()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return memoryLimit;
+	}
+}
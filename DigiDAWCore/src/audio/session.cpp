@@ -0,0 +1,946 @@
+#include "digidaw/core/audio/session.h"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "detail/hash.h"
+
+namespace DigiDAW::Core::Audio
+{
+	// A whole file mapped into memory (read only), until it goes out of scope.
+	class MappedFile
+	{
+	private:
+		const char* data;
+		std::size_t size;
+#if defined(_WIN32)
+		HANDLE file;
+		HANDLE mapping;
+#else
+		int file;
+#endif
+	public:
+		MappedFile(const std::filesystem::path& path)
+		{
+			this->data = nullptr;
+			this->size = 0;
+#if defined(_WIN32)
+			this->mapping = nullptr;
+			this->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return;
+
+			// An empty file can't be mapped.
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 ||
+				static_cast<std::uint64_t>(fileSize.QuadPart) > std::numeric_limits<std::size_t>::max())
+				return;
+
+			this->mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) return;
+
+			this->data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (data) this->size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+			this->file = open(path.c_str(), O_RDONLY);
+			if (file < 0) return;
+
+			// An empty file can't be mapped.
+			struct stat status;
+			if (fstat(file, &status) != 0 || status.st_size <= 0 ||
+				static_cast<std::uint64_t>(status.st_size) > std::numeric_limits<std::size_t>::max())
+				return;
+
+			void* mapped = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped == MAP_FAILED) return;
+
+			this->data = static_cast<const char*>(mapped);
+			this->size = static_cast<std::size_t>(status.st_size);
+#endif
+		}
+
+		~MappedFile()
+		{
+#if defined(_WIN32)
+			if (data) UnmapViewOfFile(data);
+			if (mapping) CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+			if (data) munmap(const_cast<char*>(data), size);
+			if (file >= 0) close(file);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool IsOpen()
+		{
+			return data != nullptr;
+		}
+
+		const char* GetData()
+		{
+			return data;
+		}
+
+		std::size_t GetSize()
+		{
+			return size;
+		}
+	};
+
+	template<typename T>
+	static void Append(std::vector<char>& bytes, const T& value)
+	{
+		const char* valueBytes = reinterpret_cast<const char*>(&value);
+		bytes.insert(bytes.end(), valueBytes, valueBytes + sizeof(T));
+	}
+
+	template<typename T>
+	static void Append(std::vector<char>& bytes, const std::vector<T>& values)
+	{
+		const char* valueBytes = reinterpret_cast<const char*>(values.data());
+		bytes.insert(bytes.end(), valueBytes, valueBytes + values.size() * sizeof(T));
+	}
+
+	// A name in a record is padded out to a multiple of 4 bytes in the journal, so every journal record stays one.
+	static std::uint64_t PadName(std::uint64_t length)
+	{
+		return (length + 3) / 4 * 4;
+	}
+
+	static void AppendName(std::vector<char>& bytes, const std::string& name)
+	{
+		bytes.insert(bytes.end(), name.begin(), name.end());
+		bytes.resize(bytes.size() + static_cast<std::size_t>(PadName(name.size()) - name.size()), 0);
+	}
+
+	// The entries of the chunks of to that aren't in from (leaving out the ones that are in from too, which didn't change),
+	// and the objects of the ones in the chunks of from that aren't in to, and aren't in any of those chunks either (which were removed).
+	template<typename T>
+	static void DiffChunks(const TrackHistory::ChunkList<T>& from, const TrackHistory::ChunkList<T>& to,
+		std::vector<const TrackHistory::Entry<T>*>& changed, std::vector<const T*>& removed)
+	{
+		std::unordered_set<const TrackHistory::Chunk<T>*> fromChunks;
+		std::unordered_set<const TrackHistory::Chunk<T>*> toChunks;
+		for (const std::shared_ptr<const TrackHistory::Chunk<T>>& chunk : from)
+			fromChunks.insert(chunk.get());
+		for (const std::shared_ptr<const TrackHistory::Chunk<T>>& chunk : to)
+			toChunks.insert(chunk.get());
+
+		std::unordered_set<const TrackHistory::Entry<T>*> fromEntries;
+		for (const std::shared_ptr<const TrackHistory::Chunk<T>>& chunk : from)
+			if (!toChunks.contains(chunk.get()))
+				for (const std::shared_ptr<const TrackHistory::Entry<T>>& entry : chunk->entries)
+					fromEntries.insert(entry.get());
+
+		std::unordered_set<const T*> kept;
+		for (const std::shared_ptr<const TrackHistory::Chunk<T>>& chunk : to)
+		{
+			if (fromChunks.contains(chunk.get())) continue;
+
+			for (const std::shared_ptr<const TrackHistory::Entry<T>>& entry : chunk->entries)
+			{
+				kept.insert(entry->mixable.get());
+				if (!fromEntries.contains(entry.get())) changed.push_back(entry.get());
+			}
+		}
+
+		for (const std::shared_ptr<const TrackHistory::Chunk<T>>& chunk : from)
+			if (!toChunks.contains(chunk.get()))
+				for (const std::shared_ptr<const TrackHistory::Entry<T>>& entry : chunk->entries)
+					if (!kept.contains(entry->mixable.get())) removed.push_back(entry->mixable.get());
+	}
+
+	static std::uint64_t AlignSection(std::uint64_t offset, std::size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// The record has its name at offset 0 (as in the journal).
+	Session::TrackRecord Session::MakeTrackRecord(const TrackEntry& entry, std::uint32_t id)
+	{
+		// Records are compared by their bytes, so everything is set.
+		TrackRecord record;
+		std::memset(&record, 0, sizeof(record));
+
+		const TrackHistory::Values& values = entry.values;
+		record.id = id;
+		record.nChannels = static_cast<std::uint32_t>(entry.mixable->nChannels);
+		record.gain = values.gain;
+		record.pan = values.pan;
+		record.panDepth = values.panDepth;
+		record.flags = (values.liveInput ? liveInputFlag : 0) | (values.frozen ? frozenFlag : 0);
+		record.nameOffset = 0;
+		record.nameLength = static_cast<std::uint32_t>(values.name.size());
+		return record;
+	}
+
+	// Called once every track and bus that's being saved has an id.
+	void Session::MakeBusRecord(const BusEntry& entry, std::uint32_t id, std::vector<char>& record)
+	{
+		// The inputs and device outputs can't change once a bus has been added, so they're the bus's own.
+		const TrackState::Bus& bus = *entry.mixable;
+		const TrackHistory::Values& values = entry.values;
+
+		std::vector<InputRecord> inputs;
+		std::vector<ChannelListRecord> lists;
+		std::vector<std::uint32_t> channels;
+
+		const auto addMapping = [&](const std::vector<std::vector<unsigned int>>& mapping)
+			{
+				const std::uint32_t firstList = static_cast<std::uint32_t>(lists.size());
+				for (const std::vector<unsigned int>& list : mapping)
+				{
+					lists.push_back(ChannelListRecord{ static_cast<std::uint32_t>(channels.size()), static_cast<std::uint32_t>(list.size()) });
+					channels.insert(channels.end(), list.begin(), list.end());
+				}
+				return firstList;
+			};
+
+		BusRecord busRecord;
+		std::memset(&busRecord, 0, sizeof(busRecord));
+
+		busRecord.id = id;
+		busRecord.nChannels = static_cast<std::uint32_t>(bus.nChannels);
+		busRecord.gain = values.gain;
+		busRecord.pan = values.pan;
+		busRecord.panDepth = values.panDepth;
+		busRecord.flags = values.doublePrecisionSumming ? doublePrecisionSummingFlag : 0;
+		busRecord.nameOffset = 0;
+		busRecord.nameLength = static_cast<std::uint32_t>(values.name.size());
+
+		for (const TrackState::TrackInput& input : bus.trackInputs)
+		{
+			auto it = savedTracks.find(input.track.get());
+			if (it == savedTracks.end()) continue;
+
+			const std::uint32_t firstList = addMapping(input.trackToBusMap.mapping);
+			inputs.push_back(InputRecord{ it->second.record.id, firstList, static_cast<std::uint32_t>(input.trackToBusMap.mapping.size()),
+				input.trackToBusMap.layoutPanning ? layoutPanningFlag : 0 });
+		}
+		busRecord.firstTrackInput = 0;
+		busRecord.nTrackInputs = static_cast<std::uint32_t>(inputs.size());
+
+		for (const TrackState::BusInput& input : bus.busInputs)
+		{
+			auto it = savedBuses.find(input.bus.get());
+			if (it == savedBuses.end()) continue;
+
+			const std::uint32_t firstList = addMapping(input.busToBusMap.mapping);
+			inputs.push_back(InputRecord{ it->second.id, firstList, static_cast<std::uint32_t>(input.busToBusMap.mapping.size()),
+				input.busToBusMap.layoutPanning ? layoutPanningFlag : 0 });
+		}
+		busRecord.firstBusInput = busRecord.nTrackInputs;
+		busRecord.nBusInputs = static_cast<std::uint32_t>(inputs.size()) - busRecord.nTrackInputs;
+
+		busRecord.firstOutputList = addMapping(bus.busChannelToDeviceOutputChannels);
+		busRecord.nOutputLists = static_cast<std::uint32_t>(bus.busChannelToDeviceOutputChannels.size());
+
+		record.clear();
+		Append(record, busRecord);
+		Append(record, BusSizes{ static_cast<std::uint32_t>(lists.size()), static_cast<std::uint32_t>(channels.size()) });
+		Append(record, inputs);
+		Append(record, lists);
+		Append(record, channels);
+		AppendName(record, values.name);
+	}
+
+	bool Session::IsValidTrack(const TrackView& view)
+	{
+		return static_cast<std::uint64_t>(view.track->nameOffset) + view.track->nameLength <= view.nStrings;
+	}
+
+	bool Session::IsValidBus(const BusView& view)
+	{
+		const BusRecord& bus = *view.bus;
+
+		const auto inRange = [](std::uint64_t first, std::uint64_t count, std::size_t size)
+			{
+				return first + count <= size;
+			};
+		const auto validLists = [&](std::uint32_t firstList, std::uint32_t nLists)
+			{
+				if (!inRange(firstList, nLists, view.nLists)) return false;
+				for (std::uint64_t list = firstList; list < static_cast<std::uint64_t>(firstList) + nLists; ++list)
+					if (!inRange(view.lists[list].firstChannel, view.lists[list].nChannels, view.nChannels)) return false;
+				return true;
+			};
+		const auto validInputs = [&](std::uint32_t firstInput, std::uint32_t nInputs)
+			{
+				if (!inRange(firstInput, nInputs, view.nInputs)) return false;
+				for (std::uint64_t input = firstInput; input < static_cast<std::uint64_t>(firstInput) + nInputs; ++input)
+					if (!validLists(view.inputs[input].firstList, view.inputs[input].nLists)) return false;
+				return true;
+			};
+
+		return validInputs(bus.firstTrackInput, bus.nTrackInputs) && validInputs(bus.firstBusInput, bus.nBusInputs) &&
+			validLists(bus.firstOutputList, bus.nOutputLists) && inRange(bus.nameOffset, bus.nameLength, view.nStrings);
+	}
+
+	// Only called once the inputs from other buses have been added.
+	std::shared_ptr<TrackState::Bus> Session::AddBus(const BusView& view, TrackState& trackState,
+		const std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Track>>& tracksById,
+		const std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Bus>>& busesById)
+	{
+		const BusRecord& record = *view.bus;
+
+		const auto readMapping = [&view](std::uint32_t firstList, std::uint32_t nLists)
+			{
+				std::vector<std::vector<unsigned int>> mapping(nLists);
+				for (std::uint32_t list = 0; list < nLists; ++list)
+				{
+					const ChannelListRecord& listRecord = view.lists[firstList + list];
+					mapping[list].assign(view.channels + listRecord.firstChannel, view.channels + listRecord.firstChannel + listRecord.nChannels);
+				}
+				return mapping;
+			};
+
+		std::vector<TrackState::TrackInput> trackInputs;
+		for (std::uint32_t i = 0; i < record.nTrackInputs; ++i)
+		{
+			const InputRecord& input = view.inputs[record.firstTrackInput + i];
+			auto it = tracksById.find(input.sourceId);
+			if (it == tracksById.end()) continue;
+
+			std::shared_ptr<TrackState::Track> track = it->second;
+			trackInputs.emplace_back(track, TrackState::ChannelMapping(readMapping(input.firstList, input.nLists), (input.flags & layoutPanningFlag) != 0));
+		}
+
+		std::vector<TrackState::BusInput> busInputs;
+		for (std::uint32_t i = 0; i < record.nBusInputs; ++i)
+		{
+			const InputRecord& input = view.inputs[record.firstBusInput + i];
+			auto it = busesById.find(input.sourceId);
+			if (it == busesById.end()) continue;
+
+			std::shared_ptr<TrackState::Bus> bus = it->second;
+			busInputs.emplace_back(bus, TrackState::ChannelMapping(readMapping(input.firstList, input.nLists), (input.flags & layoutPanningFlag) != 0));
+		}
+
+		// The Mixer expects a list for every channel of a bus that outputs to the device.
+		const std::uint32_t nChannels = std::clamp(record.nChannels,
+			static_cast<std::uint32_t>(TrackState::ChannelNumber::Mono), static_cast<std::uint32_t>(TrackState::ChannelNumber::MAX));
+		std::vector<std::vector<unsigned int>> deviceOutputs = readMapping(record.firstOutputList, record.nOutputLists);
+		if (!deviceOutputs.empty() && deviceOutputs.size() < nChannels)
+			deviceOutputs.resize(nChannels);
+
+		TrackState::Bus bus(std::string(view.strings + record.nameOffset, record.nameLength), static_cast<TrackState::ChannelNumber>(nChannels), record.gain, record.pan,
+			deviceOutputs, trackInputs, busInputs);
+		bus.panDepth = record.panDepth;
+		bus.doublePrecisionSumming = (record.flags & doublePrecisionSummingFlag) != 0;
+		return trackState.AddBus(bus);
+	}
+
+	ReturnCode Session::Load(const std::filesystem::path& path, TrackState& trackState)
+	{
+		MappedFile file(path);
+		if (!file.IsOpen() || file.GetSize() < sizeof(FileHeader)) return ReturnCode::Error;
+
+		const char* data = file.GetData();
+		const std::size_t size = file.GetSize();
+
+		FileHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		if (!std::equal(std::begin(fileMagic), std::end(fileMagic), header.magic) || header.version != fileVersion ||
+			header.snapshotSize < sizeof(FileHeader) || header.snapshotSize > size ||
+			header.nSections > (header.snapshotSize - sizeof(FileHeader)) / sizeof(SectionRecord))
+			return ReturnCode::Error;
+
+		// The mapping starts on a page, and every section on a multiple of sectionAlignment, so the records can be used where they are.
+		const SectionRecord* sections = reinterpret_cast<const SectionRecord*>(data + sizeof(FileHeader));
+		const auto findSection = [&](SectionType type, std::size_t recordSize, std::size_t& count) -> const char*
+			{
+				for (std::uint32_t i = 0; i < header.nSections; ++i)
+				{
+					const SectionRecord& section = sections[i];
+					if (section.type != type) continue;
+
+					if (section.recordSize != recordSize || section.offset % sectionAlignment != 0 || section.offset > header.snapshotSize ||
+						section.count > (header.snapshotSize - section.offset) / recordSize)
+						return nullptr;
+
+					count = static_cast<std::size_t>(section.count);
+					return data + section.offset;
+				}
+				return nullptr;
+			};
+
+		std::size_t nTracks = 0;
+		std::size_t nBuses = 0;
+		const TrackRecord* tracks = reinterpret_cast<const TrackRecord*>(findSection(SectionType::Tracks, sizeof(TrackRecord), nTracks));
+		const BusRecord* buses = reinterpret_cast<const BusRecord*>(findSection(SectionType::Buses, sizeof(BusRecord), nBuses));
+
+		BusView snapshotView;
+		snapshotView.bus = nullptr;
+		snapshotView.inputs = reinterpret_cast<const InputRecord*>(findSection(SectionType::Inputs, sizeof(InputRecord), snapshotView.nInputs));
+		snapshotView.lists = reinterpret_cast<const ChannelListRecord*>(findSection(SectionType::ChannelLists, sizeof(ChannelListRecord), snapshotView.nLists));
+		snapshotView.channels = reinterpret_cast<const std::uint32_t*>(findSection(SectionType::Channels, sizeof(std::uint32_t), snapshotView.nChannels));
+		snapshotView.strings = findSection(SectionType::Strings, sizeof(char), snapshotView.nStrings);
+		if (!tracks || !buses || !snapshotView.inputs || !snapshotView.lists || !snapshotView.channels || !snapshotView.strings)
+			return ReturnCode::Error;
+
+		// The tracks and buses in their order, where removed ones are null (as the indices of the others are kept by their ids).
+		std::vector<TrackView> trackViews;
+		std::unordered_map<std::uint32_t, std::size_t> trackIndices;
+		std::vector<BusView> busViews;
+		std::unordered_map<std::uint32_t, std::size_t> busIndices;
+
+		const auto setTrack = [&](const TrackView& view)
+			{
+				auto [it, added] = trackIndices.try_emplace(view.track->id, trackViews.size());
+				if (added) trackViews.push_back(view);
+				else trackViews[it->second] = view;
+			};
+		const auto setBus = [&](const BusView& view)
+			{
+				auto [it, added] = busIndices.try_emplace(view.bus->id, busViews.size());
+				if (added) busViews.push_back(view);
+				else busViews[it->second] = view;
+			};
+
+		trackViews.reserve(nTracks);
+		for (std::size_t i = 0; i < nTracks; ++i)
+			setTrack(TrackView{ tracks + i, snapshotView.strings, snapshotView.nStrings });
+		busViews.reserve(nBuses);
+		for (std::size_t i = 0; i < nBuses; ++i)
+		{
+			BusView view = snapshotView;
+			view.bus = buses + i;
+			setBus(view);
+		}
+
+		// Every record in the journal is a multiple of 4 bytes, so (from the start of the mapping) they can be used where they are too.
+		struct Change
+		{
+			JournalType type;
+			const char* payload;
+			TrackView track;
+			BusView bus;
+		};
+		std::vector<Change> changes;
+		std::size_t batchStart = static_cast<std::size_t>(header.snapshotSize);
+		std::size_t position = batchStart;
+		while (size - position >= sizeof(JournalRecord))
+		{
+			JournalRecord record;
+			std::memcpy(&record, data + position, sizeof(record));
+			const char* payload = data + position + sizeof(JournalRecord);
+			if (record.size > size - position - sizeof(JournalRecord) || record.size % 4 != 0) break;
+
+			Change change;
+			change.type = record.type;
+			change.payload = payload;
+			if (record.type == JournalType::SetTrack)
+			{
+				if (record.size < sizeof(TrackRecord)) break;
+
+				const TrackRecord* track = reinterpret_cast<const TrackRecord*>(payload);
+				if (sizeof(TrackRecord) + PadName(track->nameLength) != record.size) break;
+
+				// As is the name, from the start of the record's own.
+				change.track = TrackView{ track, payload + sizeof(TrackRecord), track->nameLength };
+			}
+			else if (record.type == JournalType::SetBus)
+			{
+				if (record.size < sizeof(BusRecord) + sizeof(BusSizes)) break;
+
+				const BusRecord* bus = reinterpret_cast<const BusRecord*>(payload);
+				BusSizes sizes;
+				std::memcpy(&sizes, payload + sizeof(BusRecord), sizeof(sizes));
+
+				const std::uint64_t nInputs = static_cast<std::uint64_t>(bus->nTrackInputs) + bus->nBusInputs;
+				const char* inputs = payload + sizeof(BusRecord) + sizeof(BusSizes);
+				const char* lists = inputs + nInputs * sizeof(InputRecord);
+				const char* channels = lists + static_cast<std::uint64_t>(sizes.nLists) * sizeof(ChannelListRecord);
+				const char* name = channels + static_cast<std::uint64_t>(sizes.nChannels) * sizeof(std::uint32_t);
+				if (sizeof(BusRecord) + sizeof(BusSizes) + nInputs * sizeof(InputRecord) + static_cast<std::uint64_t>(sizes.nLists) * sizeof(ChannelListRecord) +
+					static_cast<std::uint64_t>(sizes.nChannels) * sizeof(std::uint32_t) + PadName(bus->nameLength) != record.size)
+					break;
+
+				// The inputs (and the name) are from the start of the record's own, not the bus record's first ones.
+				change.bus.bus = bus;
+				change.bus.inputs = reinterpret_cast<const InputRecord*>(inputs);
+				change.bus.nInputs = static_cast<std::size_t>(nInputs);
+				change.bus.lists = reinterpret_cast<const ChannelListRecord*>(lists);
+				change.bus.nLists = sizes.nLists;
+				change.bus.channels = reinterpret_cast<const std::uint32_t*>(channels);
+				change.bus.nChannels = sizes.nChannels;
+				change.bus.strings = name;
+				change.bus.nStrings = bus->nameLength;
+			}
+			else if (record.type == JournalType::RemoveTrack || record.type == JournalType::RemoveBus)
+			{
+				if (record.size != sizeof(std::uint32_t)) break;
+			}
+			else if (record.type == JournalType::Commit)
+			{
+				std::uint64_t hash = 0;
+				if (record.size != sizeof(hash)) break;
+				std::memcpy(&hash, payload, sizeof(hash));
+				if (Detail::Hash::Bytes(data + batchStart, position - batchStart) != hash) break;
+
+				for (const Change& committed : changes)
+				{
+					std::uint32_t id = 0;
+					switch (committed.type)
+					{
+					case JournalType::SetTrack:
+						setTrack(committed.track);
+						break;
+					case JournalType::SetBus:
+						setBus(committed.bus);
+						break;
+					case JournalType::RemoveTrack:
+						std::memcpy(&id, committed.payload, sizeof(id));
+						if (auto it = trackIndices.find(id); it != trackIndices.end())
+						{
+							trackViews[it->second].track = nullptr;
+							trackIndices.erase(it);
+						}
+						break;
+					case JournalType::RemoveBus:
+						std::memcpy(&id, committed.payload, sizeof(id));
+						if (auto it = busIndices.find(id); it != busIndices.end())
+						{
+							busViews[it->second].bus = nullptr;
+							busIndices.erase(it);
+						}
+						break;
+					default:
+						break;
+					}
+				}
+				changes.clear();
+
+				position += sizeof(JournalRecord) + record.size;
+				batchStart = position;
+				continue;
+			}
+			else break;
+
+			changes.push_back(change);
+			position += sizeof(JournalRecord) + record.size;
+		}
+
+		// Everything that's loaded is checked before anything in the TrackState is replaced.
+		for (const TrackView& view : trackViews)
+			if (view.track && !IsValidTrack(view)) return ReturnCode::Error;
+		for (const BusView& view : busViews)
+			if (view.bus && !IsValidBus(view)) return ReturnCode::Error;
+
+		for (std::shared_ptr<TrackState::Bus> bus : trackState.ThreadedCopyAllBuses())
+			trackState.RemoveBus(bus);
+		for (std::shared_ptr<TrackState::Track> track : trackState.ThreadedCopyAllTracks())
+			trackState.RemoveTrack(track);
+
+		savedTracks.clear();
+		savedBuses.clear();
+		savedSnapshot.reset();
+		nextId = header.nextId;
+
+		std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Track>> tracksById;
+		tracksById.reserve(trackIndices.size());
+		savedTracks.reserve(trackIndices.size());
+		for (const TrackView& view : trackViews)
+		{
+			if (!view.track) continue;
+
+			const TrackRecord* record = view.track;
+			TrackState::Track track(std::string(view.strings + record->nameOffset, record->nameLength), static_cast<TrackState::ChannelNumber>(record->nChannels), record->gain, record->pan);
+			track.panDepth = record->panDepth;
+			track.liveInput = (record->flags & liveInputFlag) != 0;
+			track.frozen = (record->flags & frozenFlag) != 0;
+
+			std::shared_ptr<TrackState::Track> added = trackState.AddTrack(track);
+			tracksById[record->id] = added;
+			const TrackEntry entry{ added, TrackHistory::GetValues(*added) };
+			savedTracks[added.get()] = SavedTrack{ added, MakeTrackRecord(entry, record->id), entry.values.name };
+			nextId = std::max(nextId, record->id + 1);
+		}
+
+		// The buses a bus has as inputs have to be added before it, which they already are unless the journal added them,
+		// so they're added depth first from their inputs (and an input that would be circular is dropped).
+		std::unordered_map<std::uint32_t, std::shared_ptr<TrackState::Bus>> busesById;
+		busesById.reserve(busIndices.size());
+		savedBuses.reserve(busIndices.size());
+		enum class Visit : std::uint8_t { NotVisited, Visiting, Added };
+		std::vector<Visit> visits(busViews.size(), Visit::NotVisited);
+		std::vector<std::pair<std::size_t, std::uint32_t>> stack; // The bus, and which of its bus inputs is next.
+		for (std::size_t root = 0; root < busViews.size(); ++root)
+		{
+			if (!busViews[root].bus || visits[root] != Visit::NotVisited) continue;
+
+			visits[root] = Visit::Visiting;
+			stack.emplace_back(root, 0);
+			while (!stack.empty())
+			{
+				const std::size_t index = stack.back().first;
+				const BusView& view = busViews[index];
+				if (stack.back().second < view.bus->nBusInputs)
+				{
+					const InputRecord& input = view.inputs[view.bus->firstBusInput + stack.back().second++];
+					auto it = busIndices.find(input.sourceId);
+					if (it != busIndices.end() && visits[it->second] == Visit::NotVisited)
+					{
+						visits[it->second] = Visit::Visiting;
+						stack.emplace_back(it->second, 0);
+					}
+					continue;
+				}
+
+				busesById[view.bus->id] = AddBus(view, trackState, tracksById, busesById);
+				nextId = std::max(nextId, view.bus->id + 1);
+				visits[index] = Visit::Added;
+				stack.pop_back();
+			}
+		}
+
+		for (const auto& pair : busesById)
+			savedBuses[pair.second.get()] = SavedBus{ pair.second, pair.first, {} };
+		for (const auto& pair : busesById)
+			MakeBusRecord(BusEntry{ pair.second, TrackHistory::GetValues(*pair.second) }, pair.first, savedBuses[pair.second.get()].record);
+
+		// A batch that was cut short is left out of fileSize, so the next Save writes a snapshot over it.
+		this->path = path;
+		this->snapshotSize = header.snapshotSize;
+		this->fileSize = batchStart;
+		return ReturnCode::Success;
+	}
+
+	Session::Changes Session::GetEntries(TrackState& trackState, std::vector<TrackEntry>& tracks, std::vector<BusEntry>& buses)
+	{
+		tracks.clear();
+		buses.clear();
+		for (const std::shared_ptr<TrackState::Track>& track : trackState.ThreadedCopyAllTracks())
+			tracks.push_back(TrackEntry{ track, TrackHistory::GetValues(*track) });
+		for (const std::shared_ptr<TrackState::Bus>& bus : trackState.ThreadedCopyAllBuses())
+			buses.push_back(BusEntry{ bus, TrackHistory::GetValues(*bus) });
+
+		Changes changes;
+		changes.tracks.reserve(tracks.size());
+		for (const TrackEntry& entry : tracks)
+			changes.tracks.push_back(&entry);
+		changes.buses.reserve(buses.size());
+		for (const BusEntry& entry : buses)
+			changes.buses.push_back(&entry);
+		return changes;
+	}
+
+	Session::Changes Session::GetEntries(const TrackHistory::Snapshot& snapshot)
+	{
+		Changes changes;
+		changes.tracks.reserve(snapshot.nTracks);
+		snapshot.ForEachTrack([&changes](const TrackEntry& entry) { changes.tracks.push_back(&entry); });
+		changes.buses.reserve(snapshot.nBuses);
+		snapshot.ForEachBus([&changes](const BusEntry& entry) { changes.buses.push_back(&entry); });
+		return changes;
+	}
+
+	// Called with every track and bus there is, the saved ones that aren't (or are a different object at the same address) are gone.
+	void Session::FindRemoved(Changes& changes)
+	{
+		std::unordered_set<const TrackState::Track*> currentTracks;
+		for (const TrackEntry* entry : changes.tracks)
+			currentTracks.insert(entry->mixable.get());
+		for (const auto& [track, saved] : savedTracks)
+			if (!currentTracks.contains(track) || saved.track.expired())
+				changes.removedTracks.push_back(track);
+
+		std::unordered_set<const TrackState::Bus*> currentBuses;
+		for (const BusEntry* entry : changes.buses)
+			currentBuses.insert(entry->mixable.get());
+		for (const auto& [bus, saved] : savedBuses)
+			if (!currentBuses.contains(bus) || saved.bus.expired())
+				changes.removedBuses.push_back(bus);
+	}
+
+	bool Session::CanAppend(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		return !this->path.empty() && path == this->path && std::filesystem::file_size(path, error) == fileSize && !error;
+	}
+
+	ReturnCode Session::Save(const std::filesystem::path& path, TrackState& trackState)
+	{
+		if (!CanAppend(path)) return SaveSnapshot(path, trackState);
+
+		// savedTracks and savedBuses are of the TrackState from here on.
+		savedSnapshot.reset();
+
+		std::vector<TrackEntry> tracks;
+		std::vector<BusEntry> buses;
+		Changes changes = GetEntries(trackState, tracks, buses);
+		FindRemoved(changes);
+		return AppendBatch(path, changes, [&]() { return SaveSnapshot(path, trackState); });
+	}
+
+	ReturnCode Session::Save(const std::filesystem::path& path, const std::shared_ptr<const TrackHistory::Snapshot>& snapshot)
+	{
+		if (!CanAppend(path)) return SaveSnapshot(path, snapshot);
+
+		// After a snapshot that was saved, only the chunks that aren't shared with it can have changed.
+		Changes changes;
+		if (savedSnapshot)
+		{
+			DiffChunks(savedSnapshot->tracks, snapshot->tracks, changes.tracks, changes.removedTracks);
+			DiffChunks(savedSnapshot->buses, snapshot->buses, changes.buses, changes.removedBuses);
+		}
+		else
+		{
+			changes = GetEntries(*snapshot);
+			FindRemoved(changes);
+		}
+
+		const ReturnCode result = AppendBatch(path, changes, [&]() { return SaveSnapshot(path, snapshot); });
+		if (result == ReturnCode::Success) savedSnapshot = snapshot;
+		else savedSnapshot.reset();
+		return result;
+	}
+
+	ReturnCode Session::AppendBatch(const std::filesystem::path& path, const Changes& changes, const std::function<ReturnCode()>& saveSnapshot)
+	{
+		std::vector<char> batch;
+		const auto appendRecord = [&batch](JournalType type, const void* payload, std::size_t size)
+			{
+				Append(batch, JournalRecord{ type, static_cast<std::uint32_t>(size) });
+				batch.insert(batch.end(), static_cast<const char*>(payload), static_cast<const char*>(payload) + size);
+			};
+
+		// Ones that are gone are removed first, so their addresses are free for the new ones.
+		for (const TrackState::Track* track : changes.removedTracks)
+		{
+			auto it = savedTracks.find(track);
+			if (it == savedTracks.end()) continue;
+
+			appendRecord(JournalType::RemoveTrack, &it->second.record.id, sizeof(std::uint32_t));
+			savedTracks.erase(it);
+		}
+
+		std::vector<char> record;
+		for (const TrackEntry* entry : changes.tracks)
+		{
+			auto it = savedTracks.find(entry->mixable.get());
+			const TrackRecord trackRecord = MakeTrackRecord(*entry, (it != savedTracks.end()) ? it->second.record.id : nextId++);
+			if (it != savedTracks.end() && std::memcmp(&trackRecord, &it->second.record, sizeof(trackRecord)) == 0 && entry->values.name == it->second.name)
+				continue;
+
+			record.clear();
+			Append(record, trackRecord);
+			AppendName(record, entry->values.name);
+			appendRecord(JournalType::SetTrack, record.data(), record.size());
+			savedTracks[entry->mixable.get()] = SavedTrack{ entry->mixable, trackRecord, entry->values.name };
+		}
+
+		for (const TrackState::Bus* bus : changes.removedBuses)
+		{
+			auto it = savedBuses.find(bus);
+			if (it == savedBuses.end()) continue;
+
+			appendRecord(JournalType::RemoveBus, &it->second.id, sizeof(std::uint32_t));
+			savedBuses.erase(it);
+		}
+
+		// New buses need their ids before any bus is written, as buses can be inputs of each other.
+		for (const BusEntry* entry : changes.buses)
+			if (!savedBuses.contains(entry->mixable.get()))
+				savedBuses[entry->mixable.get()] = SavedBus{ entry->mixable, nextId++, {} };
+
+		for (const BusEntry* entry : changes.buses)
+		{
+			SavedBus& saved = savedBuses[entry->mixable.get()];
+			MakeBusRecord(*entry, saved.id, record);
+			if (record == saved.record) continue;
+
+			appendRecord(JournalType::SetBus, record.data(), record.size());
+			saved.record.swap(record);
+		}
+
+		if (batch.empty()) return ReturnCode::Success;
+
+		const std::uint64_t hash = Detail::Hash::Bytes(batch.data(), batch.size());
+		appendRecord(JournalType::Commit, &hash, sizeof(hash));
+
+		// Loading goes through the whole journal, so it's only kept while it's smaller than the snapshot.
+		if (GetJournalSize() + batch.size() > snapshotSize)
+			return saveSnapshot();
+
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::app);
+			if (file)
+			{
+				file.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+				file.flush();
+			}
+			if (!file)
+			{
+				// Whatever did make it into the file is ignored by Load, and the next Save writes a snapshot.
+				this->path.clear();
+				return ReturnCode::Error;
+			}
+		}
+
+		fileSize += batch.size();
+		return ReturnCode::Success;
+	}
+
+	ReturnCode Session::SaveSnapshot(const std::filesystem::path& path, TrackState& trackState)
+	{
+		std::vector<TrackEntry> tracks;
+		std::vector<BusEntry> buses;
+		return WriteSnapshot(path, GetEntries(trackState, tracks, buses));
+	}
+
+	ReturnCode Session::SaveSnapshot(const std::filesystem::path& path, const std::shared_ptr<const TrackHistory::Snapshot>& snapshot)
+	{
+		const ReturnCode result = WriteSnapshot(path, GetEntries(*snapshot));
+		if (result == ReturnCode::Success) savedSnapshot = snapshot;
+		return result;
+	}
+
+	ReturnCode Session::WriteSnapshot(const std::filesystem::path& path, const Changes& changes)
+	{
+		// A snapshot starts the ids again, as it has nothing from before it.
+		this->path.clear();
+		savedTracks.clear();
+		savedBuses.clear();
+		savedSnapshot.reset();
+		nextId = 0;
+
+		// The snapshot's records have where their names are in the Strings section, the saved ones are as the journal has them.
+		std::vector<TrackRecord> trackRecords;
+		std::vector<char> strings;
+		trackRecords.reserve(changes.tracks.size());
+		for (const TrackEntry* entry : changes.tracks)
+		{
+			const TrackRecord record = MakeTrackRecord(*entry, nextId++);
+			trackRecords.push_back(record);
+			trackRecords.back().nameOffset = static_cast<std::uint32_t>(strings.size());
+			strings.insert(strings.end(), entry->values.name.begin(), entry->values.name.end());
+			savedTracks[entry->mixable.get()] = SavedTrack{ entry->mixable, record, entry->values.name };
+		}
+
+		for (const BusEntry* entry : changes.buses)
+			savedBuses[entry->mixable.get()] = SavedBus{ entry->mixable, nextId++, {} };
+
+		// The same records as the journal has, with their indices moved to where they are in the sections.
+		std::vector<BusRecord> busRecords;
+		std::vector<InputRecord> inputs;
+		std::vector<ChannelListRecord> lists;
+		std::vector<std::uint32_t> channels;
+		busRecords.reserve(changes.buses.size());
+		for (const BusEntry* entry : changes.buses)
+		{
+			SavedBus& saved = savedBuses[entry->mixable.get()];
+			MakeBusRecord(*entry, saved.id, saved.record);
+
+			const std::uint32_t firstInput = static_cast<std::uint32_t>(inputs.size());
+			const std::uint32_t firstList = static_cast<std::uint32_t>(lists.size());
+			const std::uint32_t firstChannel = static_cast<std::uint32_t>(channels.size());
+
+			const char* bytes = saved.record.data();
+			BusRecord busRecord;
+			std::memcpy(&busRecord, bytes, sizeof(busRecord));
+			bytes += sizeof(busRecord);
+			BusSizes sizes;
+			std::memcpy(&sizes, bytes, sizeof(sizes));
+			bytes += sizeof(sizes);
+
+			busRecord.firstTrackInput += firstInput;
+			busRecord.firstBusInput += firstInput;
+			busRecord.firstOutputList += firstList;
+			busRecord.nameOffset = static_cast<std::uint32_t>(strings.size());
+			busRecords.push_back(busRecord);
+
+			for (std::uint32_t i = 0; i < busRecord.nTrackInputs + busRecord.nBusInputs; ++i, bytes += sizeof(InputRecord))
+			{
+				InputRecord input;
+				std::memcpy(&input, bytes, sizeof(input));
+				input.firstList += firstList;
+				inputs.push_back(input);
+			}
+			for (std::uint32_t i = 0; i < sizes.nLists; ++i, bytes += sizeof(ChannelListRecord))
+			{
+				ChannelListRecord list;
+				std::memcpy(&list, bytes, sizeof(list));
+				list.firstChannel += firstChannel;
+				lists.push_back(list);
+			}
+			channels.resize(channels.size() + sizes.nChannels);
+			std::memcpy(channels.data() + firstChannel, bytes, sizes.nChannels * sizeof(std::uint32_t));
+			bytes += sizes.nChannels * sizeof(std::uint32_t);
+			strings.insert(strings.end(), bytes, bytes + busRecord.nameLength);
+		}
+
+		// The whole snapshot is put together in memory, and written at once.
+		std::vector<SectionRecord> sections;
+		std::uint64_t size = sizeof(FileHeader) + static_cast<std::uint64_t>(SectionType::Count) * sizeof(SectionRecord);
+		const auto addSection = [&](SectionType type, std::size_t recordSize, std::size_t count)
+			{
+				size = AlignSection(size, sectionAlignment);
+				sections.push_back(SectionRecord{ type, static_cast<std::uint32_t>(recordSize), size, count });
+				size += static_cast<std::uint64_t>(recordSize) * count;
+			};
+		addSection(SectionType::Tracks, sizeof(TrackRecord), trackRecords.size());
+		addSection(SectionType::Buses, sizeof(BusRecord), busRecords.size());
+		addSection(SectionType::Inputs, sizeof(InputRecord), inputs.size());
+		addSection(SectionType::ChannelLists, sizeof(ChannelListRecord), lists.size());
+		addSection(SectionType::Channels, sizeof(std::uint32_t), channels.size());
+		addSection(SectionType::Strings, sizeof(char), strings.size());
+		size = AlignSection(size, sectionAlignment);
+
+		FileHeader header;
+		std::copy(std::begin(fileMagic), std::end(fileMagic), header.magic);
+		header.version = fileVersion;
+		header.nSections = static_cast<std::uint32_t>(sections.size());
+		header.nextId = nextId;
+		header.snapshotSize = size;
+
+		std::vector<char> snapshot(static_cast<std::size_t>(size), 0);
+		const auto copySection = [&](const SectionRecord& section, const void* records)
+			{
+				if (section.count > 0)
+					std::memcpy(snapshot.data() + section.offset, records, static_cast<std::size_t>(section.count) * section.recordSize);
+			};
+		std::memcpy(snapshot.data(), &header, sizeof(header));
+		std::memcpy(snapshot.data() + sizeof(header), sections.data(), sections.size() * sizeof(SectionRecord));
+		copySection(sections[0], trackRecords.data());
+		copySection(sections[1], busRecords.data());
+		copySection(sections[2], inputs.data());
+		copySection(sections[3], lists.data());
+		copySection(sections[4], channels.data());
+		copySection(sections[5], strings.data());
+
+		// Written under a temporary name first, so a file that's cut short never replaces the last one.
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file) return ReturnCode::Error;
+
+			file.write(snapshot.data(), static_cast<std::streamsize>(snapshot.size()));
+			if (!file) return ReturnCode::Error;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error) return ReturnCode::Error;
+
+		this->path = path;
+		this->snapshotSize = size;
+		this->fileSize = size;
+		return ReturnCode::Success;
+	}
+}
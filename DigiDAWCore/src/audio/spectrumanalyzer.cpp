@@ -0,0 +1,190 @@
+#include "digidaw/core/audio/spectrumanalyzer.h"
+
+#include "detail/simdhelper.h"
+#include "detail/fft.h"
+
+namespace DigiDAW::Core::Audio
+{
+	SpectrumAnalyzer::SpectrumAnalyzer()
+	{
+	}
+
+	SpectrumAnalyzer::SpectrumAnalyzer(const Settings& settings)
+	{
+		this->settings = settings;
+	}
+
+	void SpectrumAnalyzer::Prepare(unsigned int sampleRate)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->sampleRate = sampleRate;
+		Allocate();
+	}
+
+	void SpectrumAnalyzer::SetSettings(const Settings& settings)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->settings = settings;
+		if (sampleRate != 0) Allocate();
+	}
+
+	void SpectrumAnalyzer::Allocate()
+	{
+		// The real FFT needs an even size.
+		settings.fftSize = std::clamp(settings.fftSize + (settings.fftSize % 2), 64u, 65536u);
+		settings.nBands = std::max(settings.nBands, 1u);
+
+		const std::size_t fftSize = settings.fftSize;
+		if (!fft || fft->GetSize() != fftSize)
+			fft = std::make_shared<Detail::FFT>(fftSize);
+		const std::size_t nBins = fft->GetSpectrumSize();
+
+		window = std::vector<float>(fftSize);
+		float windowSum = 0.0f;
+		for (std::size_t i = 0; i < fftSize; ++i)
+		{
+			window[i] = 0.5f - 0.5f * std::cos(2.0f * pi<float> * static_cast<float>(i) / static_cast<float>(fftSize));
+			windowSum += window[i];
+		}
+		// A sine with an amplitude of 1 has a magnitude of windowSum / 2 in its bin.
+		decibelOffset = -20.0f * std::log10(windowSum * 0.5f);
+
+		frame = std::vector<float>(fftSize);
+		spectrumReal = std::vector<float>(nBins);
+		spectrumImag = std::vector<float>(nBins);
+		spectrumDecibel = std::vector<float>(nBins);
+
+		// Space the band edges logarithmically between the minimum and maximum frequency.
+		const float nyquist = static_cast<float>(sampleRate) * 0.5f;
+		const float binWidth = static_cast<float>(sampleRate) / static_cast<float>(fftSize);
+		const float minimumFrequency = std::clamp(settings.minimumFrequency, 1.0f, nyquist);
+		const float maximumFrequency = std::clamp(settings.maximumFrequency, minimumFrequency, nyquist);
+
+		bandFirstBin = std::vector<unsigned int>(settings.nBands);
+		bandEndBin = std::vector<unsigned int>(settings.nBands);
+		bandCenterBin = std::vector<float>(settings.nBands);
+		for (unsigned int band = 0; band < settings.nBands; ++band)
+		{
+			const float ratio = maximumFrequency / minimumFrequency;
+			const float low = minimumFrequency * std::pow(ratio, static_cast<float>(band) / static_cast<float>(settings.nBands));
+			const float high = minimumFrequency * std::pow(ratio, static_cast<float>(band + 1) / static_cast<float>(settings.nBands));
+
+			bandFirstBin[band] = std::min(static_cast<unsigned int>(std::ceil(low / binWidth)), static_cast<unsigned int>(nBins - 1));
+			bandEndBin[band] = std::min(static_cast<unsigned int>(std::ceil(high / binWidth)), static_cast<unsigned int>(nBins));
+			bandCenterBin[band] = std::min(std::sqrt(low * high) / binWidth, static_cast<float>(nBins - 1));
+		}
+
+		bands = std::vector<float>(settings.nBands, settings.minimumDecibel);
+		peaks = std::vector<float>(settings.nBands, settings.minimumDecibel);
+		peakHoldTimes = std::vector<float>(settings.nBands);
+
+		std::lock_guard<std::mutex> lock(ringBufferMutex);
+		ringBuffer = std::vector<float>(fftSize);
+		writePosition = 0;
+	}
+
+	void SpectrumAnalyzer::Push(const AudioBufferView& src)
+	{
+		const unsigned int nChannels = src.GetChannelCount();
+		const unsigned int nFrames = src.GetFrameCount();
+
+		std::lock_guard<std::mutex> lock(ringBufferMutex);
+		if (ringBuffer.empty() || nChannels == 0) return;
+
+		this->nChannels = nChannels;
+
+		// Only the last fftSize frames are ever needed.
+		std::size_t srcOffset = 0;
+		std::size_t length = nFrames;
+		if (length > ringBuffer.size())
+		{
+			srcOffset = length - ringBuffer.size();
+			length = ringBuffer.size();
+		}
+
+		// Write the sum of every channel in (at most) two parts, wrapping around the end of the circular buffer.
+		while (length > 0)
+		{
+			const std::size_t part = std::min(length, ringBuffer.size() - writePosition);
+
+			Detail::SimdHelper::CopyBufferUnaligned(src.GetChannel(0), ringBuffer.data(), srcOffset, writePosition, part);
+			for (unsigned int channel = 1; channel < nChannels; ++channel)
+				Detail::SimdHelper::AccumulateBufferUnaligned(src.GetChannel(channel), ringBuffer.data(), srcOffset, writePosition, part);
+
+			writePosition = (writePosition + part) % ringBuffer.size();
+			srcOffset += part;
+			length -= part;
+		}
+	}
+
+	void SpectrumAnalyzer::Update(float deltaTimeMS)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!fft) return;
+
+		const std::size_t fftSize = frame.size();
+		const std::size_t nBins = spectrumDecibel.size();
+
+		// Copy the circular buffer out in order (oldest frame first), so the audio thread is only held up for the copy.
+		unsigned int channels;
+		{
+			std::lock_guard<std::mutex> ringLock(ringBufferMutex);
+			Detail::SimdHelper::CopyBufferUnaligned(ringBuffer.data(), frame.data(), writePosition, 0, fftSize - writePosition);
+			Detail::SimdHelper::CopyBufferUnaligned(ringBuffer.data(), frame.data(), 0, fftSize - writePosition, writePosition);
+			channels = nChannels;
+		}
+
+		Detail::SimdHelper::MulBuffer(window.data(), frame.data(), 0, 0, fftSize);
+		fft->Forward(frame.data(), spectrumReal.data(), spectrumImag.data());
+
+		// The buffer is the sum of every channel, so it's scaled back down to the average here.
+		Detail::SimdHelper::PowerSpectrumDecibel(spectrumReal.data(), spectrumImag.data(), spectrumDecibel.data(), nBins,
+			decibelOffset - 20.0f * std::log10(static_cast<float>(channels)), settings.minimumDecibel);
+
+		const float fallAmount = settings.fallRate * deltaTimeMS / 1000.0f;
+		const float peakFallAmount = settings.peakFallRate * deltaTimeMS / 1000.0f;
+		for (std::size_t band = 0; band < bands.size(); ++band)
+		{
+			float level;
+			if (bandEndBin[band] > bandFirstBin[band])
+			{
+				level = *std::max_element(spectrumDecibel.begin() + bandFirstBin[band], spectrumDecibel.begin() + bandEndBin[band]);
+			}
+			else
+			{
+				const unsigned int bin = static_cast<unsigned int>(bandCenterBin[band]);
+				const unsigned int nextBin = std::min(bin + 1, static_cast<unsigned int>(nBins - 1));
+				level = std::lerp(spectrumDecibel[bin], spectrumDecibel[nextBin], bandCenterBin[band] - static_cast<float>(bin));
+			}
+
+			bands[band] = std::max(level, bands[band] - fallAmount);
+
+			if (bands[band] >= peaks[band])
+			{
+				peaks[band] = bands[band];
+				peakHoldTimes[band] = static_cast<float>(settings.peakHoldTimeMS);
+			}
+			else if (peakHoldTimes[band] > 0.0f)
+				peakHoldTimes[band] -= deltaTimeMS;
+			else
+				peaks[band] = std::max(peaks[band] - peakFallAmount, bands[band]);
+		}
+	}
+
+	void SpectrumAnalyzer::GetBands(std::vector<float>& bandsOut, std::vector<float>& peaksOut)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bandsOut.assign(bands.begin(), bands.end());
+		peaksOut.assign(peaks.begin(), peaks.end());
+	}
+
+	float SpectrumAnalyzer::GetBandFrequency(unsigned int band)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const float nyquist = static_cast<float>(sampleRate) * 0.5f;
+		const float minimumFrequency = std::clamp(settings.minimumFrequency, 1.0f, std::max(nyquist, 1.0f));
+		const float maximumFrequency = std::clamp(settings.maximumFrequency, minimumFrequency, std::max(nyquist, minimumFrequency));
+		return minimumFrequency * std::pow(maximumFrequency / minimumFrequency,
+			(static_cast<float>(band) + 0.5f) / static_cast<float>(settings.nBands));
+	}
+}
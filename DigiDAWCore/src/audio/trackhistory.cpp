@@ -0,0 +1,353 @@
+#include "digidaw/core/audio/trackhistory.h"
+#include "digidaw/core/audio/mixer.h"
+
+#include <cstring>
+#include <unordered_set>
+
+namespace DigiDAW::Core::Audio
+{
+	TrackHistory::Values TrackHistory::GetValues(const TrackState::Mixable& mixable)
+	{
+		Values values{};
+		values.name.assign(mixable.name, std::find(mixable.name, mixable.name + sizeof(mixable.name) - 1, '\0'));
+		values.gain = mixable.gain;
+		values.pan = mixable.pan;
+		values.panDepth = mixable.panDepth;
+		values.effects = mixable.effects;
+		return values;
+	}
+
+	TrackHistory::Values TrackHistory::GetValues(const TrackState::Track& track)
+	{
+		Values values = GetValues(static_cast<const TrackState::Mixable&>(track));
+		values.liveInput = track.liveInput;
+		values.frozen = track.frozen;
+		values.clip = track.clip;
+		return values;
+	}
+
+	TrackHistory::Values TrackHistory::GetValues(const TrackState::Bus& bus)
+	{
+		Values values = GetValues(static_cast<const TrackState::Mixable&>(bus));
+		values.doublePrecisionSumming = bus.doublePrecisionSumming;
+		return values;
+	}
+
+	void TrackHistory::SetValues(const std::shared_ptr<TrackState::Mixable>& mixable, const Values& values, Mixer& mixer)
+	{
+		const std::size_t nameLength = std::min(values.name.size(), sizeof(mixable->name) - 1);
+		std::memcpy(mixable->name, values.name.data(), nameLength);
+		mixable->name[nameLength] = '\0';
+		mixable->gain = values.gain;
+		mixable->pan = values.pan;
+		mixable->panDepth = values.panDepth;
+
+		// Only the effects after the ones both chains start with are removed and added again (which prepares them again).
+		const auto first = std::mismatch(mixable->effects.begin(), mixable->effects.end(), values.effects.begin(), values.effects.end()).first;
+		const std::vector<std::shared_ptr<Effects::Effect>> removed(first, mixable->effects.end());
+		for (const std::shared_ptr<Effects::Effect>& effect : removed)
+			mixer.RemoveEffect(mixable, effect);
+		for (std::size_t effect = mixable->effects.size(); effect < values.effects.size(); ++effect)
+			mixer.AddEffect(mixable, values.effects[effect]);
+	}
+
+	void TrackHistory::SetValues(const std::shared_ptr<TrackState::Track>& track, const Values& values, Mixer& mixer)
+	{
+		SetValues(std::static_pointer_cast<TrackState::Mixable>(track), values, mixer);
+
+		if (track->liveInput != values.liveInput)
+			mixer.SetLiveInput(track, values.liveInput);
+		if (track->clip != values.clip)
+			mixer.SetClip(track, values.clip);
+
+		// After the effects and the clip, as whether the track can be frozen depends on them.
+		if (track->frozen != values.frozen)
+		{
+			if (values.frozen) mixer.FreezeTrack(track);
+			else mixer.UnfreezeTrack(track);
+		}
+	}
+
+	void TrackHistory::SetValues(const std::shared_ptr<TrackState::Bus>& bus, const Values& values, Mixer& mixer)
+	{
+		SetValues(std::static_pointer_cast<TrackState::Mixable>(bus), values, mixer);
+
+		if (bus->doublePrecisionSumming != values.doublePrecisionSumming)
+			mixer.SetDoublePrecisionSumming(bus, values.doublePrecisionSumming);
+	}
+
+	std::size_t TrackHistory::GetEntryMemory(const Values& values)
+	{
+		// Entries of tracks and buses are the same size, what they hold is the same type either way.
+		// Names that fit in the string itself (short string optimization) don't take any more.
+		const std::size_t nameMemory = (values.name.capacity() > std::string().capacity()) ? values.name.capacity() + 1 : 0;
+		return sizeof(Entry<TrackState::Track>) + values.effects.capacity() * sizeof(std::shared_ptr<Effects::Effect>) + nameMemory;
+	}
+
+	template<typename T>
+	bool TrackHistory::CommitChunks(const ChunkList<T>& previous, const std::vector<std::shared_ptr<T>>& mixables, ChunkList<T>& chunks, std::size_t& memory)
+	{
+		// Between commits, mixables are only removed, or added at the end, so going through both in order finds every one that was kept
+		// (anything else still ends up in the right order, it just doesn't share what's after it).
+		bool changed = false;
+		std::size_t newEntryMemory = 0;
+		std::size_t next = 0;
+		chunks.reserve(previous.size() + 1);
+		for (const std::shared_ptr<const Chunk<T>>& chunk : previous)
+		{
+			std::shared_ptr<Chunk<T>> newChunk; // Only once something in the chunk has changed.
+			for (std::size_t i = 0; i < chunk->entries.size(); ++i)
+			{
+				const std::shared_ptr<const Entry<T>>& entry = chunk->entries[i];
+
+				std::shared_ptr<const Entry<T>> newEntry; // Stays null if it was removed.
+				if (next < mixables.size() && mixables[next] == entry->mixable)
+				{
+					Values values = GetValues(*mixables[next]);
+					if (values == entry->values)
+					{
+						newEntry = entry;
+					}
+					else
+					{
+						newEntryMemory += GetEntryMemory(values);
+						newEntry = std::make_shared<const Entry<T>>(Entry<T>{ mixables[next], std::move(values) });
+					}
+					++next;
+				}
+
+				if (newEntry != entry && !newChunk)
+				{
+					newChunk = std::make_shared<Chunk<T>>();
+					newChunk->entries.assign(chunk->entries.begin(), chunk->entries.begin() + i);
+				}
+				if (newChunk && newEntry)
+					newChunk->entries.push_back(newEntry);
+			}
+
+			if (!newChunk)
+			{
+				chunks.push_back(chunk);
+				continue;
+			}
+
+			changed = true;
+			if (!newChunk->entries.empty())
+				chunks.push_back(newChunk);
+		}
+
+		// The ones that were added fill up the last chunk, then go into new ones.
+		while (next < mixables.size())
+		{
+			changed = true;
+
+			std::shared_ptr<Chunk<T>> newChunk = std::make_shared<Chunk<T>>();
+			if (!chunks.empty() && chunks.back()->entries.size() < chunkSize)
+			{
+				newChunk->entries = chunks.back()->entries;
+				chunks.pop_back();
+			}
+
+			const std::size_t nAdded = std::min(chunkSize - newChunk->entries.size(), mixables.size() - next);
+			for (std::size_t i = 0; i < nAdded; ++i, ++next)
+			{
+				newChunk->entries.push_back(std::make_shared<const Entry<T>>(Entry<T>{ mixables[next], GetValues(*mixables[next]) }));
+				newEntryMemory += GetEntryMemory(newChunk->entries.back()->values);
+			}
+			chunks.push_back(newChunk);
+		}
+
+		if (!changed) return false;
+
+		// What the previous snapshot doesn't have: the list of chunks, the chunks that aren't its own, and their new entries.
+		std::unordered_set<const Chunk<T>*> previousChunks;
+		for (const std::shared_ptr<const Chunk<T>>& chunk : previous)
+			previousChunks.insert(chunk.get());
+
+		memory += chunks.capacity() * sizeof(std::shared_ptr<const Chunk<T>>) + newEntryMemory;
+		for (const std::shared_ptr<const Chunk<T>>& chunk : chunks)
+			if (!previousChunks.contains(chunk.get()))
+				memory += sizeof(Chunk<T>) + chunk->entries.capacity() * sizeof(std::shared_ptr<const Entry<T>>);
+		return true;
+	}
+
+	template<typename T>
+	TrackHistory::Changes<T> TrackHistory::FindChanges(const ChunkList<T>& from, const ChunkList<T>& to)
+	{
+		// The chunks that both snapshots start and end with are shared, so only the ones in between can differ.
+		std::size_t first = 0;
+		std::size_t position = 0;
+		while (first < from.size() && first < to.size() && from[first] == to[first])
+			position += to[first++]->entries.size();
+
+		std::size_t nLast = 0;
+		while (nLast < from.size() - first && nLast < to.size() - first && from[from.size() - 1 - nLast] == to[to.size() - 1 - nLast])
+			++nLast;
+
+		std::unordered_set<const T*> fromMixables;
+		for (std::size_t chunk = first; chunk < from.size() - nLast; ++chunk)
+			for (const std::shared_ptr<const Entry<T>>& entry : from[chunk]->entries)
+				fromMixables.insert(entry->mixable.get());
+
+		Changes<T> changes;
+		std::unordered_set<const T*> toMixables;
+		for (std::size_t chunk = first; chunk < to.size() - nLast; ++chunk)
+		{
+			for (const std::shared_ptr<const Entry<T>>& entry : to[chunk]->entries)
+			{
+				toMixables.insert(entry->mixable.get());
+				if (!fromMixables.contains(entry->mixable.get()))
+					changes.restored.emplace_back(position, entry->mixable);
+				changes.entries.push_back(entry.get());
+				++position;
+			}
+		}
+
+		for (std::size_t chunk = first; chunk < from.size() - nLast; ++chunk)
+			for (const std::shared_ptr<const Entry<T>>& entry : from[chunk]->entries)
+				if (!toMixables.contains(entry->mixable.get()))
+					changes.removed.push_back(entry->mixable);
+		return changes;
+	}
+
+	void TrackHistory::Apply(const Snapshot& from, const Snapshot& to, TrackState& trackState, Mixer& mixer)
+	{
+		Changes<TrackState::Track> tracks = FindChanges(from.tracks, to.tracks);
+		Changes<TrackState::Bus> buses = FindChanges(from.buses, to.buses);
+
+		// Anything the TrackState doesn't match the snapshot on (as it wasn't committed) is skipped, rather than removed or added twice.
+		const auto contains = [](const auto& mixables, const auto& mixable)
+			{
+				return std::find(mixables.begin(), mixables.end(), mixable) != mixables.end();
+			};
+
+		// Buses are removed before the tracks they have as inputs, and put back after them.
+		for (std::shared_ptr<TrackState::Bus>& bus : buses.removed)
+			if (contains(trackState.GetAllBuses(), bus)) trackState.RemoveBus(bus);
+		for (std::shared_ptr<TrackState::Track>& track : tracks.removed)
+			if (contains(trackState.GetAllTracks(), track)) trackState.RemoveTrack(track);
+
+		for (const auto& [position, track] : tracks.restored)
+			if (!contains(trackState.GetAllTracks(), track)) trackState.RestoreTrack(track, position);
+		for (const auto& [position, bus] : buses.restored)
+			if (!contains(trackState.GetAllBuses(), bus)) trackState.RestoreBus(bus, position);
+
+		for (const Entry<TrackState::Track>* entry : tracks.entries)
+			SetValues(entry->mixable, entry->values, mixer);
+		for (const Entry<TrackState::Bus>* entry : buses.entries)
+			SetValues(entry->mixable, entry->values, mixer);
+	}
+
+	bool TrackHistory::Commit(TrackState& trackState)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const std::shared_ptr<const Snapshot> previous = steps.empty() ? std::make_shared<const Snapshot>() : steps[currentStep].snapshot;
+
+		std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+		std::size_t memory = sizeof(Snapshot);
+		const bool tracksChanged = CommitChunks(previous->tracks, trackState.GetAllTracks(), snapshot->tracks, memory);
+		const bool busesChanged = CommitChunks(previous->buses, trackState.GetAllBuses(), snapshot->buses, memory);
+		if (!steps.empty() && !tracksChanged && !busesChanged) return false;
+
+		snapshot->nTracks = trackState.GetAllTracks().size();
+		snapshot->nBuses = trackState.GetAllBuses().size();
+
+		// What could be redone is gone once something else has changed.
+		if (!steps.empty())
+			steps.erase(steps.begin() + static_cast<std::ptrdiff_t>(currentStep) + 1, steps.end());
+		steps.push_back(Step{ snapshot, memory });
+		currentStep = steps.size() - 1;
+
+		while (steps.size() > maxSteps)
+		{
+			steps.pop_front();
+			--currentStep;
+		}
+		return true;
+	}
+
+	bool TrackHistory::Undo(TrackState& trackState, Mixer& mixer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (steps.empty() || currentStep == 0) return false;
+
+		Apply(*steps[currentStep].snapshot, *steps[currentStep - 1].snapshot, trackState, mixer);
+		--currentStep;
+		return true;
+	}
+
+	bool TrackHistory::Redo(TrackState& trackState, Mixer& mixer)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (currentStep + 1 >= steps.size()) return false;
+
+		Apply(*steps[currentStep].snapshot, *steps[currentStep + 1].snapshot, trackState, mixer);
+		++currentStep;
+		return true;
+	}
+
+	bool TrackHistory::CanUndo()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return !steps.empty() && currentStep > 0;
+	}
+
+	bool TrackHistory::CanRedo()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return currentStep + 1 < steps.size();
+	}
+
+	void TrackHistory::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		steps.clear();
+		currentStep = 0;
+	}
+
+	std::shared_ptr<const TrackHistory::Snapshot> TrackHistory::GetCurrentSnapshot()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return steps.empty() ? nullptr : steps[currentStep].snapshot;
+	}
+
+	void TrackHistory::SetMaxSteps(std::size_t maxSteps)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->maxSteps = std::max<std::size_t>(maxSteps, 1);
+
+		// The oldest go first, then the ones that could be redone (the current snapshot is always kept).
+		while (steps.size() > this->maxSteps)
+		{
+			if (currentStep > 0)
+			{
+				steps.pop_front();
+				--currentStep;
+			}
+			else steps.pop_back();
+		}
+	}
+
+	std::size_t TrackHistory::GetStepCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return steps.size();
+	}
+
+	std::size_t TrackHistory::GetStepMemory(std::size_t step)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return (step < steps.size()) ? steps[step].memory : 0;
+	}
+
+	std::size_t TrackHistory::GetMemory()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::size_t memory = 0;
+		for (const Step& step : steps)
+			memory += step.memory;
+		return memory;
+	}
+}
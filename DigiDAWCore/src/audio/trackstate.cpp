@@ -2,10 +2,18 @@
 
 namespace DigiDAW::Core::Audio
 {
+	static TrackState::ChannelNumber ClampChannelNumber(TrackState::ChannelNumber nChannels)
+	{
+		return static_cast<TrackState::ChannelNumber>(std::clamp(static_cast<int>(nChannels), 
+			static_cast<int>(TrackState::ChannelNumber::Mono), static_cast<int>(TrackState::ChannelNumber::MAX)));
+	}
+
 	std::shared_ptr<TrackState::Track> TrackState::AddTrack(Track track)
 	{
 		std::lock_guard<std::mutex> lock(tracksMutex);
 
+		track.nChannels = ClampChannelNumber(track.nChannels);
+
 		currentTracks.push_back(std::make_shared<Track>(track));
 		for (auto& func : addTrackCallbacks) func(currentTracks.back());
 		return currentTracks.back();
@@ -15,11 +23,31 @@ namespace DigiDAW::Core::Audio
 	{
 		std::lock_guard<std::mutex> lock(busesMutex);
 
+		bus.nChannels = ClampChannelNumber(bus.nChannels);
+
 		currentBuses.push_back(std::make_shared<Bus>(bus));
 		for (auto& func : addBusCallbacks) func(currentBuses.back());
 		return currentBuses.back();
 	}
 
+	std::shared_ptr<TrackState::Track> TrackState::RestoreTrack(const std::shared_ptr<Track>& track, std::size_t position)
+	{
+		std::lock_guard<std::mutex> lock(tracksMutex);
+
+		auto it = currentTracks.insert(currentTracks.begin() + std::min(position, currentTracks.size()), track);
+		for (auto& func : addTrackCallbacks) func(*it);
+		return *it;
+	}
+
+	std::shared_ptr<TrackState::Bus> TrackState::RestoreBus(const std::shared_ptr<Bus>& bus, std::size_t position)
+	{
+		std::lock_guard<std::mutex> lock(busesMutex);
+
+		auto it = currentBuses.insert(currentBuses.begin() + std::min(position, currentBuses.size()), bus);
+		for (auto& func : addBusCallbacks) func(*it);
+		return *it;
+	}
+
 	void TrackState::RemoveTrack(std::shared_ptr<Track>& track)
 	{
 		std::lock_guard<std::mutex> lock(tracksMutex);
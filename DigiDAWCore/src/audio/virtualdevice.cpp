@@ -0,0 +1,240 @@
+#include "digidaw/core/audio/virtualdevice.h"
+
+#include "detail/hash.h"
+
+namespace DigiDAW::Core::Audio
+{
+	VirtualDevice::VirtualDevice(const Settings& settings)
+	{
+		this->settings = settings;
+		this->inputLoaded = false;
+		this->referenceLoaded = false;
+		this->streamOpen = false;
+		this->callback = nullptr;
+		this->userData = nullptr;
+		this->nStreamOutputChannels = 0;
+		this->nStreamInputChannels = 0;
+		this->streamSampleRate = 0;
+		this->bufferFrames = 0;
+		this->framePosition = 0;
+		this->outputHash = Detail::Hash::offsetBasis;
+		this->referenceDifference = 0.0;
+		this->streamTime = 0.0;
+		this->running = false;
+
+		unsigned int inputSampleRate = 0;
+		if (!settings.inputPath.empty())
+			inputLoaded = WavReader::Read(settings.inputPath, input, inputSampleRate) == ReturnCode::Success;
+
+		unsigned int referenceSampleRate = 0;
+		if (!settings.referencePath.empty())
+			referenceLoaded = WavReader::Read(settings.referencePath, reference, referenceSampleRate) == ReturnCode::Success;
+
+		info.probed = true;
+		info.ID = 0;
+		info.name = "Virtual Device";
+		info.outputChannels = settings.nOutputChannels;
+		// An input file that can't be read leaves it without any inputs, rather than quietly using silence instead.
+		info.inputChannels = inputLoaded ? input.GetChannelCount() : (settings.inputPath.empty() ? settings.nInputChannels : 0);
+		info.duplexChannels = std::min(info.outputChannels, info.inputChannels);
+		info.isDefaultOutput = true;
+		info.isDefaultInput = true;
+		info.sampleRates = inputLoaded ? std::vector<unsigned int>{ inputSampleRate } : settings.sampleRates;
+		info.preferredSampleRate = !info.sampleRates.empty() ? *std::max_element(info.sampleRates.begin(), info.sampleRates.end()) : 0;
+		info.nativeFormats = RTAUDIO_FLOAT32;
+	}
+
+	VirtualDevice::~VirtualDevice()
+	{
+		CloseStream();
+	}
+
+	RtAudio::DeviceInfo VirtualDevice::GetDeviceInfo(unsigned int device)
+	{
+		return (device == 0) ? info : RtAudio::DeviceInfo();
+	}
+
+	RtAudioErrorType VirtualDevice::OpenStream(
+		RtAudio::StreamParameters* outputParams,
+		RtAudio::StreamParameters* inputParams,
+		RtAudioFormat format,
+		unsigned int sampleRate,
+		unsigned int* bufferFrames,
+		RtAudioCallback callback,
+		void* userData,
+		RtAudio::StreamOptions* options)
+	{
+		if (streamOpen || !callback || !bufferFrames || (!outputParams && !inputParams))
+			return RTAUDIO_INVALID_USE;
+		if (format != RTAUDIO_FLOAT32 || !options || !(options->flags & RTAUDIO_NONINTERLEAVED))
+			return RTAUDIO_INVALID_USE;
+
+		const auto validParams = [](const RtAudio::StreamParameters* params, unsigned int nChannels)
+			{
+				return !params || (params->deviceId == 0 && params->nChannels > 0 && params->firstChannel + params->nChannels <= nChannels);
+			};
+		if (!validParams(outputParams, info.outputChannels) || !validParams(inputParams, info.inputChannels))
+			return RTAUDIO_INVALID_USE;
+		if (std::find(info.sampleRates.begin(), info.sampleRates.end(), sampleRate) == info.sampleRates.end())
+			return RTAUDIO_INVALID_USE;
+
+		*bufferFrames = std::max(*bufferFrames, 1u);
+
+		this->nStreamOutputChannels = outputParams ? outputParams->nChannels : 0;
+		this->nStreamInputChannels = inputParams ? inputParams->nChannels : 0;
+		this->streamSampleRate = sampleRate;
+		this->bufferFrames = *bufferFrames;
+		this->callback = callback;
+		this->userData = userData;
+
+		if (nStreamOutputChannels > 0 && !settings.outputPath.empty() &&
+			output.Open(settings.outputPath, nStreamOutputChannels, sampleRate, this->bufferFrames) != ReturnCode::Success)
+			return RTAUDIO_SYSTEM_ERROR;
+
+		outputBuffer = std::vector<float>(static_cast<std::size_t>(nStreamOutputChannels) * this->bufferFrames);
+		inputBuffer = std::vector<float>(static_cast<std::size_t>(nStreamInputChannels) * this->bufferFrames);
+
+		// Every stream starts from the beginning (of the input file, and of the random amounts).
+		framePosition = 0;
+		outputHash = Detail::Hash::offsetBasis;
+		referenceDifference = 0.0;
+		streamTime = 0.0;
+		framesRandom.seed(settings.seed);
+		jitterRandom.seed(settings.seed + 1);
+
+		streamOpen = true;
+		return RTAUDIO_NO_ERROR;
+	}
+
+	void VirtualDevice::CloseStream()
+	{
+		if (!streamOpen) return;
+
+		StopStream();
+		output.Close();
+		streamOpen = false;
+	}
+
+	RtAudioErrorType VirtualDevice::StartStream()
+	{
+		if (!streamOpen) return RTAUDIO_INVALID_USE;
+		if (running) return RTAUDIO_WARNING;
+
+		// The stream can have stopped itself (at the end of its length, or when the callback asked it to).
+		JoinDeviceThread();
+
+		if (settings.lengthFrames != 0 && framePosition >= settings.lengthFrames)
+			return RTAUDIO_WARNING;
+
+		running = true;
+		deviceThread = std::jthread([&](std::stop_token stopToken) { Run(stopToken); });
+		return RTAUDIO_NO_ERROR;
+	}
+
+	RtAudioErrorType VirtualDevice::StopStream()
+	{
+		if (!streamOpen) return RTAUDIO_INVALID_USE;
+
+		const bool wasRunning = running;
+		JoinDeviceThread();
+		return wasRunning ? RTAUDIO_NO_ERROR : RTAUDIO_WARNING;
+	}
+
+	void VirtualDevice::JoinDeviceThread()
+	{
+		if (!deviceThread.joinable()) return;
+
+		deviceThread.request_stop();
+		deviceThread.join();
+	}
+
+	void VirtualDevice::CheckOutput(const AudioBufferView& outputView)
+	{
+		const unsigned int nFrames = outputView.GetFrameCount();
+		for (unsigned int frame = 0; frame < nFrames; ++frame)
+			for (unsigned int channel = 0; channel < outputView.GetChannelCount(); ++channel)
+				outputHash = Detail::Hash::Combine(outputHash, outputView.GetChannel(channel)[frame]);
+
+		if (!referenceLoaded) return;
+
+		for (unsigned int channel = 0; channel < outputView.GetChannelCount(); ++channel)
+		{
+			const float* samples = outputView.GetChannel(channel);
+			const float* referenceSamples = (channel < reference.GetChannelCount()) ? reference.GetChannel(channel) : nullptr;
+			for (unsigned int frame = 0; frame < nFrames; ++frame)
+			{
+				const std::uint64_t position = framePosition + frame;
+				const float expected = (referenceSamples && position < reference.GetFrameCount()) ? referenceSamples[position] : 0.0f;
+				referenceDifference = std::max(referenceDifference, std::abs(static_cast<double>(samples[frame]) - expected));
+			}
+		}
+	}
+
+	void VirtualDevice::Run(std::stop_token stopToken)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		std::uniform_int_distribution<unsigned int> framesDistribution(1, bufferFrames);
+		std::uniform_real_distribution<double> jitterDistribution(0.0, std::max(settings.jitterMS, 0.0));
+
+		Clock::time_point deadline = Clock::now();
+		RtAudioStreamStatus status = 0;
+		while (!stopToken.stop_requested())
+		{
+			unsigned int nFrames = settings.variableFrames ? framesDistribution(framesRandom) : bufferFrames;
+			if (settings.lengthFrames != 0)
+				nFrames = static_cast<unsigned int>(std::min<std::uint64_t>(nFrames, settings.lengthFrames - framePosition));
+
+			// The channels are nFrames apart, like they are from RtAudio.
+			AudioBufferView inputView(inputBuffer.data(), nStreamInputChannels, nFrames);
+			for (unsigned int channel = 0; channel < nStreamInputChannels; ++channel)
+			{
+				float* samples = inputView.GetChannel(channel);
+				unsigned int nRead = 0;
+				if (inputLoaded && framePosition < input.GetFrameCount())
+				{
+					nRead = static_cast<unsigned int>(std::min<std::uint64_t>(nFrames, input.GetFrameCount() - framePosition));
+					std::copy_n(input.GetChannel(channel) + framePosition, nRead, samples);
+				}
+				std::fill(samples + nRead, samples + nFrames, 0.0f);
+			}
+			std::fill(outputBuffer.begin(), outputBuffer.end(), 0.0f);
+
+			const int result = callback(
+				nStreamOutputChannels > 0 ? outputBuffer.data() : nullptr,
+				nStreamInputChannels > 0 ? inputBuffer.data() : nullptr,
+				nFrames, streamTime, status, userData);
+			if (result == 2) break; // Abort, without playing this block.
+
+			const AudioBufferView outputView(outputBuffer.data(), nStreamOutputChannels, nFrames);
+			output.Write(outputView, nFrames);
+			CheckOutput(outputView);
+			framePosition += nFrames;
+			streamTime = static_cast<double>(framePosition) / streamSampleRate;
+
+			if (result == 1 || (settings.lengthFrames != 0 && framePosition >= settings.lengthFrames)) break;
+
+			status = 0;
+			if (settings.simulateClock)
+			{
+				// The next block is due once this one has played, and the callback arrives late by up to the jitter.
+				const auto blockDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(nFrames) / streamSampleRate));
+				const auto jitter = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(jitterDistribution(jitterRandom)));
+				deadline += blockDuration;
+				std::this_thread::sleep_until(deadline + jitter);
+
+				// A callback that took longer than a block would have left a real device without anything to play, which then carries on from now.
+				const Clock::time_point now = Clock::now();
+				if (now - deadline > blockDuration)
+				{
+					status = RTAUDIO_OUTPUT_UNDERFLOW;
+					deadline = now;
+				}
+			}
+		}
+
+		// So the output file is whole even if the stream stopped itself, and is never stopped.
+		output.Flush();
+		running = false;
+	}
+}
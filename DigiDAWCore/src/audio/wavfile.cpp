@@ -0,0 +1,217 @@
+#include "digidaw/core/audio/wavfile.h"
+
+#include <cstring>
+
+namespace DigiDAW::Core::Audio
+{
+	// WAV files are always little endian, whatever the machine is.
+	static std::uint32_t ReadLE(const unsigned char* bytes, unsigned int nBytes)
+	{
+		std::uint32_t value = 0;
+		for (unsigned int i = 0; i < nBytes; ++i)
+			value |= static_cast<std::uint32_t>(bytes[i]) << (8 * i);
+		return value;
+	}
+
+	static void WriteLE(std::ostream& stream, std::uint32_t value, unsigned int nBytes)
+	{
+		for (unsigned int i = 0; i < nBytes; ++i)
+			stream.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+	static constexpr std::uint16_t formatPCM = 1;
+	static constexpr std::uint16_t formatFloat = 3;
+	static constexpr std::uint16_t formatExtensible = 0xFFFE;
+
+	ReturnCode WavReader::Read(const std::filesystem::path& path, AudioBuffer& audio, unsigned int& sampleRate)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return ReturnCode::Error;
+
+		unsigned char header[12];
+		if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+			std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0)
+			return ReturnCode::Error;
+
+		std::uint16_t format = 0;
+		unsigned int nChannels = 0;
+		unsigned int fileSampleRate = 0;
+		unsigned int bitsPerSample = 0;
+		std::vector<unsigned char> data;
+
+		unsigned char chunkHeader[8];
+		while (file.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader)))
+		{
+			const std::uint32_t chunkSize = ReadLE(chunkHeader + 4, 4);
+			const std::streamoff paddedSize = static_cast<std::streamoff>(chunkSize) + (chunkSize & 1);
+
+			if (std::memcmp(chunkHeader, "fmt ", 4) == 0)
+			{
+				if (chunkSize < 16 || chunkSize > 64) return ReturnCode::Error;
+
+				unsigned char fmt[64];
+				if (!file.read(reinterpret_cast<char*>(fmt), paddedSize)) return ReturnCode::Error;
+
+				format = static_cast<std::uint16_t>(ReadLE(fmt, 2));
+				nChannels = ReadLE(fmt + 2, 2);
+				fileSampleRate = ReadLE(fmt + 4, 4);
+				bitsPerSample = ReadLE(fmt + 14, 2);
+
+				// The actual format is at the start of the sub format GUID.
+				if (format == formatExtensible)
+				{
+					if (chunkSize < 40) return ReturnCode::Error;
+					format = static_cast<std::uint16_t>(ReadLE(fmt + 24, 2));
+				}
+			}
+			else if (std::memcmp(chunkHeader, "data", 4) == 0)
+			{
+				// Streams that were cut short can claim more data than there is, so it's read up to the end of the file.
+				data.resize(chunkSize);
+				file.read(reinterpret_cast<char*>(data.data()), chunkSize);
+				data.resize(static_cast<std::size_t>(file.gcount()));
+				break;
+			}
+			else if (!file.seekg(paddedSize, std::ios::cur))
+				return ReturnCode::Error;
+		}
+
+		const bool supported =
+			(format == formatPCM && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32)) ||
+			(format == formatFloat && (bitsPerSample == 32 || bitsPerSample == 64));
+		if (!supported || nChannels == 0 || fileSampleRate == 0)
+			return ReturnCode::Error;
+
+		const unsigned int bytesPerSample = bitsPerSample / 8;
+		const std::size_t nFrames = data.size() / (static_cast<std::size_t>(bytesPerSample) * nChannels);
+		if (nFrames > std::numeric_limits<unsigned int>::max())
+			return ReturnCode::Error;
+
+		AudioBuffer read(nChannels, static_cast<unsigned int>(nFrames));
+		const unsigned char* sample = data.data();
+		for (std::size_t frame = 0; frame < nFrames; ++frame)
+		{
+			for (unsigned int channel = 0; channel < nChannels; ++channel, sample += bytesPerSample)
+			{
+				float value = 0.0f;
+				if (format == formatFloat && bitsPerSample == 32)
+				{
+					const std::uint32_t bits = ReadLE(sample, 4);
+					std::memcpy(&value, &bits, sizeof(value));
+				}
+				else if (format == formatFloat)
+				{
+					const std::uint64_t bits = ReadLE(sample, 4) | (static_cast<std::uint64_t>(ReadLE(sample + 4, 4)) << 32);
+					double wide = 0.0;
+					std::memcpy(&wide, &bits, sizeof(wide));
+					value = static_cast<float>(wide);
+				}
+				else
+				{
+					// Sign extend from the top of a 32 bit integer, so every size scales the same way.
+					const std::int32_t integer = static_cast<std::int32_t>(ReadLE(sample, bytesPerSample) << (32 - bitsPerSample));
+					value = static_cast<float>(static_cast<double>(integer) / 2147483648.0);
+				}
+				read.GetChannel(channel)[frame] = value;
+			}
+		}
+
+		audio = std::move(read);
+		sampleRate = fileSampleRate;
+		return ReturnCode::Success;
+	}
+
+	ReturnCode WavWriter::Open(const std::filesystem::path& path, unsigned int nChannels, unsigned int sampleRate, unsigned int maxFrames)
+	{
+		Close();
+		if (nChannels == 0 || sampleRate == 0) return ReturnCode::Error;
+
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file) return ReturnCode::Error;
+
+		this->nChannels = nChannels;
+		this->nFrames = 0;
+		this->interleaved = std::vector<float>(static_cast<std::size_t>(nChannels) * maxFrames);
+
+		// The sizes are filled in by Flush.
+		const unsigned int bytesPerFrame = nChannels * sizeof(float);
+		file.write("RIFF", 4);
+		WriteLE(file, 0, 4);
+		file.write("WAVE", 4);
+
+		file.write("fmt ", 4);
+		WriteLE(file, 18, 4);
+		WriteLE(file, formatFloat, 2);
+		WriteLE(file, nChannels, 2);
+		WriteLE(file, sampleRate, 4);
+		WriteLE(file, sampleRate * bytesPerFrame, 4);
+		WriteLE(file, bytesPerFrame, 2);
+		WriteLE(file, 32, 2);
+		WriteLE(file, 0, 2);
+
+		file.write("fact", 4);
+		WriteLE(file, 4, 4);
+		WriteLE(file, 0, 4);
+
+		file.write("data", 4);
+		WriteLE(file, 0, 4);
+
+		if (!file)
+		{
+			Close();
+			return ReturnCode::Error;
+		}
+		return ReturnCode::Success;
+	}
+
+	void WavWriter::Write(const AudioBufferView& audio, unsigned int nFrames)
+	{
+		if (!file.is_open()) return;
+
+		nFrames = static_cast<unsigned int>(std::min<std::size_t>(nFrames, interleaved.size() / nChannels));
+		for (unsigned int channel = 0; channel < nChannels; ++channel)
+		{
+			const float* samples = audio.GetChannel(channel);
+			for (unsigned int frame = 0; frame < nFrames; ++frame)
+				interleaved[static_cast<std::size_t>(frame) * nChannels + channel] = samples[frame];
+		}
+
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			file.write(reinterpret_cast<const char*>(interleaved.data()), static_cast<std::streamsize>(nFrames) * nChannels * sizeof(float));
+		}
+		else
+		{
+			for (std::size_t i = 0; i < static_cast<std::size_t>(nFrames) * nChannels; ++i)
+				WriteLE(file, std::bit_cast<std::uint32_t>(interleaved[i]), 4);
+		}
+		this->nFrames += nFrames;
+	}
+
+	void WavWriter::Flush()
+	{
+		if (!file.is_open()) return;
+
+		// Sizes that don't fit are left at the largest they can be, which most readers take as "up to the end of the file".
+		const std::uint64_t dataSize = nFrames * nChannels * sizeof(float);
+		const std::uint32_t maxSize = std::numeric_limits<std::uint32_t>::max();
+
+		const std::streampos end = file.tellp();
+		file.seekp(4);
+		WriteLE(file, static_cast<std::uint32_t>(std::min<std::uint64_t>(dataSize + 50, maxSize)), 4);
+		file.seekp(46);
+		WriteLE(file, static_cast<std::uint32_t>(std::min<std::uint64_t>(nFrames, maxSize)), 4);
+		file.seekp(54);
+		WriteLE(file, static_cast<std::uint32_t>(std::min<std::uint64_t>(dataSize, maxSize)), 4);
+		file.seekp(end);
+		file.flush();
+	}
+
+	void WavWriter::Close()
+	{
+		if (!file.is_open()) return;
+
+		Flush();
+		file.close();
+	}
+}
@@ -0,0 +1,69 @@
+#include "digidaw/core/threading/denormals.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <xmmintrin.h>
+#define DIGIDAW_DENORMALS_MXCSR
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DIGIDAW_DENORMALS_FPCR
+#endif
+
+namespace DigiDAW::Core::Threading
+{
+#if defined(DIGIDAW_DENORMALS_MXCSR)
+	static constexpr std::uint64_t flushDenormalsFlags = 0x8040; // FTZ (bit 15) and DAZ (bit 6) of the MXCSR.
+
+	static std::uint64_t GetFloatingPointState()
+	{
+		return _mm_getcsr();
+	}
+
+	static void SetFloatingPointState(std::uint64_t state)
+	{
+		_mm_setcsr(static_cast<unsigned int>(state));
+	}
+#elif defined(DIGIDAW_DENORMALS_FPCR)
+	static constexpr std::uint64_t flushDenormalsFlags = 1ull << 24; // FZ of the FPCR (which covers both inputs and outputs).
+
+	static std::uint64_t GetFloatingPointState()
+	{
+		std::uint64_t state;
+		__asm__ __volatile__("mrs %0, fpcr" : "=r"(state));
+		return state;
+	}
+
+	static void SetFloatingPointState(std::uint64_t state)
+	{
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+	}
+#else
+	// Nothing to set on other architectures.
+	static constexpr std::uint64_t flushDenormalsFlags = 0;
+
+	static std::uint64_t GetFloatingPointState()
+	{
+		return 0;
+	}
+
+	static void SetFloatingPointState(std::uint64_t)
+	{
+	}
+#endif
+
+	DenormalGuard::DenormalGuard()
+	{
+		previousState = GetFloatingPointState();
+		if ((previousState & flushDenormalsFlags) != flushDenormalsFlags)
+			SetFloatingPointState(previousState | flushDenormalsFlags);
+	}
+
+	DenormalGuard::~DenormalGuard()
+	{
+		if (GetFloatingPointState() != previousState)
+			SetFloatingPointState(previousState);
+	}
+
+	bool DenormalGuard::IsFlushingDenormals()
+	{
+		return flushDenormalsFlags != 0 && (GetFloatingPointState() & flushDenormalsFlags) == flushDenormalsFlags;
+	}
+}
@@ -0,0 +1,210 @@
+#include "digidaw/core/threading/priority.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace DigiDAW::Core::Threading
+{
+	// Whether SetCurrentThreadAffinity pinned the calling thread, and the affinity it had before that
+	// (which UnpinCurrentThread gives back, as it may have been set by the audio API, the host or the user).
+	static thread_local bool pinned = false;
+#if defined(_WIN32)
+	static thread_local DWORD_PTR unpinnedMask = 0;
+#elif !defined(__APPLE__)
+	static thread_local cpu_set_t unpinnedSet;
+#endif
+
+	bool ThreadPriority::SetCurrentThreadPriority(Priority priority)
+	{
+		if (priority == Priority::Realtime)
+			return SetCurrentThreadRealtime(Scheduling().realtimePriority, false) > 0;
+
+#if defined(_WIN32)
+		int windowsPriority = THREAD_PRIORITY_NORMAL;
+		switch (priority)
+		{
+		case Priority::Low: windowsPriority = THREAD_PRIORITY_BELOW_NORMAL; break;
+		case Priority::Normal: windowsPriority = THREAD_PRIORITY_NORMAL; break;
+		case Priority::High: windowsPriority = THREAD_PRIORITY_ABOVE_NORMAL; break;
+		default: break;
+		}
+		return SetThreadPriority(GetCurrentThread(), windowsPriority) != 0;
+#elif defined(__APPLE__)
+		qos_class_t qosClass = QOS_CLASS_DEFAULT;
+		switch (priority)
+		{
+		case Priority::Low: qosClass = QOS_CLASS_UTILITY; break;
+		case Priority::Normal: qosClass = QOS_CLASS_DEFAULT; break;
+		case Priority::High: qosClass = QOS_CLASS_USER_INTERACTIVE; break;
+		default: break;
+		}
+		return pthread_set_qos_class_self_np(qosClass, 0) == 0;
+#else
+		// Leave realtime scheduling first (if the thread was realtime), as the nice value is ignored by SCHED_FIFO/SCHED_RR.
+		sched_param param = {};
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+		// On Linux the nice value is per thread (when using the thread id), lowering it below 0 usually needs privileges.
+		int niceValue = 0;
+		switch (priority)
+		{
+		case Priority::Low: niceValue = 10; break;
+		case Priority::Normal: niceValue = 0; break;
+		case Priority::High: niceValue = -10; break;
+		default: break;
+		}
+		return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), niceValue) == 0;
+#endif
+	}
+
+	int ThreadPriority::SetCurrentThreadRealtime(int realtimePriority, bool roundRobin)
+	{
+		realtimePriority = std::clamp(realtimePriority, 1, 99);
+
+#if defined(_WIN32)
+		return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0 ? realtimePriority : 0;
+#elif defined(__APPLE__)
+		// The thread needs up to 2ms of every 5ms (which is more than any callback takes), and can be preempted.
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		const double ticksPerMS = 1000000.0 * static_cast<double>(timebase.denom) / static_cast<double>(timebase.numer);
+
+		thread_time_constraint_policy_data_t policy;
+		policy.period = 0;
+		policy.computation = static_cast<uint32_t>(2.0 * ticksPerMS);
+		policy.constraint = static_cast<uint32_t>(5.0 * ticksPerMS);
+		policy.preemptible = 1;
+		return thread_policy_set(
+			mach_thread_self(), THREAD_TIME_CONSTRAINT_POLICY,
+			reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS ? realtimePriority : 0;
+#else
+		const int policy = roundRobin ? SCHED_RR : SCHED_FIFO;
+
+		sched_param param = {};
+		param.sched_priority = realtimePriority;
+		if (pthread_setschedparam(pthread_self(), policy, &param) == 0) return realtimePriority;
+
+		// Without CAP_SYS_NICE, only priorities up to RLIMIT_RTPRIO are allowed (which is 0 unless it's been configured).
+		rlimit limit;
+		if (getrlimit(RLIMIT_RTPRIO, &limit) != 0 || limit.rlim_cur == 0) return 0;
+
+		param.sched_priority = std::min(realtimePriority, static_cast<int>(std::min<rlim_t>(limit.rlim_cur, 99)));
+		if (pthread_setschedparam(pthread_self(), policy, &param) == 0) return param.sched_priority;
+		return 0;
+#endif
+	}
+
+	bool ThreadPriority::SetCurrentThreadAffinity(int core)
+	{
+#if defined(_WIN32)
+		DWORD_PTR mask;
+		if (core < 0)
+		{
+			DWORD_PTR systemMask;
+			if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask)) return false;
+		}
+		else
+		{
+			if (core >= static_cast<int>(sizeof(DWORD_PTR) * 8)) return false;
+			mask = static_cast<DWORD_PTR>(1) << core;
+		}
+		const DWORD_PTR previousMask = SetThreadAffinityMask(GetCurrentThread(), mask);
+		if (previousMask == 0) return false;
+
+		if (core >= 0 && !pinned) unpinnedMask = previousMask;
+		pinned = core >= 0;
+		return true;
+#elif defined(__APPLE__)
+		// macOS only has affinity hints (which don't pin anything), so letting the thread run anywhere is all that's supported.
+		return core < 0;
+#else
+		cpu_set_t previousSet;
+		if (core >= 0 && !pinned && pthread_getaffinity_np(pthread_self(), sizeof(previousSet), &previousSet) != 0) return false;
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (core < 0)
+		{
+			for (unsigned int i = 0; i < GetCoreCount(); ++i)
+				CPU_SET(i, &set);
+		}
+		else
+			CPU_SET(static_cast<unsigned int>(core), &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) return false;
+
+		if (core >= 0 && !pinned) unpinnedSet = previousSet;
+		pinned = core >= 0;
+		return true;
+#endif
+	}
+
+	bool ThreadPriority::UnpinCurrentThread()
+	{
+		if (!pinned) return true;
+
+#if defined(_WIN32)
+		if (SetThreadAffinityMask(GetCurrentThread(), unpinnedMask) == 0) return false;
+#elif !defined(__APPLE__)
+		if (pthread_setaffinity_np(pthread_self(), sizeof(unpinnedSet), &unpinnedSet) != 0) return false;
+#endif
+		pinned = false;
+		return true;
+	}
+
+	unsigned int ThreadPriority::GetCoreCount()
+	{
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	ThreadPriority::Report ThreadPriority::ScheduleCurrentThread(const Scheduling& scheduling, std::size_t index)
+	{
+		Report report;
+		report.requested = scheduling.priority;
+
+		Priority priority = scheduling.priority;
+		if (priority == Priority::Realtime)
+		{
+			report.realtimePriority = SetCurrentThreadRealtime(scheduling.realtimePriority, scheduling.roundRobin);
+			if (report.realtimePriority > 0)
+				report.granted = Priority::Realtime;
+			else
+				priority = Priority::High; // Not allowed, so fall back to the highest normal priority.
+		}
+
+		if (report.realtimePriority == 0)
+		{
+			if (priority != Priority::Normal && !SetCurrentThreadPriority(priority))
+				priority = Priority::Normal;
+			// This also undoes any previous scheduling (which can fail when going back up, e.g. from Low on Linux).
+			if (priority == Priority::Normal)
+				SetCurrentThreadPriority(Priority::Normal);
+			report.granted = priority;
+		}
+
+		if (scheduling.firstCore >= 0)
+		{
+			const unsigned int core = (static_cast<unsigned int>(scheduling.firstCore) + 
+				static_cast<unsigned int>(index % std::max(scheduling.nCores, 1u))) % GetCoreCount();
+			if (SetCurrentThreadAffinity(static_cast<int>(core))) report.core = static_cast<int>(core);
+		}
+		else
+			UnpinCurrentThread(); // Only if pinning was on before, any other affinity the thread has isn't ours to change.
+
+		return report;
+	}
+}
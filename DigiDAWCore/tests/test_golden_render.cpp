@@ -0,0 +1,385 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "digidaw/core/audio/engine.h"
+#include "digidaw/core/audio/wavfile.h"
+#include "digidaw/core/audio/effects/equalizer.h"
+#include "digidaw/core/audio/effects/dynamics.h"
+#include "digidaw/core/audio/effects/convolution.h"
+
+using namespace DigiDAW::Core;
+using namespace DigiDAW::Core::Audio;
+
+/*
+ * Renders every reference session on the virtual device (as fast as possible, with deterministic processing) for every track thread count,
+ * and compares the hash of the output (see VirtualDevice::GetOutputHash) against the fingerprint checked in for the SIMD target
+ * this was built for. Every thread count has to give the same output, and that output must match the fingerprint exactly,
+ * so any change to what the Mixer, the SIMD kernels or the effects output fails here, however small.
+ *
+ * The buses that only feed other buses are each rendered once more turned all the way down, which has to change the output,
+ * so a bus that doesn't contribute anything (and the fingerprint that was taken with it silent) fails here too.
+ *
+ * When a change is meant to change the output, run this with --print (for every SIMD target) and replace the fingerprints of that target.
+ * The fingerprints are of x86-64 builds with GCC, without fused multiply-adds (see DIGIDAW_SIMD_OPTIONS), other compilers and standard libraries can compute the effects' coefficients differently.
+ * There are none for AVX (without AVX2) yet, as the SIMD kernels don't compile for it with this version of libsimdpp.
+ */
+
+static constexpr unsigned int sampleRate = 48000;
+static constexpr unsigned int bufferSize = 256;
+static constexpr unsigned int renderFrames = sampleRate;
+static constexpr unsigned int nOutputChannels = 8;
+static constexpr std::size_t threadCounts[] = { 1, 2, 4, 16 };
+
+#if defined(SIMDPP_ARCH_X86_AVX2)
+static constexpr const char* simdTarget = "AVX2";
+#elif defined(SIMDPP_ARCH_X86_AVX)
+static constexpr const char* simdTarget = "AVX";
+#else
+static constexpr const char* simdTarget = "None";
+#endif
+
+using Mapping = std::vector<std::vector<unsigned int>>;
+
+struct Fingerprint
+{
+	const char* session;
+	const char* target;
+	std::uint64_t hash;
+};
+
+static constexpr Fingerprint fingerprints[] =
+{
+	{ "Routing", "None", 0x90ce49fcf1093e48ull },
+	{ "Panning and gain", "None", 0x2bdeefd51cae4cbeull },
+	{ "Surround", "None", 0x16d363f698d235a6ull },
+	{ "Effects", "None", 0x6ca8d82289ef978dull },
+	{ "Live input", "None", 0xe8b906ba505c8827ull },
+	{ "Routing", "AVX2", 0x90ce49fcf1093e48ull },
+	{ "Panning and gain", "AVX2", 0x2bdeefd51cae4cbeull },
+	{ "Surround", "AVX2", 0x16d363f698d235a6ull },
+	{ "Effects", "AVX2", 0x6ca8d82289ef978dull },
+	{ "Live input", "AVX2", 0xe8b906ba505c8827ull },
+};
+
+// Noise and a sawtooth from integer arithmetic only, so the clips are the same on every platform.
+static std::shared_ptr<const AudioBuffer> MakeClip(unsigned int nChannels, unsigned int nFrames, std::uint32_t seed, unsigned int period)
+{
+	std::shared_ptr<AudioBuffer> clip = std::make_shared<AudioBuffer>(nChannels, nFrames);
+	std::uint32_t state = seed;
+	for (unsigned int channel = 0; channel < nChannels; ++channel)
+	{
+		float* samples = clip->GetChannel(channel);
+		for (unsigned int frame = 0; frame < nFrames; ++frame)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			const float noise = static_cast<float>(static_cast<std::int32_t>(state) >> 8) / 8388608.0f;
+			const float saw = static_cast<float>((frame + channel * period / 4) % period) / static_cast<float>(period) * 2.0f - 1.0f;
+			samples[frame] = 0.125f * noise + 0.25f * saw;
+		}
+	}
+	return clip;
+}
+
+static std::shared_ptr<TrackState::Track> AddTrack(
+	Engine& engine, const char* name, TrackState::ChannelNumber nChannels, float gain, float pan, const std::shared_ptr<const AudioBuffer>& clip)
+{
+	std::shared_ptr<TrackState::Track> track = engine.trackState.AddTrack(TrackState::Track(name, nChannels, gain, pan));
+	engine.mixer.SetClip(track, clip);
+	return track;
+}
+
+static std::vector<std::vector<unsigned int>> Outputs(unsigned int firstChannel, unsigned int nChannels)
+{
+	std::vector<std::vector<unsigned int>> outputs;
+	for (unsigned int channel = 0; channel < nChannels; ++channel)
+		outputs.push_back({ firstChannel + channel });
+	return outputs;
+}
+
+// Tracks into buses into other buses, onto different device channels, with every kind of channel mapping.
+static void BuildRouting(Engine& engine)
+{
+	std::shared_ptr<TrackState::Track> stereo = AddTrack(engine, "Stereo", TrackState::ChannelNumber::Stereo, 0.0f, 0.0f, MakeClip(2, renderFrames, 1, 100));
+	std::shared_ptr<TrackState::Track> mono = AddTrack(engine, "Mono", TrackState::ChannelNumber::Mono, -6.0f, 0.0f, MakeClip(1, renderFrames / 2, 2, 441));
+	std::shared_ptr<TrackState::Track> wide = AddTrack(engine, "Wide", TrackState::ChannelNumber::Stereo, -3.0f, 0.0f, MakeClip(1, renderFrames, 3, 64));
+
+	std::shared_ptr<TrackState::Bus> group = engine.trackState.AddBus(TrackState::Bus("Group", TrackState::ChannelNumber::Stereo, -2.0f, 0.0f,
+		Outputs(2, 2),
+		{
+			TrackState::TrackInput(mono, TrackState::ChannelMapping(Mapping{ { 0, 1 } })),
+			TrackState::TrackInput(wide, TrackState::ChannelMapping(Mapping{ { 1 }, { 0 } }))
+		},
+		{}));
+	engine.trackState.AddBus(TrackState::Bus("Main", TrackState::ChannelNumber::Stereo, 0.0f, 0.0f,
+		Outputs(0, 2),
+		{ TrackState::TrackInput(stereo, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })) },
+		{ TrackState::BusInput(group, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })) }));
+}
+
+// Gains and pans on tracks and buses, including the balance of stereo tracks and a mono bus spread onto two channels.
+static void BuildPanningAndGain(Engine& engine)
+{
+	std::shared_ptr<TrackState::Track> left = AddTrack(engine, "Left", TrackState::ChannelNumber::Mono, -1.5f, -75.0f, MakeClip(1, renderFrames, 4, 120));
+	std::shared_ptr<TrackState::Track> right = AddTrack(engine, "Right", TrackState::ChannelNumber::Mono, -9.0f, 40.0f, MakeClip(1, renderFrames, 5, 300));
+	std::shared_ptr<TrackState::Track> balance = AddTrack(engine, "Balance", TrackState::ChannelNumber::Stereo, 3.0f, 60.0f, MakeClip(2, renderFrames, 6, 77));
+
+	std::shared_ptr<TrackState::Bus> mono = engine.trackState.AddBus(TrackState::Bus("Mono", TrackState::ChannelNumber::Mono, -4.0f, 0.0f,
+		{},
+		{ TrackState::TrackInput(balance, TrackState::ChannelMapping(Mapping{ { 0 }, { 0 } })) },
+		{}));
+	engine.trackState.AddBus(TrackState::Bus("Main", TrackState::ChannelNumber::Stereo, -1.0f, -20.0f,
+		Outputs(0, 2),
+		{
+			TrackState::TrackInput(left, TrackState::ChannelMapping(Mapping{ { 0, 1 } })),
+			TrackState::TrackInput(right, TrackState::ChannelMapping(Mapping{ { 0, 1 } }))
+		},
+		{ TrackState::BusInput(mono, TrackState::ChannelMapping(Mapping{ { 0, 1 } })) }));
+}
+
+// Mono and stereo tracks panned onto 5.1 and 7.1 layouts, and a 5.1 bus downmixed onto a stereo one.
+static void BuildSurround(Engine& engine)
+{
+	std::shared_ptr<TrackState::Track> front = AddTrack(engine, "Front", TrackState::ChannelNumber::Mono, 0.0f, -30.0f, MakeClip(1, renderFrames, 7, 200));
+	front->panDepth = 20.0f;
+	std::shared_ptr<TrackState::Track> back = AddTrack(engine, "Back", TrackState::ChannelNumber::Mono, -3.0f, 70.0f, MakeClip(1, renderFrames, 8, 150));
+	back->panDepth = 90.0f;
+	std::shared_ptr<TrackState::Track> stereo = AddTrack(engine, "Stereo", TrackState::ChannelNumber::Stereo, -6.0f, 0.0f, MakeClip(2, renderFrames, 9, 90));
+
+	std::shared_ptr<TrackState::Bus> surround = engine.trackState.AddBus(TrackState::Bus("5.1", TrackState::ChannelNumber::Surround_5_1, 0.0f, 0.0f,
+		Outputs(2, 6),
+		{
+			TrackState::TrackInput(front, TrackState::ChannelMapping(Mapping{ { 0, 1, 2, 3, 4, 5 } }, true)),
+			TrackState::TrackInput(back, TrackState::ChannelMapping(Mapping{ { 0, 1, 2, 3, 4, 5 } }, true))
+		},
+		{}));
+	std::shared_ptr<TrackState::Bus> wide = engine.trackState.AddBus(TrackState::Bus("7.1", TrackState::ChannelNumber::Surround_7_1, -2.0f, 0.0f,
+		{},
+		{ TrackState::TrackInput(stereo, TrackState::ChannelMapping(Mapping{ { 0, 1, 2, 3, 4, 5, 6, 7 }, { 0, 1, 2, 3, 4, 5, 6, 7 } }, true)) },
+		{}));
+	engine.trackState.AddBus(TrackState::Bus("Downmix", TrackState::ChannelNumber::Stereo, -3.0f, 0.0f,
+		Outputs(0, 2),
+		{},
+		{
+			TrackState::BusInput(surround, TrackState::ChannelMapping(Mapping{ { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 } }, true)),
+			TrackState::BusInput(wide, TrackState::ChannelMapping(Mapping{ { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 } }, true))
+		}));
+}
+
+// Every effect, on tracks and buses, with the latency of the convolution compensated on the parallel paths,
+// and a bus that sums in double precision.
+static void BuildEffects(Engine& engine)
+{
+	std::shared_ptr<TrackState::Track> equalized = AddTrack(engine, "Equalized", TrackState::ChannelNumber::Stereo, -3.0f, 0.0f, MakeClip(2, renderFrames, 10, 50));
+	std::shared_ptr<TrackState::Track> compressed = AddTrack(engine, "Compressed", TrackState::ChannelNumber::Mono, 0.0f, 10.0f, MakeClip(1, renderFrames, 11, 500));
+	std::shared_ptr<TrackState::Track> dry = AddTrack(engine, "Dry", TrackState::ChannelNumber::Stereo, -6.0f, 0.0f, MakeClip(2, renderFrames / 4, 12, 33));
+
+	std::shared_ptr<Effects::Equalizer> equalizer = std::make_shared<Effects::Equalizer>();
+	equalizer->SetBand(0, Effects::Equalizer::Band(Effects::Equalizer::FilterType::HighPass, 80.0f, 0.0f, 0.707f));
+	equalizer->SetBand(1, Effects::Equalizer::Band(Effects::Equalizer::FilterType::Bell, 1000.0f, 6.0f, 1.0f));
+	equalizer->SetBand(2, Effects::Equalizer::Band(Effects::Equalizer::FilterType::HighShelf, 8000.0f, -4.0f, 0.707f));
+	engine.mixer.AddEffect(equalized, equalizer);
+
+	Effects::Dynamics::Parameters parameters;
+	parameters.detection = Effects::Dynamics::Detection::RMS;
+	parameters.threshold = -24.0f;
+	parameters.makeupGain = 6.0f;
+	std::shared_ptr<Effects::Dynamics> dynamics = std::make_shared<Effects::Dynamics>();
+	dynamics->SetParameters(parameters);
+	engine.mixer.AddEffect(compressed, dynamics);
+
+	std::shared_ptr<TrackState::Bus> reverb = engine.trackState.AddBus(TrackState::Bus("Reverb", TrackState::ChannelNumber::Stereo, -6.0f, 0.0f,
+		{},
+		{
+			TrackState::TrackInput(equalized, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })),
+			TrackState::TrackInput(compressed, TrackState::ChannelMapping(Mapping{ { 0, 1 } }))
+		},
+		{}));
+	std::shared_ptr<Effects::Convolution> convolution = std::make_shared<Effects::Convolution>();
+	engine.mixer.AddEffect(reverb, convolution);
+	std::shared_ptr<const AudioBuffer> impulse = MakeClip(2, sampleRate / 4, 13, 1000);
+	std::vector<std::vector<float>> impulseResponse(2, std::vector<float>(impulse->GetFrameCount()));
+	for (unsigned int channel = 0; channel < 2; ++channel)
+		for (unsigned int frame = 0; frame < impulse->GetFrameCount(); ++frame)
+			impulseResponse[channel][frame] = impulse->GetChannel(channel)[frame] / static_cast<float>(1 + frame / 64);
+	convolution->SetImpulseResponse(impulseResponse, Effects::Convolution::Routing::PerChannel);
+
+	std::shared_ptr<TrackState::Bus> main = engine.trackState.AddBus(TrackState::Bus("Main", TrackState::ChannelNumber::Stereo, 0.0f, 0.0f,
+		Outputs(0, 2),
+		{
+			TrackState::TrackInput(equalized, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })),
+			TrackState::TrackInput(dry, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } }))
+		},
+		{ TrackState::BusInput(reverb, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })) }));
+	engine.mixer.SetDoublePrecisionSumming(main, true);
+}
+
+// A live track fed by the input device (from the input file), next to a track playing a clip.
+static void BuildLiveInput(Engine& engine)
+{
+	std::shared_ptr<TrackState::Track> live = engine.trackState.AddTrack(TrackState::Track("Live", TrackState::ChannelNumber::Stereo, -3.0f, 0.0f));
+	engine.mixer.SetLiveInput(live, true);
+	std::shared_ptr<TrackState::Track> clip = AddTrack(engine, "Clip", TrackState::ChannelNumber::Mono, -6.0f, 0.0f, MakeClip(1, renderFrames, 14, 240));
+
+	engine.trackState.AddBus(TrackState::Bus("Main", TrackState::ChannelNumber::Stereo, 0.0f, 0.0f,
+		Outputs(0, 2),
+		{
+			TrackState::TrackInput(live, TrackState::ChannelMapping(Mapping{ { 0 }, { 1 } })),
+			TrackState::TrackInput(clip, TrackState::ChannelMapping(Mapping{ { 0, 1 } }))
+		},
+		{}));
+}
+
+struct Session
+{
+	const char* name;
+	std::function<void(Engine&)> build;
+	bool liveInput;
+	std::vector<const char*> subBuses; // The buses that feed other buses, which all have to be audible.
+};
+
+static const std::filesystem::path inputPath = std::filesystem::temp_directory_path() / "digidaw_golden_render_input.wav";
+
+static ReturnCode WriteInputFile()
+{
+	std::shared_ptr<const AudioBuffer> input = MakeClip(2, renderFrames, 15, 128);
+	WavWriter writer;
+	if (writer.Open(inputPath, 2, sampleRate, renderFrames) != ReturnCode::Success) return ReturnCode::Error;
+	writer.Write(input->GetView(), renderFrames);
+	writer.Close();
+	return ReturnCode::Success;
+}
+
+// Renders the session on a new Engine, so nothing (like the state of an effect) carries over from another render.
+// A quietBus has its gain turned all the way down after the session is built.
+static bool Render(const Session& session, std::size_t nThreads, std::uint64_t& hash, const char* quietBus = nullptr)
+{
+	Engine engine(Engine::virtualAPI);
+
+	VirtualDevice::Settings settings;
+	settings.nOutputChannels = nOutputChannels;
+	settings.sampleRates = { sampleRate };
+	settings.simulateClock = false;
+	settings.lengthFrames = renderFrames;
+	if (session.liveInput) settings.inputPath = inputPath;
+	if (engine.SetVirtualDeviceSettings(settings) != ReturnCode::Success) return false;
+
+	Engine::EngineConfig config;
+	config.outputDevice = "Virtual Device";
+	config.inputDevice = session.liveInput ? "Virtual Device" : "";
+	config.sampleRate = sampleRate;
+	config.bufferSize = bufferSize;
+	if (engine.ApplyConfig(config) != ReturnCode::Success) return false;
+
+	engine.mixer.SetDeterministicProcessing(true);
+	engine.mixer.SetMaxTrackThreads(nThreads);
+	session.build(engine);
+	if (quietBus)
+		for (const std::shared_ptr<TrackState::Bus>& bus : engine.trackState.GetAllBuses())
+			if (std::strcmp(bus->name, quietBus) == 0) bus->gain = -200.0f;
+
+	engine.StartEngine();
+	const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (engine.IsStreamRunning())
+	{
+		if (std::chrono::steady_clock::now() >= timeout) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	VirtualDevice* device = engine.GetVirtualDevice();
+	if (!device || device->GetPlayedFrames() != renderFrames) return false;
+	hash = device->GetOutputHash();
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const bool print = argc > 1 && std::strcmp(argv[1], "--print") == 0;
+
+	const Session sessions[] =
+	{
+		{ "Routing", BuildRouting, false, { "Group" } },
+		{ "Panning and gain", BuildPanningAndGain, false, { "Mono" } },
+		{ "Surround", BuildSurround, false, { "5.1", "7.1" } },
+		{ "Effects", BuildEffects, false, { "Reverb" } },
+		{ "Live input", BuildLiveInput, true, {} }
+	};
+
+	if (WriteInputFile() != ReturnCode::Success)
+	{
+		std::printf("Couldn't write the input file %s\n", inputPath.string().c_str());
+		return 1;
+	}
+
+	int result = 0;
+	for (const Session& session : sessions)
+	{
+		std::uint64_t hash = 0;
+		for (std::size_t nThreads : threadCounts)
+		{
+			std::uint64_t threadHash = 0;
+			if (!Render(session, nThreads, threadHash))
+			{
+				std::printf("%s: couldn't render with %zu track threads\n", session.name, nThreads);
+				result = 1;
+			}
+			else if (nThreads != threadCounts[0] && threadHash != hash)
+			{
+				std::printf("%s: %zu track threads rendered 0x%016" PRIx64 ", 1 rendered 0x%016" PRIx64 "\n", session.name, nThreads, threadHash, hash);
+				result = 1;
+			}
+			if (nThreads == threadCounts[0]) hash = threadHash;
+		}
+
+		for (const char* bus : session.subBuses)
+		{
+			std::uint64_t quietHash = 0;
+			if (!Render(session, threadCounts[0], quietHash, bus))
+			{
+				std::printf("%s: couldn't render with the %s bus turned down\n", session.name, bus);
+				result = 1;
+			}
+			else if (quietHash == hash)
+			{
+				std::printf("%s: the %s bus is silent, turning it down didn't change the output\n", session.name, bus);
+				result = 1;
+			}
+		}
+
+		if (print)
+		{
+			std::printf("\t{ \"%s\", \"%s\", 0x%016" PRIx64 "ull },\n", session.name, simdTarget, hash);
+			continue;
+		}
+
+		const Fingerprint* fingerprint = nullptr;
+		for (const Fingerprint& candidate : fingerprints)
+			if (std::strcmp(candidate.session, session.name) == 0 && std::strcmp(candidate.target, simdTarget) == 0)
+				fingerprint = &candidate;
+
+		if (!fingerprint)
+		{
+			std::printf("%s: there's no fingerprint for %s, rendered 0x%016" PRIx64 "\n", session.name, simdTarget, hash);
+			result = 1;
+		}
+		else if (fingerprint->hash != hash)
+		{
+			std::printf("%s: rendered 0x%016" PRIx64 " on %s, the fingerprint is 0x%016" PRIx64 "\n", session.name, hash, simdTarget, fingerprint->hash);
+			result = 1;
+		}
+		else
+			std::printf("%s: matches on %s\n", session.name, simdTarget);
+	}
+
+	std::filesystem::remove(inputPath);
+	return result;
+}
@@ -12,6 +12,7 @@
 #include "digidaw/ui/windows/timeline.h"
 #include "digidaw/ui/windows/tracks.h"
 #include "digidaw/ui/windows/buses.h"
+#include "digidaw/ui/windows/spectrum_analyzer.h"
 
 #include <digidaw/core/audio/engine.h>
 
@@ -35,15 +36,19 @@ namespace DigiDAW::UI
 		std::unique_ptr<Windows::Timeline> timelineWindow;
 		std::unique_ptr<Windows::Tracks> tracksWindow;
 		std::unique_ptr<Windows::Buses> busesWindow;
+		std::unique_ptr<Windows::SpectrumAnalyzer> spectrumAnalyzerWindow;
 		
 		void InitializeDockspace(ImGuiID dockspace, ImGuiDockNodeFlags dockspaceFlags, ImVec2 size);
 		void RenderDockspace();
 		void RenderMenuBars();
+		void UpdateHistory();
 
 		bool hasDockspaceBeenInitialized = false;
 
 		bool shouldExit = false;
 
+		bool wasAnyItemActive = false;
+
 		const char* mainWindowDockspace = "MainWindowDock";
 		const char* dockspaceWindowTitle = "DockSpace";
 	public:
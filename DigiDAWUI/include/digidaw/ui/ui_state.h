@@ -6,6 +6,7 @@
 #include "digidaw/ui/gui_util.h"
 
 #include <digidaw/core/audio/engine.h>
+#include <digidaw/core/audio/trackhistory.h>
 
 namespace DigiDAW::UI
 {
@@ -98,17 +99,6 @@ namespace DigiDAW::UI
             style.Colors[ImGuiCol_TableRowBg] = ImVec4(windowBg.x * 1.25f, windowBg.y * 1.25f, windowBg.z * 1.25f, 1.0f);
         }
 
-        unsigned int GetDeviceByName(std::string name)
-        {
-            std::vector<Core::Audio::Engine::AudioDevice> devices = audioEngine->GetDevices();
-            for (Core::Audio::Engine::AudioDevice& device : devices)
-            {
-                if (device.info.name == name)
-                    return device.index;
-            }
-            return -1;
-        }
-
         bool SettingsTryGetFloat(const std::string& section, const std::string& name, float& out)
         {
             try
@@ -217,44 +207,55 @@ namespace DigiDAW::UI
             unsigned int settingsApi = static_cast<unsigned int>(RtAudio::Api::UNSPECIFIED);
             SettingsTryGetUInt("Audio", "api", settingsApi);
 
-            // Make sure that the API selected is supported and is within the enum range. Otherwise use the default.
-            const std::vector<RtAudio::Api>& supportedApis = audioEngine->GetSupportedAPIs();
-            if (settingsApi < RtAudio::Api::NUM_APIS &&
-                std::find(supportedApis.begin(), supportedApis.end(), settingsApi) != supportedApis.end())
+            // The devices are probed in the background, if the API wasn't found last time, wait to find out if it's there now.
+            const std::vector<RtAudio::Api>& cachedApis = audioEngine->GetSupportedAPIs();
+            if (settingsApi != RtAudio::Api::UNSPECIFIED && settingsApi < RtAudio::Api::NUM_APIS && audioEngine->IsProbingDevices() &&
+                std::find(cachedApis.begin(), cachedApis.end(), settingsApi) == cachedApis.end())
             {
-                audioEngine->ChangeBackend((RtAudio::Api)settingsApi);
+                audioEngine->ReconcileDevices(true);
             }
 
-            // Set the current input device.
-            unsigned int settingsInputDevice = audioEngine->GetCurrentInputDevice();
-            if (settingsStructure["Audio"]["inputDevice"] == "None")
-                settingsInputDevice = -1;
-            else
-                settingsInputDevice = GetDeviceByName(settingsStructure["Audio"]["inputDevice"]);
-            if (!settingsStructure["Audio"]["inputDevice"].empty()) audioEngine->SetCurrentInputDevice(settingsInputDevice);
+            // The audio settings are applied together, so the stream is only opened once.
+            Core::Audio::Engine::EngineConfig config;
 
-            // Set the current output device.
-            unsigned int settingsOutputDevice = audioEngine->GetCurrentOutputDevice();
-            if (settingsStructure["Audio"]["outputDevice"] == "None")
-                settingsOutputDevice = -1;
-            else
-                settingsOutputDevice = GetDeviceByName(settingsStructure["Audio"]["outputDevice"]);
-            if (!settingsStructure["Audio"]["outputDevice"].empty()) audioEngine->SetCurrentOutputDevice(settingsOutputDevice);
+            // Make sure that the API selected is supported and is within the enum range (which ends with the virtual device). Otherwise use the default.
+            const std::vector<RtAudio::Api>& supportedApis = audioEngine->GetSupportedAPIs();
+            if (settingsApi <= Core::Audio::Engine::virtualAPI &&
+                std::find(supportedApis.begin(), supportedApis.end(), settingsApi) != supportedApis.end())
+            {
+                config.api = (RtAudio::Api)settingsApi;
+            }
 
-            // Set the sample rate by default to the fastest supported sample rate.
-            const std::vector<unsigned int>& supportedSampleRates = audioEngine->GetSupportedSampleRates();
-            unsigned int settingsSampleRate = (supportedSampleRates.size() > 0) ? supportedSampleRates[supportedSampleRates.size() - 1] : -1;
-            // Try to load the sample rate from the ini file.
-            SettingsTryGetUInt("Audio", "sampleRate", settingsSampleRate);
+            // Set the devices by name ("None" is no device), the Engine finds them among the devices of the API.
+            if (!settingsStructure["Audio"]["inputDevice"].empty())
+                config.inputDevice = (settingsStructure["Audio"]["inputDevice"] == "None") ? std::string() : settingsStructure["Audio"]["inputDevice"];
+            if (!settingsStructure["Audio"]["outputDevice"].empty())
+                config.outputDevice = (settingsStructure["Audio"]["outputDevice"] == "None") ? std::string() : settingsStructure["Audio"]["outputDevice"];
 
-            // Make sure what we've picked is a supported sample rate, and if it is, set the current sample rate to it.
-            if (std::find(supportedSampleRates.begin(), supportedSampleRates.end(), settingsSampleRate) != supportedSampleRates.end())
-                audioEngine->SetCurrentSampleRate(settingsSampleRate);
+            // Without a sample rate the Engine picks the fastest one the devices support.
+            unsigned int settingsSampleRate = 0;
+            if (SettingsTryGetUInt("Audio", "sampleRate", settingsSampleRate))
+                config.sampleRate = settingsSampleRate;
 
-            // Set the current buffer size.
             unsigned int bufferSize = 0;
             if (SettingsTryGetUInt("Audio", "bufferSize", bufferSize))
-                audioEngine->SetCurrentBufferSize(bufferSize);
+                config.bufferSize = bufferSize;
+
+            // Nothing is applied if any of it can't be used, so drop what's most likely to be stale (the sample rate, then the devices) and try again.
+            if (audioEngine->ApplyConfig(config) != Core::Audio::ReturnCode::Success)
+            {
+                config.sampleRate.reset();
+                if (audioEngine->ApplyConfig(config) != Core::Audio::ReturnCode::Success)
+                {
+                    config.inputDevice.reset();
+                    config.outputDevice.reset();
+                    if (audioEngine->ApplyConfig(config) != Core::Audio::ReturnCode::Success)
+                    {
+                        config.bufferSize.reset();
+                        audioEngine->ApplyConfig(config);
+                    }
+                }
+            }
 
             SaveSettings(); // Save all the current settings to the ini file (just incase we had to reset anything due to errors)
         }
@@ -278,6 +279,7 @@ namespace DigiDAW::UI
 		ImFont* iconFont = nullptr;
 
 		std::shared_ptr<Core::Audio::Engine> audioEngine;
+		Core::Audio::TrackHistory trackHistory;
 
 		unsigned int currentStyle;
 
@@ -297,9 +299,9 @@ namespace DigiDAW::UI
             unsigned int currentInputDevice = audioEngine->GetCurrentInputDevice();
             unsigned int currentOutputDevice = audioEngine->GetCurrentOutputDevice();
             SettingsSave("Audio", "inputDevice",
-                (currentInputDevice != -1 && currentInputDevice < devices.size()) ? devices[currentInputDevice].info.name : "None");
+                (currentInputDevice != Core::Audio::Engine::noDevice && currentInputDevice < devices.size()) ? devices[currentInputDevice].info.name : "None");
             SettingsSave("Audio", "outputDevice",
-                (currentOutputDevice != -1 && currentOutputDevice < devices.size()) ? devices[currentOutputDevice].info.name : "None");
+                (currentOutputDevice != Core::Audio::Engine::noDevice && currentOutputDevice < devices.size()) ? devices[currentOutputDevice].info.name : "None");
 
             // UI
             SettingsSave("UI", "style", currentStyle);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "digidaw/ui/window.h"
+#include "digidaw/ui/ui_state.h"
+
+namespace DigiDAW::UI::Windows
+{
+	class SpectrumAnalyzer : public Window
+	{
+	private:
+		std::shared_ptr<UIState> state;
+
+		std::shared_ptr<Core::Audio::TrackState::Bus> currentBus;
+		std::shared_ptr<Core::Audio::SpectrumAnalyzer> analyzer; // Only enabled while the window is visible.
+
+		// Reused every frame, so drawing doesn't allocate.
+		std::vector<float> bands;
+		std::vector<float> peaks;
+
+		void SetAnalyzing(bool analyzing);
+		void SelectBus(const std::shared_ptr<Core::Audio::TrackState::Bus>& bus);
+		void RenderSpectrum();
+	public:
+		SpectrumAnalyzer(bool open, std::shared_ptr<UIState>& state);
+
+		void Render();
+		std::string GetName();
+	};
+}
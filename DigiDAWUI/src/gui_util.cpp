@@ -221,23 +221,23 @@ namespace DigiDAW::UI
             ImGui::VSliderFloat("##gain", ImVec2(20.0f, audioMeterFullHeight), &faderGainLinear, 0.0f, maxSlider, "",
                 ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_NoRoundToFormat);
 
-            const Core::Audio::Mixer::MixableInfo& mixableInfo = audioEngine->mixer.GetMixableInfo(mixable);
-            if (mixableInfo.channels.size() == 1)
+            const std::span<const Core::Audio::Mixer::ChannelInfo> channels = audioEngine->mixer.GetMeter(mixable);
+            if (channels.size() == 1)
             {
                 DrawAudioMeter("##audio_meter_layout",
-                    DecibelToPercentage(mixableInfo.channels[0].rms, audioEngine->mixer.minimumDecibelLevel),
-                    DecibelToPercentage(mixableInfo.channels[0].peak, audioEngine->mixer.minimumDecibelLevel),
-                        mixableInfo.channels[0].clip, audioMeterStyle);
+                    DecibelToPercentage(channels[0].rms, audioEngine->mixer.minimumDecibelLevel),
+                    DecibelToPercentage(channels[0].peak, audioEngine->mixer.minimumDecibelLevel),
+                        channels[0].clip, audioMeterStyle);
             }
-            else if (mixableInfo.channels.size() == 2)
+            else if (channels.size() == 2)
             {
                 DrawAudioMeterStereo("##audio_meter_layout",
-                    DecibelToPercentage(mixableInfo.channels[0].rms, audioEngine->mixer.minimumDecibelLevel),
-                    DecibelToPercentage(mixableInfo.channels[1].rms, audioEngine->mixer.minimumDecibelLevel),
-                    DecibelToPercentage(mixableInfo.channels[0].peak, audioEngine->mixer.minimumDecibelLevel),
-                    DecibelToPercentage(mixableInfo.channels[1].peak, audioEngine->mixer.minimumDecibelLevel),
-                        mixableInfo.channels[0].clip, 
-                        mixableInfo.channels[1].clip, audioMeterStyle);
+                    DecibelToPercentage(channels[0].rms, audioEngine->mixer.minimumDecibelLevel),
+                    DecibelToPercentage(channels[1].rms, audioEngine->mixer.minimumDecibelLevel),
+                    DecibelToPercentage(channels[0].peak, audioEngine->mixer.minimumDecibelLevel),
+                    DecibelToPercentage(channels[1].peak, audioEngine->mixer.minimumDecibelLevel),
+                        channels[0].clip, 
+                        channels[1].clip, audioMeterStyle);
             }
         }
         ImGui::EndHorizontal();
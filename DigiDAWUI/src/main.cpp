@@ -27,7 +27,7 @@ static void glfw_error_callback(int error, const char* description)
 
 int main()
 {
-	auto audioEngine = std::make_shared<Core::Audio::Engine>(RtAudio::Api::UNSPECIFIED);
+	auto audioEngine = std::make_shared<Core::Audio::Engine>(RtAudio::Api::UNSPECIFIED, "devices.cache");
 
     {
         std::shared_ptr<Core::Audio::TrackState::Track> track1 = audioEngine->trackState.AddTrack(
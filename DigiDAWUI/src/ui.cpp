@@ -46,6 +46,10 @@ namespace DigiDAW::UI
         timelineWindow = std::make_unique<Windows::Timeline>(true, state);
         tracksWindow = std::make_unique<Windows::Tracks>(true, state);
         busesWindow = std::make_unique<Windows::Buses>(true, state);
+        spectrumAnalyzerWindow = std::make_unique<Windows::SpectrumAnalyzer>(false, state);
+
+        // What the tracks and buses start as is what can be undone back to.
+        state->trackHistory.Commit(state->audioEngine->trackState);
 
         // Finally, start the audio engine.
         state->audioEngine->StartEngine();
@@ -55,8 +59,13 @@ namespace DigiDAW::UI
 	{
         clearColor = ImGui::GetStyleColorVec4(ImGuiCol_WindowBg);
 
+        // Pick up the devices from the background probe once it's done, and remember where they ended up.
+        if (state->audioEngine->ReconcileDevices())
+            state->SaveSettings();
+
         RenderMenuBars();
         RenderDockspace();
+        UpdateHistory();
 
         // For Development purposes...
         //ImGui::ShowDemoWindow();
@@ -68,6 +77,7 @@ namespace DigiDAW::UI
         timelineWindow->Render();
         tracksWindow->Render();
         busesWindow->Render();
+        spectrumAnalyzerWindow->Render();
 	}
 
     inline void UI::InitializeDockspace(ImGuiID dockspace, ImGuiDockNodeFlags dockspaceFlags, ImVec2 size)
@@ -85,6 +95,7 @@ namespace DigiDAW::UI
         ImGui::DockBuilderDockWindow(effectsChainWindow->GetName().c_str(), topId);
         ImGui::DockBuilderDockWindow(tracksWindow->GetName().c_str(), bottomId);
         ImGui::DockBuilderDockWindow(busesWindow->GetName().c_str(), bottomRightId);
+        ImGui::DockBuilderDockWindow(spectrumAnalyzerWindow->GetName().c_str(), topId);
 
         ImGui::DockBuilderFinish(dockspace);
     }
@@ -143,6 +154,11 @@ namespace DigiDAW::UI
 
                     if (ImGui::BeginMenu("Edit"))
                     {
+                        if (ImGui::MenuItem("Undo", "Ctrl+Z", false, state->trackHistory.CanUndo()))
+                            state->trackHistory.Undo(state->audioEngine->trackState, state->audioEngine->mixer);
+                        if (ImGui::MenuItem("Redo", "Ctrl+Y", false, state->trackHistory.CanRedo()))
+                            state->trackHistory.Redo(state->audioEngine->trackState, state->audioEngine->mixer);
+                        ImGui::Separator();
                         if (ImGui::MenuItem("Settings"))
                             settingsWindow->open = true;
                         ImGui::EndMenu();
@@ -153,6 +169,7 @@ namespace DigiDAW::UI
                         ImGui::MenuItem(effectsChainWindow->GetName().c_str(), nullptr, &effectsChainWindow->open);
                         ImGui::MenuItem(tracksWindow->GetName().c_str(), nullptr, &tracksWindow->open);
                         ImGui::MenuItem(busesWindow->GetName().c_str(), nullptr, &busesWindow->open);
+                        ImGui::MenuItem(spectrumAnalyzerWindow->GetName().c_str(), nullptr, &spectrumAnalyzerWindow->open);
                         ImGui::EndMenu();
                     }
 
@@ -186,11 +203,15 @@ namespace DigiDAW::UI
                             state->audioEngine->StartEngine();
                     }
 
+                    unsigned int sampleRate = state->audioEngine->GetCurrentSampleRate();
+                    unsigned int outputLatency = state->audioEngine->GetTotalOutputLatency();
+                    float outputLatencyMS = (sampleRate != 0) ? ((float)outputLatency / (float)sampleRate) * 1000.0f : 0.0f;
                     Util::TextRightAlign(
-                        fmt::format("Current API: {}   Sample Rate: {}hz   Buffer Size: {} Samples",
+                        fmt::format("Current API: {}   Sample Rate: {}hz   Buffer Size: {} Samples   Output Latency: {} Samples ({:.2f}ms)",
                             state->audioEngine->GetAPIDisplayName(state->audioEngine->GetCurrentAPI()),
-                            state->audioEngine->GetCurrentSampleRate(),
-                            state->audioEngine->GetCurrentBufferSize()).c_str(),
+                            sampleRate,
+                            state->audioEngine->GetCurrentBufferSize(),
+                            outputLatency, outputLatencyMS).c_str(),
                         10.0f); // Info Text
                     ImGui::EndMenuBar();
                 }
@@ -200,6 +221,25 @@ namespace DigiDAW::UI
         ImGui::PopStyleVar();
     }
 
+    inline void UI::UpdateHistory()
+    {
+        // An edit is finished once nothing is being dragged or typed into anymore, which is when it goes into the history.
+        const bool anyItemActive = ImGui::IsAnyItemActive();
+        if (wasAnyItemActive && !anyItemActive)
+            state->trackHistory.Commit(state->audioEngine->trackState);
+        wasAnyItemActive = anyItemActive;
+
+        // Not while typing, where they're the text's own undo and redo.
+        const ImGuiIO& io = ImGui::GetIO();
+        if (!anyItemActive && io.KeyCtrl && !io.WantTextInput)
+        {
+            if (ImGui::IsKeyPressed(ImGuiKey_Z, false))
+                state->trackHistory.Undo(state->audioEngine->trackState, state->audioEngine->mixer);
+            else if (ImGui::IsKeyPressed(ImGuiKey_Y, false))
+                state->trackHistory.Redo(state->audioEngine->trackState, state->audioEngine->mixer);
+        }
+    }
+
     ImVec4 UI::GetClearColor()
     {
         return clearColor;
@@ -113,8 +113,8 @@ namespace DigiDAW::UI::Windows
 
                                                     // TODO: Add option to display more channels 
                                                     // (the output device can have way more channels than just 2)
-                                                    const std::vector<Core::Audio::Mixer::ChannelInfo>& outputChannels =
-                                                        state->audioEngine->mixer.GetOutputInfo().channels;
+                                                    const std::span<const Core::Audio::Mixer::ChannelInfo> outputChannels =
+                                                        state->audioEngine->mixer.GetOutputMeter();
                                                     if (outputChannels.size() > 0)
                                                     {
                                                         if (outputChannels.size() >= 2)
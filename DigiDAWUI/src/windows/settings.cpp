@@ -48,10 +48,10 @@ namespace DigiDAW::UI::Windows
 
         // Input Device Dropdown
         unsigned int currentInput = state->audioEngine->GetCurrentInputDevice();
-        if (ImGui::BeginCombo("Input Device", (currentInput != -1) ? devices[currentInput].info.name.c_str() : "None"))
+        if (ImGui::BeginCombo("Input Device", (currentInput != Core::Audio::Engine::noDevice) ? devices[currentInput].info.name.c_str() : "None"))
         {
-            if (ImGui::Selectable("None", currentInput == -1))
-                state->audioEngine->SetCurrentInputDevice(-1);
+            if (ImGui::Selectable("None", currentInput == Core::Audio::Engine::noDevice))
+                state->audioEngine->SetCurrentInputDevice(Core::Audio::Engine::noDevice);
 
             for (Core::Audio::Engine::AudioDevice device : devices)
             {
@@ -70,10 +70,10 @@ namespace DigiDAW::UI::Windows
 
         // Output Device Dropdown
         unsigned int currentOutput = state->audioEngine->GetCurrentOutputDevice();
-        if (ImGui::BeginCombo("Output Device", (currentOutput != -1) ? devices[currentOutput].info.name.c_str() : "None"))
+        if (ImGui::BeginCombo("Output Device", (currentOutput != Core::Audio::Engine::noDevice) ? devices[currentOutput].info.name.c_str() : "None"))
         {
-            if (ImGui::Selectable("None", currentOutput == -1))
-                state->audioEngine->SetCurrentOutputDevice(-1);
+            if (ImGui::Selectable("None", currentOutput == Core::Audio::Engine::noDevice))
+                state->audioEngine->SetCurrentOutputDevice(Core::Audio::Engine::noDevice);
 
             for (Core::Audio::Engine::AudioDevice device : devices)
             {
@@ -138,6 +138,11 @@ namespace DigiDAW::UI::Windows
 
             ImGui::EndCombo();
         }
+
+        // How long the last change took, and how much of that the audio was faded out for.
+        const Core::Audio::Engine::ReconfigurationReport report = state->audioEngine->GetReconfigurationReport();
+        ImGui::TextUnformatted(
+            fmt::format("Last Reconfiguration: {:.1f}ms ({:.1f}ms without audio)", report.totalMS, report.reopenMS).c_str());
     }
 
     inline void Settings::RenderUITab()
@@ -0,0 +1,112 @@
+#define IMGUI_DEFINE_MATH_OPERATORS
+#include "imgui_internal.h"
+
+#include "digidaw/ui/windows/spectrum_analyzer.h"
+
+namespace DigiDAW::UI::Windows
+{
+	SpectrumAnalyzer::SpectrumAnalyzer(bool open, std::shared_ptr<UIState>& state)
+		: Window(open)
+	{
+		this->state = state;
+	}
+
+    std::string SpectrumAnalyzer::GetName()
+    {
+        return "Spectrum Analyzer";
+    }
+
+    void SpectrumAnalyzer::SetAnalyzing(bool analyzing)
+    {
+        if (analyzing && currentBus && !analyzer)
+            analyzer = state->audioEngine->mixer.EnableSpectrumAnalyzer(currentBus);
+        else if (!analyzing && analyzer)
+        {
+            state->audioEngine->mixer.DisableSpectrumAnalyzer(currentBus);
+            analyzer = nullptr;
+        }
+    }
+
+    void SpectrumAnalyzer::SelectBus(const std::shared_ptr<Core::Audio::TrackState::Bus>& bus)
+    {
+        if (bus == currentBus) return;
+
+        SetAnalyzing(false);
+        currentBus = bus;
+    }
+
+    inline void SpectrumAnalyzer::RenderSpectrum()
+    {
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        const ImVec2 position = ImGui::GetCursorScreenPos();
+        const ImVec2 size = ImGui::GetContentRegionAvail();
+        if (size.x <= 0.0f || size.y <= 0.0f) return;
+
+        drawList->AddRectFilled(position, position + size, ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+        if (!analyzer) return;
+
+        analyzer->GetBands(bands, peaks);
+        if (bands.empty()) return;
+
+        const float minimumDecibel = analyzer->GetSettings().minimumDecibel;
+        const ImU32 bandColor = ImGui::GetColorU32(state->audioMeterStyle.lowRangeColor);
+        const ImU32 peakColor = ImGui::GetColorU32(state->audioMeterStyle.highRangeColor);
+
+        const float bandWidth = size.x / static_cast<float>(bands.size());
+        for (std::size_t band = 0; band < bands.size(); ++band)
+        {
+            const float left = position.x + bandWidth * static_cast<float>(band);
+            const float right = left + std::max(bandWidth - 1.0f, 1.0f);
+            const float bottom = position.y + size.y;
+
+            const float bandHeight = Util::DecibelToPercentage(bands[band], minimumDecibel) * size.y;
+            const float peakHeight = Util::DecibelToPercentage(peaks[band], minimumDecibel) * size.y;
+
+            if (bandHeight > 0.0f)
+                drawList->AddRectFilled(ImVec2(left, bottom - bandHeight), ImVec2(right, bottom), bandColor);
+            if (peakHeight > 0.0f)
+                drawList->AddLine(ImVec2(left, bottom - peakHeight), ImVec2(right, bottom - peakHeight), peakColor);
+        }
+    }
+
+	void SpectrumAnalyzer::Render()
+	{
+        if (open)
+        {
+            if (ImGui::Begin(GetName().c_str(), &open, ImGuiWindowFlags_NoCollapse))
+            {
+                std::vector<std::shared_ptr<Core::Audio::TrackState::Bus>>& buses = state->audioEngine->trackState.GetAllBuses();
+
+                // Stop analyzing a bus that's been removed.
+                if (currentBus && std::find(buses.begin(), buses.end(), currentBus) == buses.end())
+                    SelectBus(nullptr);
+
+                if (ImGui::BeginCombo("Bus", currentBus ? currentBus->name : "None"))
+                {
+                    if (ImGui::Selectable("None", !currentBus))
+                        SelectBus(nullptr);
+
+                    for (std::size_t i = 0; i < buses.size(); ++i)
+                    {
+                        ImGui::PushID(static_cast<int>(i));
+                        if (ImGui::Selectable(buses[i]->name, buses[i] == currentBus))
+                            SelectBus(buses[i]);
+                        ImGui::PopID();
+                    }
+                    ImGui::EndCombo();
+                }
+
+                SetAnalyzing(true);
+                RenderSpectrum();
+            }
+            else
+            {
+                // Don't spend any time analyzing while the window is hidden.
+                SetAnalyzing(false);
+            }
+            ImGui::End();
+        }
+        else SetAnalyzing(false);
+	}
+}